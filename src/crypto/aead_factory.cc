@@ -0,0 +1,71 @@
+#include "crypto/aead_factory.h"
+#include "crypto/aesni_engine.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+using base::Status;
+
+namespace crypto {
+
+namespace {
+
+const char kAutoType[] = "auto";
+
+std::mutex* get_aead_factory_lock() {
+  static std::mutex aead_factory_lock;
+  return &aead_factory_lock;
+}
+
+typedef std::vector<std::pair<std::string, AEADFactory*>> AEADFactories;
+
+AEADFactories* aead_factories() {
+  static AEADFactories* factories = new AEADFactories;
+  return factories;
+}
+
+} // namespace
+
+// static
+void AEADFactory::Register(const std::string& aead_type,
+                           AEADFactory* factory) {
+  if (aead_type == kAutoType) {
+    LOG(ERROR) << "\"" << kAutoType << "\" is reserved for the preferred AEAD";
+    return;
+  }
+  std::lock_guard<std::mutex> l(*get_aead_factory_lock());
+  for (const auto& entry : *aead_factories()) {
+    if (entry.first == aead_type) {
+      LOG(ERROR) << "Two aead factories are being registered under "
+                 << aead_type;
+      return;
+    }
+  }
+  aead_factories()->push_back({aead_type, factory});
+}
+
+// static
+Status AEADFactory::GetFactory(const std::string& aead_type,
+                               AEADFactory** out_factory) {
+  const std::string type = aead_type == kAutoType ? AutoType() : aead_type;
+  std::lock_guard<std::mutex> l(*get_aead_factory_lock());
+  for (const auto& entry : *aead_factories()) {
+    if (entry.second->AcceptsOptions(type)) {
+      *out_factory = entry.second;
+      return Status::OK;
+    }
+  }
+  return Status(base::error::NOT_FOUND,
+                "No AEAD factory registered for the given aead_type: "
+                + aead_type);
+}
+
+// static
+const char* AEADFactory::AutoType() {
+  return AesNiEngine::Supported() ? "aes_gcm" : "chacha20_poly1305";
+}
+
+} // namespace crypto
@@ -0,0 +1,37 @@
+#ifndef CRYPTO_AEAD_FACTORY_H_
+#define CRYPTO_AEAD_FACTORY_H_
+
+#include "base/status.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/aes_key.h"
+
+#include <memory>
+#include <string>
+
+namespace crypto {
+
+// Factories for AEAD encryptors that take a 12-byte nonce and append a
+// 16-byte tag to the ciphertext (AES-GCM, ChaCha20-Poly1305), registered
+// by name the same way as AESFactory.
+class AEADFactory {
+ public:
+  virtual ~AEADFactory() {}
+
+  // |aad| is authenticated but not encrypted; it may be empty. Encrypt()
+  // seals one message under |iv|, and fails after that.
+  virtual std::unique_ptr<AESEncryptor> Create(std::unique_ptr<AESKey>& key,
+                                               const std::string& iv,
+                                               const std::string& aad) = 0;
+  virtual bool AcceptsOptions(const std::string& aead_type) = 0;
+
+  // "auto" is reserved for GetFactory().
+  static void Register(const std::string& aead_type, AEADFactory* factory);
+  // "auto" is AutoType(): AES-GCM where the CPU has AES-NI, and
+  // ChaCha20-Poly1305 where EVP AES falls back to table code.
+  static base::Status GetFactory(const std::string& aead_type,
+                                 AEADFactory** out_factory);
+  static const char* AutoType();
+};
+
+} // namespace crypto
+#endif // CRYPTO_AEAD_FACTORY_H_
@@ -0,0 +1,299 @@
+#include "crypto/aes_cipher_streams.h"
+#include "crypto/ssl_aes_util.h"
+
+#include "io/io_util.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const int kDefaultBlockSize = 64 << 10;
+const int kTagSize = 16;
+
+// Keys |ctx| for |mode|; false when the key or the IV do not fit it.
+bool InitCipher(EVP_CIPHER_CTX* ctx,
+                AESStreamMode mode,
+                strings::StringPiece raw_key,
+                const std::string& iv,
+                bool do_encrypt) {
+  const EVP_CIPHER* cipher = mode == kAESStreamCTR ?
+      SslAESUtil::CTRCipher(raw_key) : SslAESUtil::GCMCipher(raw_key);
+  size_t iv_size = mode == kAESStreamCTR ? 16 : 12;
+  if (!cipher) {
+    LOG(ERROR) << "Key must be 128 or 256 bits";
+    return false;
+  }
+  if (iv.size() != iv_size) {
+    LOG(ERROR) << "IV must be " << iv_size << " bytes";
+    return false;
+  }
+  if (!EVP_CipherInit_ex(ctx, cipher, nullptr,
+                         reinterpret_cast<const uint8_t*>(raw_key.data()),
+                         reinterpret_cast<const uint8_t*>(iv.data()),
+                         do_encrypt)) {
+    LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+// EncryptingOutputStream
+
+EncryptingOutputStream::EncryptingOutputStream(AESStreamMode mode,
+                                               strings::StringPiece raw_key,
+                                               const std::string& iv,
+                                               io::OutputStream* output)
+    : mode_(mode),
+      output_(output),
+      ok_(InitCipher(ctx_.get(), mode, raw_key, iv, true)),
+      closed_(false),
+      start_count_(output->ByteCount()),
+      trailer_size_(0),
+      pending_(nullptr),
+      pending_size_(0) {
+}
+
+EncryptingOutputStream::~EncryptingOutputStream() {
+  if (!closed_) {
+    Close();
+  }
+}
+
+bool EncryptingOutputStream::EncryptPending() {
+  if (pending_size_ > 0) {
+    int len = 0;
+    if (!EVP_CipherUpdate(ctx_.get(), pending_, &len,
+                          pending_, pending_size_) ||
+        len != pending_size_) {
+      LOG(ERROR) << "EVP_CipherUpdate: in_len: " << pending_size_
+                 << ", ERROR";
+      return false;
+    }
+  }
+  pending_ = nullptr;
+  pending_size_ = 0;
+  return true;
+}
+
+bool EncryptingOutputStream::Next(void** data, int* size) {
+  if (!ok_ || closed_) {
+    return false;
+  }
+  // The wrapped stream may flush its buffer on Next(), so what the caller
+  // wrote is encrypted first.
+  if (!EncryptPending() || !output_->Next(data, size)) {
+    ok_ = false;
+    return false;
+  }
+  pending_ = static_cast<uint8_t*>(*data);
+  pending_size_ = *size;
+  return true;
+}
+
+void EncryptingOutputStream::BackUp(int count) {
+  CHECK_GE(count, 0);
+  CHECK_LE(count, pending_size_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  pending_size_ -= count;
+  output_->BackUp(count);
+}
+
+int64_t EncryptingOutputStream::ByteCount() const {
+  return output_->ByteCount() - start_count_ - trailer_size_;
+}
+
+bool EncryptingOutputStream::Close() {
+  if (closed_) {
+    return ok_;
+  }
+  closed_ = true;
+  if (!ok_ || !EncryptPending()) {
+    ok_ = false;
+    return false;
+  }
+  if (mode_ == kAESStreamGCM) {
+    uint8_t final_block[kTagSize];
+    uint8_t tag[kTagSize];
+    int len = 0;
+    if (!EVP_CipherFinal_ex(ctx_.get(), final_block, &len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_GCM_GET_TAG, kTagSize,
+                             tag)) {
+      LOG(ERROR) << "EVP_CTRL_GCM_GET_TAG: ERROR";
+      ok_ = false;
+      return false;
+    }
+    if (!io::IOUtil::WriteToOutput(output_, tag, kTagSize)) {
+      ok_ = false;
+      return false;
+    }
+    trailer_size_ = kTagSize;
+  }
+  return true;
+}
+
+// DecryptingInputStream
+
+DecryptingInputStream::DecryptingInputStream(AESStreamMode mode,
+                                             strings::StringPiece raw_key,
+                                             const std::string& iv,
+                                             io::InputStream* input,
+                                             int block_size)
+    : mode_(mode),
+      input_(input),
+      done_(false),
+      buffer_size_(block_size > 0 ? block_size : kDefaultBlockSize),
+      buffer_used_(0),
+      backup_bytes_(0),
+      position_(0),
+      held_size_(0) {
+  if (!InitCipher(ctx_.get(), mode, raw_key, iv, false)) {
+    status_ = base::Status(base::error::INVALID_ARGUMENT,
+                           "Bad key or IV for the cipher stream");
+    done_ = true;
+  }
+}
+
+DecryptingInputStream::~DecryptingInputStream() {}
+
+bool DecryptingInputStream::Decrypt(const uint8_t* data,
+                                    int size,
+                                    int* out_size) {
+  if (size == 0) {
+    return true;
+  }
+  int len = 0;
+  if (!EVP_CipherUpdate(ctx_.get(), buffer_.get() + *out_size, &len,
+                        data, size) ||
+      len != size) {
+    LOG(ERROR) << "EVP_CipherUpdate: in_len: " << size << ", ERROR";
+    status_ = base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+    return false;
+  }
+  *out_size += len;
+  return true;
+}
+
+bool DecryptingInputStream::Finish() {
+  done_ = true;
+  if (mode_ != kAESStreamGCM) {
+    return true;
+  }
+  uint8_t final_block[kTagSize];
+  int len = 0;
+  if (held_size_ != kTagSize ||
+      !EVP_CIPHER_CTX_ctrl(ctx_.get(), EVP_CTRL_GCM_SET_TAG, kTagSize,
+                           held_) ||
+      !EVP_CipherFinal_ex(ctx_.get(), final_block, &len)) {
+    status_ = base::Status(base::error::DATA_LOSS,
+                           "GCM authentication tag mismatch");
+    return false;
+  }
+  return true;
+}
+
+bool DecryptingInputStream::Next(const void** data, int* size) {
+  if (backup_bytes_ > 0) {
+    *data = buffer_.get() + buffer_used_ - backup_bytes_;
+    *size = backup_bytes_;
+    position_ += backup_bytes_;
+    backup_bytes_ = 0;
+    return true;
+  }
+  if (!buffer_) {
+    buffer_.reset(new uint8_t[buffer_size_]);
+  }
+  while (!done_) {
+    const void* in_data;
+    int in_size;
+    if (!input_->Next(&in_data, &in_size)) {
+      Finish();
+      return false;
+    }
+    // At most a buffer's worth at a time; the rest comes next round.
+    int take = std::min(in_size, buffer_size_);
+    if (take < in_size) {
+      input_->BackUp(in_size - take);
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(in_data);
+
+    int out_size = 0;
+    if (mode_ == kAESStreamCTR) {
+      if (!Decrypt(in, take, &out_size)) {
+        done_ = true;
+        return false;
+      }
+    } else {
+      // Everything but the last 16 bytes seen so far is ciphertext.
+      int total = held_size_ + take;
+      if (total <= kTagSize) {
+        memcpy(held_ + held_size_, in, take);
+        held_size_ = total;
+        continue;
+      }
+      int emit = total - kTagSize;
+      int from_held = std::min(held_size_, emit);
+      int from_in = emit - from_held;
+      if (!Decrypt(held_, from_held, &out_size) ||
+          !Decrypt(in, from_in, &out_size)) {
+        done_ = true;
+        return false;
+      }
+      int kept = held_size_ - from_held;
+      memmove(held_, held_ + from_held, kept);
+      memcpy(held_ + kept, in + from_in, take - from_in);
+      held_size_ = kTagSize;
+    }
+    if (out_size == 0) {
+      continue;
+    }
+    buffer_used_ = out_size;
+    position_ += out_size;
+    *data = buffer_.get();
+    *size = out_size;
+    return true;
+  }
+  return false;
+}
+
+void DecryptingInputStream::BackUp(int count) {
+  CHECK_GE(count, 0);
+  CHECK_EQ(backup_bytes_, 0)
+      << " BackUp() can only be called after Next().";
+  CHECK_LE(count, buffer_used_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  backup_bytes_ = count;
+  position_ -= count;
+}
+
+bool DecryptingInputStream::Skip(int count) {
+  CHECK_GE(count, 0);
+  // Skipped bytes are still decrypted: the GCM tag covers them.
+  const void* data;
+  int size;
+  while (count > 0) {
+    if (!Next(&data, &size)) {
+      return false;
+    }
+    if (size > count) {
+      BackUp(size - count);
+      return true;
+    }
+    count -= size;
+  }
+  return true;
+}
+
+int64_t DecryptingInputStream::ByteCount() const {
+  return position_;
+}
+
+} // namespace crypto
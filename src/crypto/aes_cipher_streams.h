@@ -0,0 +1,124 @@
+#ifndef CRYPTO_AES_CIPHER_STREAMS_H_
+#define CRYPTO_AES_CIPHER_STREAMS_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "crypto/ssl_cipher_stream.h"
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "strings/string_piece.h"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace crypto {
+
+// Length-preserving AES modes the cipher streams can run in place.
+enum AESStreamMode {
+  kAESStreamCTR,  // 16-byte initial counter block
+  kAESStreamGCM,  // 12-byte nonce, 16-byte tag after the ciphertext
+};
+
+// An OutputStream that encrypts into the stream it wraps.
+//
+// Next() hands out the wrapped stream's own buffer; what the caller wrote
+// there is encrypted in place on the following Next() or Close(), so a
+// producer writes straight into the ciphertext with no copy in between.
+// The output is byte-for-byte what SslAESUtil::CTREncrypt() or
+// SslGcmAESEncryptor produce for the same key and IV.
+class EncryptingOutputStream : public io::OutputStream {
+ public:
+  EncryptingOutputStream(AESStreamMode mode,
+                         strings::StringPiece raw_key,
+                         const std::string& iv,
+                         io::OutputStream* output);
+  // Closes the stream if Close() was not called.
+  virtual ~EncryptingOutputStream() override;
+
+  // False when the key or the IV were rejected.
+  bool ok() const { return ok_; }
+
+  // Encrypts the last buffer and, for GCM, appends the tag. Nothing may be
+  // written afterwards.
+  bool Close();
+
+  // From io::OutputStream. ByteCount() counts plaintext bytes.
+  virtual bool Next(void** data, int* size) override;
+  virtual void BackUp(int count) override;
+  virtual int64_t ByteCount() const override;
+
+ private:
+  // Encrypts the buffer handed out by the last Next().
+  bool EncryptPending();
+
+  const AESStreamMode mode_;
+  io::OutputStream* output_;
+  ScopedCipherCTX ctx_;
+  bool ok_;
+  bool closed_;
+  const int64_t start_count_;
+  // The GCM tag, once written.
+  int trailer_size_;
+
+  uint8_t* pending_;
+  int pending_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncryptingOutputStream);
+};
+
+// An InputStream that decrypts the stream it wraps.
+//
+// Input buffers are read-only, so each chunk of the wrapped stream is
+// decrypted once into a buffer of at most |block_size| bytes, which is what
+// Next() returns. With GCM the last 16 bytes of the wrapped stream are the
+// tag: it is checked when the wrapped stream ends, and only then does
+// Next() return false with an OK status(). As with SslGcmAESEncryptor,
+// plaintext is handed out before the tag is checked, so callers must drop
+// what they read when status() is not OK.
+class DecryptingInputStream : public io::InputStream {
+ public:
+  DecryptingInputStream(AESStreamMode mode,
+                        strings::StringPiece raw_key,
+                        const std::string& iv,
+                        io::InputStream* input,
+                        int block_size = -1);
+  virtual ~DecryptingInputStream() override;
+
+  // Why the stream stopped early: a rejected key or IV, a cipher error or,
+  // with DATA_LOSS, a missing or mismatched GCM tag.
+  base::Status status() const { return status_; }
+
+  // From io::InputStream. ByteCount() counts plaintext bytes.
+  virtual bool Next(const void** data, int* size) override;
+  virtual void BackUp(int count) override;
+  virtual bool Skip(int count) override;
+  virtual int64_t ByteCount() const override;
+
+ private:
+  // Decrypts |size| bytes from |data| to the end of the output buffer.
+  bool Decrypt(const uint8_t* data, int size, int* out_size);
+  // Checks the GCM tag once the wrapped stream ended.
+  bool Finish();
+
+  const AESStreamMode mode_;
+  io::InputStream* input_;
+  ScopedCipherCTX ctx_;
+  base::Status status_;
+  bool done_;
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  const int buffer_size_;
+  int buffer_used_;
+  int backup_bytes_;
+  int64_t position_;
+
+  // GCM: the trailing bytes that may turn out to be the tag.
+  uint8_t held_[16];
+  int held_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecryptingInputStream);
+};
+
+} // namespace crypto
+#endif // CRYPTO_AES_CIPHER_STREAMS_H_
@@ -1,7 +1,15 @@
 #include "crypto/aes_encryptor.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <mutex>
+#include <utility>
+#include <vector>
+
+#include "io/array_input_stream.h"
+#include "io/array_output_stream.h"
+#include "system/env.h"
 
 #include <glog/logging.h>
 
@@ -11,34 +19,211 @@ namespace crypto {
 
 namespace {
 
+const char kAutoType[] = "auto";
+const int kNumModes = AESFactory::kGCM + 1;
+const int kNumKeySizes = 2;
+
+// Input size and repetitions of the per-factory measurement.
+const int kBenchmarkSize = 64 << 10;
+const int kBenchmarkRounds = 8;
+
+// The registered factories. A published Registry is never modified:
+// Register() builds a new one, so lookups can read it without locking.
+// Only the "auto" choices are filled in later, once each.
+struct Registry {
+  Registry() {
+    for (int m = 0; m < kNumModes; ++m) {
+      for (int k = 0; k < kNumKeySizes; ++k) {
+        fastest[m][k].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::vector<std::pair<std::string, AESFactory*>> factories;
+
+  mutable std::once_flag measured[kNumModes][kNumKeySizes];
+  mutable std::atomic<AESFactory*> fastest[kNumModes][kNumKeySizes];
+};
+
 std::mutex* get_aes_factory_lock() {
   static std::mutex server_factory_lock;
   return &server_factory_lock;
 }
 
-typedef std::unordered_map<std::string, AESFactory*> AESFactories;
-AESFactories* aes_factories() {
-  static AESFactories* factories = new AESFactories;
-  return factories;
+// Replaced registries are not freed: a lookup may still be reading one.
+// Factories are registered a handful of times at startup.
+std::atomic<const Registry*>* current_registry() {
+  static std::atomic<const Registry*> registry(new Registry);
+  return &registry;
+}
+
+const char* ModeName(AESFactory::Mode mode) {
+  switch (mode) {
+    case AESFactory::kCBC: return "cbc";
+    case AESFactory::kECB: return "ecb";
+    case AESFactory::kCTR: return "ctr";
+    case AESFactory::kGCM: return "gcm";
+  }
+  return "unknown";
+}
+
+std::unique_ptr<AESEncryptor> CreateForMode(AESFactory* factory,
+                                            AESFactory::Mode mode,
+                                            std::unique_ptr<AESKey>& key) {
+  switch (mode) {
+    case AESFactory::kCBC:
+      return factory->CreateCBC(key, std::string(16, '\0'));
+    case AESFactory::kECB:
+      return factory->CreateECB(key);
+    case AESFactory::kCTR:
+      return factory->CreateCTR(key, std::string(16, '\0'));
+    case AESFactory::kGCM:
+      return factory->CreateGCM(key, std::string(12, '\0'));
+  }
+  return nullptr;
+}
+
+// Bytes per microsecond |factory| encrypts in |mode|, 0 when it cannot.
+double MeasureThroughput(AESFactory* factory,
+                         AESFactory::Mode mode,
+                         int key_size_in_bits) {
+  std::unique_ptr<AESKey> key = AESKey::Create(key_size_in_bits);
+  if (!key) {
+    return 0;
+  }
+
+  const std::vector<char> input(kBenchmarkSize, 'a');
+  std::vector<char> output(kBenchmarkSize + 32);
+  core::Env* env = core::Env::Default();
+  uint64_t best = std::numeric_limits<uint64_t>::max();
+  for (int i = 0; i < kBenchmarkRounds; ++i) {
+    // A GCM encryptor seals one message under the nonce it is built with,
+    // so every round gets its own.
+    std::unique_ptr<AESEncryptor> encryptor =
+        CreateForMode(factory, mode, key);
+    if (!encryptor) {
+      return 0;
+    }
+    io::ArrayInputStream in(input.data(), input.size());
+    io::ArrayOutputStream out(output.data(), output.size());
+    uint64_t start = env->NowMicros();
+    if (!encryptor->Encrypt(&in, &out).ok()) {
+      return 0;
+    }
+    best = std::min(best, env->NowMicros() - start);
+  }
+  return static_cast<double>(kBenchmarkSize) / std::max<uint64_t>(best, 1);
+}
+
+AESFactory* Fastest(const Registry& registry,
+                    AESFactory::Mode mode,
+                    int key_size_in_bits) {
+  const int k = key_size_in_bits == 128 ? 0 : 1;
+  std::call_once(registry.measured[mode][k], [&]() {
+    AESFactory* fastest = nullptr;
+    double fastest_speed = 0;
+    for (const auto& entry : registry.factories) {
+      if (!entry.second->IsAES()) {
+        continue;
+      }
+      double speed = MeasureThroughput(entry.second, mode, key_size_in_bits);
+      LOG(INFO) << "AES factory " << entry.first << ": " << ModeName(mode)
+                << "-" << key_size_in_bits << " " << speed << " MB/s";
+      if (speed > fastest_speed) {
+        fastest = entry.second;
+        fastest_speed = speed;
+      }
+    }
+    registry.fastest[mode][k].store(fastest, std::memory_order_release);
+  });
+  return registry.fastest[mode][k].load(std::memory_order_acquire);
 }
 
 } // namespace
 
+void AESEncryptor::EncryptBatch(const AESBatchRecord* records,
+                                int count,
+                                base::Status* statuses) {
+  for (int i = 0; i < count; ++i) {
+    statuses[i] = EncryptRecord(records[i]);
+  }
+}
+
+void AESEncryptor::DecryptBatch(const AESBatchRecord* records,
+                                int count,
+                                base::Status* statuses) {
+  for (int i = 0; i < count; ++i) {
+    statuses[i] = DecryptRecord(records[i]);
+  }
+}
+
+Status AESEncryptor::EncryptRecord(const AESBatchRecord& record) {
+  if (!record.iv.empty()) {
+    return Status(base::error::UNIMPLEMENTED,
+                  "Per-record IV not supported by this encryptor");
+  }
+  return Encrypt(record.input, record.output);
+}
+
+Status AESEncryptor::DecryptRecord(const AESBatchRecord& record) {
+  if (!record.iv.empty()) {
+    return Status(base::error::UNIMPLEMENTED,
+                  "Per-record IV not supported by this encryptor");
+  }
+  return Decrypt(record.input, record.output);
+}
+
 // static
 void AESFactory::Register(const std::string& encryptor_type,
                           AESFactory* factory) {
+  if (encryptor_type == kAutoType) {
+    LOG(ERROR) << "\"" << kAutoType << "\" is reserved for the fastest factory";
+    return;
+  }
   std::unique_lock<std::mutex> l(*get_aes_factory_lock());
-  if (!aes_factories()->insert({encryptor_type, factory}).second) {
-    LOG(ERROR) << "Two aes factories are begin registered under "
-               << encryptor_type;
+  const Registry* current = current_registry()->load(std::memory_order_acquire);
+  for (const auto& entry : current->factories) {
+    if (entry.first == encryptor_type) {
+      LOG(ERROR) << "Two aes factories are begin registered under "
+                 << encryptor_type;
+      return;
+    }
   }
+  Registry* next = new Registry;
+  next->factories = current->factories;
+  next->factories.push_back({encryptor_type, factory});
+  current_registry()->store(next, std::memory_order_release);
 }
 
 // static
 Status AESFactory::GetFactory(const std::string& encryptor_type,
                               AESFactory** out_factory) {
-  std::unique_lock<std::mutex> l(*get_aes_factory_lock());
-  for (const auto& aes_factory : *aes_factories()) {
+  return GetFactory(encryptor_type, kCBC, 128, out_factory);
+}
+
+// static
+Status AESFactory::GetFactory(const std::string& encryptor_type,
+                              Mode mode,
+                              int key_size_in_bits,
+                              AESFactory** out_factory) {
+  const Registry* registry =
+      current_registry()->load(std::memory_order_acquire);
+  if (encryptor_type == kAutoType) {
+    if (key_size_in_bits != 128 && key_size_in_bits != 256) {
+      return Status(base::error::INVALID_ARGUMENT,
+                    "AES key size must be 128 or 256 bits");
+    }
+    AESFactory* fastest = Fastest(*registry, mode, key_size_in_bits);
+    if (!fastest) {
+      return Status(base::error::NOT_FOUND,
+                    std::string("No AES Encryptor factory supports ")
+                    + ModeName(mode));
+    }
+    *out_factory = fastest;
+    return Status::OK;
+  }
+
+  for (const auto& aes_factory : registry->factories) {
     if (aes_factory.second->AcceptsOptions(encryptor_type)) {
       *out_factory = aes_factory.second;
       return Status::OK;
@@ -15,6 +15,14 @@ class OutputStream;
 
 namespace crypto {
 
+// One independent message of a batch.
+struct AESBatchRecord {
+  io::InputStream* input;
+  io::OutputStream* output;
+  // This record's IV; empty means the one the encryptor was built with.
+  std::string iv;
+};
+
 class AESEncryptor {
  public:
   virtual ~AESEncryptor() {}  
@@ -24,20 +32,62 @@ class AESEncryptor {
 
   virtual base::Status Decrypt(io::InputStream* input,
                                io::OutputStream* output) = 0;
+
+  // Encrypts |count| independent records and stores the result of each in
+  // |statuses|. By default the records run one after another through
+  // EncryptRecord(); encryptors with a multi-buffer kernel interleave them.
+  virtual void EncryptBatch(const AESBatchRecord* records,
+                            int count,
+                            base::Status* statuses);
+  // The same for decryption, through DecryptRecord().
+  virtual void DecryptBatch(const AESBatchRecord* records,
+                            int count,
+                            base::Status* statuses);
+
+ protected:
+  // Encrypts one record of a batch. The default only handles records
+  // without an IV of their own.
+  virtual base::Status EncryptRecord(const AESBatchRecord& record);
+  virtual base::Status DecryptRecord(const AESBatchRecord& record);
 };
 
 class AESFactory {
  public:
+  enum Mode {
+    kCBC,
+    kECB,
+    kCTR,
+    kGCM,
+  };
+
   virtual ~AESFactory() {}
 
   virtual std::unique_ptr<AESEncryptor> CreateCBC(std::unique_ptr<AESKey>& key, 
                                                   const std::string& iv) = 0;
   virtual std::unique_ptr<AESEncryptor> CreateECB(std::unique_ptr<AESKey>& key) = 0;
-  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key) = 0;
+  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) = 0;
+  virtual std::unique_ptr<AESEncryptor> CreateGCM(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) = 0;
   virtual bool AcceptsOptions(const std::string& encryptor_type) = 0;
+  // False for factories of another block cipher served through this
+  // interface (SM4): "auto" only picks among the AES factories.
+  virtual bool IsAES() const { return true; }
 
+  // "auto" is reserved for GetFactory().
   static void Register(const std::string& encryptor_type, AESFactory* factory);
+  // Lookups are served from an immutable snapshot of the registered
+  // factories, without taking a lock. "auto" is the fastest factory for
+  // CBC with 128-bit keys.
+  static base::Status GetFactory(const std::string& encryptor_type,
+                                 AESFactory** out_factory);
+  // Same, but "auto" is the fastest factory for |mode| and
+  // |key_size_in_bits| (128 or 256). Every registered factory is measured
+  // once per process for each mode and key size, the first time it is
+  // asked for.
   static base::Status GetFactory(const std::string& encryptor_type,
+                                 Mode mode,
+                                 int key_size_in_bits,
                                  AESFactory** out_factory);
 };
 
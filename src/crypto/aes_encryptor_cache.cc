@@ -0,0 +1,186 @@
+#include "crypto/aes_encryptor_cache.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+#include "third_party/boringssl/include/openssl/hmac.h"
+#include "third_party/boringssl/include/openssl/rand.h"
+
+#include <string.h>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kFingerprintSize = 32;
+
+// A cached keyed encryptor with the IV of one lookup, which it hands down
+// as the IV of every record.
+class IVBoundEncryptor : public AESEncryptor {
+ public:
+  IVBoundEncryptor(std::shared_ptr<AESEncryptor> keyed, const std::string& iv)
+      : keyed_(std::move(keyed)), iv_(iv) {}
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override {
+    AESBatchRecord record = {input, output, iv_};
+    base::Status status;
+    keyed_->EncryptBatch(&record, 1, &status);
+    return status;
+  }
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override {
+    AESBatchRecord record = {input, output, iv_};
+    base::Status status;
+    keyed_->DecryptBatch(&record, 1, &status);
+    return status;
+  }
+  virtual void EncryptBatch(const AESBatchRecord* records,
+                            int count,
+                            base::Status* statuses) override {
+    std::vector<AESBatchRecord> bound = Bind(records, count);
+    keyed_->EncryptBatch(bound.data(), count, statuses);
+  }
+  virtual void DecryptBatch(const AESBatchRecord* records,
+                            int count,
+                            base::Status* statuses) override {
+    std::vector<AESBatchRecord> bound = Bind(records, count);
+    keyed_->DecryptBatch(bound.data(), count, statuses);
+  }
+
+ private:
+  // |records|, with iv_ for those without an IV of their own.
+  std::vector<AESBatchRecord> Bind(const AESBatchRecord* records,
+                                   int count) const {
+    std::vector<AESBatchRecord> bound(records, records + count);
+    for (AESBatchRecord& record : bound) {
+      if (record.iv.empty()) {
+        record.iv = iv_;
+      }
+    }
+    return bound;
+  }
+
+  const std::shared_ptr<AESEncryptor> keyed_;
+  const std::string iv_;
+
+  DISALLOW_COPY_AND_ASSIGN(IVBoundEncryptor);
+};
+
+} // namespace
+
+AESEncryptorCache::AESEncryptorCache(AESFactory* factory,
+                                     size_t capacity,
+                                     int num_shards)
+    : factory_(factory),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {
+  CHECK(factory_);
+  CHECK_GT(num_shards, 0);
+  shard_capacity_ = (capacity + num_shards - 1) / num_shards;
+  if (shard_capacity_ == 0) {
+    shard_capacity_ = 1;
+  }
+  for (int i = 0; i < num_shards; ++i) {
+    shards_.emplace_back(new Shard);
+  }
+  CHECK_EQ(1, RAND_bytes(secret_, sizeof(secret_)));
+}
+
+AESEncryptorCache::~AESEncryptorCache() {
+  OPENSSL_cleanse(secret_, sizeof(secret_));
+}
+
+std::string AESEncryptorCache::CacheKey(AESFactory::Mode mode,
+                                        const AESKey& key) const {
+  std::string cache_key(1 + kFingerprintSize, '\0');
+  cache_key[0] = static_cast<char>(mode);
+  strings::StringPiece raw_key = key.key();
+  unsigned int mac_size = 0;
+  CHECK(HMAC(EVP_sha256(), secret_, sizeof(secret_),
+             reinterpret_cast<const uint8_t*>(raw_key.data()), raw_key.size(),
+             reinterpret_cast<uint8_t*>(&cache_key[1]), &mac_size));
+  DCHECK_EQ(kFingerprintSize, mac_size);
+  return cache_key;
+}
+
+std::shared_ptr<AESEncryptor> AESEncryptorCache::Get(
+    AESFactory::Mode mode,
+    std::unique_ptr<AESKey>& key,
+    const std::string& iv) {
+  if (mode != AESFactory::kCBC && mode != AESFactory::kECB) {
+    LOG(ERROR) << "Only CBC and ECB encryptors are cached: a shared CTR or "
+                  "GCM encryptor would reuse its nonce";
+    return nullptr;
+  }
+  if (!key) {
+    return nullptr;
+  }
+  std::shared_ptr<AESEncryptor> keyed = GetKeyed(mode, key);
+  if (!keyed || mode == AESFactory::kECB) {
+    return keyed;
+  }
+  return std::make_shared<IVBoundEncryptor>(std::move(keyed), iv);
+}
+
+std::shared_ptr<AESEncryptor> AESEncryptorCache::GetKeyed(
+    AESFactory::Mode mode,
+    std::unique_ptr<AESKey>& key) {
+  const std::string cache_key = CacheKey(mode, *key);
+  uint32_t hash;
+  memcpy(&hash, cache_key.data() + 1, sizeof(hash));
+  Shard* shard = shards_[hash % shards_.size()].get();
+
+  {
+    std::lock_guard<std::mutex> l(shard->mu);
+    auto it = shard->index.find(cache_key);
+    if (it != shard->index.end()) {
+      shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+      hits_++;
+      return it->second->second;
+    }
+  }
+
+  // Key expansion happens outside the lock; a concurrent miss on the same
+  // entry builds its own encryptor and the first one inserted wins.
+  misses_++;
+  // CBC is built with the zero IV; lookups pass their own per call.
+  std::shared_ptr<AESEncryptor> encryptor(
+      mode == AESFactory::kCBC ? factory_->CreateCBC(key, std::string())
+                               : factory_->CreateECB(key));
+  if (!encryptor) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> l(shard->mu);
+  auto it = shard->index.find(cache_key);
+  if (it != shard->index.end()) {
+    shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+    return it->second->second;
+  }
+  shard->lru.emplace_front(cache_key, encryptor);
+  shard->index[cache_key] = shard->lru.begin();
+  while (shard->lru.size() > shard_capacity_) {
+    shard->index.erase(shard->lru.back().first);
+    shard->lru.pop_back();
+    evictions_++;
+  }
+  return encryptor;
+}
+
+AESEncryptorCache::Stats AESEncryptorCache::stats() const {
+  Stats stats;
+  stats.hits = hits_.load();
+  stats.misses = misses_.load();
+  stats.evictions = evictions_.load();
+  stats.size = 0;
+  for (const std::unique_ptr<Shard>& shard : shards_) {
+    std::lock_guard<std::mutex> l(shard->mu);
+    stats.size += shard->lru.size();
+  }
+  return stats;
+}
+
+} // namespace crypto
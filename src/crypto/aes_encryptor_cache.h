@@ -0,0 +1,96 @@
+#ifndef CRYPTO_AES_ENCRYPTOR_CACHE_H_
+#define CRYPTO_AES_ENCRYPTOR_CACHE_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/aes_key.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace crypto {
+
+// A bounded cache of ready encryptors, so that a hot key does not pay for
+// key expansion and context setup on every request.
+//
+// Entries are keyed by mode and a fingerprint of the key: an HMAC of the
+// key bytes under a secret drawn when the cache is built. Raw keys are
+// never stored in the cache's own keys. An entry holds only the keyed
+// encryptor; the IV of a lookup travels with every call through a batch
+// record, so per-message IVs share one entry. Each shard has its own lock
+// and evicts least recently used entries; a returned encryptor stays
+// valid after it is evicted. Encryptors are shared between callers, so
+// only thread-safe encryptors (all of the Ssl* and AesNi* ones) belong
+// here.
+//
+// Only CBC and ECB are cached. One CTR or GCM encryptor handed to many
+// callers is one nonce used for many messages, so those are refused.
+class AESEncryptorCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t size;
+  };
+
+  // Creates encryptors through |factory| and holds at most |capacity| of
+  // them, spread over |num_shards| shards.
+  AESEncryptorCache(AESFactory* factory, size_t capacity, int num_shards = 16);
+  ~AESEncryptorCache();
+
+  // An encryptor for |key| in |mode| with |iv| (ignored for ECB), over the
+  // cached keyed encryptor, which is created on a miss. nullptr for CTR
+  // and GCM, and when the factory fails.
+  std::shared_ptr<AESEncryptor> Get(AESFactory::Mode mode,
+                                    std::unique_ptr<AESKey>& key,
+                                    const std::string& iv);
+
+  std::shared_ptr<AESEncryptor> GetCBC(std::unique_ptr<AESKey>& key,
+                                       const std::string& iv) {
+    return Get(AESFactory::kCBC, key, iv);
+  }
+  std::shared_ptr<AESEncryptor> GetECB(std::unique_ptr<AESKey>& key) {
+    return Get(AESFactory::kECB, key, std::string());
+  }
+
+  Stats stats() const;
+
+ private:
+  typedef std::pair<std::string, std::shared_ptr<AESEncryptor>> Entry;
+
+  struct Shard {
+    std::mutex mu;
+    // Most recently used first.
+    std::list<Entry> lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  };
+
+  // Mode and fingerprint of a lookup.
+  std::string CacheKey(AESFactory::Mode mode, const AESKey& key) const;
+  // The keyed encryptor, from the cache or just built.
+  std::shared_ptr<AESEncryptor> GetKeyed(AESFactory::Mode mode,
+                                         std::unique_ptr<AESKey>& key);
+
+  AESFactory* factory_;
+  size_t shard_capacity_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  uint8_t secret_[32];
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> evictions_;
+
+  DISALLOW_COPY_AND_ASSIGN(AESEncryptorCache);
+};
+
+} // namespace crypto
+#endif // CRYPTO_AES_ENCRYPTOR_CACHE_H_
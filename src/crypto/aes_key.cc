@@ -1,5 +1,6 @@
 #include "crypto/aes_key.h"
 
+#include "third_party/boringssl/include/openssl/crypto.h"
 #include "third_party/boringssl/include/openssl/evp.h"
 #include "third_party/boringssl/include/openssl/rand.h"
 
@@ -9,6 +10,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 namespace crypto {
 
@@ -23,6 +25,16 @@ bool IsValidBytesLen(int key_size_in_bytes) {
   return IsValidBitsLen(key_size_in_bytes * 8);
 }
 
+// Copies |size| bytes into a fresh arena slot.
+std::shared_ptr<const SecureKeyBytes> CopyToArena(const char* bytes,
+                                                  size_t size) {
+  std::shared_ptr<SecureKeyBytes> key = SecureKeyBytes::Allocate(size);
+  if (key) {
+    memcpy(key->data(), bytes, size);
+  }
+  return key;
+}
+
 } // namespace
 
 AESKey::~AESKey() {}
@@ -33,15 +45,43 @@ std::unique_ptr<AESKey> AESKey::Create(int key_size_in_bits) {
     return nullptr;
   }
   OpenSSLErrStackTracer err_tracer(FROM_HERE);
-  std::unique_ptr<AESKey> key(new AESKey);
-
   size_t key_size_in_bytes = key_size_in_bits / 8;
-  uint8_t* key_data = reinterpret_cast<uint8_t*>(
-    strings::WriteInto(&key->key_, key_size_in_bytes + 1));
-
-  int rv = RAND_bytes(key_data,
+  std::shared_ptr<SecureKeyBytes> key_data =
+      SecureKeyBytes::Allocate(key_size_in_bytes);
+  if (!key_data) {
+    return nullptr;
+  }
+  int rv = RAND_bytes(key_data->data(),
                       static_cast<int>(key_size_in_bytes));
-  return rv == 1 ? std::move(key) : nullptr;
+  if (rv != 1) {
+    return nullptr;
+  }
+  return std::unique_ptr<AESKey>(new AESKey(std::move(key_data)));
+}
+
+// static
+std::unique_ptr<AESKey> AESKey::CreateXTS(int key_size_in_bits) {
+  if (key_size_in_bits != 256 && key_size_in_bits != 512) {
+    return nullptr;
+  }
+  OpenSSLErrStackTracer err_tracer(FROM_HERE);
+  const size_t half = key_size_in_bits / 16;
+  std::shared_ptr<SecureKeyBytes> key_data =
+      SecureKeyBytes::Allocate(2 * half);
+  if (!key_data) {
+    return nullptr;
+  }
+  uint8_t* bytes = key_data->data();
+  if (RAND_bytes(bytes, static_cast<int>(2 * half)) != 1) {
+    return nullptr;
+  }
+  // IEEE 1619 wants the data key and the tweak key to differ.
+  while (memcmp(bytes, bytes + half, half) == 0) {
+    if (RAND_bytes(bytes + half, static_cast<int>(half)) != 1) {
+      return nullptr;
+    }
+  }
+  return std::unique_ptr<AESKey>(new AESKey(std::move(key_data)));
 }
 
 // static
@@ -50,9 +90,13 @@ std::unique_ptr<AESKey> AESKey::FromHexString(const std::string& hex_string) {
   if (hex_bytes_string.empty()) {
     return nullptr;
   }
-  std::unique_ptr<AESKey> key(new AESKey);
-  key->key_ = std::move(hex_bytes_string);
-  return key;
+  std::shared_ptr<const SecureKeyBytes> key_data =
+      CopyToArena(hex_bytes_string.data(), hex_bytes_string.size());
+  OPENSSL_cleanse(&hex_bytes_string[0], hex_bytes_string.size());
+  if (!key_data) {
+    return nullptr;
+  }
+  return std::unique_ptr<AESKey>(new AESKey(std::move(key_data)));
 }
 
 // static
@@ -61,19 +105,27 @@ std::unique_ptr<AESKey> AESKey::FromBytesBuffer(const char* buffer,
   if (!IsValidBytesLen(len)) {
     return nullptr;
   }
-  std::unique_ptr<AESKey> key(new AESKey);
-  key->key_ = std::move(std::string(buffer, len));
-  return key;
+  std::shared_ptr<const SecureKeyBytes> key_data = CopyToArena(buffer, len);
+  if (!key_data) {
+    return nullptr;
+  }
+  return std::unique_ptr<AESKey>(new AESKey(std::move(key_data)));
+}
+
+std::unique_ptr<AESKey> AESKey::Clone() const {
+  return std::unique_ptr<AESKey>(new AESKey(key_));
 }
 
 std::string AESKey::ToHexString() const {
-  return strings::HexEncode(key_);
+  return strings::HexEncode(key().data(), key().size());
 }
 
 std::string AESKey::raw_key() const {
-  return key_;
+  return key().as_string();
 }
 
-AESKey::AESKey() = default;
+AESKey::AESKey(std::shared_ptr<const SecureKeyBytes> key)
+    : key_(std::move(key)) {
+}
 
 } // namespace crypto
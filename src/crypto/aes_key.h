@@ -2,6 +2,8 @@
 #define CRYPTO_AES_KEY_H_
 
 #include "base/macros.h"
+#include "crypto/secure_key_arena.h"
+#include "strings/string_piece.h"
 
 #include <memory>
 #include <string>
@@ -12,16 +14,27 @@ class AESKey {
  public:
   virtual ~AESKey();
 
+  // A random 128- or 256-bit key.
   static std::unique_ptr<AESKey> Create(int key_size_in_bits);
+  // A random XTS key pair, data key then tweak key: 256 bits for
+  // XTS-AES-128, 512 for XTS-AES-256. The two halves never match.
+  static std::unique_ptr<AESKey> CreateXTS(int key_size_in_bits);
   static std::unique_ptr<AESKey> FromHexString(const std::string& hex_string); 
   static std::unique_ptr<AESKey> FromBytesBuffer(const char* buffer, int len);
 
+  // Another handle on the same key bytes; nothing is copied.
+  std::unique_ptr<AESKey> Clone() const;
+
   std::string ToHexString() const;
+  // The key bytes, in a locked SecureKeyArena slot that lives as long as
+  // this key or any of its clones.
+  strings::StringPiece key() const { return key_->piece(); }
+  // A heap copy of key(); prefer key() on hot paths.
   std::string raw_key() const;
 
  private:
-  AESKey();
-  std::string key_;
+  explicit AESKey(std::shared_ptr<const SecureKeyBytes> key);
+  std::shared_ptr<const SecureKeyBytes> key_;
 
   DISALLOW_COPY_AND_ASSIGN(AESKey);
 };
@@ -0,0 +1,438 @@
+#include "crypto/aesni_aes_encryptor.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = 16;
+// Blocks handed to a kernel per call; bounds the output scratch buffer.
+const size_t kChunkBlocks = 4096;
+// Bytes of batch records encrypted together.
+const size_t kBatchGroupSize = 256 << 10;
+
+base::Status WriteError() {
+  return base::Status(base::error::INTERNAL, "Failed to write AES output");
+}
+
+// Appends everything left in |in| to |data|.
+void ReadAll(io::InputStream* in, std::string* data) {
+  const void* chunk;
+  int size;
+  while (in->Next(&chunk, &size)) {
+    data->append(reinterpret_cast<const char*>(chunk), size);
+  }
+}
+
+} // namespace
+
+// AesNiAESEncryptor
+
+AesNiAESEncryptor::AesNiAESEncryptor(strings::StringPiece raw_key,
+                                     const AesNiEngine::Kernels* kernels)
+    : key_ok_(false),
+      kernels_(kernels) {
+  if (!kernels_) {
+    LOG(ERROR) << "AES-NI not supported by this CPU";
+    return;
+  }
+  key_ok_ = AesNiEngine::ExpandKey(raw_key, &key_);
+}
+
+AesNiAESEncryptor::~AesNiAESEncryptor() {
+  memset(&key_, 0, sizeof(key_));
+}
+
+base::Status AesNiAESEncryptor::CheckReady() const {
+  if (!kernels_) {
+    return base::Status(base::error::UNIMPLEMENTED,
+                        "AES-NI not supported by this CPU");
+  }
+  if (!key_ok_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "AES-NI key must be 128 or 256 bits");
+  }
+  return base::Status::OK;
+}
+
+base::Status AesNiAESEncryptor::CryptPadded(bool do_encrypt,
+                                            const std::string& chain,
+                                            io::InputStream* in,
+                                            io::OutputStream* out) {
+  base::Status status = CheckReady();
+  if (!status.ok()) {
+    return status;
+  }
+
+  const bool chained = !chain.empty();
+  uint8_t chain_block[kBlockSize];
+  if (chained) {
+    DCHECK_EQ(chain.size(), kBlockSize);
+    memcpy(chain_block, chain.data(), kBlockSize);
+  }
+  auto process = [&](const uint8_t* src, uint8_t* dst, size_t blocks) {
+    if (chained) {
+      (do_encrypt ? kernels_->cbc_encrypt : kernels_->cbc_decrypt)(
+          key_, chain_block, src, dst, blocks);
+    } else {
+      (do_encrypt ? kernels_->ecb_encrypt : kernels_->ecb_decrypt)(
+          key_, src, dst, blocks);
+    }
+  };
+
+  // Left uninitialized: short messages should not pay for clearing it.
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[kChunkBlocks * kBlockSize]);
+  // Bytes of a block that is not complete yet. When decrypting, the last
+  // complete block also waits here: it holds the padding if the stream
+  // ends after it.
+  uint8_t carry[kBlockSize];
+  size_t carry_len = 0;
+  int64_t total = 0;
+
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t n = size;
+    total += size;
+    while (n > 0) {
+      if (carry_len == kBlockSize) {
+        process(carry, buffer.get(), 1);
+        if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+          return WriteError();
+        }
+        carry_len = 0;
+      }
+      if (carry_len > 0) {
+        size_t take = std::min(kBlockSize - carry_len, n);
+        memcpy(carry + carry_len, p, take);
+        carry_len += take;
+        p += take;
+        n -= take;
+        if (do_encrypt && carry_len == kBlockSize) {
+          process(carry, buffer.get(), 1);
+          if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+            return WriteError();
+          }
+          carry_len = 0;
+        }
+        continue;
+      }
+
+      size_t blocks = n / kBlockSize;
+      if (!do_encrypt && blocks > 0 && n % kBlockSize == 0) {
+        blocks--;
+      }
+      blocks = std::min(blocks, kChunkBlocks);
+      if (blocks == 0) {
+        memcpy(carry, p, n);
+        carry_len = n;
+        break;
+      }
+      process(p, buffer.get(), blocks);
+      if (!io::IOUtil::WriteToOutput(out, buffer.get(),
+                                     blocks * kBlockSize)) {
+        return WriteError();
+      }
+      p += blocks * kBlockSize;
+      n -= blocks * kBlockSize;
+    }
+  }
+
+  // Like the EVP path, an empty stream maps to an empty stream.
+  if (total == 0) {
+    return base::Status::OK;
+  }
+
+  if (do_encrypt) {
+    uint8_t pad = static_cast<uint8_t>(kBlockSize - carry_len);
+    memset(carry + carry_len, pad, pad);
+    process(carry, buffer.get(), 1);
+    if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+      return WriteError();
+    }
+    return base::Status::OK;
+  }
+
+  if (carry_len != kBlockSize) {
+    return base::Status(base::error::DATA_LOSS,
+                        "AES ciphertext is not a whole number of blocks");
+  }
+  process(carry, buffer.get(), 1);
+  uint8_t pad = buffer[kBlockSize - 1];
+  bool bad = pad == 0 || pad > kBlockSize;
+  for (size_t i = kBlockSize - std::min<size_t>(pad, kBlockSize);
+       !bad && i < kBlockSize; ++i) {
+    bad = buffer[i] != pad;
+  }
+  if (bad) {
+    return base::Status(base::error::DATA_LOSS, "Bad AES padding");
+  }
+  if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize - pad)) {
+    return WriteError();
+  }
+  return base::Status::OK;
+}
+
+// AesNiEcbAESEncryptor
+
+AesNiEcbAESEncryptor::AesNiEcbAESEncryptor(strings::StringPiece raw_key,
+                                           const AesNiEngine::Kernels* kernels)
+    : AesNiAESEncryptor(raw_key, kernels) {
+}
+
+AesNiEcbAESEncryptor::~AesNiEcbAESEncryptor() {}
+
+base::Status AesNiEcbAESEncryptor::Encrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  return CryptPadded(true, "", in, out);
+}
+
+base::Status AesNiEcbAESEncryptor::Decrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  return CryptPadded(false, "", in, out);
+}
+
+// AesNiCbcAESEncryptor
+
+AesNiCbcAESEncryptor::AesNiCbcAESEncryptor(strings::StringPiece raw_key,
+                                           const std::string& iv,
+                                           const AesNiEngine::Kernels* kernels)
+    : AesNiAESEncryptor(raw_key, kernels),
+      iv_(iv.empty() ? std::string(kBlockSize, '\0') : iv) {
+}
+
+AesNiCbcAESEncryptor::~AesNiCbcAESEncryptor() {}
+
+base::Status AesNiCbcAESEncryptor::Encrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  return Crypt(true, iv_, in, out);
+}
+
+base::Status AesNiCbcAESEncryptor::Decrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  return Crypt(false, iv_, in, out);
+}
+
+base::Status AesNiCbcAESEncryptor::EncryptRecord(
+    const AESBatchRecord& record) {
+  return Crypt(true, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status AesNiCbcAESEncryptor::DecryptRecord(
+    const AESBatchRecord& record) {
+  return Crypt(false, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status AesNiCbcAESEncryptor::Crypt(bool do_encrypt,
+                                         const std::string& iv,
+                                         io::InputStream* in,
+                                         io::OutputStream* out) {
+  if (iv.size() != kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CBC iv must be 16 bytes");
+  }
+  return CryptPadded(do_encrypt, iv, in, out);
+}
+
+void AesNiCbcAESEncryptor::EncryptBatch(const AESBatchRecord* records,
+                                        int count,
+                                        base::Status* statuses) {
+  // Nothing to interleave.
+  if (count == 1) {
+    statuses[0] = EncryptRecord(records[0]);
+    return;
+  }
+  const base::Status ready = CheckReady();
+
+  // Records are gathered, padded, into one reused arena and encrypted in
+  // place a group at a time, which keeps the working set in cache.
+  struct Pending {
+    int record;
+    size_t offset;
+    size_t size;
+  };
+  std::string arena;
+  std::vector<Pending> group;
+
+  const int kNumLanes = AesNiEngine::kCbcLanes;
+  AesNiEngine::CbcLanes lanes;
+  size_t remaining[kNumLanes];
+  // Idle lanes spin on this block.
+  alignas(16) uint8_t scratch[kBlockSize] = {0};
+
+  auto flush = [&]() {
+    size_t next = 0;
+    auto assign = [&](int lane) {
+      if (next == group.size()) {
+        lanes.in[lane] = scratch;
+        lanes.out[lane] = scratch;
+        lanes.stride[lane] = 0;
+        remaining[lane] = 0;
+        return;
+      }
+      const Pending& pending = group[next++];
+      const std::string& iv = records[pending.record].iv.empty()
+                                  ? iv_ : records[pending.record].iv;
+      memcpy(lanes.chain[lane], iv.data(), kBlockSize);
+      uint8_t* data = reinterpret_cast<uint8_t*>(&arena[pending.offset]);
+      lanes.in[lane] = data;
+      lanes.out[lane] = data;
+      lanes.stride[lane] = kBlockSize;
+      remaining[lane] = pending.size / kBlockSize;
+    };
+
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      assign(lane);
+    }
+    while (true) {
+      // Run until the shortest active record is done.
+      size_t steps = 0;
+      for (int lane = 0; lane < kNumLanes; ++lane) {
+        if (remaining[lane] > 0 && (steps == 0 || remaining[lane] < steps)) {
+          steps = remaining[lane];
+        }
+      }
+      if (steps == 0) {
+        break;
+      }
+      kernels_->cbc_encrypt_lanes(key_, &lanes, steps);
+      for (int lane = 0; lane < kNumLanes; ++lane) {
+        if (remaining[lane] == 0) {
+          continue;
+        }
+        remaining[lane] -= steps;
+        if (remaining[lane] == 0) {
+          assign(lane);
+        }
+      }
+    }
+
+    for (const Pending& pending : group) {
+      if (!io::IOUtil::WriteToOutput(records[pending.record].output,
+                                     arena.data() + pending.offset,
+                                     pending.size)) {
+        statuses[pending.record] = WriteError();
+      }
+    }
+    group.clear();
+    arena.clear();
+  };
+
+  for (int i = 0; i < count; ++i) {
+    statuses[i] = ready;
+    if (!ready.ok()) {
+      continue;
+    }
+    const std::string& iv = records[i].iv.empty() ? iv_ : records[i].iv;
+    if (iv.size() != kBlockSize) {
+      statuses[i] = base::Status(base::error::INVALID_ARGUMENT,
+                                 "CBC iv must be 16 bytes");
+      continue;
+    }
+    size_t offset = arena.size();
+    ReadAll(records[i].input, &arena);
+    size_t size = arena.size() - offset;
+    // Like the EVP path, an empty record maps to an empty record.
+    if (size == 0) {
+      continue;
+    }
+    size_t pad = kBlockSize - size % kBlockSize;
+    arena.append(pad, static_cast<char>(pad));
+    group.push_back({i, offset, size + pad});
+    if (arena.size() >= kBatchGroupSize) {
+      flush();
+    }
+  }
+  flush();
+}
+
+// AesNiCtrAESEncryptor
+
+AesNiCtrAESEncryptor::AesNiCtrAESEncryptor(strings::StringPiece raw_key,
+                                           const std::string& iv,
+                                           const AesNiEngine::Kernels* kernels)
+    : AesNiAESEncryptor(raw_key, kernels),
+      iv_(iv) {
+}
+
+AesNiCtrAESEncryptor::~AesNiCtrAESEncryptor() {}
+
+base::Status AesNiCtrAESEncryptor::Encrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  base::Status status = CheckReady();
+  if (!status.ok()) {
+    return status;
+  }
+  if (iv_.size() != kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CTR iv must be 16 bytes");
+  }
+
+  uint8_t counter[kBlockSize];
+  memcpy(counter, iv_.data(), kBlockSize);
+  // Left uninitialized: short messages should not pay for clearing it.
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[kChunkBlocks * kBlockSize]);
+  // Keystream left over from a block that was only partly used.
+  uint8_t keystream[kBlockSize];
+  size_t keystream_used = kBlockSize;
+
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t n = size;
+    while (n > 0) {
+      if (keystream_used < kBlockSize) {
+        size_t take = std::min(kBlockSize - keystream_used, n);
+        for (size_t i = 0; i < take; ++i) {
+          buffer[i] = p[i] ^ keystream[keystream_used + i];
+        }
+        if (!io::IOUtil::WriteToOutput(out, buffer.get(), take)) {
+          return WriteError();
+        }
+        keystream_used += take;
+        p += take;
+        n -= take;
+        continue;
+      }
+
+      size_t blocks = std::min(n / kBlockSize, kChunkBlocks);
+      if (blocks == 0) {
+        // Encrypting a zero block yields the keystream for the tail.
+        memset(keystream, 0, kBlockSize);
+        kernels_->ctr_crypt(key_, counter, keystream, keystream, 1);
+        keystream_used = 0;
+        continue;
+      }
+      kernels_->ctr_crypt(key_, counter, p, buffer.get(), blocks);
+      if (!io::IOUtil::WriteToOutput(out, buffer.get(),
+                                     blocks * kBlockSize)) {
+        return WriteError();
+      }
+      p += blocks * kBlockSize;
+      n -= blocks * kBlockSize;
+    }
+  }
+  memset(keystream, 0, kBlockSize);
+  return base::Status::OK;
+}
+
+base::Status AesNiCtrAESEncryptor::Decrypt(io::InputStream* in,
+                                           io::OutputStream* out) {
+  return Encrypt(in, out);
+}
+
+} // namespace crypto
@@ -0,0 +1,121 @@
+#ifndef CRYPTO_AESNI_AES_ENCRYPTOR_H_
+#define CRYPTO_AESNI_AES_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/aesni_engine.h"
+#include "strings/string_piece.h"
+
+#include <string>
+
+namespace crypto {
+
+// Encryptors on the AesNiEngine kernels. The output is byte-for-byte what
+// the Ssl*AESEncryptor of the same mode produces, PKCS#7 padding included.
+// The key is expanded once in the constructor; calls keep their chaining
+// state on the stack, so an encryptor can be shared between threads.
+class AesNiAESEncryptor : public AESEncryptor {
+ public:
+  virtual ~AesNiAESEncryptor() override;
+
+ protected:
+  AesNiAESEncryptor(strings::StringPiece raw_key,
+                    const AesNiEngine::Kernels* kernels);
+
+  // OK, or why the key or the kernels are unusable.
+  base::Status CheckReady() const;
+
+  // Pads and encrypts (or decrypts and unpads) the whole stream with
+  // |chain| as the chaining block; ECB ignores it.
+  base::Status CryptPadded(bool do_encrypt,
+                           const std::string& chain,
+                           io::InputStream* input,
+                           io::OutputStream* output);
+
+  AesNiKey key_;
+  bool key_ok_;
+  const AesNiEngine::Kernels* kernels_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AesNiAESEncryptor);
+};
+
+class AesNiEcbAESEncryptor : public AesNiAESEncryptor {
+ public:
+  // |kernels| defaults to the best set for this CPU.
+  explicit AesNiEcbAESEncryptor(strings::StringPiece raw_key,
+                                const AesNiEngine::Kernels* kernels =
+                                    AesNiEngine::Get());
+  virtual ~AesNiEcbAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AesNiEcbAESEncryptor);
+};
+
+class AesNiCbcAESEncryptor : public AesNiAESEncryptor {
+ public:
+  // An empty |iv| is all zeros, as with SslCbcAESEncryptor.
+  AesNiCbcAESEncryptor(strings::StringPiece raw_key,
+                       const std::string& iv,
+                       const AesNiEngine::Kernels* kernels =
+                           AesNiEngine::Get());
+  virtual ~AesNiCbcAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // Reads every record into memory and encrypts up to
+  // AesNiEngine::kCbcLanes of them side by side; a lane that finishes its
+  // record picks up the next one. Meant for many short records.
+  virtual void EncryptBatch(const AESBatchRecord* records,
+                            int count,
+                            base::Status* statuses) override;
+
+ protected:
+  // From AESEncryptor; a single record is streamed instead.
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
+ private:
+  base::Status Crypt(bool do_encrypt,
+                     const std::string& iv,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  std::string iv_;
+
+  DISALLOW_COPY_AND_ASSIGN(AesNiCbcAESEncryptor);
+};
+
+class AesNiCtrAESEncryptor : public AesNiAESEncryptor {
+ public:
+  // |iv| is the 16-byte initial counter block.
+  AesNiCtrAESEncryptor(strings::StringPiece raw_key,
+                       const std::string& iv,
+                       const AesNiEngine::Kernels* kernels =
+                           AesNiEngine::Get());
+  virtual ~AesNiCtrAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ private:
+  std::string iv_;
+
+  DISALLOW_COPY_AND_ASSIGN(AesNiCtrAESEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_AESNI_AES_ENCRYPTOR_H_
@@ -0,0 +1,61 @@
+#include "crypto/aes_encryptor.h"
+#include "crypto/aesni_aes_encryptor.h"
+#include "crypto/aesni_engine.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
+
+namespace crypto {
+
+// Selected explicitly with GetFactory("aesni_aes"); only registered when
+// the CPU has AES-NI.
+class AesNiAESFactory : public AESFactory {
+ public:
+  AesNiAESFactory() {}
+  virtual ~AesNiAESFactory() override {}
+
+  // From AESFactory
+  virtual std::unique_ptr<AESEncryptor> CreateCBC(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    std::unique_ptr<AesNiCbcAESEncryptor> ret(new AesNiCbcAESEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateECB(std::unique_ptr<AESKey>& key) override {
+    std::unique_ptr<AesNiEcbAESEncryptor> ret(new AesNiEcbAESEncryptor(key->key()));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    std::unique_ptr<AesNiCtrAESEncryptor> ret(new AesNiCtrAESEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  // There is no hand-written GHASH; the EVP GCM already runs on AES-NI and
+  // PCLMULQDQ.
+  virtual std::unique_ptr<AESEncryptor> CreateGCM(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    std::unique_ptr<SslGcmAESEncryptor> ret(new SslGcmAESEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual bool AcceptsOptions(const std::string& encryptor_type) override {
+    return encryptor_type == "aesni_aes";
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AesNiAESFactory);
+};
+
+namespace { // register
+
+class AesNiAESRegistrar {
+ public:
+  AesNiAESRegistrar() {
+    if (AesNiEngine::Supported()) {
+      AESFactory::Register("aesni_aes", new AesNiAESFactory());
+    }
+  }
+};
+static AesNiAESRegistrar registrar;
+} // namespace
+} // namespace crypto
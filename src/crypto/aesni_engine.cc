@@ -0,0 +1,641 @@
+#include "crypto/aesni_engine.h"
+
+#include <cpuid.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <glog/logging.h>
+
+// The kernels are compiled for their instruction sets one function at a
+// time, so the rest of the tree keeps building for the baseline CPU and
+// nothing here runs before CPUID said it may.
+#define AESNI_TARGET __attribute__((target("aes,ssse3,sse4.1")))
+#define VAES_TARGET \
+    __attribute__((target("aes,ssse3,sse4.1,avx2,avx512f,avx512bw,vaes")))
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = 16;
+// Blocks in flight per iteration: enough to hide the latency of AESENC.
+const size_t kLanes = 8;
+// Four blocks per zmm register, four registers per iteration.
+const size_t kWideRegs = 4;
+const size_t kWideLanes = kWideRegs * 4;
+
+// CPUID
+
+struct CpuFeatures {
+  bool aesni;
+  bool vaes;
+};
+
+uint64_t ReadXCR0() {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+CpuFeatures DetectFeatures() {
+  CpuFeatures features = {false, false};
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return features;
+  }
+  const bool aes = ecx & (1u << 25);
+  const bool ssse3 = ecx & (1u << 9);
+  const bool sse41 = ecx & (1u << 19);
+  const bool osxsave = ecx & (1u << 27);
+  features.aesni = aes && ssse3 && sse41;
+  if (!features.aesni || !osxsave || __get_cpuid_max(0, nullptr) < 7) {
+    return features;
+  }
+
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  const bool avx2 = ebx & (1u << 5);
+  const bool avx512f = ebx & (1u << 16);
+  const bool avx512bw = ebx & (1u << 30);
+  const bool vaes = ecx & (1u << 9);
+  // The OS has to save the xmm, ymm, opmask and both halves of the zmm
+  // state.
+  const bool os_avx512 = (ReadXCR0() & 0xe6) == 0xe6;
+  features.vaes = avx2 && avx512f && avx512bw && vaes && os_avx512;
+  return features;
+}
+
+const CpuFeatures& Features() {
+  static const CpuFeatures features = DetectFeatures();
+  return features;
+}
+
+// Key schedule
+
+AESNI_TARGET inline __m128i ExpandStep(__m128i key, __m128i assist) {
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+// AESKEYGENASSIST takes the round constant as an immediate.
+#define EXPAND_128(i, rcon)                                                 \
+  rk[i] = ExpandStep(rk[i - 1],                                             \
+      _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i - 1], rcon), 0xff))
+#define EXPAND_256_EVEN(i, rcon)                                            \
+  rk[i] = ExpandStep(rk[i - 2],                                             \
+      _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i - 1], rcon), 0xff))
+#define EXPAND_256_ODD(i)                                                   \
+  rk[i] = ExpandStep(rk[i - 2],                                             \
+      _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i - 1], 0x00), 0xaa))
+
+AESNI_TARGET void ExpandKey128(const uint8_t* raw_key, __m128i* rk) {
+  rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw_key));
+  EXPAND_128(1, 0x01);
+  EXPAND_128(2, 0x02);
+  EXPAND_128(3, 0x04);
+  EXPAND_128(4, 0x08);
+  EXPAND_128(5, 0x10);
+  EXPAND_128(6, 0x20);
+  EXPAND_128(7, 0x40);
+  EXPAND_128(8, 0x80);
+  EXPAND_128(9, 0x1b);
+  EXPAND_128(10, 0x36);
+}
+
+AESNI_TARGET void ExpandKey256(const uint8_t* raw_key, __m128i* rk) {
+  rk[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw_key));
+  rk[1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw_key + 16));
+  EXPAND_256_EVEN(2, 0x01);
+  EXPAND_256_ODD(3);
+  EXPAND_256_EVEN(4, 0x02);
+  EXPAND_256_ODD(5);
+  EXPAND_256_EVEN(6, 0x04);
+  EXPAND_256_ODD(7);
+  EXPAND_256_EVEN(8, 0x08);
+  EXPAND_256_ODD(9);
+  EXPAND_256_EVEN(10, 0x10);
+  EXPAND_256_ODD(11);
+  EXPAND_256_EVEN(12, 0x20);
+  EXPAND_256_ODD(13);
+  EXPAND_256_EVEN(14, 0x40);
+}
+
+#undef EXPAND_128
+#undef EXPAND_256_EVEN
+#undef EXPAND_256_ODD
+
+// The equivalent inverse cipher runs the encryption round keys backwards,
+// with InvMixColumns applied to all but the first and last.
+AESNI_TARGET void DeriveDecryptKeys(const __m128i* ek, int rounds,
+                                    __m128i* dk) {
+  dk[0] = ek[rounds];
+  for (int i = 1; i < rounds; ++i) {
+    dk[i] = _mm_aesimc_si128(ek[rounds - i]);
+  }
+  dk[rounds] = ek[0];
+}
+
+// AES-NI kernels
+
+inline const __m128i* EncryptKeys(const AesNiKey& key) {
+  return reinterpret_cast<const __m128i*>(key.encrypt_keys);
+}
+
+inline const __m128i* DecryptKeys(const AesNiKey& key) {
+  return reinterpret_cast<const __m128i*>(key.decrypt_keys);
+}
+
+AESNI_TARGET inline __m128i LoadBlock(const uint8_t* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+AESNI_TARGET inline void StoreBlock(uint8_t* p, __m128i block) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), block);
+}
+
+template <bool kDecrypt>
+AESNI_TARGET inline __m128i Round(__m128i block, __m128i round_key) {
+  return kDecrypt ? _mm_aesdec_si128(block, round_key)
+                  : _mm_aesenc_si128(block, round_key);
+}
+
+template <bool kDecrypt>
+AESNI_TARGET inline __m128i LastRound(__m128i block, __m128i round_key) {
+  return kDecrypt ? _mm_aesdeclast_si128(block, round_key)
+                  : _mm_aesenclast_si128(block, round_key);
+}
+
+template <bool kDecrypt>
+AESNI_TARGET inline __m128i CryptBlock(const __m128i* rk, int rounds,
+                                       __m128i block) {
+  block = _mm_xor_si128(block, rk[0]);
+  for (int r = 1; r < rounds; ++r) {
+    block = Round<kDecrypt>(block, rk[r]);
+  }
+  return LastRound<kDecrypt>(block, rk[rounds]);
+}
+
+// Runs kLanes independent blocks through the rounds side by side.
+template <bool kDecrypt>
+AESNI_TARGET inline void CryptLanes(const __m128i* rk, int rounds,
+                                    __m128i* blocks) {
+#pragma GCC unroll 8
+  for (size_t i = 0; i < kLanes; ++i) {
+    blocks[i] = _mm_xor_si128(blocks[i], rk[0]);
+  }
+  for (int r = 1; r < rounds; ++r) {
+    const __m128i round_key = rk[r];
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      blocks[i] = Round<kDecrypt>(blocks[i], round_key);
+    }
+  }
+#pragma GCC unroll 8
+  for (size_t i = 0; i < kLanes; ++i) {
+    blocks[i] = LastRound<kDecrypt>(blocks[i], rk[rounds]);
+  }
+}
+
+template <bool kDecrypt>
+AESNI_TARGET void EcbCrypt(const AesNiKey& key, const uint8_t* in,
+                           uint8_t* out, size_t blocks) {
+  const __m128i* rk = kDecrypt ? DecryptKeys(key) : EncryptKeys(key);
+  const int rounds = key.rounds;
+  for (; blocks >= kLanes; blocks -= kLanes) {
+    __m128i b[kLanes];
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      b[i] = LoadBlock(in + i * kBlockSize);
+    }
+    CryptLanes<kDecrypt>(rk, rounds, b);
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      StoreBlock(out + i * kBlockSize, b[i]);
+    }
+    in += kLanes * kBlockSize;
+    out += kLanes * kBlockSize;
+  }
+  for (; blocks > 0; --blocks) {
+    StoreBlock(out, CryptBlock<kDecrypt>(rk, rounds, LoadBlock(in)));
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+}
+
+AESNI_TARGET void EcbEncryptAESNI(const AesNiKey& key, const uint8_t* in,
+                                  uint8_t* out, size_t blocks) {
+  EcbCrypt<false>(key, in, out, blocks);
+}
+
+AESNI_TARGET void EcbDecryptAESNI(const AesNiKey& key, const uint8_t* in,
+                                  uint8_t* out, size_t blocks) {
+  EcbCrypt<true>(key, in, out, blocks);
+}
+
+// Every block depends on the previous ciphertext: no pipelining possible.
+AESNI_TARGET void CbcEncryptAESNI(const AesNiKey& key, uint8_t* chain,
+                                  const uint8_t* in, uint8_t* out,
+                                  size_t blocks) {
+  const __m128i* rk = EncryptKeys(key);
+  __m128i iv = LoadBlock(chain);
+  for (; blocks > 0; --blocks) {
+    iv = CryptBlock<false>(rk, key.rounds, _mm_xor_si128(LoadBlock(in), iv));
+    StoreBlock(out, iv);
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+  StoreBlock(chain, iv);
+}
+
+AESNI_TARGET void CbcDecryptAESNI(const AesNiKey& key, uint8_t* chain,
+                                  const uint8_t* in, uint8_t* out,
+                                  size_t blocks) {
+  const __m128i* rk = DecryptKeys(key);
+  const int rounds = key.rounds;
+  __m128i iv = LoadBlock(chain);
+  for (; blocks >= kLanes; blocks -= kLanes) {
+    // All ciphertext is loaded before anything is stored, so |in| may
+    // equal |out|.
+    __m128i c[kLanes];
+    __m128i b[kLanes];
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      c[i] = LoadBlock(in + i * kBlockSize);
+      b[i] = c[i];
+    }
+    CryptLanes<true>(rk, rounds, b);
+    StoreBlock(out, _mm_xor_si128(b[0], iv));
+#pragma GCC unroll 8
+    for (size_t i = 1; i < kLanes; ++i) {
+      StoreBlock(out + i * kBlockSize, _mm_xor_si128(b[i], c[i - 1]));
+    }
+    iv = c[kLanes - 1];
+    in += kLanes * kBlockSize;
+    out += kLanes * kBlockSize;
+  }
+  for (; blocks > 0; --blocks) {
+    __m128i c = LoadBlock(in);
+    StoreBlock(out, _mm_xor_si128(CryptBlock<true>(rk, rounds, c), iv));
+    iv = c;
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+  StoreBlock(chain, iv);
+}
+
+static_assert(static_cast<size_t>(AesNiEngine::kCbcLanes) == kLanes,
+              "one CBC chain per pipeline lane");
+
+AESNI_TARGET void CbcEncryptLanesAESNI(const AesNiKey& key,
+                                       AesNiEngine::CbcLanes* lanes,
+                                       size_t blocks) {
+  const __m128i* rk = EncryptKeys(key);
+  const int rounds = key.rounds;
+  __m128i iv[kLanes];
+  const uint8_t* in[kLanes];
+  uint8_t* out[kLanes];
+#pragma GCC unroll 8
+  for (size_t i = 0; i < kLanes; ++i) {
+    iv[i] = LoadBlock(lanes->chain[i]);
+    in[i] = lanes->in[i];
+    out[i] = lanes->out[i];
+  }
+  for (; blocks > 0; --blocks) {
+    __m128i b[kLanes];
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      b[i] = _mm_xor_si128(LoadBlock(in[i]), iv[i]);
+    }
+    CryptLanes<false>(rk, rounds, b);
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      StoreBlock(out[i], b[i]);
+      iv[i] = b[i];
+      in[i] += lanes->stride[i];
+      out[i] += lanes->stride[i];
+    }
+  }
+#pragma GCC unroll 8
+  for (size_t i = 0; i < kLanes; ++i) {
+    StoreBlock(lanes->chain[i], iv[i]);
+    lanes->in[i] = in[i];
+    lanes->out[i] = out[i];
+  }
+}
+
+// The counter block is a 128-bit big-endian integer, kept here as two
+// native halves.
+struct Counter {
+  uint64_t hi;
+  uint64_t lo;
+
+  void Load(const uint8_t* block) {
+    uint64_t hi_be, lo_be;
+    memcpy(&hi_be, block, 8);
+    memcpy(&lo_be, block + 8, 8);
+    hi = __builtin_bswap64(hi_be);
+    lo = __builtin_bswap64(lo_be);
+  }
+
+  void Store(uint8_t* block) const {
+    uint64_t hi_be = __builtin_bswap64(hi);
+    uint64_t lo_be = __builtin_bswap64(lo);
+    memcpy(block, &hi_be, 8);
+    memcpy(block + 8, &lo_be, 8);
+  }
+
+  void Increment() {
+    if (++lo == 0) {
+      ++hi;
+    }
+  }
+};
+
+AESNI_TARGET inline __m128i ByteSwapMask() {
+  return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+AESNI_TARGET inline __m128i CounterBlock(const Counter& counter,
+                                         __m128i byte_swap) {
+  return _mm_shuffle_epi8(
+      _mm_set_epi64x(static_cast<long long>(counter.hi),
+                     static_cast<long long>(counter.lo)),
+      byte_swap);
+}
+
+AESNI_TARGET void CtrCryptAESNI(const AesNiKey& key, uint8_t* chain,
+                                const uint8_t* in, uint8_t* out,
+                                size_t blocks) {
+  const __m128i* rk = EncryptKeys(key);
+  const int rounds = key.rounds;
+  const __m128i byte_swap = ByteSwapMask();
+  Counter counter;
+  counter.Load(chain);
+  for (; blocks >= kLanes; blocks -= kLanes) {
+    __m128i b[kLanes];
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      b[i] = CounterBlock(counter, byte_swap);
+      counter.Increment();
+    }
+    CryptLanes<false>(rk, rounds, b);
+#pragma GCC unroll 8
+    for (size_t i = 0; i < kLanes; ++i) {
+      StoreBlock(out + i * kBlockSize,
+                 _mm_xor_si128(b[i], LoadBlock(in + i * kBlockSize)));
+    }
+    in += kLanes * kBlockSize;
+    out += kLanes * kBlockSize;
+  }
+  for (; blocks > 0; --blocks) {
+    __m128i b = CryptBlock<false>(rk, rounds, CounterBlock(counter, byte_swap));
+    counter.Increment();
+    StoreBlock(out, _mm_xor_si128(b, LoadBlock(in)));
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+  counter.Store(chain);
+}
+
+// VAES kernels. They handle whole groups of kWideLanes blocks and leave
+// the remainder to the AES-NI kernels.
+
+// The plain forms of these three leave the unused source operand undefined,
+// which GCC 12 flags under -Werror; an all-ones zero-mask is the same
+// instruction.
+VAES_TARGET inline __m512i Broadcast128(__m128i block) {
+  return _mm512_maskz_broadcast_i32x4(0xffff, block);
+}
+
+VAES_TARGET inline __m128i ExtractTopBlock(__m512i blocks) {
+  return _mm512_maskz_extracti32x4_epi32(0xf, blocks, 3);
+}
+
+// The top block of |low| followed by the lower three blocks of |high|.
+VAES_TARGET inline __m512i ShiftInBlock(__m512i high, __m512i low) {
+  return _mm512_maskz_alignr_epi64(0xff, high, low, 6);
+}
+
+VAES_TARGET inline void BroadcastKeys(const __m128i* rk, int rounds,
+                                      __m512i* wide_keys) {
+  for (int r = 0; r <= rounds; ++r) {
+    wide_keys[r] = Broadcast128(rk[r]);
+  }
+}
+
+template <bool kDecrypt>
+VAES_TARGET inline void CryptWide(const __m512i* wk, int rounds,
+                                  __m512i* regs) {
+#pragma GCC unroll 4
+  for (size_t i = 0; i < kWideRegs; ++i) {
+    regs[i] = _mm512_xor_si512(regs[i], wk[0]);
+  }
+  for (int r = 1; r < rounds; ++r) {
+    const __m512i round_key = wk[r];
+#pragma GCC unroll 4
+    for (size_t i = 0; i < kWideRegs; ++i) {
+      regs[i] = kDecrypt ? _mm512_aesdec_epi128(regs[i], round_key)
+                         : _mm512_aesenc_epi128(regs[i], round_key);
+    }
+  }
+#pragma GCC unroll 4
+  for (size_t i = 0; i < kWideRegs; ++i) {
+    regs[i] = kDecrypt ? _mm512_aesdeclast_epi128(regs[i], wk[rounds])
+                       : _mm512_aesenclast_epi128(regs[i], wk[rounds]);
+  }
+}
+
+template <bool kDecrypt>
+VAES_TARGET void EcbCryptWide(const AesNiKey& key, const uint8_t* in,
+                              uint8_t* out, size_t blocks) {
+  __m512i wk[AesNiKey::kMaxRounds + 1];
+  BroadcastKeys(kDecrypt ? DecryptKeys(key) : EncryptKeys(key),
+                key.rounds, wk);
+  for (; blocks >= kWideLanes; blocks -= kWideLanes) {
+    __m512i regs[kWideRegs];
+#pragma GCC unroll 4
+    for (size_t i = 0; i < kWideRegs; ++i) {
+      regs[i] = _mm512_loadu_si512(in + i * 4 * kBlockSize);
+    }
+    CryptWide<kDecrypt>(wk, key.rounds, regs);
+#pragma GCC unroll 4
+    for (size_t i = 0; i < kWideRegs; ++i) {
+      _mm512_storeu_si512(out + i * 4 * kBlockSize, regs[i]);
+    }
+    in += kWideLanes * kBlockSize;
+    out += kWideLanes * kBlockSize;
+  }
+  EcbCrypt<kDecrypt>(key, in, out, blocks);
+}
+
+VAES_TARGET void EcbEncryptVAES(const AesNiKey& key, const uint8_t* in,
+                                uint8_t* out, size_t blocks) {
+  EcbCryptWide<false>(key, in, out, blocks);
+}
+
+VAES_TARGET void EcbDecryptVAES(const AesNiKey& key, const uint8_t* in,
+                                uint8_t* out, size_t blocks) {
+  EcbCryptWide<true>(key, in, out, blocks);
+}
+
+VAES_TARGET void CbcDecryptVAES(const AesNiKey& key, uint8_t* chain,
+                                const uint8_t* in, uint8_t* out,
+                                size_t blocks) {
+  __m512i wk[AesNiKey::kMaxRounds + 1];
+  BroadcastKeys(DecryptKeys(key), key.rounds, wk);
+  // Only the top block of |last| matters: it is the ciphertext in front
+  // of the next group.
+  __m512i last = Broadcast128(LoadBlock(chain));
+  if (blocks >= kWideLanes) {
+    for (; blocks >= kWideLanes; blocks -= kWideLanes) {
+      __m512i c[kWideRegs];
+      __m512i regs[kWideRegs];
+#pragma GCC unroll 4
+      for (size_t i = 0; i < kWideRegs; ++i) {
+        c[i] = _mm512_loadu_si512(in + i * 4 * kBlockSize);
+        regs[i] = c[i];
+      }
+      CryptWide<true>(wk, key.rounds, regs);
+      // Shifting each register up by one block, with the top block of the
+      // register below shifted in, lines every block up with the
+      // ciphertext that precedes it.
+      __m512i prev = last;
+#pragma GCC unroll 4
+      for (size_t i = 0; i < kWideRegs; ++i) {
+        __m512i chained = ShiftInBlock(c[i], prev);
+        _mm512_storeu_si512(out + i * 4 * kBlockSize,
+                            _mm512_xor_si512(regs[i], chained));
+        prev = c[i];
+      }
+      last = c[kWideRegs - 1];
+      in += kWideLanes * kBlockSize;
+      out += kWideLanes * kBlockSize;
+    }
+    StoreBlock(chain, ExtractTopBlock(last));
+  }
+  CbcDecryptAESNI(key, chain, in, out, blocks);
+}
+
+VAES_TARGET void CtrCryptVAES(const AesNiKey& key, uint8_t* chain,
+                              const uint8_t* in, uint8_t* out,
+                              size_t blocks) {
+  __m512i wk[AesNiKey::kMaxRounds + 1];
+  BroadcastKeys(EncryptKeys(key), key.rounds, wk);
+  const __m512i byte_swap = Broadcast128(ByteSwapMask());
+  Counter counter;
+  counter.Load(chain);
+  for (; blocks >= kWideLanes; blocks -= kWideLanes) {
+    __m512i regs[kWideRegs];
+    if (counter.lo <= UINT64_MAX - kWideLanes) {
+      // No carry into the high half within this group: count in vector
+      // registers.
+      const long long hi = static_cast<long long>(counter.hi);
+      const long long lo = static_cast<long long>(counter.lo);
+      __m512i native = _mm512_set_epi64(hi, lo + 3, hi, lo + 2,
+                                        hi, lo + 1, hi, lo);
+      const __m512i step = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+#pragma GCC unroll 4
+      for (size_t i = 0; i < kWideRegs; ++i) {
+        regs[i] = _mm512_shuffle_epi8(native, byte_swap);
+        native = _mm512_add_epi64(native, step);
+      }
+      counter.lo += kWideLanes;
+    } else {
+      uint64_t halves[kWideLanes * 2];
+      for (size_t i = 0; i < kWideLanes; ++i) {
+        halves[2 * i] = counter.lo;
+        halves[2 * i + 1] = counter.hi;
+        counter.Increment();
+      }
+#pragma GCC unroll 4
+      for (size_t i = 0; i < kWideRegs; ++i) {
+        regs[i] = _mm512_shuffle_epi8(_mm512_loadu_si512(halves + i * 8),
+                                      byte_swap);
+      }
+    }
+    CryptWide<false>(wk, key.rounds, regs);
+#pragma GCC unroll 4
+    for (size_t i = 0; i < kWideRegs; ++i) {
+      __m512i data = _mm512_loadu_si512(in + i * 4 * kBlockSize);
+      _mm512_storeu_si512(out + i * 4 * kBlockSize,
+                          _mm512_xor_si512(regs[i], data));
+    }
+    in += kWideLanes * kBlockSize;
+    out += kWideLanes * kBlockSize;
+  }
+  counter.Store(chain);
+  CtrCryptAESNI(key, chain, in, out, blocks);
+}
+
+const AesNiEngine::Kernels kAESNIKernels = {
+  AesNiEngine::kAESNI,
+  "aesni",
+  EcbEncryptAESNI,
+  EcbDecryptAESNI,
+  CbcEncryptAESNI,
+  CbcDecryptAESNI,
+  CtrCryptAESNI,
+  CbcEncryptLanesAESNI,
+};
+
+const AesNiEngine::Kernels kVAESKernels = {
+  AesNiEngine::kVAES,
+  "vaes",
+  EcbEncryptVAES,
+  EcbDecryptVAES,
+  CbcEncryptAESNI,
+  CbcDecryptVAES,
+  CtrCryptVAES,
+  CbcEncryptLanesAESNI,
+};
+
+} // namespace
+
+// static
+bool AesNiEngine::Supported() {
+  return Features().aesni;
+}
+
+// static
+const AesNiEngine::Kernels* AesNiEngine::Get() {
+  const Kernels* kernels = Get(kVAES);
+  return kernels ? kernels : Get(kAESNI);
+}
+
+// static
+const AesNiEngine::Kernels* AesNiEngine::Get(Level level) {
+  switch (level) {
+    case kAESNI:
+      return Features().aesni ? &kAESNIKernels : nullptr;
+    case kVAES:
+      return Features().vaes ? &kVAESKernels : nullptr;
+  }
+  return nullptr;
+}
+
+// static
+bool AesNiEngine::ExpandKey(strings::StringPiece raw_key, AesNiKey* key) {
+  DCHECK(Supported());
+  const uint8_t* raw = reinterpret_cast<const uint8_t*>(raw_key.data());
+  __m128i* ek = reinterpret_cast<__m128i*>(key->encrypt_keys);
+  switch (raw_key.size()) {
+    case 16:
+      key->rounds = 10;
+      ExpandKey128(raw, ek);
+      break;
+    case 32:
+      key->rounds = 14;
+      ExpandKey256(raw, ek);
+      break;
+    default:
+      LOG(ERROR) << "AES-NI key must be 128 or 256 bits, got "
+                 << raw_key.size() * 8;
+      return false;
+  }
+  DeriveDecryptKeys(ek, key->rounds,
+                    reinterpret_cast<__m128i*>(key->decrypt_keys));
+  return true;
+}
+
+} // namespace crypto
@@ -0,0 +1,95 @@
+#ifndef CRYPTO_AESNI_ENGINE_H_
+#define CRYPTO_AESNI_ENGINE_H_
+
+#include "base/macros.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace crypto {
+
+// Expanded AES round keys in the layout the AES-NI instructions expect.
+struct AesNiKey {
+  static const int kMaxRounds = 14;
+
+  alignas(16) uint8_t encrypt_keys[(kMaxRounds + 1) * 16];
+  alignas(16) uint8_t decrypt_keys[(kMaxRounds + 1) * 16];
+  int rounds;
+};
+
+// Hand-written AES kernels on top of the AES-NI instructions, and on top of
+// VAES (four blocks per AVX-512 register) where the CPU has it.
+//
+// The independent modes are pipelined: 8 blocks are in flight at a time
+// with AES-NI, 16 with VAES. CBC encryption of one message is inherently
+// serial and runs one block at a time; independent messages can share the
+// pipeline through cbc_encrypt_lanes. The best kernel set is picked once,
+// through CPUID.
+class AesNiEngine {
+ public:
+  enum Level {
+    kAESNI,
+    kVAES,
+  };
+
+  // |blocks| counts 16-byte blocks; |in| may equal |out|.
+  typedef void (*BlockFunc)(const AesNiKey& key,
+                            const uint8_t* in,
+                            uint8_t* out,
+                            size_t blocks);
+  // |chain| is the CBC IV, or the big-endian CTR counter block, and is
+  // updated so that consecutive calls continue the same stream.
+  typedef void (*ChainFunc)(const AesNiKey& key,
+                            uint8_t* chain,
+                            const uint8_t* in,
+                            uint8_t* out,
+                            size_t blocks);
+
+  // kCbcLanes independent CBC chains, encrypted in lockstep so that the
+  // AES unit always has a block of every chain in flight.
+  static const int kCbcLanes = 8;
+  struct CbcLanes {
+    alignas(16) uint8_t chain[kCbcLanes][16];
+    const uint8_t* in[kCbcLanes];
+    uint8_t* out[kCbcLanes];
+    // How far a lane moves per block: 16, or 0 for a lane with nothing to
+    // do that is parked on a scratch block.
+    size_t stride[kCbcLanes];
+  };
+  // Advances every lane by |blocks| blocks.
+  typedef void (*LanesFunc)(const AesNiKey& key,
+                            CbcLanes* lanes,
+                            size_t blocks);
+
+  struct Kernels {
+    Level level;
+    const char* name;
+    BlockFunc ecb_encrypt;
+    BlockFunc ecb_decrypt;
+    ChainFunc cbc_encrypt;
+    ChainFunc cbc_decrypt;
+    ChainFunc ctr_crypt;
+    LanesFunc cbc_encrypt_lanes;
+  };
+
+  // True when the CPU has AES-NI (with SSSE3 and SSE4.1).
+  static bool Supported();
+
+  // The fastest kernel set the CPU runs, nullptr without AES-NI.
+  static const Kernels* Get();
+  // The kernel set for |level|, nullptr when the CPU lacks it.
+  static const Kernels* Get(Level level);
+
+  // Expands a 128 or 256-bit |raw_key|. Must only be called when
+  // Supported().
+  static bool ExpandKey(strings::StringPiece raw_key, AesNiKey* key);
+
+ private:
+  AesNiEngine() = delete;
+  DISALLOW_COPY_AND_ASSIGN(AesNiEngine);
+};
+
+} // namespace crypto
+#endif // CRYPTO_AESNI_ENGINE_H_
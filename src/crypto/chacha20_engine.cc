@@ -0,0 +1,547 @@
+#include "crypto/chacha20_engine.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <cpuid.h>
+#include <string.h>
+#include <algorithm>
+#include <immintrin.h>
+
+#include <glog/logging.h>
+
+// As in aesni_engine.cc, the SIMD kernels are compiled for their
+// instruction sets one function at a time.
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("ssse3,avx2")))
+
+namespace crypto {
+
+namespace {
+
+// "expand 32-byte k"
+const uint32_t kSigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+const int kDoubleRounds = 10;
+
+inline uint32_t LoadLE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) |
+         static_cast<uint32_t>(p[1]) << 8 |
+         static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[3]) << 24;
+}
+
+inline void StoreLE32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+inline uint64_t LoadLE64(const uint8_t* p) {
+  return static_cast<uint64_t>(LoadLE32(p)) |
+         static_cast<uint64_t>(LoadLE32(p + 4)) << 32;
+}
+
+inline void StoreLE64(uint8_t* p, uint64_t v) {
+  StoreLE32(p, static_cast<uint32_t>(v));
+  StoreLE32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+// CPUID
+
+struct CpuFeatures {
+  bool ssse3;
+  bool avx2;
+};
+
+uint64_t ReadXCR0() {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+CpuFeatures DetectFeatures() {
+  CpuFeatures features = {false, false};
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return features;
+  }
+  features.ssse3 = ecx & (1u << 9);
+  const bool osxsave = ecx & (1u << 27);
+  if (!features.ssse3 || !osxsave || __get_cpuid_max(0, nullptr) < 7) {
+    return features;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  // The OS has to save the xmm and ymm state.
+  features.avx2 = (ebx & (1u << 5)) && (ReadXCR0() & 0x6) == 0x6;
+  return features;
+}
+
+const CpuFeatures& Features() {
+  static const CpuFeatures features = DetectFeatures();
+  return features;
+}
+
+// Portable kernel
+
+inline uint32_t Rotl(uint32_t v, int n) {
+  return (v << n) | (v >> (32 - n));
+}
+
+#define QUARTER_ROUND(a, b, c, d)                                           \
+  a += b; d ^= a; d = Rotl(d, 16);                                          \
+  c += d; b ^= c; b = Rotl(b, 12);                                          \
+  a += b; d ^= a; d = Rotl(d, 8);                                           \
+  c += d; b ^= c; b = Rotl(b, 7)
+
+void Block(const ChaCha20State& state, uint32_t counter, uint8_t* out) {
+  uint32_t in[16];
+  memcpy(in, kSigma, sizeof(kSigma));
+  memcpy(in + 4, state.key, sizeof(state.key));
+  in[12] = counter;
+  memcpy(in + 13, state.nonce, sizeof(state.nonce));
+
+  uint32_t x[16];
+  memcpy(x, in, sizeof(x));
+  for (int i = 0; i < kDoubleRounds; ++i) {
+    QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+    QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+    QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+    QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+    QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+    QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+    QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+    QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+  }
+  for (int i = 0; i < 16; ++i) {
+    StoreLE32(out + 4 * i, x[i] + in[i]);
+  }
+}
+
+#undef QUARTER_ROUND
+
+void XorPortable(ChaCha20State* state, const uint8_t* in, uint8_t* out,
+                 size_t blocks) {
+  uint8_t keystream[ChaCha20Engine::kBlockSize];
+  for (; blocks > 0; --blocks) {
+    Block(*state, state->counter++, keystream);
+    for (size_t i = 0; i < ChaCha20Engine::kBlockSize; ++i) {
+      out[i] = in[i] ^ keystream[i];
+    }
+    in += ChaCha20Engine::kBlockSize;
+    out += ChaCha20Engine::kBlockSize;
+  }
+}
+
+// SIMD kernels. Register i holds word i of every block in flight, one
+// block per lane, so a quarter round on the registers runs it on every
+// block at once. The rotations by 16 and 8 are byte shuffles.
+
+#define SIMD_CAT_(a, b, c) a##b##c
+#define SIMD_CAT(a, b, c) SIMD_CAT_(a, b, c)
+// BITS is defined before each kernel: 128 or 256.
+#define SIMD_XOR(PREFIX) SIMD_CAT(PREFIX, _xor_si, BITS)
+#define SIMD_OR(PREFIX) SIMD_CAT(PREFIX, _or_si, BITS)
+
+#define SIMD_QUARTER_ROUND(PREFIX, a, b, c, d)                              \
+  a = PREFIX##_add_epi32(a, b);                                             \
+  d = PREFIX##_shuffle_epi8(SIMD_XOR(PREFIX)(d, a), rot16);                 \
+  c = PREFIX##_add_epi32(c, d);                                             \
+  b = SIMD_XOR(PREFIX)(b, c);                                               \
+  b = SIMD_OR(PREFIX)(PREFIX##_slli_epi32(b, 12),                           \
+                      PREFIX##_srli_epi32(b, 20));                          \
+  a = PREFIX##_add_epi32(a, b);                                             \
+  d = PREFIX##_shuffle_epi8(SIMD_XOR(PREFIX)(d, a), rot8);                  \
+  c = PREFIX##_add_epi32(c, d);                                             \
+  b = SIMD_XOR(PREFIX)(b, c);                                               \
+  b = SIMD_OR(PREFIX)(PREFIX##_slli_epi32(b, 7),                            \
+                      PREFIX##_srli_epi32(b, 25))
+
+#define SIMD_DOUBLE_ROUND(PREFIX, x)                                        \
+  SIMD_QUARTER_ROUND(PREFIX, x[0], x[4], x[8], x[12]);                      \
+  SIMD_QUARTER_ROUND(PREFIX, x[1], x[5], x[9], x[13]);                      \
+  SIMD_QUARTER_ROUND(PREFIX, x[2], x[6], x[10], x[14]);                     \
+  SIMD_QUARTER_ROUND(PREFIX, x[3], x[7], x[11], x[15]);                     \
+  SIMD_QUARTER_ROUND(PREFIX, x[0], x[5], x[10], x[15]);                     \
+  SIMD_QUARTER_ROUND(PREFIX, x[1], x[6], x[11], x[12]);                     \
+  SIMD_QUARTER_ROUND(PREFIX, x[2], x[7], x[8], x[13]);                      \
+  SIMD_QUARTER_ROUND(PREFIX, x[3], x[4], x[9], x[14])
+
+#define BITS 128
+
+SSSE3_TARGET void XorSSSE3(ChaCha20State* state, const uint8_t* in,
+                           uint8_t* out, size_t blocks) {
+  const size_t kWays = 4;
+  const __m128i rot16 = _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10,
+                                     5, 4, 7, 6, 1, 0, 3, 2);
+  const __m128i rot8 = _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11,
+                                    6, 5, 4, 7, 2, 1, 0, 3);
+  for (; blocks >= kWays; blocks -= kWays) {
+    __m128i s[16];
+    for (int i = 0; i < 4; ++i) {
+      s[i] = _mm_set1_epi32(static_cast<int>(kSigma[i]));
+    }
+    for (int i = 0; i < 8; ++i) {
+      s[4 + i] = _mm_set1_epi32(static_cast<int>(state->key[i]));
+    }
+    s[12] = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(state->counter)),
+                          _mm_set_epi32(3, 2, 1, 0));
+    for (int i = 0; i < 3; ++i) {
+      s[13 + i] = _mm_set1_epi32(static_cast<int>(state->nonce[i]));
+    }
+
+    __m128i x[16];
+    memcpy(x, s, sizeof(x));
+    for (int i = 0; i < kDoubleRounds; ++i) {
+      SIMD_DOUBLE_ROUND(_mm, x);
+    }
+
+    // Four words of four blocks at a time: a 4x4 transpose turns them into
+    // 16 bytes of each block.
+    for (int g = 0; g < 4; ++g) {
+      __m128i a = _mm_add_epi32(x[4 * g], s[4 * g]);
+      __m128i b = _mm_add_epi32(x[4 * g + 1], s[4 * g + 1]);
+      __m128i c = _mm_add_epi32(x[4 * g + 2], s[4 * g + 2]);
+      __m128i d = _mm_add_epi32(x[4 * g + 3], s[4 * g + 3]);
+      __m128i t0 = _mm_unpacklo_epi32(a, b);
+      __m128i t1 = _mm_unpackhi_epi32(a, b);
+      __m128i t2 = _mm_unpacklo_epi32(c, d);
+      __m128i t3 = _mm_unpackhi_epi32(c, d);
+      __m128i rows[4] = {_mm_unpacklo_epi64(t0, t2),
+                         _mm_unpackhi_epi64(t0, t2),
+                         _mm_unpacklo_epi64(t1, t3),
+                         _mm_unpackhi_epi64(t1, t3)};
+      for (size_t k = 0; k < kWays; ++k) {
+        const size_t offset = k * ChaCha20Engine::kBlockSize + 16 * g;
+        __m128i data =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + offset));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + offset),
+                         _mm_xor_si128(data, rows[k]));
+      }
+    }
+    state->counter += kWays;
+    in += kWays * ChaCha20Engine::kBlockSize;
+    out += kWays * ChaCha20Engine::kBlockSize;
+  }
+  XorPortable(state, in, out, blocks);
+}
+
+#undef BITS
+#define BITS 256
+
+AVX2_TARGET void XorAVX2(ChaCha20State* state, const uint8_t* in,
+                         uint8_t* out, size_t blocks) {
+  const size_t kWays = 8;
+  const __m256i rot16 = _mm256_broadcastsi128_si256(
+      _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+  const __m256i rot8 = _mm256_broadcastsi128_si256(
+      _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+  for (; blocks >= kWays; blocks -= kWays) {
+    __m256i s[16];
+    for (int i = 0; i < 4; ++i) {
+      s[i] = _mm256_set1_epi32(static_cast<int>(kSigma[i]));
+    }
+    for (int i = 0; i < 8; ++i) {
+      s[4 + i] = _mm256_set1_epi32(static_cast<int>(state->key[i]));
+    }
+    s[12] = _mm256_add_epi32(
+        _mm256_set1_epi32(static_cast<int>(state->counter)),
+        _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    for (int i = 0; i < 3; ++i) {
+      s[13 + i] = _mm256_set1_epi32(static_cast<int>(state->nonce[i]));
+    }
+
+    __m256i x[16];
+    memcpy(x, s, sizeof(x));
+    for (int i = 0; i < kDoubleRounds; ++i) {
+      SIMD_DOUBLE_ROUND(_mm256, x);
+    }
+
+    // The unpacks transpose within each 128-bit half: for four words,
+    // rows[k] holds 16 bytes of block k in its low half and of block k + 4
+    // in its high half. Pairs of word groups are then recombined into 32
+    // contiguous bytes of one block.
+    __m256i rows[4][4];
+    for (int g = 0; g < 4; ++g) {
+      __m256i a = _mm256_add_epi32(x[4 * g], s[4 * g]);
+      __m256i b = _mm256_add_epi32(x[4 * g + 1], s[4 * g + 1]);
+      __m256i c = _mm256_add_epi32(x[4 * g + 2], s[4 * g + 2]);
+      __m256i d = _mm256_add_epi32(x[4 * g + 3], s[4 * g + 3]);
+      __m256i t0 = _mm256_unpacklo_epi32(a, b);
+      __m256i t1 = _mm256_unpackhi_epi32(a, b);
+      __m256i t2 = _mm256_unpacklo_epi32(c, d);
+      __m256i t3 = _mm256_unpackhi_epi32(c, d);
+      rows[g][0] = _mm256_unpacklo_epi64(t0, t2);
+      rows[g][1] = _mm256_unpackhi_epi64(t0, t2);
+      rows[g][2] = _mm256_unpacklo_epi64(t1, t3);
+      rows[g][3] = _mm256_unpackhi_epi64(t1, t3);
+    }
+    for (size_t k = 0; k < 4; ++k) {
+      for (int half = 0; half < 2; ++half) {
+        const __m256i low = _mm256_permute2x128_si256(
+            rows[2 * half][k], rows[2 * half + 1][k], 0x20);
+        const __m256i high = _mm256_permute2x128_si256(
+            rows[2 * half][k], rows[2 * half + 1][k], 0x31);
+        const size_t offset = k * ChaCha20Engine::kBlockSize + 32 * half;
+        const size_t high_offset = offset + 4 * ChaCha20Engine::kBlockSize;
+        __m256i data = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + offset));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + offset),
+                            _mm256_xor_si256(data, low));
+        data = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + high_offset));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + high_offset),
+                            _mm256_xor_si256(data, high));
+      }
+    }
+    state->counter += kWays;
+    in += kWays * ChaCha20Engine::kBlockSize;
+    out += kWays * ChaCha20Engine::kBlockSize;
+  }
+  XorSSSE3(state, in, out, blocks);
+}
+
+#undef BITS
+#undef SIMD_DOUBLE_ROUND
+#undef SIMD_QUARTER_ROUND
+#undef SIMD_OR
+#undef SIMD_XOR
+#undef SIMD_CAT
+#undef SIMD_CAT_
+
+const ChaCha20Engine::Kernels kPortableKernels = {
+  ChaCha20Engine::kPortable,
+  "portable",
+  XorPortable,
+};
+
+const ChaCha20Engine::Kernels kSSSE3Kernels = {
+  ChaCha20Engine::kSSSE3,
+  "ssse3",
+  XorSSSE3,
+};
+
+const ChaCha20Engine::Kernels kAVX2Kernels = {
+  ChaCha20Engine::kAVX2,
+  "avx2",
+  XorAVX2,
+};
+
+// Poly1305 on 44, 44 and 42-bit limbs.
+const uint64_t kMask44 = (1ULL << 44) - 1;
+const uint64_t kMask42 = (1ULL << 42) - 1;
+const uint64_t kHiBit = 1ULL << 40;
+
+typedef unsigned __int128 uint128_t;
+
+} // namespace
+
+void ChaCha20State::Init(const uint8_t* key_bytes,
+                         const uint8_t* nonce_bytes,
+                         uint32_t initial_counter) {
+  for (int i = 0; i < 8; ++i) {
+    key[i] = LoadLE32(key_bytes + 4 * i);
+  }
+  for (int i = 0; i < 3; ++i) {
+    nonce[i] = LoadLE32(nonce_bytes + 4 * i);
+  }
+  counter = initial_counter;
+}
+
+const size_t ChaCha20Engine::kBlockSize;
+
+// static
+const ChaCha20Engine::Kernels* ChaCha20Engine::Get() {
+  const Kernels* kernels = Get(kAVX2);
+  if (!kernels) {
+    kernels = Get(kSSSE3);
+  }
+  return kernels ? kernels : Get(kPortable);
+}
+
+// static
+const ChaCha20Engine::Kernels* ChaCha20Engine::Get(Level level) {
+  switch (level) {
+    case kPortable:
+      return &kPortableKernels;
+    case kSSSE3:
+      return Features().ssse3 ? &kSSSE3Kernels : nullptr;
+    case kAVX2:
+      return Features().avx2 ? &kAVX2Kernels : nullptr;
+  }
+  return nullptr;
+}
+
+// static
+void ChaCha20Engine::Crypt(const Kernels* kernels,
+                           ChaCha20State* state,
+                           const uint8_t* in,
+                           uint8_t* out,
+                           size_t size) {
+  const size_t blocks = size / kBlockSize;
+  kernels->xor_keystream(state, in, out, blocks);
+  const size_t tail = size % kBlockSize;
+  if (tail > 0) {
+    uint8_t block[kBlockSize] = {0};
+    memcpy(block, in + blocks * kBlockSize, tail);
+    kernels->xor_keystream(state, block, block, 1);
+    memcpy(out + blocks * kBlockSize, block, tail);
+    OPENSSL_cleanse(block, sizeof(block));
+  }
+}
+
+const size_t Poly1305::kKeySize;
+const size_t Poly1305::kTagSize;
+
+Poly1305::Poly1305(const uint8_t* key)
+    : buffered_(0) {
+  // r is clamped as the RFC requires.
+  const uint64_t t0 = LoadLE64(key);
+  const uint64_t t1 = LoadLE64(key + 8);
+  r_[0] = t0 & 0xffc0fffffffULL;
+  r_[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffULL;
+  r_[2] = (t1 >> 24) & 0x00ffffffc0fULL;
+  h_[0] = h_[1] = h_[2] = 0;
+  pad_[0] = LoadLE64(key + 16);
+  pad_[1] = LoadLE64(key + 24);
+}
+
+Poly1305::~Poly1305() {
+  OPENSSL_cleanse(r_, sizeof(r_));
+  OPENSSL_cleanse(pad_, sizeof(pad_));
+  OPENSSL_cleanse(buffer_, sizeof(buffer_));
+}
+
+void Poly1305::Blocks(const uint8_t* data, size_t blocks, uint64_t hibit) {
+  const uint64_t r0 = r_[0], r1 = r_[1], r2 = r_[2];
+  const uint64_t s1 = r1 * (5 << 2);
+  const uint64_t s2 = r2 * (5 << 2);
+  uint64_t h0 = h_[0], h1 = h_[1], h2 = h_[2];
+  for (; blocks > 0; --blocks) {
+    const uint64_t t0 = LoadLE64(data);
+    const uint64_t t1 = LoadLE64(data + 8);
+    h0 += t0 & kMask44;
+    h1 += ((t0 >> 44) | (t1 << 20)) & kMask44;
+    h2 += ((t1 >> 24) & kMask42) | hibit;
+
+    uint128_t d0 = static_cast<uint128_t>(h0) * r0 +
+                   static_cast<uint128_t>(h1) * s2 +
+                   static_cast<uint128_t>(h2) * s1;
+    uint128_t d1 = static_cast<uint128_t>(h0) * r1 +
+                   static_cast<uint128_t>(h1) * r0 +
+                   static_cast<uint128_t>(h2) * s2;
+    uint128_t d2 = static_cast<uint128_t>(h0) * r2 +
+                   static_cast<uint128_t>(h1) * r1 +
+                   static_cast<uint128_t>(h2) * r0;
+
+    uint64_t c = static_cast<uint64_t>(d0 >> 44);
+    h0 = static_cast<uint64_t>(d0) & kMask44;
+    d1 += c;
+    c = static_cast<uint64_t>(d1 >> 44);
+    h1 = static_cast<uint64_t>(d1) & kMask44;
+    d2 += c;
+    c = static_cast<uint64_t>(d2 >> 42);
+    h2 = static_cast<uint64_t>(d2) & kMask42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= kMask44;
+    h1 += c;
+    data += 16;
+  }
+  h_[0] = h0;
+  h_[1] = h1;
+  h_[2] = h2;
+}
+
+void Poly1305::Update(const uint8_t* data, size_t size) {
+  if (buffered_ > 0) {
+    const size_t want = std::min(sizeof(buffer_) - buffered_, size);
+    memcpy(buffer_ + buffered_, data, want);
+    buffered_ += want;
+    data += want;
+    size -= want;
+    if (buffered_ < sizeof(buffer_)) {
+      return;
+    }
+    Blocks(buffer_, 1, kHiBit);
+    buffered_ = 0;
+  }
+  const size_t blocks = size / 16;
+  Blocks(data, blocks, kHiBit);
+  data += blocks * 16;
+  size -= blocks * 16;
+  memcpy(buffer_, data, size);
+  buffered_ = size;
+}
+
+void Poly1305::PadTo16() {
+  if (buffered_ > 0) {
+    memset(buffer_ + buffered_, 0, sizeof(buffer_) - buffered_);
+    Blocks(buffer_, 1, kHiBit);
+    buffered_ = 0;
+  }
+}
+
+void Poly1305::Finish(uint8_t* tag) {
+  if (buffered_ > 0) {
+    buffer_[buffered_] = 1;
+    memset(buffer_ + buffered_ + 1, 0, sizeof(buffer_) - buffered_ - 1);
+    Blocks(buffer_, 1, 0);
+    buffered_ = 0;
+  }
+
+  // Fully carries h.
+  uint64_t h0 = h_[0], h1 = h_[1], h2 = h_[2];
+  uint64_t c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= kMask42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += c;
+  c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += c;
+  c = h2 >> 42;
+  h2 &= kMask42;
+  h0 += c * 5;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += c;
+
+  // g = h - p; keeps g when it did not go negative, in constant time.
+  uint64_t g0 = h0 + 5;
+  c = g0 >> 44;
+  g0 &= kMask44;
+  uint64_t g1 = h1 + c;
+  c = g1 >> 44;
+  g1 &= kMask44;
+  uint64_t g2 = h2 + c - (1ULL << 42);
+  c = (g2 >> 63) - 1;
+  g0 &= c;
+  g1 &= c;
+  g2 &= c;
+  c = ~c;
+  h0 = (h0 & c) | g0;
+  h1 = (h1 & c) | g1;
+  h2 = (h2 & c) | g2;
+
+  // tag = (h + pad) mod 2^128
+  const uint64_t t0 = pad_[0];
+  const uint64_t t1 = pad_[1];
+  h0 += t0 & kMask44;
+  c = h0 >> 44;
+  h0 &= kMask44;
+  h1 += (((t0 >> 44) | (t1 << 20)) & kMask44) + c;
+  c = h1 >> 44;
+  h1 &= kMask44;
+  h2 += ((t1 >> 24) & kMask42) + c;
+  h2 &= kMask42;
+
+  StoreLE64(tag, h0 | (h1 << 44));
+  StoreLE64(tag + 8, (h1 >> 20) | (h2 << 24));
+  h_[0] = h_[1] = h_[2] = 0;
+}
+
+} // namespace crypto
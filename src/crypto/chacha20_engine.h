@@ -0,0 +1,98 @@
+#ifndef CRYPTO_CHACHA20_ENGINE_H_
+#define CRYPTO_CHACHA20_ENGINE_H_
+
+#include "base/macros.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace crypto {
+
+// The ChaCha20 key, nonce and block counter of RFC 8439, as little-endian
+// words.
+struct ChaCha20State {
+  uint32_t key[8];
+  uint32_t nonce[3];
+  uint32_t counter;
+
+  // |key| is 32 bytes, |nonce| 12.
+  void Init(const uint8_t* key_bytes, const uint8_t* nonce_bytes,
+            uint32_t initial_counter);
+};
+
+// ChaCha20 kernels. It needs nothing but 32-bit adds, xors and rotates, so
+// it runs at full speed on CPUs (or virtual machines) without AES-NI.
+//
+// The SIMD kernels compute several 64-byte blocks at once, one block per
+// 32-bit lane: 4 blocks with SSSE3, 8 with AVX2. The best kernel set is
+// picked once, through CPUID.
+class ChaCha20Engine {
+ public:
+  enum Level {
+    kPortable,
+    kSSSE3,
+    kAVX2,
+  };
+
+  static const size_t kBlockSize = 64;
+
+  // XORs the keystream starting at block |state->counter| into |blocks|
+  // 64-byte blocks, and advances the counter. |in| may equal |out|.
+  typedef void (*XorFunc)(ChaCha20State* state,
+                          const uint8_t* in,
+                          uint8_t* out,
+                          size_t blocks);
+
+  struct Kernels {
+    Level level;
+    const char* name;
+    XorFunc xor_keystream;
+  };
+
+  // The fastest kernel set the CPU runs; never nullptr.
+  static const Kernels* Get();
+  // The kernel set for |level|, nullptr when the CPU lacks it.
+  static const Kernels* Get(Level level);
+
+  // XORs the keystream into |size| bytes with |kernels|. Only the last call
+  // for a stream may pass a size that is not a multiple of 64.
+  static void Crypt(const Kernels* kernels,
+                    ChaCha20State* state,
+                    const uint8_t* in,
+                    uint8_t* out,
+                    size_t size);
+
+ private:
+  ChaCha20Engine() = delete;
+  DISALLOW_COPY_AND_ASSIGN(ChaCha20Engine);
+};
+
+// The Poly1305 one-time authenticator of RFC 8439, fed incrementally.
+class Poly1305 {
+ public:
+  static const size_t kKeySize = 32;
+  static const size_t kTagSize = 16;
+
+  explicit Poly1305(const uint8_t* key);
+  ~Poly1305();
+
+  void Update(const uint8_t* data, size_t size);
+  // Pads what was fed so far with zeros to a multiple of 16 bytes, as the
+  // AEAD construction does after the AAD and the ciphertext.
+  void PadTo16();
+  void Finish(uint8_t* tag);
+
+ private:
+  void Blocks(const uint8_t* data, size_t blocks, uint64_t hibit);
+
+  uint64_t r_[3];
+  uint64_t h_[3];
+  uint64_t pad_[2];
+  uint8_t buffer_[16];
+  size_t buffered_;
+
+  DISALLOW_COPY_AND_ASSIGN(Poly1305);
+};
+
+} // namespace crypto
+#endif // CRYPTO_CHACHA20_ENGINE_H_
@@ -0,0 +1,201 @@
+#include "crypto/chacha20_poly1305_encryptor.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+// Bytes run through the kernels per step; a multiple of the block size.
+const size_t kChunkSize = 16 << 10;
+// The block counter is 32 bits and block 0 keys Poly1305.
+const uint64_t kMaxTextSize =
+    0xffffffffULL * ChaCha20Engine::kBlockSize;
+
+base::Status WriteError() {
+  return base::Status(base::error::INTERNAL, "Failed to write output");
+}
+
+bool TagsEqual(const uint8_t* a, const uint8_t* b, size_t size) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < size; ++i) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+} // namespace
+
+const int ChaCha20Poly1305Encryptor::kKeySize;
+const int ChaCha20Poly1305Encryptor::kNonceSize;
+const int ChaCha20Poly1305Encryptor::kTagSize;
+
+ChaCha20Poly1305Encryptor::ChaCha20Poly1305Encryptor(
+    strings::StringPiece raw_key,
+    const std::string& iv,
+    const std::string& aad,
+    const ChaCha20Engine::Kernels* kernels)
+    : iv_(iv),
+      iv_used_(false),
+      aad_(aad),
+      kernels_(kernels) {
+  if (raw_key.size() == static_cast<size_t>(kKeySize)) {
+    key_ = SecureKeyBytes::Allocate(raw_key.size());
+    if (key_) {
+      memcpy(key_->data(), raw_key.data(), raw_key.size());
+    }
+  } else {
+    LOG(ERROR) << "ChaCha20 key must be 256 bits, got " << raw_key.size() * 8;
+  }
+}
+
+ChaCha20Poly1305Encryptor::~ChaCha20Poly1305Encryptor() {}
+
+base::Status ChaCha20Poly1305Encryptor::Encrypt(io::InputStream* input,
+                                                io::OutputStream* output) {
+  if (iv_used_.exchange(true)) {
+    return base::Status(base::error::FAILED_PRECONDITION,
+                        "ChaCha20-Poly1305 nonce already used; "
+                        "pass a fresh one");
+  }
+  return Crypt(true, iv_, input, output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::Decrypt(io::InputStream* input,
+                                                io::OutputStream* output) {
+  return Crypt(false, iv_, input, output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::Encrypt(const std::string& nonce,
+                                                io::InputStream* input,
+                                                io::OutputStream* output) {
+  return Crypt(true, nonce, input, output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::Decrypt(const std::string& nonce,
+                                                io::InputStream* input,
+                                                io::OutputStream* output) {
+  return Crypt(false, nonce, input, output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::EncryptRecord(
+    const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Encrypt(record.input, record.output);
+  }
+  return Encrypt(record.iv, record.input, record.output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::DecryptRecord(
+    const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Decrypt(record.input, record.output);
+  }
+  return Decrypt(record.iv, record.input, record.output);
+}
+
+base::Status ChaCha20Poly1305Encryptor::Crypt(bool do_encrypt,
+                                              const std::string& nonce,
+                                              io::InputStream* input,
+                                              io::OutputStream* output) {
+  if (!key_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "ChaCha20 key must be 256 bits");
+  }
+  if (nonce.size() != static_cast<size_t>(kNonceSize)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "ChaCha20-Poly1305 nonce must be 12 bytes");
+  }
+  if (!kernels_) {
+    return base::Status(base::error::FAILED_PRECONDITION,
+                        "ChaCha20 kernels not supported on this CPU");
+  }
+
+  ChaCha20State state;
+  state.Init(key_->data(), reinterpret_cast<const uint8_t*>(nonce.data()), 0);
+  // The first 32 bytes of keystream block 0 are the Poly1305 key.
+  uint8_t poly_key[ChaCha20Engine::kBlockSize] = {0};
+  ChaCha20Engine::Crypt(kernels_, &state, poly_key, poly_key,
+                        sizeof(poly_key));
+  Poly1305 mac(poly_key);
+  OPENSSL_cleanse(poly_key, sizeof(poly_key));
+  mac.Update(reinterpret_cast<const uint8_t*>(aad_.data()), aad_.size());
+  mac.PadTo16();
+
+  // Decrypt() keeps the last kTagSize bytes read back: they may be the tag.
+  std::string buffer(kChunkSize + kTagSize, '\0');
+  uint8_t* data = reinterpret_cast<uint8_t*>(&buffer[0]);
+  const size_t read_size = do_encrypt ? kChunkSize : buffer.size();
+  size_t held = 0;
+  size_t size = 0;
+  uint64_t text_size = 0;
+  while (true) {
+    int n = io::IOUtil::ReadFromInput(input, data + held, read_size - held);
+    size = held + (n > 0 ? n : 0);
+    const bool last = size < read_size;
+    if (!do_encrypt) {
+      if (size < static_cast<size_t>(kTagSize)) {
+        return base::Status(base::error::DATA_LOSS,
+                            "ChaCha20-Poly1305 input shorter than a tag");
+      }
+      // Carried over to the next round, or the tag.
+      size -= kTagSize;
+      held = kTagSize;
+    }
+    if (text_size + size > kMaxTextSize) {
+      return base::Status(base::error::OUT_OF_RANGE,
+                          "Too much data for one ChaCha20-Poly1305 nonce");
+    }
+    if (!do_encrypt) {
+      mac.Update(data, size);
+    }
+    ChaCha20Engine::Crypt(kernels_, &state, data, data, size);
+    if (do_encrypt) {
+      mac.Update(data, size);
+    }
+    if (size > 0 && !io::IOUtil::WriteToOutput(output, data, size)) {
+      return WriteError();
+    }
+    text_size += size;
+    if (last) {
+      break;
+    }
+    if (!do_encrypt) {
+      memmove(data, data + size, kTagSize);
+    }
+  }
+
+  uint8_t lengths[16];
+  const uint64_t aad_size = aad_.size();
+  for (int i = 0; i < 8; ++i) {
+    lengths[i] = static_cast<uint8_t>(aad_size >> (8 * i));
+    lengths[8 + i] = static_cast<uint8_t>(text_size >> (8 * i));
+  }
+  mac.PadTo16();
+  mac.Update(lengths, sizeof(lengths));
+  uint8_t tag[kTagSize];
+  mac.Finish(tag);
+
+  if (do_encrypt) {
+    if (!io::IOUtil::WriteToOutput(output, tag, kTagSize)) {
+      return WriteError();
+    }
+    return base::Status::OK;
+  }
+  if (!TagsEqual(tag, data + size, kTagSize)) {
+    return base::Status(base::error::DATA_LOSS,
+                        "ChaCha20-Poly1305 authentication tag mismatch");
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
@@ -0,0 +1,73 @@
+#ifndef CRYPTO_CHACHA20_POLY1305_ENCRYPTOR_H_
+#define CRYPTO_CHACHA20_POLY1305_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/chacha20_engine.h"
+#include "crypto/secure_key_arena.h"
+#include "strings/string_piece.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace crypto {
+
+// The ChaCha20-Poly1305 AEAD of RFC 8439 on the ChaCha20Engine kernels.
+// Same layout and contract as SslGcmAESEncryptor: Encrypt() writes the
+// ciphertext followed by a 16-byte tag, Decrypt() streams plaintext out
+// before the tag is checked, so callers must discard the output when it
+// fails, and the nonce given to the constructor seals one message.
+class ChaCha20Poly1305Encryptor : public AESEncryptor {
+ public:
+  static const int kKeySize = 32;
+  static const int kNonceSize = 12;
+  static const int kTagSize = 16;
+
+  // |raw_key| is 32 bytes, |iv| the 12-byte nonce and |aad| optional
+  // additional data that is authenticated but not encrypted. |kernels|
+  // defaults to the best set for this CPU.
+  ChaCha20Poly1305Encryptor(strings::StringPiece raw_key,
+                            const std::string& iv,
+                            const std::string& aad = "",
+                            const ChaCha20Engine::Kernels* kernels =
+                                ChaCha20Engine::Get());
+  virtual ~ChaCha20Poly1305Encryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // With |nonce| in place of the one the encryptor was built with.
+  base::Status Encrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+  base::Status Decrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+
+ protected:
+  // From AESEncryptor
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
+ private:
+  base::Status Crypt(bool do_encrypt,
+                     const std::string& nonce,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  std::shared_ptr<SecureKeyBytes> key_;
+  std::string iv_;
+  // Set by the first Encrypt() under iv_.
+  std::atomic<bool> iv_used_;
+  std::string aad_;
+  const ChaCha20Engine::Kernels* kernels_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChaCha20Poly1305Encryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_CHACHA20_POLY1305_ENCRYPTOR_H_
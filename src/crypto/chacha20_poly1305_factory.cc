@@ -0,0 +1,38 @@
+#include "crypto/aead_factory.h"
+#include "crypto/chacha20_poly1305_encryptor.h"
+
+namespace crypto {
+
+class ChaCha20Poly1305Factory : public AEADFactory {
+ public:
+  ChaCha20Poly1305Factory() {}
+  virtual ~ChaCha20Poly1305Factory() override {}
+
+  // From AEADFactory
+  virtual std::unique_ptr<AESEncryptor> Create(std::unique_ptr<AESKey>& key,
+                                               const std::string& iv,
+                                               const std::string& aad) override {
+    std::unique_ptr<ChaCha20Poly1305Encryptor> ret(
+        new ChaCha20Poly1305Encryptor(key->key(), iv, aad));
+    return std::move(ret);
+  }
+
+  virtual bool AcceptsOptions(const std::string& aead_type) override {
+    return aead_type == "chacha20_poly1305";
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ChaCha20Poly1305Factory);
+};
+
+namespace { // register
+
+class ChaCha20Poly1305Registrar {
+ public:
+  ChaCha20Poly1305Registrar() {
+    AEADFactory::Register("chacha20_poly1305", new ChaCha20Poly1305Factory());
+  }
+};
+static ChaCha20Poly1305Registrar registrar;
+} // namespace
+} // namespace crypto
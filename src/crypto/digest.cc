@@ -0,0 +1,291 @@
+#include "crypto/digest.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = DigestEngine::kBlockSize;
+
+inline void StoreBE32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+// Appends 0x80, zeros and the message length in bits to the |buffered|
+// bytes at the start of the 128-byte |buffer|. Returns the number of
+// blocks that make up.
+size_t Pad(uint8_t* buffer, size_t buffered, uint64_t total) {
+  const size_t blocks = buffered + 9 > kBlockSize ? 2 : 1;
+  const size_t end = blocks * kBlockSize;
+  buffer[buffered] = 0x80;
+  memset(buffer + buffered + 1, 0, end - 8 - buffered - 1);
+  const uint64_t bits = total * 8;
+  StoreBE32(buffer + end - 8, static_cast<uint32_t>(bits >> 32));
+  StoreBE32(buffer + end - 4, static_cast<uint32_t>(bits));
+  return blocks;
+}
+
+void StoreDigest(const uint32_t* state, uint8_t* digest) {
+  for (int i = 0; i < 8; ++i) {
+    StoreBE32(digest + 4 * i, state[i]);
+  }
+}
+
+// One stream of Digest::HashStreams(), as seen by its lane.
+struct LaneStream {
+  io::InputStream* input;
+  std::string* digest;
+  // What is left of the buffer Next() returned last.
+  const uint8_t* chunk;
+  size_t chunk_size;
+  uint64_t total;
+  // The bytes that straddle two buffers, and at the end the padding.
+  uint8_t buffer[2 * kBlockSize];
+  size_t buffered;
+  bool padded;
+  // The blocks the lane runs through next, in |chunk| or in |buffer|.
+  const uint8_t* window;
+  size_t window_blocks;
+  bool in_buffer;
+
+  void Start(io::InputStream* stream_input, std::string* stream_digest) {
+    input = stream_input;
+    digest = stream_digest;
+    chunk = nullptr;
+    chunk_size = 0;
+    total = 0;
+    buffered = 0;
+    padded = false;
+    window = nullptr;
+    window_blocks = 0;
+    in_buffer = false;
+  }
+
+  // Lines up the next window, reading from |input| as needed. False once
+  // the padding went through.
+  bool NextWindow() {
+    while (true) {
+      if (padded) {
+        return false;
+      }
+      if (buffered == 0 && chunk_size >= kBlockSize) {
+        window = chunk;
+        window_blocks = chunk_size / kBlockSize;
+        in_buffer = false;
+        return true;
+      }
+      if (chunk_size > 0) {
+        const size_t take = std::min(kBlockSize - buffered, chunk_size);
+        memcpy(buffer + buffered, chunk, take);
+        buffered += take;
+        chunk += take;
+        chunk_size -= take;
+        if (buffered == kBlockSize) {
+          window = buffer;
+          window_blocks = 1;
+          in_buffer = true;
+          return true;
+        }
+        continue;
+      }
+      const void* data;
+      int size;
+      if (input->Next(&data, &size)) {
+        chunk = reinterpret_cast<const uint8_t*>(data);
+        chunk_size = size;
+        total += size;
+        continue;
+      }
+      window = buffer;
+      window_blocks = Pad(buffer, buffered, total);
+      in_buffer = true;
+      padded = true;
+      return true;
+    }
+  }
+
+  void Advance(size_t blocks) {
+    window += blocks * kBlockSize;
+    window_blocks -= blocks;
+    if (!in_buffer) {
+      chunk += blocks * kBlockSize;
+      chunk_size -= blocks * kBlockSize;
+    } else if (window_blocks == 0) {
+      buffered = 0;
+    }
+  }
+};
+
+} // namespace
+
+const size_t Digest::kDigestSize;
+const size_t Digest::kBlockSize;
+
+Digest::Digest(DigestEngine::Algorithm algorithm,
+               const DigestEngine::Kernels* kernels)
+    : kernels_(kernels ? kernels : DigestEngine::Get(algorithm)),
+      total_(0),
+      buffered_(0) {
+  CHECK_EQ(algorithm, kernels_->algorithm);
+  memcpy(state_, DigestEngine::InitialState(algorithm), sizeof(state_));
+}
+
+Digest::~Digest() {
+  OPENSSL_cleanse(buffer_, sizeof(buffer_));
+}
+
+void Digest::Update(const void* data, size_t size) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  total_ += size;
+  if (buffered_ > 0) {
+    const size_t take = std::min(kBlockSize - buffered_, size);
+    memcpy(buffer_ + buffered_, p, take);
+    buffered_ += take;
+    p += take;
+    size -= take;
+    if (buffered_ < kBlockSize) {
+      return;
+    }
+    kernels_->blocks(state_, buffer_, 1);
+    buffered_ = 0;
+  }
+  const size_t blocks = size / kBlockSize;
+  if (blocks > 0) {
+    kernels_->blocks(state_, p, blocks);
+  }
+  p += blocks * kBlockSize;
+  size -= blocks * kBlockSize;
+  memcpy(buffer_, p, size);
+  buffered_ = size;
+}
+
+int64_t Digest::Update(io::InputStream* input) {
+  int64_t read = 0;
+  const void* data;
+  int size;
+  while (input->Next(&data, &size)) {
+    Update(data, size);
+    read += size;
+  }
+  return read;
+}
+
+void Digest::Finish(uint8_t* digest) {
+  uint8_t last[2 * kBlockSize];
+  memcpy(last, buffer_, buffered_);
+  kernels_->blocks(state_, last, Pad(last, buffered_, total_));
+  OPENSSL_cleanse(last, sizeof(last));
+  buffered_ = 0;
+  StoreDigest(state_, digest);
+}
+
+// static
+std::string Digest::Hash(DigestEngine::Algorithm algorithm,
+                         strings::StringPiece data) {
+  Digest digest(algorithm);
+  digest.Update(data);
+  std::string out(kDigestSize, '\0');
+  digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+  return out;
+}
+
+// static
+std::string Digest::Hash(DigestEngine::Algorithm algorithm,
+                         io::InputStream* input) {
+  Digest digest(algorithm);
+  digest.Update(input);
+  std::string out(kDigestSize, '\0');
+  digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+  return out;
+}
+
+// static
+void Digest::HashStreams(DigestEngine::Algorithm algorithm,
+                         io::InputStream* const* inputs,
+                         int count,
+                         std::string* digests,
+                         const DigestEngine::Kernels* kernels) {
+  if (!kernels) {
+    kernels = DigestEngine::Get(algorithm);
+  }
+  CHECK_EQ(algorithm, kernels->algorithm);
+  const int kNumLanes = DigestEngine::kLanes;
+  const uint32_t* initial = DigestEngine::InitialState(algorithm);
+  DigestEngine::Lanes lanes;
+  LaneStream streams[kNumLanes];
+  bool active[kNumLanes];
+  // Idle lanes spin on this block.
+  uint8_t scratch[kBlockSize] = {0};
+  int next = 0;
+
+  // Hands |lane| the next stream; false when none is left. Every stream
+  // has a first window, if only its padding.
+  auto assign = [&](int lane) {
+    if (next == count) {
+      return false;
+    }
+    streams[lane].Start(inputs[next], &digests[next]);
+    ++next;
+    memcpy(lanes.state[lane], initial, sizeof(lanes.state[lane]));
+    return streams[lane].NextWindow();
+  };
+  for (int lane = 0; lane < kNumLanes; ++lane) {
+    active[lane] = assign(lane);
+  }
+
+  while (true) {
+    int num_active = 0;
+    int last_active = 0;
+    size_t steps = 0;
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      if (!active[lane]) {
+        continue;
+      }
+      const size_t blocks = streams[lane].window_blocks;
+      steps = num_active == 0 ? blocks : std::min(steps, blocks);
+      ++num_active;
+      last_active = lane;
+    }
+    if (num_active == 0) {
+      break;
+    }
+
+    if (num_active == 1) {
+      // Nothing to run side by side with.
+      kernels->blocks(lanes.state[last_active], streams[last_active].window,
+                      steps);
+    } else {
+      for (int lane = 0; lane < kNumLanes; ++lane) {
+        lanes.data[lane] = active[lane] ? streams[lane].window : scratch;
+        lanes.stride[lane] = active[lane] ? kBlockSize : 0;
+      }
+      kernels->blocks_lanes(&lanes, steps);
+    }
+
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      if (!active[lane]) {
+        continue;
+      }
+      LaneStream& stream = streams[lane];
+      stream.Advance(steps);
+      if (stream.window_blocks > 0 || stream.NextWindow()) {
+        continue;
+      }
+      stream.digest->assign(kDigestSize, '\0');
+      StoreDigest(lanes.state[lane],
+                  reinterpret_cast<uint8_t*>(&(*stream.digest)[0]));
+      active[lane] = assign(lane);
+    }
+  }
+}
+
+} // namespace crypto
@@ -0,0 +1,64 @@
+#ifndef CRYPTO_DIGEST_H_
+#define CRYPTO_DIGEST_H_
+
+#include "base/macros.h"
+#include "crypto/digest_engine.h"
+#include "io/input_stream.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace crypto {
+
+// A SHA-256 or SM3 digest, fed incrementally on the DigestEngine kernels.
+// Whole blocks are hashed where they lie, so feeding an io::InputStream
+// copies nothing but the bytes that straddle the buffers it hands out.
+class Digest {
+ public:
+  static const size_t kDigestSize = DigestEngine::kDigestSize;
+  static const size_t kBlockSize = DigestEngine::kBlockSize;
+
+  // |kernels| must be for |algorithm|; nullptr picks the fastest set.
+  explicit Digest(DigestEngine::Algorithm algorithm,
+                  const DigestEngine::Kernels* kernels = nullptr);
+  ~Digest();
+
+  void Update(const void* data, size_t size);
+  void Update(strings::StringPiece data) { Update(data.data(), data.size()); }
+  // Feeds |input| up to its end, through Next(). Returns the number of
+  // bytes it read.
+  int64_t Update(io::InputStream* input);
+  // Writes kDigestSize bytes. The object must not be fed afterwards.
+  void Finish(uint8_t* digest);
+
+  // The digest of |data| or of the rest of |input|, as kDigestSize raw
+  // bytes.
+  static std::string Hash(DigestEngine::Algorithm algorithm,
+                          strings::StringPiece data);
+  static std::string Hash(DigestEngine::Algorithm algorithm,
+                          io::InputStream* input);
+
+  // Stores the digest of each of |count| streams in |digests|. Up to
+  // DigestEngine::kLanes streams are hashed side by side through the lane
+  // kernel, and a lane moves on to the next stream as soon as its own
+  // ends, which is what pays off for many small objects.
+  static void HashStreams(DigestEngine::Algorithm algorithm,
+                          io::InputStream* const* inputs,
+                          int count,
+                          std::string* digests,
+                          const DigestEngine::Kernels* kernels = nullptr);
+
+ private:
+  const DigestEngine::Kernels* kernels_;
+  uint32_t state_[8];
+  uint64_t total_;
+  uint8_t buffer_[kBlockSize];
+  size_t buffered_;
+
+  DISALLOW_COPY_AND_ASSIGN(Digest);
+};
+
+} // namespace crypto
+#endif // CRYPTO_DIGEST_H_
@@ -0,0 +1,579 @@
+#include "crypto/digest_engine.h"
+
+#include <cpuid.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <glog/logging.h>
+
+// As in aesni_engine.cc, the SIMD kernels are compiled for their
+// instruction sets one function at a time.
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+namespace crypto {
+
+namespace {
+
+const uint32_t kSha256Initial[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const uint32_t kSha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t kSm3Initial[8] = {
+  0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+  0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e,
+};
+
+inline uint32_t Rotl(uint32_t v, int n) {
+  n &= 31;
+  return n == 0 ? v : (v << n) | (v >> (32 - n));
+}
+
+inline uint32_t Rotr(uint32_t v, int n) {
+  return (v >> n) | (v << (32 - n));
+}
+
+inline uint32_t LoadBE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) << 24 |
+         static_cast<uint32_t>(p[1]) << 16 |
+         static_cast<uint32_t>(p[2]) << 8 |
+         static_cast<uint32_t>(p[3]);
+}
+
+// The SM3 round constants T_j <<< j.
+struct Sm3Constants {
+  Sm3Constants() {
+    for (int j = 0; j < 64; ++j) {
+      t[j] = Rotl(j < 16 ? 0x79cc4519 : 0x7a879d8a, j);
+    }
+  }
+  uint32_t t[64];
+};
+
+const uint32_t* Sm3T() {
+  static const Sm3Constants constants;
+  return constants.t;
+}
+
+// CPUID
+
+struct CpuFeatures {
+  bool avx2;
+  bool sha;
+};
+
+uint64_t ReadXCR0() {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+CpuFeatures DetectFeatures() {
+  CpuFeatures features = {false, false};
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return features;
+  }
+  const bool ssse3 = ecx & (1u << 9);
+  const bool sse41 = ecx & (1u << 19);
+  const bool osxsave = ecx & (1u << 27);
+  if (!ssse3 || !sse41 || __get_cpuid_max(0, nullptr) < 7) {
+    return features;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  features.sha = ebx & (1u << 29);
+  // The OS has to save the xmm and ymm state.
+  features.avx2 = osxsave && (ebx & (1u << 5)) &&
+                  (ReadXCR0() & 0x6) == 0x6;
+  return features;
+}
+
+const CpuFeatures& Features() {
+  static const CpuFeatures features = DetectFeatures();
+  return features;
+}
+
+// Portable kernels
+
+void Sha256Portable(uint32_t* state, const uint8_t* data, size_t blocks) {
+  uint32_t w[64];
+  for (; blocks > 0; --blocks, data += DigestEngine::kBlockSize) {
+    for (int t = 0; t < 16; ++t) {
+      w[t] = LoadBE32(data + 4 * t);
+    }
+    for (int t = 16; t < 64; ++t) {
+      const uint32_t s0 = Rotr(w[t - 15], 7) ^ Rotr(w[t - 15], 18) ^
+                          (w[t - 15] >> 3);
+      const uint32_t s1 = Rotr(w[t - 2], 17) ^ Rotr(w[t - 2], 19) ^
+                          (w[t - 2] >> 10);
+      w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; ++t) {
+      const uint32_t s1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+      const uint32_t ch = g ^ (e & (f ^ g));
+      const uint32_t t1 = h + s1 + ch + kSha256K[t] + w[t];
+      const uint32_t s0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+      const uint32_t maj = (a & b) | (c & (a | b));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + s0 + maj;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+inline uint32_t P0(uint32_t x) {
+  return x ^ Rotl(x, 9) ^ Rotl(x, 17);
+}
+
+inline uint32_t P1(uint32_t x) {
+  return x ^ Rotl(x, 15) ^ Rotl(x, 23);
+}
+
+void Sm3Portable(uint32_t* state, const uint8_t* data, size_t blocks) {
+  const uint32_t* tj = Sm3T();
+  uint32_t w[68];
+  for (; blocks > 0; --blocks, data += DigestEngine::kBlockSize) {
+    for (int j = 0; j < 16; ++j) {
+      w[j] = LoadBE32(data + 4 * j);
+    }
+    for (int j = 16; j < 68; ++j) {
+      w[j] = P1(w[j - 16] ^ w[j - 9] ^ Rotl(w[j - 3], 15)) ^
+             Rotl(w[j - 13], 7) ^ w[j - 6];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int j = 0; j < 64; ++j) {
+      const uint32_t a12 = Rotl(a, 12);
+      const uint32_t ss1 = Rotl(a12 + e + tj[j], 7);
+      const uint32_t ss2 = ss1 ^ a12;
+      const uint32_t ff = j < 16 ? a ^ b ^ c : (a & b) | (c & (a | b));
+      const uint32_t gg = j < 16 ? e ^ f ^ g : g ^ (e & (f ^ g));
+      const uint32_t tt1 = ff + d + ss2 + (w[j] ^ w[j + 4]);
+      const uint32_t tt2 = gg + h + ss1 + w[j];
+      d = c;
+      c = Rotl(b, 9);
+      b = a;
+      a = tt1;
+      h = g;
+      g = Rotl(f, 19);
+      f = e;
+      e = P0(tt2);
+    }
+    state[0] ^= a;
+    state[1] ^= b;
+    state[2] ^= c;
+    state[3] ^= d;
+    state[4] ^= e;
+    state[5] ^= f;
+    state[6] ^= g;
+    state[7] ^= h;
+  }
+}
+
+// Lanes one after the other, for kernel sets without a SIMD lane kernel.
+template <DigestEngine::BlocksFunc kBlocks>
+void SerialLanes(DigestEngine::Lanes* lanes, size_t blocks) {
+  for (int lane = 0; lane < DigestEngine::kLanes; ++lane) {
+    if (lanes->stride[lane] != 0) {
+      kBlocks(lanes->state[lane], lanes->data[lane], blocks);
+      lanes->data[lane] += blocks * DigestEngine::kBlockSize;
+    }
+  }
+}
+
+// SHA-NI kernel
+
+// Four rounds of SHA-256 on the message words in |current|. With
+// kSchedule the words of the group after |current| are completed into
+// |next|, and with kStart the group after that is started in |previous|.
+template <bool kSchedule, bool kStart>
+SHANI_TARGET inline void Sha256Quad(__m128i* abef, __m128i* cdgh,
+                                    const uint32_t* k, __m128i current,
+                                    __m128i* previous, __m128i* next) {
+  __m128i message = _mm_add_epi32(
+      current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(k)));
+  *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, message);
+  if (kSchedule) {
+    *next = _mm_add_epi32(*next, _mm_alignr_epi8(current, *previous, 4));
+    *next = _mm_sha256msg2_epu32(*next, current);
+  }
+  message = _mm_shuffle_epi32(message, 0x0e);
+  *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, message);
+  if (kStart) {
+    *previous = _mm_sha256msg1_epu32(*previous, current);
+  }
+}
+
+SHANI_TARGET void Sha256SHANI(uint32_t* state, const uint8_t* data,
+                              size_t blocks) {
+  const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                      0x0405060700010203ULL);
+  // The rounds instruction wants the state as ABEF and CDGH.
+  __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+  __m128i cdgh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+  t = _mm_shuffle_epi32(t, 0xb1);
+  cdgh = _mm_shuffle_epi32(cdgh, 0x1b);
+  __m128i abef = _mm_alignr_epi8(t, cdgh, 8);
+  cdgh = _mm_blend_epi16(cdgh, t, 0xf0);
+
+  const uint32_t* k = kSha256K;
+  for (; blocks > 0; --blocks, data += DigestEngine::kBlockSize) {
+    const __m128i abef_save = abef;
+    const __m128i cdgh_save = cdgh;
+    const __m128i* in = reinterpret_cast<const __m128i*>(data);
+    __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(in), swap);
+    __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), swap);
+    __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), swap);
+    __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), swap);
+
+    Sha256Quad<false, false>(&abef, &cdgh, k, m0, &m3, &m1);
+    Sha256Quad<false, true>(&abef, &cdgh, k + 4, m1, &m0, &m2);
+    Sha256Quad<false, true>(&abef, &cdgh, k + 8, m2, &m1, &m3);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 12, m3, &m2, &m0);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 16, m0, &m3, &m1);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 20, m1, &m0, &m2);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 24, m2, &m1, &m3);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 28, m3, &m2, &m0);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 32, m0, &m3, &m1);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 36, m1, &m0, &m2);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 40, m2, &m1, &m3);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 44, m3, &m2, &m0);
+    Sha256Quad<true, true>(&abef, &cdgh, k + 48, m0, &m3, &m1);
+    Sha256Quad<true, false>(&abef, &cdgh, k + 52, m1, &m0, &m2);
+    Sha256Quad<true, false>(&abef, &cdgh, k + 56, m2, &m1, &m3);
+    Sha256Quad<false, false>(&abef, &cdgh, k + 60, m3, &m2, &m0);
+
+    abef = _mm_add_epi32(abef, abef_save);
+    cdgh = _mm_add_epi32(cdgh, cdgh_save);
+  }
+
+  t = _mm_shuffle_epi32(abef, 0x1b);
+  cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+  abef = _mm_blend_epi16(t, cdgh, 0xf0);
+  cdgh = _mm_alignr_epi8(cdgh, t, 8);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), abef);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), cdgh);
+}
+
+// AVX2 lane kernels: lane i of every ymm register belongs to message i.
+
+AVX2_TARGET inline __m256i Rotl256(__m256i v, int n) {
+  return _mm256_or_si256(_mm256_slli_epi32(v, n),
+                         _mm256_srli_epi32(v, 32 - n));
+}
+
+AVX2_TARGET inline __m256i Rotr256(__m256i v, int n) {
+  return Rotl256(v, 32 - n);
+}
+
+AVX2_TARGET inline __m256i Add(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+AVX2_TARGET inline __m256i Xor(__m256i a, __m256i b) {
+  return _mm256_xor_si256(a, b);
+}
+
+// The 8x8 word transpose: eight rows of eight words in, the eight columns
+// out. It is its own inverse.
+AVX2_TARGET inline void Transpose8(__m256i* x) {
+  const __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]);
+  const __m256i t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+  const __m256i t2 = _mm256_unpacklo_epi32(x[2], x[3]);
+  const __m256i t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+  const __m256i t4 = _mm256_unpacklo_epi32(x[4], x[5]);
+  const __m256i t5 = _mm256_unpackhi_epi32(x[4], x[5]);
+  const __m256i t6 = _mm256_unpacklo_epi32(x[6], x[7]);
+  const __m256i t7 = _mm256_unpackhi_epi32(x[6], x[7]);
+  const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+  x[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  x[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  x[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  x[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  x[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  x[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  x[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  x[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+AVX2_TARGET inline void LoadStates(const DigestEngine::Lanes& lanes,
+                                   __m256i* s) {
+  for (int i = 0; i < 8; ++i) {
+    s[i] = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(lanes.state[i]));
+  }
+  Transpose8(s);
+}
+
+AVX2_TARGET inline void StoreStates(__m256i* s, DigestEngine::Lanes* lanes) {
+  Transpose8(s);
+  for (int i = 0; i < 8; ++i) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes->state[i]), s[i]);
+  }
+}
+
+// The 16 big-endian words of the current block of every lane, and moves
+// the lanes on to their next block.
+AVX2_TARGET inline void LoadMessages(DigestEngine::Lanes* lanes, __m256i* w) {
+  const __m256i swap = _mm256_broadcastsi128_si256(_mm_set_epi64x(
+      0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL));
+  for (int half = 0; half < 2; ++half) {
+    __m256i* x = w + 8 * half;
+    for (int i = 0; i < 8; ++i) {
+      x[i] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(lanes->data[i] + 32 * half));
+    }
+    Transpose8(x);
+    for (int i = 0; i < 8; ++i) {
+      x[i] = _mm256_shuffle_epi8(x[i], swap);
+    }
+  }
+  for (int i = 0; i < 8; ++i) {
+    lanes->data[i] += lanes->stride[i];
+  }
+}
+
+// One SHA-256 round. The names rotate instead of the values: the new a
+// lands in h and the new e in d.
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, t)                              \
+  do {                                                                       \
+    const __m256i s1 = Xor(Xor(Rotr256(e, 6), Rotr256(e, 11)),              \
+                           Rotr256(e, 25));                                  \
+    const __m256i ch = Xor(g, _mm256_and_si256(e, Xor(f, g)));               \
+    const __m256i t1 = Add(Add(Add(h, s1), Add(ch, w[t])),                   \
+                           _mm256_set1_epi32(kSha256K[t]));                  \
+    const __m256i s0 = Xor(Xor(Rotr256(a, 2), Rotr256(a, 13)),              \
+                           Rotr256(a, 22));                                  \
+    const __m256i maj = _mm256_or_si256(                                     \
+        _mm256_and_si256(a, b),                                              \
+        _mm256_and_si256(c, _mm256_or_si256(a, b)));                         \
+    d = Add(d, t1);                                                          \
+    h = Add(t1, Add(s0, maj));                                               \
+  } while (0)
+
+AVX2_TARGET void Sha256AVX2Lanes(DigestEngine::Lanes* lanes, size_t blocks) {
+  __m256i s[8];
+  LoadStates(*lanes, s);
+  __m256i w[64];
+  for (; blocks > 0; --blocks) {
+    LoadMessages(lanes, w);
+    for (int t = 16; t < 64; ++t) {
+      const __m256i s0 = Xor(Xor(Rotr256(w[t - 15], 7),
+                                 Rotr256(w[t - 15], 18)),
+                             _mm256_srli_epi32(w[t - 15], 3));
+      const __m256i s1 = Xor(Xor(Rotr256(w[t - 2], 17),
+                                 Rotr256(w[t - 2], 19)),
+                             _mm256_srli_epi32(w[t - 2], 10));
+      w[t] = Add(Add(w[t - 16], s0), Add(w[t - 7], s1));
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0; t < 64; t += 8) {
+      SHA256_ROUND(a, b, c, d, e, f, g, h, t);
+      SHA256_ROUND(h, a, b, c, d, e, f, g, t + 1);
+      SHA256_ROUND(g, h, a, b, c, d, e, f, t + 2);
+      SHA256_ROUND(f, g, h, a, b, c, d, e, t + 3);
+      SHA256_ROUND(e, f, g, h, a, b, c, d, t + 4);
+      SHA256_ROUND(d, e, f, g, h, a, b, c, t + 5);
+      SHA256_ROUND(c, d, e, f, g, h, a, b, t + 6);
+      SHA256_ROUND(b, c, d, e, f, g, h, a, t + 7);
+    }
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+  }
+  StoreStates(s, lanes);
+}
+
+#undef SHA256_ROUND
+
+AVX2_TARGET inline __m256i P0x8(__m256i x) {
+  return Xor(x, Xor(Rotl256(x, 9), Rotl256(x, 17)));
+}
+
+AVX2_TARGET inline __m256i P1x8(__m256i x) {
+  return Xor(x, Xor(Rotl256(x, 15), Rotl256(x, 23)));
+}
+
+// One SM3 round, FF and GG picked by |early| (j < 16). The new a lands in
+// d and the new e in h; b and f are rotated in place.
+#define SM3_ROUND(a, b, c, d, e, f, g, h, j, early)                          \
+  do {                                                                       \
+    const __m256i a12 = Rotl256(a, 12);                                      \
+    const __m256i ss1 = Rotl256(Add(Add(a12, e), _mm256_set1_epi32(tj[j])), \
+                                7);                                          \
+    const __m256i ss2 = Xor(ss1, a12);                                       \
+    const __m256i ff = early ? Xor(Xor(a, b), c) :                           \
+        _mm256_or_si256(_mm256_and_si256(a, b),                              \
+                        _mm256_and_si256(c, _mm256_or_si256(a, b)));         \
+    const __m256i gg = early ? Xor(Xor(e, f), g) :                           \
+        Xor(g, _mm256_and_si256(e, Xor(f, g)));                              \
+    const __m256i tt1 = Add(Add(ff, d), Add(ss2, Xor(w[j], w[(j) + 4])));    \
+    const __m256i tt2 = Add(Add(gg, h), Add(ss1, w[j]));                     \
+    b = Rotl256(b, 9);                                                       \
+    f = Rotl256(f, 19);                                                      \
+    d = tt1;                                                                 \
+    h = P0x8(tt2);                                                           \
+  } while (0)
+
+#define SM3_ROUNDS4(j, early)                                                \
+  do {                                                                       \
+    SM3_ROUND(a, b, c, d, e, f, g, h, j, early);                             \
+    SM3_ROUND(d, a, b, c, h, e, f, g, (j) + 1, early);                       \
+    SM3_ROUND(c, d, a, b, g, h, e, f, (j) + 2, early);                       \
+    SM3_ROUND(b, c, d, a, f, g, h, e, (j) + 3, early);                       \
+  } while (0)
+
+AVX2_TARGET void Sm3AVX2Lanes(DigestEngine::Lanes* lanes, size_t blocks) {
+  const uint32_t* tj = Sm3T();
+  __m256i s[8];
+  LoadStates(*lanes, s);
+  __m256i w[68];
+  for (; blocks > 0; --blocks) {
+    LoadMessages(lanes, w);
+    for (int j = 16; j < 68; ++j) {
+      w[j] = Xor(Xor(P1x8(Xor(Xor(w[j - 16], w[j - 9]),
+                              Rotl256(w[j - 3], 15))),
+                     Rotl256(w[j - 13], 7)),
+                 w[j - 6]);
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int j = 0; j < 16; j += 4) {
+      SM3_ROUNDS4(j, true);
+    }
+    for (int j = 16; j < 64; j += 4) {
+      SM3_ROUNDS4(j, false);
+    }
+    s[0] = Xor(s[0], a);
+    s[1] = Xor(s[1], b);
+    s[2] = Xor(s[2], c);
+    s[3] = Xor(s[3], d);
+    s[4] = Xor(s[4], e);
+    s[5] = Xor(s[5], f);
+    s[6] = Xor(s[6], g);
+    s[7] = Xor(s[7], h);
+  }
+  StoreStates(s, lanes);
+}
+
+#undef SM3_ROUNDS4
+#undef SM3_ROUND
+
+const DigestEngine::Kernels kSha256PortableKernels = {
+  DigestEngine::kSha256, DigestEngine::kPortable, "portable",
+  Sha256Portable, SerialLanes<Sha256Portable>,
+};
+
+const DigestEngine::Kernels kSha256AVX2Kernels = {
+  DigestEngine::kSha256, DigestEngine::kAVX2, "avx2",
+  Sha256Portable, Sha256AVX2Lanes,
+};
+
+// SHA-NI does a message faster than the AVX2 lanes do eight, so it runs
+// the lanes too.
+const DigestEngine::Kernels kSha256SHANIKernels = {
+  DigestEngine::kSha256, DigestEngine::kSHANI, "shani",
+  Sha256SHANI, SerialLanes<Sha256SHANI>,
+};
+
+const DigestEngine::Kernels kSm3PortableKernels = {
+  DigestEngine::kSm3, DigestEngine::kPortable, "portable",
+  Sm3Portable, SerialLanes<Sm3Portable>,
+};
+
+const DigestEngine::Kernels kSm3AVX2Kernels = {
+  DigestEngine::kSm3, DigestEngine::kAVX2, "avx2",
+  Sm3Portable, Sm3AVX2Lanes,
+};
+
+} // namespace
+
+const size_t DigestEngine::kBlockSize;
+const size_t DigestEngine::kDigestSize;
+const int DigestEngine::kLanes;
+
+// static
+const DigestEngine::Kernels* DigestEngine::Get(Algorithm algorithm) {
+  const Kernels* kernels = Get(algorithm, kSHANI);
+  if (!kernels) {
+    kernels = Get(algorithm, kAVX2);
+  }
+  return kernels ? kernels : Get(algorithm, kPortable);
+}
+
+// static
+const DigestEngine::Kernels* DigestEngine::Get(Algorithm algorithm,
+                                               Level level) {
+  const bool sha256 = algorithm == kSha256;
+  switch (level) {
+    case kPortable:
+      return sha256 ? &kSha256PortableKernels : &kSm3PortableKernels;
+    case kAVX2:
+      if (!Features().avx2) {
+        return nullptr;
+      }
+      return sha256 ? &kSha256AVX2Kernels : &kSm3AVX2Kernels;
+    case kSHANI:
+      return sha256 && Features().sha ? &kSha256SHANIKernels : nullptr;
+  }
+  return nullptr;
+}
+
+// static
+const uint32_t* DigestEngine::InitialState(Algorithm algorithm) {
+  return algorithm == kSha256 ? kSha256Initial : kSm3Initial;
+}
+
+} // namespace crypto
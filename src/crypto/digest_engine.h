@@ -0,0 +1,78 @@
+#ifndef CRYPTO_DIGEST_ENGINE_H_
+#define CRYPTO_DIGEST_ENGINE_H_
+
+#include "base/macros.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace crypto {
+
+// Compression kernels for the two 256-bit Merkle-Damgard hashes the
+// containers use, SHA-256 (FIPS 180-4) and SM3 (GB/T 32905-2016). Both
+// work on 64-byte blocks and eight 32-bit state words, and pad the same
+// way; Digest does the buffering and padding around the kernels.
+//
+// Besides one message at a time, every kernel set can compress kLanes
+// independent messages in lockstep. The AVX2 kernels hold one message per
+// 32-bit lane of a ymm register, which is what makes hashing many small
+// objects fast; SHA-NI runs a single message faster than that, so it is
+// the serial kernel wherever the CPU has it. The best kernel set is picked
+// once, through CPUID.
+class DigestEngine {
+ public:
+  enum Algorithm {
+    kSha256,
+    kSm3,
+  };
+
+  enum Level {
+    kPortable,
+    kAVX2,
+    // SHA-256 only.
+    kSHANI,
+  };
+
+  static const size_t kBlockSize = 64;
+  static const size_t kDigestSize = 32;
+
+  // Compresses |blocks| 64-byte blocks into |state|.
+  typedef void (*BlocksFunc)(uint32_t* state,
+                             const uint8_t* data,
+                             size_t blocks);
+
+  static const int kLanes = 8;
+  struct Lanes {
+    uint32_t state[kLanes][8];
+    const uint8_t* data[kLanes];
+    // How far a lane moves per block: 64, or 0 for a lane with nothing to
+    // do that is parked on a scratch block. The state of such a lane is
+    // garbage afterwards.
+    size_t stride[kLanes];
+  };
+  // Advances every lane by |blocks| blocks.
+  typedef void (*LanesFunc)(Lanes* lanes, size_t blocks);
+
+  struct Kernels {
+    Algorithm algorithm;
+    Level level;
+    const char* name;
+    BlocksFunc blocks;
+    LanesFunc blocks_lanes;
+  };
+
+  // The fastest kernel set for |algorithm| the CPU runs; never nullptr.
+  static const Kernels* Get(Algorithm algorithm);
+  // The kernel set for |level|, nullptr when the CPU lacks it.
+  static const Kernels* Get(Algorithm algorithm, Level level);
+
+  // The eight words a message starts from.
+  static const uint32_t* InitialState(Algorithm algorithm);
+
+ private:
+  DigestEngine() = delete;
+  DISALLOW_COPY_AND_ASSIGN(DigestEngine);
+};
+
+} // namespace crypto
+#endif // CRYPTO_DIGEST_ENGINE_H_
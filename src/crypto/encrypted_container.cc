@@ -0,0 +1,557 @@
+#include "crypto/encrypted_container.h"
+#include "crypto/ssl_aes_util.h"
+
+#include "third_party/boringssl/include/openssl/evp.h"
+#include "third_party/boringssl/include/openssl/rand.h"
+
+#include "system/blocking_counter.h"
+#include "system/threadpool.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const char kHeaderMagic[] = "XCRYPTSC";
+const char kTrailerMagic[] = "XCRYPTSF";
+const size_t kMagicSize = 8;
+const size_t kNoncePrefixOffset = 16;
+const size_t kNoncePrefixSize = 8;
+const size_t kNonceSize = 12;
+const uint32_t kIndexCounter = 0xffffffff;
+// Keeps a segment and its tag addressable with 32-bit sizes.
+const size_t kMaxSegmentSize = 1 << 30;
+
+void PutFixed32(char* dst, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    dst[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+void PutFixed64(char* dst, uint64_t value) {
+  for (int i = 0; i < 8; ++i) {
+    dst[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+uint32_t GetFixed32(const char* src) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(src[i])) << (8 * i);
+  }
+  return value;
+}
+
+uint64_t GetFixed64(const char* src) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(static_cast<uint8_t>(src[i])) << (8 * i);
+  }
+  return value;
+}
+
+base::Status SslError() {
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+base::Status Corrupted(const std::string& what) {
+  return base::Status(base::error::DATA_LOSS,
+                      "Encrypted container corrupted: " + what);
+}
+
+// Encrypts (or decrypts and verifies) |size| bytes from |in| to |out| under
+// the nonce for |counter|. |tag| is written when encrypting and checked
+// when decrypting. |in| and |out| may be the same buffer.
+base::Status Seal(SslCipherContextPool* contexts,
+                  const std::string& header,
+                  uint32_t counter,
+                  bool do_encrypt,
+                  const char* in,
+                  size_t size,
+                  char* out,
+                  char* tag) {
+  uint8_t nonce[kNonceSize];
+  memcpy(nonce, header.data() + kNoncePrefixOffset, kNoncePrefixSize);
+  for (int i = 0; i < 4; ++i) {
+    nonce[kNoncePrefixSize + i] = static_cast<uint8_t>(counter >> (24 - 8 * i));
+  }
+  SslCipherContextPool::Lease ctx(contexts, nonce, do_encrypt ? 1 : 0);
+  if (!ctx.get()) {
+    return SslError();
+  }
+  int len = 0;
+  if (!EVP_CipherUpdate(ctx.get(), nullptr, &len,
+                        reinterpret_cast<const uint8_t*>(header.data()),
+                        header.size())) {
+    LOG(ERROR) << "EVP_CipherUpdate(aad): ERROR";
+    return SslError();
+  }
+  if (size > 0 &&
+      !EVP_CipherUpdate(ctx.get(), reinterpret_cast<uint8_t*>(out), &len,
+                        reinterpret_cast<const uint8_t*>(in), size)) {
+    LOG(ERROR) << "EVP_CipherUpdate: in_len: " << size << ", ERROR";
+    return SslError();
+  }
+  const int tag_size = static_cast<int>(EncryptedContainer::kTagSize);
+  if (!do_encrypt &&
+      !EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, tag_size, tag)) {
+    LOG(ERROR) << "EVP_CTRL_GCM_SET_TAG: ERROR";
+    return SslError();
+  }
+  uint8_t trailer[EncryptedContainer::kTagSize];
+  if (!EVP_CipherFinal_ex(ctx.get(), trailer, &len)) {
+    if (do_encrypt) {
+      LOG(ERROR) << "EVP_CipherFinal_ex: ERROR";
+      return SslError();
+    }
+    return Corrupted("authentication tag mismatch");
+  }
+  if (do_encrypt &&
+      !EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, tag_size, tag)) {
+    LOG(ERROR) << "EVP_CTRL_GCM_GET_TAG: ERROR";
+    return SslError();
+  }
+  return base::Status::OK;
+}
+
+} // namespace
+
+const size_t EncryptedContainer::kHeaderSize;
+const size_t EncryptedContainer::kTrailerSize;
+const size_t EncryptedContainer::kTagSize;
+const size_t EncryptedContainer::kIndexEntrySize;
+const uint32_t EncryptedContainer::kVersion;
+const size_t EncryptedContainer::kDefaultSegmentSize;
+const int EncryptedContainerWriter::kSealBatch;
+
+// static
+const EVP_CIPHER* EncryptedContainer::Cipher(strings::StringPiece raw_key) {
+  return SslAESUtil::GCMCipher(raw_key);
+}
+
+// static
+base::Status EncryptedContainer::PlaintextSize(
+    const files::RandomAccessFile* file,
+    uint64_t file_size,
+    uint64_t* size) {
+  if (file_size < kHeaderSize + kTagSize + kTrailerSize) {
+    return Corrupted("too short");
+  }
+  char trailer[kTrailerSize];
+  strings::StringPiece piece;
+  RETURN_IF_ERROR(file->Read(file_size - kTrailerSize, kTrailerSize,
+                             &piece, trailer));
+  if (memcmp(piece.data() + 16, kTrailerMagic, kMagicSize) != 0) {
+    return Corrupted("bad trailer magic");
+  }
+  const uint64_t index_offset = GetFixed64(piece.data());
+  const uint64_t count = GetFixed32(piece.data() + 8);
+  if (index_offset < kHeaderSize + count * kTagSize ||
+      index_offset + count * kIndexEntrySize + kTagSize + kTrailerSize !=
+          file_size) {
+    return Corrupted("bad index offset");
+  }
+  *size = index_offset - kHeaderSize - count * kTagSize;
+  return base::Status::OK;
+}
+
+// EncryptedContainerWriter
+
+// static
+base::Status EncryptedContainerWriter::New(
+    strings::StringPiece raw_key,
+    size_t segment_size,
+    std::unique_ptr<files::WritableFile> file,
+    core::thread::ThreadPool* pool,
+    std::unique_ptr<EncryptedContainerWriter>* result) {
+  if (!EncryptedContainer::Cipher(raw_key)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Key must be 128 or 256 bits");
+  }
+  if (segment_size == 0 || segment_size > kMaxSegmentSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Segment size out of range");
+  }
+  std::unique_ptr<EncryptedContainerWriter> writer(
+      new EncryptedContainerWriter(raw_key, segment_size, std::move(file),
+                                   pool));
+  // A writer that never got going has nothing to finish.
+  if (!writer->contexts_.ok()) {
+    writer->closed_ = true;
+    return SslError();
+  }
+  base::Status status = writer->WriteHeader();
+  if (!status.ok()) {
+    writer->closed_ = true;
+    return status;
+  }
+  *result = std::move(writer);
+  return base::Status::OK;
+}
+
+EncryptedContainerWriter::EncryptedContainerWriter(
+    strings::StringPiece raw_key,
+    size_t segment_size,
+    std::unique_ptr<files::WritableFile> file,
+    core::thread::ThreadPool* pool)
+    : segment_size_(segment_size),
+      file_(std::move(file)),
+      pool_(pool),
+      contexts_(EncryptedContainer::Cipher(raw_key), raw_key, true,
+                pool ? kSealBatch : 1),
+      offset_(0),
+      closed_(false) {
+}
+
+EncryptedContainerWriter::~EncryptedContainerWriter() {
+  // Without the index and the trailer the file could never be opened.
+  if (!closed_) {
+    base::Status status = Close();
+    LOG_IF(ERROR, !status.ok())
+        << "Closing an encrypted container on destruction: " << status;
+  }
+}
+
+base::Status EncryptedContainerWriter::WriteHeader() {
+  header_.assign(EncryptedContainer::kHeaderSize, '\0');
+  memcpy(&header_[0], kHeaderMagic, kMagicSize);
+  PutFixed32(&header_[8], EncryptedContainer::kVersion);
+  PutFixed32(&header_[12], static_cast<uint32_t>(segment_size_));
+  if (RAND_bytes(reinterpret_cast<uint8_t*>(&header_[kNoncePrefixOffset]),
+                 kNoncePrefixSize) != 1) {
+    return SslError();
+  }
+  RETURN_IF_ERROR(file_->Append(header_));
+  offset_ = header_.size();
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerWriter::WriteSegment(const char* data,
+                                                    size_t size) {
+  if (index_.size() >= kIndexCounter) {
+    return base::Status(base::error::OUT_OF_RANGE, "Too many segments");
+  }
+  sealed_.resize(size + EncryptedContainer::kTagSize);
+  RETURN_IF_ERROR(Seal(&contexts_, header_, index_.size(), true, data, size,
+                       &sealed_[0], &sealed_[size]));
+  RETURN_IF_ERROR(file_->Append(sealed_));
+  Segment segment;
+  segment.offset = offset_;
+  segment.size = static_cast<uint32_t>(size);
+  index_.push_back(segment);
+  offset_ += sealed_.size();
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerWriter::WriteSegments(
+    const char* const* segments,
+    int count) {
+  if (index_.size() + count > kIndexCounter) {
+    return base::Status(base::error::OUT_OF_RANGE, "Too many segments");
+  }
+  const size_t sealed_size = segment_size_ + EncryptedContainer::kTagSize;
+  const uint32_t first = static_cast<uint32_t>(index_.size());
+  sealed_.resize(count * sealed_size);
+  std::vector<base::Status> statuses(count);
+  auto seal = [&](int k) {
+    char* out = &sealed_[k * sealed_size];
+    statuses[k] = Seal(&contexts_, header_, first + k, true, segments[k],
+                       segment_size_, out, out + segment_size_);
+  };
+
+  if (pool_ && count > 1) {
+    core::BlockingCounter counter(count - 1);
+    for (int k = 1; k < count; ++k) {
+      pool_->Schedule([&seal, &counter, k]() {
+        seal(k);
+        counter.DecrementCount();
+      });
+    }
+    seal(0);
+    counter.Wait();
+  } else {
+    for (int k = 0; k < count; ++k) {
+      seal(k);
+    }
+  }
+  for (const base::Status& s : statuses) {
+    RETURN_IF_ERROR(s);
+  }
+
+  RETURN_IF_ERROR(file_->Append(sealed_));
+  for (int k = 0; k < count; ++k) {
+    Segment segment;
+    segment.offset = offset_;
+    segment.size = static_cast<uint32_t>(segment_size_);
+    index_.push_back(segment);
+    offset_ += sealed_size;
+  }
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerWriter::Append(
+    const strings::StringPiece& data) {
+  if (closed_) {
+    return base::Status(base::error::FAILED_PRECONDITION, "Already closed");
+  }
+  const char* ptr = data.data();
+  size_t left = data.size();
+  // The whole segments to seal; buffer_ is only refilled once they are.
+  const char* batch[kSealBatch];
+  int count = 0;
+  if (!buffer_.empty()) {
+    size_t n = std::min(left, segment_size_ - buffer_.size());
+    buffer_.append(ptr, n);
+    ptr += n;
+    left -= n;
+    if (buffer_.size() < segment_size_) {
+      return base::Status::OK;
+    }
+    batch[count++] = buffer_.data();
+  }
+  // Whole segments go straight from |data|.
+  while (left >= segment_size_) {
+    batch[count++] = ptr;
+    ptr += segment_size_;
+    left -= segment_size_;
+    if (count == kSealBatch) {
+      RETURN_IF_ERROR(WriteSegments(batch, count));
+      count = 0;
+    }
+  }
+  if (count > 0) {
+    RETURN_IF_ERROR(WriteSegments(batch, count));
+  }
+  buffer_.assign(ptr, left);
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerWriter::Close() {
+  if (closed_) {
+    return base::Status(base::error::FAILED_PRECONDITION, "Already closed");
+  }
+  closed_ = true;
+  if (!buffer_.empty()) {
+    RETURN_IF_ERROR(WriteSegment(buffer_.data(), buffer_.size()));
+    buffer_.clear();
+  }
+
+  const size_t index_size = index_.size() * EncryptedContainer::kIndexEntrySize;
+  std::string footer(index_size + EncryptedContainer::kTagSize +
+                     EncryptedContainer::kTrailerSize, '\0');
+  char* entry = &footer[0];
+  for (const Segment& segment : index_) {
+    PutFixed64(entry, segment.offset);
+    PutFixed32(entry + 8, segment.size);
+    entry += EncryptedContainer::kIndexEntrySize;
+  }
+  RETURN_IF_ERROR(Seal(&contexts_, header_, kIndexCounter, true,
+                       footer.data(), index_size, &footer[0],
+                       &footer[index_size]));
+  char* trailer = &footer[index_size + EncryptedContainer::kTagSize];
+  PutFixed64(trailer, offset_);
+  PutFixed32(trailer + 8, static_cast<uint32_t>(index_.size()));
+  memcpy(trailer + 16, kTrailerMagic, kMagicSize);
+  RETURN_IF_ERROR(file_->Append(footer));
+  return file_->Close();
+}
+
+base::Status EncryptedContainerWriter::Flush() {
+  return file_->Flush();
+}
+
+base::Status EncryptedContainerWriter::Sync() {
+  return file_->Sync();
+}
+
+// EncryptedContainerReader
+
+// static
+base::Status EncryptedContainerReader::Open(
+    strings::StringPiece raw_key,
+    std::unique_ptr<files::RandomAccessFile> file,
+    uint64_t file_size,
+    core::thread::ThreadPool* pool,
+    std::unique_ptr<EncryptedContainerReader>* result) {
+  if (!EncryptedContainer::Cipher(raw_key)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Key must be 128 or 256 bits");
+  }
+  std::unique_ptr<EncryptedContainerReader> reader(
+      new EncryptedContainerReader(raw_key, std::move(file), pool));
+  if (!reader->contexts_.ok()) {
+    return SslError();
+  }
+  RETURN_IF_ERROR(reader->ReadIndex(file_size));
+  *result = std::move(reader);
+  return base::Status::OK;
+}
+
+EncryptedContainerReader::EncryptedContainerReader(
+    strings::StringPiece raw_key,
+    std::unique_ptr<files::RandomAccessFile> file,
+    core::thread::ThreadPool* pool)
+    : file_(std::move(file)),
+      pool_(pool),
+      contexts_(EncryptedContainer::Cipher(raw_key), raw_key, false),
+      segment_size_(0),
+      size_(0) {
+}
+
+EncryptedContainerReader::~EncryptedContainerReader() {}
+
+base::Status EncryptedContainerReader::ReadIndex(uint64_t file_size) {
+  const size_t kHeaderSize = EncryptedContainer::kHeaderSize;
+  const size_t kTagSize = EncryptedContainer::kTagSize;
+  const size_t kTrailerSize = EncryptedContainer::kTrailerSize;
+  if (file_size < kHeaderSize + kTagSize + kTrailerSize) {
+    return Corrupted("too short");
+  }
+
+  std::string buffer(kHeaderSize, '\0');
+  strings::StringPiece piece;
+  RETURN_IF_ERROR(file_->Read(0, kHeaderSize, &piece, &buffer[0]));
+  header_ = piece.ToString();
+  if (memcmp(header_.data(), kHeaderMagic, kMagicSize) != 0) {
+    return Corrupted("bad header magic");
+  }
+  if (GetFixed32(&header_[8]) != EncryptedContainer::kVersion) {
+    return base::Status(base::error::UNIMPLEMENTED,
+                        "Unknown encrypted container version");
+  }
+  segment_size_ = GetFixed32(&header_[12]);
+  if (segment_size_ == 0 || segment_size_ > kMaxSegmentSize) {
+    return Corrupted("bad segment size");
+  }
+
+  char trailer[kTrailerSize];
+  RETURN_IF_ERROR(file_->Read(file_size - kTrailerSize, kTrailerSize,
+                              &piece, trailer));
+  if (memcmp(piece.data() + 16, kTrailerMagic, kMagicSize) != 0) {
+    return Corrupted("bad trailer magic");
+  }
+  const uint64_t index_offset = GetFixed64(piece.data());
+  const uint64_t count = GetFixed32(piece.data() + 8);
+  const uint64_t index_size = count * EncryptedContainer::kIndexEntrySize;
+  if (index_offset < kHeaderSize ||
+      index_offset + index_size + kTagSize + kTrailerSize != file_size) {
+    return Corrupted("bad index offset");
+  }
+
+  buffer.resize(index_size + kTagSize);
+  RETURN_IF_ERROR(file_->Read(index_offset, buffer.size(), &piece,
+                              &buffer[0]));
+  if (piece.data() != buffer.data()) {
+    memcpy(&buffer[0], piece.data(), buffer.size());
+  }
+  RETURN_IF_ERROR(Seal(&contexts_, header_, kIndexCounter, false,
+                       buffer.data(), index_size, &buffer[0],
+                       &buffer[index_size]));
+
+  // Only the last segment may be short, and segments are laid out back to
+  // back between the header and the index.
+  uint64_t expected_offset = kHeaderSize;
+  index_.resize(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    const char* entry = buffer.data() + i * EncryptedContainer::kIndexEntrySize;
+    Segment& segment = index_[i];
+    segment.offset = GetFixed64(entry);
+    segment.size = GetFixed32(entry + 8);
+    bool last = i + 1 == count;
+    if (segment.offset != expected_offset ||
+        segment.size > segment_size_ ||
+        (!last && segment.size != segment_size_) ||
+        segment.size == 0) {
+      return Corrupted("bad index entry");
+    }
+    expected_offset += segment.size + kTagSize;
+    size_ += segment.size;
+  }
+  if (expected_offset != index_offset) {
+    return Corrupted("index does not cover the segments");
+  }
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerReader::ReadSegment(size_t i,
+                                                   size_t begin,
+                                                   size_t end,
+                                                   char* dst) const {
+  const Segment& segment = index_[i];
+  const size_t sealed_size = segment.size + EncryptedContainer::kTagSize;
+  std::unique_ptr<char[]> buffer(new char[sealed_size]);
+  strings::StringPiece piece;
+  base::Status s = file_->Read(segment.offset, sealed_size, &piece,
+                               buffer.get());
+  if (!s.ok()) {
+    return s.error_code() == base::error::OUT_OF_RANGE ?
+        Corrupted("truncated segment") : s;
+  }
+  // The tag is read from |piece| before anything is written over it.
+  char tag[EncryptedContainer::kTagSize];
+  memcpy(tag, piece.data() + segment.size, sizeof(tag));
+  // A whole segment is decrypted straight into |dst|, a partial one in
+  // place and then copied.
+  bool whole = begin == 0 && end == segment.size;
+  RETURN_IF_ERROR(Seal(&contexts_, header_, i, false, piece.data(),
+                       segment.size, whole ? dst : buffer.get(), tag));
+  if (!whole) {
+    memcpy(dst, buffer.get() + begin, end - begin);
+  }
+  return base::Status::OK;
+}
+
+base::Status EncryptedContainerReader::Read(uint64_t offset,
+                                            size_t n,
+                                            strings::StringPiece* result,
+                                            char* scratch) const {
+  *result = strings::StringPiece(scratch, 0);
+  uint64_t end = offset >= size_ ? offset : std::min<uint64_t>(offset + n, size_);
+  if (end > offset) {
+    const size_t first = offset / segment_size_;
+    const size_t last = (end - 1) / segment_size_;
+    const int num_segments = static_cast<int>(last - first + 1);
+    std::vector<base::Status> statuses(num_segments);
+
+    auto read_segment = [&](int k) {
+      size_t i = first + k;
+      uint64_t segment_start = static_cast<uint64_t>(i) * segment_size_;
+      size_t begin = std::max(offset, segment_start) - segment_start;
+      size_t stop = std::min<uint64_t>(end, segment_start + index_[i].size) -
+                    segment_start;
+      char* dst = scratch + (segment_start + begin - offset);
+      statuses[k] = ReadSegment(i, begin, stop, dst);
+    };
+
+    if (pool_ && num_segments > 1) {
+      core::BlockingCounter counter(num_segments - 1);
+      for (int k = 1; k < num_segments; ++k) {
+        pool_->Schedule([&read_segment, &counter, k]() {
+          read_segment(k);
+          counter.DecrementCount();
+        });
+      }
+      read_segment(0);
+      counter.Wait();
+    } else {
+      for (int k = 0; k < num_segments; ++k) {
+        read_segment(k);
+      }
+    }
+    for (const base::Status& s : statuses) {
+      RETURN_IF_ERROR(s);
+    }
+    *result = strings::StringPiece(scratch, end - offset);
+  }
+  if (end - offset < n) {
+    return base::Status(base::error::OUT_OF_RANGE,
+                        "Read less bytes than requested");
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
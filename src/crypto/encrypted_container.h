@@ -0,0 +1,168 @@
+#ifndef CRYPTO_ENCRYPTED_CONTAINER_H_
+#define CRYPTO_ENCRYPTED_CONTAINER_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "files/file_system.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// A seekable encrypted file: the plaintext is cut into fixed-size segments
+// that are encrypted and authenticated independently with AES-GCM, so any
+// range can be read by decrypting only the segments it overlaps.
+//
+//   header   magic "XCRYPTSC", version (u32), segment size (u32),
+//            nonce prefix (8 random bytes), 8 reserved bytes
+//   segment  ciphertext || 16-byte tag, one per segment; all segments but
+//            the last hold exactly segment-size plaintext bytes
+//   index    per segment: file offset (u64), plaintext size (u32); GCM
+//            encrypted, followed by its tag
+//   trailer  index offset (u64), segment count (u32), reserved (u32),
+//            magic "XCRYPTSF"
+//
+// Integers are little-endian. Segment i uses the nonce prefix || i
+// (big-endian u32), the index uses prefix || 0xffffffff, and the header is
+// the additional data of every one of them. Reordered, truncated or
+// swapped segments, and segments from another file, fail authentication.
+class EncryptedContainer {
+ public:
+  static const size_t kHeaderSize = 32;
+  static const size_t kTrailerSize = 24;
+  static const size_t kTagSize = 16;
+  static const size_t kIndexEntrySize = 12;
+  static const uint32_t kVersion = 1;
+  static const size_t kDefaultSegmentSize = 64 << 10;
+
+  // The GCM cipher for |raw_key|, nullptr unless it is 128 or 256 bits.
+  static const EVP_CIPHER* Cipher(strings::StringPiece raw_key);
+
+  // The plaintext size of the |file_size|-byte container in |file|, taken
+  // from the trailer alone. Nothing is authenticated until it is read.
+  static base::Status PlaintextSize(const files::RandomAccessFile* file,
+                                    uint64_t file_size,
+                                    uint64_t* size);
+};
+
+// Writes a container to |file|. Plaintext is buffered up to one segment;
+// Close() writes the last segment and the index, then closes |file|. A
+// writer destroyed without Close() closes itself, as LinuxWritableFile
+// does.
+class EncryptedContainerWriter : public files::WritableFile {
+ public:
+  // Up to this many whole segments are sealed per batch, and written with
+  // one Append().
+  static const int kSealBatch = 16;
+
+  // When |pool| is given, the segments of a batch are sealed on it side by
+  // side.
+  static base::Status New(strings::StringPiece raw_key,
+                          size_t segment_size,
+                          std::unique_ptr<files::WritableFile> file,
+                          core::thread::ThreadPool* pool,
+                          std::unique_ptr<EncryptedContainerWriter>* result);
+  virtual ~EncryptedContainerWriter() override;
+
+  // From files::WritableFile. Flush() and Sync() only reach the segments
+  // written so far; the buffered tail goes out with Close().
+  virtual base::Status Append(const strings::StringPiece& data) override;
+  virtual base::Status Close() override;
+  virtual base::Status Flush() override;
+  virtual base::Status Sync() override;
+
+ private:
+  struct Segment {
+    uint64_t offset;
+    uint32_t size;
+  };
+
+  EncryptedContainerWriter(strings::StringPiece raw_key,
+                           size_t segment_size,
+                           std::unique_ptr<files::WritableFile> file,
+                           core::thread::ThreadPool* pool);
+
+  base::Status WriteHeader();
+  base::Status WriteSegment(const char* data, size_t size);
+  // Seals and writes |count| whole segments.
+  base::Status WriteSegments(const char* const* segments, int count);
+
+  const size_t segment_size_;
+  std::unique_ptr<files::WritableFile> file_;
+  core::thread::ThreadPool* pool_;
+  SslCipherContextPool contexts_;
+  std::string header_;
+  std::string buffer_;
+  std::string sealed_;
+  std::vector<Segment> index_;
+  uint64_t offset_;
+  bool closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncryptedContainerWriter);
+};
+
+// Random access to the plaintext of a container. Read() is safe to call
+// from several threads at once.
+class EncryptedContainerReader : public files::RandomAccessFile {
+ public:
+  // |file_size| is the size of the container in |file|. When |pool| is
+  // set, reads spanning several segments decrypt them on it in parallel.
+  static base::Status Open(strings::StringPiece raw_key,
+                           std::unique_ptr<files::RandomAccessFile> file,
+                           uint64_t file_size,
+                           core::thread::ThreadPool* pool,
+                           std::unique_ptr<EncryptedContainerReader>* result);
+  virtual ~EncryptedContainerReader() override;
+
+  // From files::RandomAccessFile. Like a plain file, a read past the end
+  // returns the bytes that exist with OUT_OF_RANGE. A segment that fails
+  // authentication fails the whole read with DATA_LOSS.
+  virtual base::Status Read(uint64_t offset,
+                            size_t n,
+                            strings::StringPiece* result,
+                            char* scratch) const override;
+
+  // Plaintext size.
+  uint64_t size() const { return size_; }
+  size_t segment_size() const { return segment_size_; }
+
+ private:
+  struct Segment {
+    uint64_t offset;
+    uint32_t size;
+  };
+
+  EncryptedContainerReader(strings::StringPiece raw_key,
+                           std::unique_ptr<files::RandomAccessFile> file,
+                           core::thread::ThreadPool* pool);
+
+  base::Status ReadIndex(uint64_t file_size);
+  // Decrypts segment |i| and copies its bytes [begin, end) to |dst|.
+  base::Status ReadSegment(size_t i, size_t begin, size_t end,
+                           char* dst) const;
+
+  std::unique_ptr<files::RandomAccessFile> file_;
+  core::thread::ThreadPool* pool_;
+  mutable SslCipherContextPool contexts_;
+  std::string header_;
+  size_t segment_size_;
+  std::vector<Segment> index_;
+  uint64_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncryptedContainerReader);
+};
+
+} // namespace crypto
+#endif // CRYPTO_ENCRYPTED_CONTAINER_H_
@@ -0,0 +1,289 @@
+#include "crypto/encrypted_file_system.h"
+#include "crypto/encrypted_container.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+#include "third_party/boringssl/include/openssl/rand.h"
+
+#include "files/linux/linux_file_system.h"
+#include "io/array_input_stream.h"
+#include "io/array_output_stream.h"
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+// The envelope is the magic, the nonce, then the data key encrypted under
+// the master key with the magic as additional data, and its tag.
+const char kEnvelopeMagic[] = "XCRYPTEK";
+const size_t kMagicSize = 8;
+const size_t kDataKeySize = 32;
+
+std::mutex* master_key_mu = new std::mutex;
+AESKey* master_key = nullptr;
+
+Status Unimplemented(const std::string& what) {
+  return Status(base::error::UNIMPLEMENTED,
+                what + " is not supported on encrypted files");
+}
+
+// Reads |file| shifted by |offset| bytes.
+class OffsetRandomAccessFile : public files::RandomAccessFile {
+ public:
+  OffsetRandomAccessFile(std::unique_ptr<files::RandomAccessFile> file,
+                         uint64_t offset)
+      : file_(std::move(file)),
+        offset_(offset) {
+  }
+
+  Status Read(uint64_t offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    return file_->Read(offset_ + offset, n, result, scratch);
+  }
+
+ private:
+  std::unique_ptr<files::RandomAccessFile> file_;
+  const uint64_t offset_;
+};
+
+Status WrapKey(const AESKey& master, const AESKey& data_key,
+               std::string* envelope) {
+  envelope->assign(kEnvelopeMagic, kMagicSize);
+  std::string nonce(SslGcmAESEncryptor::kNonceSize, '\0');
+  if (RAND_bytes(reinterpret_cast<uint8_t*>(&nonce[0]), nonce.size()) != 1) {
+    return Status(base::error::INTERNAL, "RAND_bytes failed");
+  }
+  envelope->append(nonce);
+
+  char wrapped[kDataKeySize + SslGcmAESEncryptor::kTagSize];
+  SslGcmAESEncryptor gcm(master.key(), nonce,
+                         std::string(kEnvelopeMagic, kMagicSize));
+  StringPiece raw_key = data_key.key();
+  io::ArrayInputStream input(raw_key.data(), raw_key.size());
+  io::ArrayOutputStream output(wrapped, sizeof(wrapped));
+  RETURN_IF_ERROR(gcm.Encrypt(&input, &output));
+  if (output.ByteCount() != static_cast<int64_t>(sizeof(wrapped))) {
+    return Status(base::error::INTERNAL, "Wrapped key size mismatch");
+  }
+  envelope->append(wrapped, sizeof(wrapped));
+  DCHECK_EQ(EncryptedFileSystem::kEnvelopeSize, envelope->size());
+  return Status::OK;
+}
+
+Status UnwrapKey(const AESKey& master, StringPiece envelope,
+                 std::unique_ptr<AESKey>* data_key) {
+  if (envelope.size() != EncryptedFileSystem::kEnvelopeSize ||
+      memcmp(envelope.data(), kEnvelopeMagic, kMagicSize) != 0) {
+    return Status(base::error::DATA_LOSS, "Not an encrypted file");
+  }
+  const char* nonce = envelope.data() + kMagicSize;
+  const char* wrapped = nonce + SslGcmAESEncryptor::kNonceSize;
+  SslGcmAESEncryptor gcm(master.key(),
+                         std::string(nonce, SslGcmAESEncryptor::kNonceSize),
+                         std::string(kEnvelopeMagic, kMagicSize));
+  // GCM writes the plaintext before checking the tag, hence the room for
+  // a whole block more than the key.
+  char raw_key[kDataKeySize + 16];
+  io::ArrayInputStream input(wrapped,
+                             kDataKeySize + SslGcmAESEncryptor::kTagSize);
+  io::ArrayOutputStream output(raw_key, sizeof(raw_key));
+  Status s = gcm.Decrypt(&input, &output);
+  if (s.ok() && output.ByteCount() == static_cast<int64_t>(kDataKeySize)) {
+    *data_key = AESKey::FromBytesBuffer(raw_key, kDataKeySize);
+  }
+  OPENSSL_cleanse(raw_key, sizeof(raw_key));
+  if (!s.ok()) {
+    return Status(base::error::DATA_LOSS,
+                  "Data key does not open under the master key");
+  }
+  if (!*data_key) {
+    return Status(base::error::INTERNAL, "Failed to load the data key");
+  }
+  return Status::OK;
+}
+
+} // namespace
+
+const size_t EncryptedFileSystem::kEnvelopeSize;
+
+EncryptedFileSystem::EncryptedFileSystem()
+    : owned_base_(new files::LocalLinuxFileSystem),
+      base_(owned_base_.get()) {
+}
+
+EncryptedFileSystem::EncryptedFileSystem(files::FileSystem* base,
+                                         std::unique_ptr<AESKey> master_key)
+    : base_(base),
+      master_key_(std::move(master_key)) {
+}
+
+EncryptedFileSystem::~EncryptedFileSystem() {}
+
+// static
+void EncryptedFileSystem::SetMasterKey(std::unique_ptr<AESKey> key) {
+  std::lock_guard<std::mutex> l(*master_key_mu);
+  delete master_key;
+  master_key = key.release();
+}
+
+Status EncryptedFileSystem::MasterKey(std::unique_ptr<AESKey>* key) const {
+  if (master_key_) {
+    *key = master_key_->Clone();
+    return Status::OK;
+  }
+  std::lock_guard<std::mutex> l(*master_key_mu);
+  if (!master_key) {
+    return Status(base::error::FAILED_PRECONDITION,
+                  "No master key for encrypted files");
+  }
+  *key = master_key->Clone();
+  return Status::OK;
+}
+
+core::thread::ThreadPool* EncryptedFileSystem::pool() {
+  std::call_once(pool_once_, [this]() {
+    int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    pool_.reset(new core::thread::ThreadPool(core::Env::Default(), "enc_fs",
+                                             num_threads));
+  });
+  return pool_.get();
+}
+
+std::string EncryptedFileSystem::TranslateName(const std::string& name) const {
+  return files::GetNameFromURI(name);
+}
+
+Status EncryptedFileSystem::NewRandomAccessFile(
+    const std::string& fname,
+    std::unique_ptr<files::RandomAccessFile>* result) {
+  std::unique_ptr<AESKey> master;
+  RETURN_IF_ERROR(MasterKey(&master));
+  const std::string name = TranslateName(fname);
+  uint64_t file_size;
+  RETURN_IF_ERROR(base_->GetFileSize(name, &file_size));
+  if (file_size < kEnvelopeSize) {
+    return Status(base::error::DATA_LOSS, "Not an encrypted file: " + fname);
+  }
+  std::unique_ptr<files::RandomAccessFile> file;
+  RETURN_IF_ERROR(base_->NewRandomAccessFile(name, &file));
+
+  char envelope[kEnvelopeSize];
+  StringPiece piece;
+  RETURN_IF_ERROR(file->Read(0, kEnvelopeSize, &piece, envelope));
+  std::unique_ptr<AESKey> data_key;
+  RETURN_IF_ERROR(UnwrapKey(*master, piece, &data_key));
+
+  std::unique_ptr<EncryptedContainerReader> reader;
+  RETURN_IF_ERROR(EncryptedContainerReader::Open(
+      data_key->key(),
+      std::unique_ptr<files::RandomAccessFile>(
+          new OffsetRandomAccessFile(std::move(file), kEnvelopeSize)),
+      file_size - kEnvelopeSize, pool(), &reader));
+  *result = std::move(reader);
+  return Status::OK;
+}
+
+Status EncryptedFileSystem::NewWritableFile(
+    const std::string& fname,
+    std::unique_ptr<files::WritableFile>* result) {
+  std::unique_ptr<AESKey> master;
+  RETURN_IF_ERROR(MasterKey(&master));
+  std::unique_ptr<AESKey> data_key = AESKey::Create(kDataKeySize * 8);
+  if (!data_key) {
+    return Status(base::error::INTERNAL, "Failed to create a data key");
+  }
+  std::string envelope;
+  RETURN_IF_ERROR(WrapKey(*master, *data_key, &envelope));
+
+  std::unique_ptr<files::WritableFile> file;
+  RETURN_IF_ERROR(base_->NewWritableFile(TranslateName(fname), &file));
+  RETURN_IF_ERROR(file->Append(envelope));
+  std::unique_ptr<EncryptedContainerWriter> writer;
+  RETURN_IF_ERROR(EncryptedContainerWriter::New(
+      data_key->key(), EncryptedContainer::kDefaultSegmentSize,
+      std::move(file), pool(), &writer));
+  *result = std::move(writer);
+  return Status::OK;
+}
+
+Status EncryptedFileSystem::NewAppendableFile(
+    const std::string& fname,
+    std::unique_ptr<files::WritableFile>* result) {
+  return Unimplemented("Appending");
+}
+
+Status EncryptedFileSystem::NewReadOnlyMemoryRegionFromFile(
+    const std::string& fname,
+    std::unique_ptr<files::ReadOnlyMemoryRegion>* result) {
+  return Unimplemented("Mapping");
+}
+
+bool EncryptedFileSystem::FileExists(const std::string& fname) {
+  return base_->FileExists(TranslateName(fname));
+}
+
+Status EncryptedFileSystem::GetChildren(const std::string& dir,
+                                        std::vector<std::string>* result) {
+  return base_->GetChildren(TranslateName(dir), result);
+}
+
+Status EncryptedFileSystem::PlaintextSize(const std::string& name,
+                                          uint64_t* size) {
+  uint64_t file_size;
+  RETURN_IF_ERROR(base_->GetFileSize(name, &file_size));
+  if (file_size < kEnvelopeSize) {
+    return Status(base::error::DATA_LOSS, "Not an encrypted file: " + name);
+  }
+  std::unique_ptr<files::RandomAccessFile> file;
+  RETURN_IF_ERROR(base_->NewRandomAccessFile(name, &file));
+  OffsetRandomAccessFile container(std::move(file), kEnvelopeSize);
+  return EncryptedContainer::PlaintextSize(&container,
+                                           file_size - kEnvelopeSize, size);
+}
+
+Status EncryptedFileSystem::Stat(const std::string& fname,
+                                 files::FileStatistics* stat) {
+  const std::string name = TranslateName(fname);
+  RETURN_IF_ERROR(base_->Stat(name, stat));
+  if (stat->is_directory) {
+    return Status::OK;
+  }
+  uint64_t size;
+  RETURN_IF_ERROR(PlaintextSize(name, &size));
+  stat->length = static_cast<int64_t>(size);
+  return Status::OK;
+}
+
+Status EncryptedFileSystem::DeleteFile(const std::string& fname) {
+  return base_->DeleteFile(TranslateName(fname));
+}
+
+Status EncryptedFileSystem::CreateDir(const std::string& dirname) {
+  return base_->CreateDir(TranslateName(dirname));
+}
+
+Status EncryptedFileSystem::DeleteDir(const std::string& dirname) {
+  return base_->DeleteDir(TranslateName(dirname));
+}
+
+Status EncryptedFileSystem::GetFileSize(const std::string& fname,
+                                        uint64_t* size) {
+  return PlaintextSize(TranslateName(fname), size);
+}
+
+Status EncryptedFileSystem::RenameFile(const std::string& src,
+                                       const std::string& target) {
+  return base_->RenameFile(TranslateName(src), TranslateName(target));
+}
+
+REGISTER_FILE_SYSTEM_ENV(core::Env::Default(), "enc", EncryptedFileSystem);
+
+} // namespace crypto
@@ -0,0 +1,97 @@
+#ifndef CRYPTO_ENCRYPTED_FILE_SYSTEM_H_
+#define CRYPTO_ENCRYPTED_FILE_SYSTEM_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "crypto/aes_key.h"
+#include "files/file_system.h"
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// Encryption at rest on top of another FileSystem, registered as "enc", so
+// that Env::NewWritableFile("enc:///path") and friends, ReadFileToString
+// and WriteStringToFile included, encrypt and decrypt transparently.
+//
+// Every file gets its own random 256-bit data key. It is stored in front of
+// the data, wrapped (AES-GCM) under the master key, and the data follows as
+// an EncryptedContainer: memory stays bounded by one segment when writing,
+// and reads decrypt only the segments they touch, in parallel when they
+// span several. Sizes reported by Stat() and GetFileSize() are plaintext
+// sizes.
+//
+// Files cannot be appended to or mapped; those calls are UNIMPLEMENTED.
+class EncryptedFileSystem : public files::FileSystem {
+ public:
+  // Size of the wrapped data key in front of every file.
+  static const size_t kEnvelopeSize = 68;
+
+  // The registered instance: encrypts onto the local file system with the
+  // process master key (see SetMasterKey()).
+  EncryptedFileSystem();
+  // Encrypts onto |base|, which must outlive this, with |master_key|.
+  EncryptedFileSystem(files::FileSystem* base,
+                      std::unique_ptr<AESKey> master_key);
+  virtual ~EncryptedFileSystem() override;
+
+  // Sets the master key of the registered "enc" file system. Until it is
+  // set, every file operation there fails with FAILED_PRECONDITION.
+  static void SetMasterKey(std::unique_ptr<AESKey> master_key);
+
+  // From files::FileSystem
+  virtual Status NewRandomAccessFile(
+      const std::string& fname,
+      std::unique_ptr<files::RandomAccessFile>* result) override;
+  virtual Status NewWritableFile(
+      const std::string& fname,
+      std::unique_ptr<files::WritableFile>* result) override;
+  virtual Status NewAppendableFile(
+      const std::string& fname,
+      std::unique_ptr<files::WritableFile>* result) override;
+  virtual Status NewReadOnlyMemoryRegionFromFile(
+      const std::string& fname,
+      std::unique_ptr<files::ReadOnlyMemoryRegion>* result) override;
+  virtual bool FileExists(const std::string& fname) override;
+  virtual Status GetChildren(const std::string& dir,
+                             std::vector<std::string>* result) override;
+  virtual Status Stat(const std::string& fname,
+                      files::FileStatistics* stat) override;
+  virtual Status DeleteFile(const std::string& fname) override;
+  virtual Status CreateDir(const std::string& dirname) override;
+  virtual Status DeleteDir(const std::string& dirname) override;
+  virtual Status GetFileSize(const std::string& fname,
+                             uint64_t* size) override;
+  virtual Status RenameFile(const std::string& src,
+                            const std::string& target) override;
+  virtual std::string TranslateName(const std::string& name) const override;
+
+ private:
+  // A handle on the master key, or FAILED_PRECONDITION.
+  Status MasterKey(std::unique_ptr<AESKey>* key) const;
+  // The plaintext size of the container file |name| (translated).
+  Status PlaintextSize(const std::string& name, uint64_t* size);
+  core::thread::ThreadPool* pool();
+
+  std::unique_ptr<files::FileSystem> owned_base_;
+  files::FileSystem* base_;
+  std::unique_ptr<AESKey> master_key_;
+
+  std::once_flag pool_once_;
+  std::unique_ptr<core::thread::ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncryptedFileSystem);
+};
+
+} // namespace crypto
+#endif // CRYPTO_ENCRYPTED_FILE_SYSTEM_H_
@@ -0,0 +1,354 @@
+#include "crypto/hash_tree.h"
+#include "crypto/digest.h"
+
+#include "files/file_system.h"
+#include "system/blocking_counter.h"
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kDigestSize = DigestEngine::kDigestSize;
+// Chunks, or nodes, per task of the pool.
+const uint64_t kChunksPerTask = 16;
+const uint64_t kNodesPerTask = 4096;
+const uint8_t kLeafTag = 0x00;
+const uint8_t kNodeTag = 0x01;
+const uint8_t kRootTag = 0x02;
+
+inline void StoreLE(uint8_t* p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    p[i] = static_cast<uint8_t>(v >> (8 * i));
+  }
+}
+
+// The index and tag that follow a chunk.
+struct LeafSuffix {
+  explicit LeafSuffix(uint64_t index) {
+    StoreLE(bytes, index, 8);
+    bytes[8] = kLeafTag;
+  }
+  uint8_t bytes[9];
+};
+
+// A chunk and its suffix as one stream, so that Digest::HashStreams()
+// reads the chunk where it lies.
+class LeafInputStream : public io::InputStream {
+ public:
+  LeafInputStream(const uint8_t* chunk, size_t size, uint64_t index)
+      : suffix_(index),
+        part_(0),
+        offset_(0),
+        byte_count_(0) {
+    parts_[0] = chunk;
+    sizes_[0] = size;
+    parts_[1] = suffix_.bytes;
+    sizes_[1] = sizeof(suffix_.bytes);
+  }
+
+  // From io::InputStream
+  virtual bool Next(const void** data, int* size) override {
+    while (part_ < 2 && offset_ == sizes_[part_]) {
+      ++part_;
+      offset_ = 0;
+    }
+    if (part_ == 2) {
+      return false;
+    }
+    *data = parts_[part_] + offset_;
+    *size = static_cast<int>(sizes_[part_] - offset_);
+    byte_count_ += *size;
+    offset_ = sizes_[part_];
+    return true;
+  }
+  virtual void BackUp(int count) override {
+    CHECK_LE(static_cast<size_t>(count), offset_);
+    offset_ -= count;
+    byte_count_ -= count;
+  }
+  virtual bool Skip(int count) override {
+    const void* data;
+    int size;
+    while (count > 0 && Next(&data, &size)) {
+      if (size > count) {
+        BackUp(size - count);
+        size = count;
+      }
+      count -= size;
+    }
+    return count == 0;
+  }
+  virtual int64_t ByteCount() const override { return byte_count_; }
+
+ private:
+  LeafSuffix suffix_;
+  const uint8_t* parts_[2];
+  size_t sizes_[2];
+  int part_;
+  size_t offset_;
+  int64_t byte_count_;
+};
+
+// Runs |fn| over [0, |count|) in ranges of |grain|, the first on the
+// calling thread and the others on |pool|, and returns once all are done.
+void ParallelFor(core::thread::ThreadPool* pool, uint64_t count,
+                 uint64_t grain,
+                 const std::function<void(uint64_t, uint64_t)>& fn) {
+  const uint64_t num_ranges = (count + grain - 1) / grain;
+  if (pool == nullptr || num_ranges <= 1) {
+    fn(0, count);
+    return;
+  }
+  core::BlockingCounter counter(static_cast<int>(num_ranges - 1));
+  for (uint64_t i = 1; i < num_ranges; ++i) {
+    pool->Schedule([&fn, &counter, i, count, grain]() {
+      fn(i * grain, std::min(count, (i + 1) * grain));
+      counter.DecrementCount();
+    });
+  }
+  fn(0, std::min(count, grain));
+  counter.Wait();
+}
+
+uint64_t NumChunks(uint64_t size, size_t chunk_size) {
+  return size == 0 ? 1 : (size - 1) / chunk_size + 1;
+}
+
+// The size of chunk |index|.
+size_t ChunkSize(uint64_t size, size_t chunk_size, uint64_t index) {
+  const uint64_t begin = index * chunk_size;
+  return static_cast<size_t>(std::min<uint64_t>(chunk_size, size - begin));
+}
+
+std::string LeafHash(DigestEngine::Algorithm algorithm, uint64_t index,
+                     strings::StringPiece chunk) {
+  const LeafSuffix suffix(index);
+  Digest digest(algorithm);
+  digest.Update(chunk);
+  digest.Update(suffix.bytes, sizeof(suffix.bytes));
+  std::string out(kDigestSize, '\0');
+  digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+  return out;
+}
+
+void NodeHash(DigestEngine::Algorithm algorithm, const char* left,
+              const char* right, char* out) {
+  Digest digest(algorithm);
+  digest.Update(left, kDigestSize);
+  digest.Update(right, kDigestSize);
+  digest.Update(&kNodeTag, 1);
+  digest.Finish(reinterpret_cast<uint8_t*>(out));
+}
+
+std::string RootHash(DigestEngine::Algorithm algorithm,
+                     strings::StringPiece top, uint64_t size,
+                     size_t chunk_size) {
+  uint8_t geometry[13];
+  StoreLE(geometry, size, 8);
+  StoreLE(geometry + 8, chunk_size, 4);
+  geometry[12] = kRootTag;
+  Digest digest(algorithm);
+  digest.Update(top);
+  digest.Update(geometry, sizeof(geometry));
+  std::string out(kDigestSize, '\0');
+  digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+  return out;
+}
+
+bool ValidChunkSize(size_t chunk_size) {
+  // Input streams and the root encoding take 32-bit sizes.
+  return chunk_size > 0 && chunk_size <= INT_MAX;
+}
+
+base::Status Mismatch() {
+  return base::Status(base::error::DATA_LOSS, "Chunk does not match its hash");
+}
+
+} // namespace
+
+const size_t HashTree::kDefaultChunkSize;
+
+HashTree::HashTree(DigestEngine::Algorithm algorithm, uint64_t size,
+                   size_t chunk_size)
+    : algorithm_(algorithm),
+      size_(size),
+      chunk_size_(chunk_size),
+      num_chunks_(NumChunks(size, chunk_size)) {}
+
+HashTree::~HashTree() {}
+
+// static
+std::unique_ptr<HashTree> HashTree::Build(DigestEngine::Algorithm algorithm,
+                                          const void* data,
+                                          uint64_t size,
+                                          size_t chunk_size,
+                                          core::thread::ThreadPool* pool) {
+  if (!ValidChunkSize(chunk_size)) {
+    LOG(ERROR) << "Invalid hash tree chunk size " << chunk_size;
+    return nullptr;
+  }
+  std::unique_ptr<HashTree> tree(new HashTree(algorithm, size, chunk_size));
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  const uint64_t num_chunks = tree->num_chunks_;
+
+  // Every task hashes its chunks side by side through the lane kernel.
+  tree->levels_.emplace_back(num_chunks * kDigestSize, '\0');
+  char* leaves = &tree->levels_[0][0];
+  ParallelFor(pool, num_chunks, kChunksPerTask,
+              [=](uint64_t begin, uint64_t end) {
+    std::vector<std::unique_ptr<LeafInputStream>> streams;
+    std::vector<io::InputStream*> inputs;
+    for (uint64_t i = begin; i < end; ++i) {
+      streams.emplace_back(new LeafInputStream(
+          bytes + i * chunk_size, ChunkSize(size, chunk_size, i), i));
+      inputs.push_back(streams.back().get());
+    }
+    std::vector<std::string> digests(end - begin);
+    Digest::HashStreams(algorithm, inputs.data(),
+                        static_cast<int>(inputs.size()),
+                        digests.data());
+    for (uint64_t i = begin; i < end; ++i) {
+      memcpy(leaves + i * kDigestSize, digests[i - begin].data(),
+             kDigestSize);
+    }
+  });
+
+  for (uint64_t width = num_chunks; width > 1; width = (width + 1) / 2) {
+    const std::string& below = tree->levels_.back();
+    std::string level(((width + 1) / 2) * kDigestSize, '\0');
+    const char* children = below.data();
+    char* parents = &level[0];
+    ParallelFor(pool, width / 2, kNodesPerTask,
+                [=](uint64_t begin, uint64_t end) {
+      for (uint64_t i = begin; i < end; ++i) {
+        NodeHash(algorithm, children + 2 * i * kDigestSize,
+                 children + (2 * i + 1) * kDigestSize,
+                 parents + i * kDigestSize);
+      }
+    });
+    if (width % 2 == 1) {
+      memcpy(parents + (width / 2) * kDigestSize,
+             children + (width - 1) * kDigestSize, kDigestSize);
+    }
+    tree->levels_.push_back(std::move(level));
+  }
+  tree->root_ = RootHash(algorithm, tree->levels_.back(), size, chunk_size);
+  return tree;
+}
+
+// static
+base::Status HashTree::BuildFromFile(core::Env* env,
+                                     const std::string& fname,
+                                     DigestEngine::Algorithm algorithm,
+                                     size_t chunk_size,
+                                     core::thread::ThreadPool* pool,
+                                     std::unique_ptr<HashTree>* tree) {
+  if (!ValidChunkSize(chunk_size)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Invalid hash tree chunk size");
+  }
+  uint64_t size = 0;
+  base::Status status = env->GetFileSize(fname, &size);
+  if (!status.ok()) {
+    return status;
+  }
+  // An empty file cannot be mapped.
+  if (size == 0) {
+    *tree = Build(algorithm, "", 0, chunk_size, pool);
+    return base::Status::OK;
+  }
+  std::unique_ptr<files::ReadOnlyMemoryRegion> region;
+  status = env->NewReadOnlyMemoryRegionFromFile(fname, &region);
+  if (!status.ok()) {
+    return status;
+  }
+  *tree = Build(algorithm, region->data(), region->length(), chunk_size,
+                pool);
+  return base::Status::OK;
+}
+
+base::Status HashTree::VerifyChunk(uint64_t index,
+                                   strings::StringPiece chunk) const {
+  if (index >= num_chunks_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Chunk index past the end of the tree");
+  }
+  if (chunk.size() != ChunkSize(size_, chunk_size_, index) ||
+      LeafHash(algorithm_, index, chunk) !=
+          strings::StringPiece(levels_[0].data() + index * kDigestSize,
+                               kDigestSize)) {
+    return Mismatch();
+  }
+  return base::Status::OK;
+}
+
+std::vector<std::string> HashTree::Proof(uint64_t index) const {
+  CHECK_LT(index, num_chunks_);
+  std::vector<std::string> proof;
+  for (size_t level = 0; level + 1 < levels_.size(); ++level) {
+    const uint64_t sibling = index ^ 1;
+    if (sibling * kDigestSize < levels_[level].size()) {
+      proof.push_back(levels_[level].substr(sibling * kDigestSize,
+                                            kDigestSize));
+    }
+    index /= 2;
+  }
+  return proof;
+}
+
+// static
+base::Status HashTree::VerifyProof(DigestEngine::Algorithm algorithm,
+                                   strings::StringPiece root,
+                                   uint64_t size,
+                                   size_t chunk_size,
+                                   uint64_t index,
+                                   strings::StringPiece chunk,
+                                   const std::vector<std::string>& proof) {
+  if (!ValidChunkSize(chunk_size)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Invalid hash tree chunk size");
+  }
+  const uint64_t num_chunks = NumChunks(size, chunk_size);
+  if (index >= num_chunks) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "Chunk index past the end of the tree");
+  }
+  if (chunk.size() != ChunkSize(size, chunk_size, index)) {
+    return Mismatch();
+  }
+
+  std::string node = LeafHash(algorithm, index, chunk);
+  size_t used = 0;
+  for (uint64_t width = num_chunks; width > 1; width = (width + 1) / 2) {
+    if ((index ^ 1) < width) {
+      if (used == proof.size() || proof[used].size() != kDigestSize) {
+        return Mismatch();
+      }
+      const std::string& sibling = proof[used++];
+      std::string parent(kDigestSize, '\0');
+      if (index % 2 == 0) {
+        NodeHash(algorithm, node.data(), sibling.data(), &parent[0]);
+      } else {
+        NodeHash(algorithm, sibling.data(), node.data(), &parent[0]);
+      }
+      node.swap(parent);
+    }
+    index /= 2;
+  }
+  if (used != proof.size() ||
+      RootHash(algorithm, node, size, chunk_size) != root) {
+    return Mismatch();
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
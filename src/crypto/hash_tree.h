@@ -0,0 +1,101 @@
+#ifndef CRYPTO_HASH_TREE_H_
+#define CRYPTO_HASH_TREE_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "crypto/digest_engine.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+class Env;
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// A Merkle tree over fixed-size chunks of a file, so that a large file is
+// hashed on all cores and any chunk can be checked on its own.
+//
+//   leaf i  H(chunk i || i as a little-endian u64 || 0x00)
+//   node    H(left || right || 0x01); the last node of a level with an
+//           odd width moves up unchanged
+//   root    H(top node || size as u64 || chunk size as u32 || 0x02)
+//
+// H is SHA-256 or SM3; an empty file is one empty chunk. The root binds
+// the geometry, so two files only share a root when they have the same
+// bytes and the same chunk size. The default chunk size is that of
+// EncryptedContainer segments, which lets a container be re-verified one
+// segment at a time.
+class HashTree {
+ public:
+  static const size_t kDefaultChunkSize = 64 << 10;
+
+  // Hashes |size| bytes at |data|. The leaves (and the wider levels) are
+  // split over |pool| when it is not nullptr.
+  static std::unique_ptr<HashTree> Build(
+      DigestEngine::Algorithm algorithm,
+      const void* data,
+      uint64_t size,
+      size_t chunk_size = kDefaultChunkSize,
+      core::thread::ThreadPool* pool = nullptr);
+  // Maps |fname| through |env| and hashes it as Build() does.
+  static base::Status BuildFromFile(
+      core::Env* env,
+      const std::string& fname,
+      DigestEngine::Algorithm algorithm,
+      size_t chunk_size,
+      core::thread::ThreadPool* pool,
+      std::unique_ptr<HashTree>* tree);
+
+  ~HashTree();
+
+  DigestEngine::Algorithm algorithm() const { return algorithm_; }
+  uint64_t size() const { return size_; }
+  size_t chunk_size() const { return chunk_size_; }
+  uint64_t num_chunks() const { return num_chunks_; }
+  // DigestEngine::kDigestSize raw bytes.
+  const std::string& root() const { return root_; }
+
+  // OK when |chunk| holds exactly the bytes chunk |index| was built from,
+  // DATA_LOSS when it does not, INVALID_ARGUMENT for an index past the end.
+  base::Status VerifyChunk(uint64_t index, strings::StringPiece chunk) const;
+
+  // The sibling hashes from leaf |index| up to the top node, for
+  // VerifyProof().
+  std::vector<std::string> Proof(uint64_t index) const;
+
+  // Checks |chunk| as chunk |index| of a tree with |root| over |size|
+  // bytes, knowing nothing but its Proof(). Same codes as VerifyChunk().
+  static base::Status VerifyProof(DigestEngine::Algorithm algorithm,
+                                  strings::StringPiece root,
+                                  uint64_t size,
+                                  size_t chunk_size,
+                                  uint64_t index,
+                                  strings::StringPiece chunk,
+                                  const std::vector<std::string>& proof);
+
+ private:
+  HashTree(DigestEngine::Algorithm algorithm, uint64_t size,
+           size_t chunk_size);
+
+  DigestEngine::Algorithm algorithm_;
+  uint64_t size_;
+  size_t chunk_size_;
+  uint64_t num_chunks_;
+  // levels_[0] holds the leaves, each level its hashes back to back.
+  std::vector<std::string> levels_;
+  std::string root_;
+
+  DISALLOW_COPY_AND_ASSIGN(HashTree);
+};
+
+} // namespace crypto
+#endif // CRYPTO_HASH_TREE_H_
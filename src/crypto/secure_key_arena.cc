@@ -0,0 +1,126 @@
+#include "crypto/secure_key_arena.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+const size_t SecureKeyArena::kSlotSize;
+
+// static
+SecureKeyArena* SecureKeyArena::Default() {
+  static SecureKeyArena* arena = new SecureKeyArena;
+  return arena;
+}
+
+SecureKeyArena::SecureKeyArena()
+    : in_use_(0),
+      locked_(true) {
+}
+
+SecureKeyArena::~SecureKeyArena() {
+  for (void* page : pages_) {
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    OPENSSL_cleanse(page, page_size);
+    munlock(page, page_size);
+    munmap(page, page_size);
+  }
+}
+
+bool SecureKeyArena::Grow() {
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  void* page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    LOG(ERROR) << "mmap key arena page: " << strerror(errno);
+    return false;
+  }
+  if (mlock(page, page_size) != 0) {
+    if (locked_) {
+      LOG(WARNING) << "mlock key arena page: " << strerror(errno)
+                   << "; keys may be swapped out";
+    }
+    locked_ = false;
+  }
+#ifdef MADV_DONTDUMP
+  madvise(page, page_size, MADV_DONTDUMP);
+#endif
+  pages_.push_back(page);
+
+  // Hand out the lowest addresses first.
+  uint8_t* base = reinterpret_cast<uint8_t*>(page);
+  for (size_t offset = page_size; offset >= kSlotSize; offset -= kSlotSize) {
+    free_.push_back(base + offset - kSlotSize);
+  }
+  return true;
+}
+
+uint8_t* SecureKeyArena::Allocate(size_t size) {
+  if (size > kSlotSize) {
+    LOG(ERROR) << "Key of " << size << " bytes does not fit a "
+               << kSlotSize << "-byte slot";
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> l(mu_);
+  if (free_.empty() && !Grow()) {
+    return nullptr;
+  }
+  uint8_t* slot = free_.back();
+  free_.pop_back();
+  in_use_++;
+  return slot;
+}
+
+void SecureKeyArena::Release(uint8_t* slot) {
+  if (!slot) {
+    return;
+  }
+  // Pages are zero when mapped, so a wiped slot is ready for reuse.
+  OPENSSL_cleanse(slot, kSlotSize);
+  std::lock_guard<std::mutex> l(mu_);
+  free_.push_back(slot);
+  in_use_--;
+}
+
+size_t SecureKeyArena::slots_in_use() const {
+  std::lock_guard<std::mutex> l(mu_);
+  return in_use_;
+}
+
+bool SecureKeyArena::locked() const {
+  std::lock_guard<std::mutex> l(mu_);
+  return locked_;
+}
+
+// SecureKeyBytes
+
+// static
+std::shared_ptr<SecureKeyBytes> SecureKeyBytes::Allocate(size_t size) {
+  SecureKeyArena* arena = SecureKeyArena::Default();
+  uint8_t* data = arena->Allocate(size);
+  if (!data) {
+    return nullptr;
+  }
+  return std::shared_ptr<SecureKeyBytes>(
+      new SecureKeyBytes(arena, data, size));
+}
+
+SecureKeyBytes::SecureKeyBytes(SecureKeyArena* arena,
+                               uint8_t* data,
+                               size_t size)
+    : arena_(arena),
+      data_(data),
+      size_(size) {
+}
+
+SecureKeyBytes::~SecureKeyBytes() {
+  arena_->Release(data_);
+}
+
+} // namespace crypto
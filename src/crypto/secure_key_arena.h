@@ -0,0 +1,80 @@
+#ifndef CRYPTO_SECURE_KEY_ARENA_H_
+#define CRYPTO_SECURE_KEY_ARENA_H_
+
+#include "base/macros.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace crypto {
+
+// Fixed-size slots for key material, carved out of pages that are locked
+// into RAM (kept out of swap) and excluded from core dumps. A slot is
+// wiped when it is released. Pages are never returned to the system.
+class SecureKeyArena {
+ public:
+  // Large enough for any AES key, XTS key pairs included.
+  static const size_t kSlotSize = 64;
+
+  // The process-wide arena.
+  static SecureKeyArena* Default();
+
+  SecureKeyArena();
+  ~SecureKeyArena();
+
+  // A zeroed slot, nullptr when |size| > kSlotSize or no page could be
+  // mapped.
+  uint8_t* Allocate(size_t size);
+  // Wipes |slot| and makes it available again.
+  void Release(uint8_t* slot);
+
+  size_t slots_in_use() const;
+  // False when the OS refused to lock some page (see RLIMIT_MEMLOCK); the
+  // arena still works, but those keys may be swapped out.
+  bool locked() const;
+
+ private:
+  bool Grow();
+
+  mutable std::mutex mu_;
+  std::vector<void*> pages_;
+  std::vector<uint8_t*> free_;
+  size_t in_use_;
+  bool locked_;
+
+  DISALLOW_COPY_AND_ASSIGN(SecureKeyArena);
+};
+
+// Key bytes living in a SecureKeyArena slot, released (and wiped) with the
+// last reference. AESKey shares one SecureKeyBytes between its clones, so
+// handing a key to several encryptors does not copy it.
+class SecureKeyBytes {
+ public:
+  // nullptr when the arena cannot hold |size| bytes.
+  static std::shared_ptr<SecureKeyBytes> Allocate(size_t size);
+  ~SecureKeyBytes();
+
+  uint8_t* data() { return data_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  strings::StringPiece piece() const {
+    return strings::StringPiece(reinterpret_cast<const char*>(data_), size_);
+  }
+
+ private:
+  SecureKeyBytes(SecureKeyArena* arena, uint8_t* data, size_t size);
+
+  SecureKeyArena* arena_;
+  uint8_t* data_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SecureKeyBytes);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SECURE_KEY_ARENA_H_
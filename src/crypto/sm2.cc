@@ -0,0 +1,1013 @@
+#include "crypto/sm2.h"
+#include "crypto/sm3.h"
+
+#include "system/blocking_counter.h"
+#include "system/threadpool.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+#include "third_party/boringssl/include/openssl/rand.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+// Coordinates in the Montgomery form modulo p, as little-endian limbs.
+struct Sm2Point {
+  uint64_t x[4];
+  uint64_t y[4];
+};
+
+namespace {
+
+typedef unsigned __int128 uint128_t;
+
+const size_t kScalarSize = 32;
+// The base point table has a row of 15 multiples for each 4-bit digit.
+const int kDigits = 64;
+const int kMultiples = 15;
+// Signatures a task of VerifyBatch() checks.
+const int kVerifyBatchSize = 32;
+// The longest ID whose bit length fits the 16-bit ENTL.
+const size_t kMaxIdSize = 0xffff / 8;
+
+struct Modulus {
+  uint64_t m[4];
+  // -m^-1 mod 2^64.
+  uint64_t m_inv;
+  // 2^512 mod m.
+  uint64_t rr[4];
+};
+
+// The field prime p and the group order n of GB/T 32918.5.
+const Modulus kP = {
+  {0xffffffffffffffffULL, 0xffffffff00000000ULL,
+   0xffffffffffffffffULL, 0xfffffffeffffffffULL},
+  0x1ULL,
+  {0x0000000200000003ULL, 0x00000002ffffffffULL,
+   0x0000000100000001ULL, 0x0000000400000002ULL},
+};
+const Modulus kN = {
+  {0x53bbf40939d54123ULL, 0x7203df6b21c6052bULL,
+   0xffffffffffffffffULL, 0xfffffffeffffffffULL},
+  0x327f9e8872350975ULL,
+  {0x901192af7c114f20ULL, 0x3464504ade6fa2faULL,
+   0x620fc84c3affe0d4ULL, 0x1eb5e412a22b3d3bULL},
+};
+
+// a = p - 3, b and the base point G, in the usual form.
+const uint64_t kA[4] = {
+  0xfffffffffffffffcULL, 0xffffffff00000000ULL,
+  0xffffffffffffffffULL, 0xfffffffeffffffffULL,
+};
+const uint64_t kB[4] = {
+  0xddbcbd414d940e93ULL, 0xf39789f515ab8f92ULL,
+  0x4d5a9e4bcf6509a7ULL, 0x28e9fa9e9d9f5e34ULL,
+};
+const uint64_t kGx[4] = {
+  0x715a4589334c74c7ULL, 0x8fe30bbff2660be1ULL,
+  0x5f9904466a39c994ULL, 0x32c4ae2c1f198119ULL,
+};
+const uint64_t kGy[4] = {
+  0x02df32e52139f0a0ULL, 0xd0a9877cc62a4740ULL,
+  0x59bdcee36b692153ULL, 0xbc3736a2f4f6779cULL,
+};
+const uint64_t kOne[4] = {1, 0, 0, 0};
+
+struct JacobianPoint {
+  uint64_t x[4];
+  uint64_t y[4];
+  // Zero at infinity.
+  uint64_t z[4];
+};
+
+// Multi-precision helpers. Nothing branches on the value of an operand:
+// selections go through masks.
+
+inline void Copy(uint64_t* out, const uint64_t* a) {
+  memcpy(out, a, 4 * sizeof(uint64_t));
+}
+
+// All ones when |a| is zero, else zero.
+inline uint64_t ZeroMask(const uint64_t* a) {
+  const uint64_t v = a[0] | a[1] | a[2] | a[3];
+  return ((v | (0 - v)) >> 63) - 1;
+}
+
+inline bool IsZero(const uint64_t* a) {
+  return ZeroMask(a) != 0;
+}
+
+// |out| = |mask| ? |a| : |b|.
+inline void Select(uint64_t* out, uint64_t mask, const uint64_t* a,
+                   const uint64_t* b) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = (a[i] & mask) | (b[i] & ~mask);
+  }
+}
+
+// |out| = |a| - |b|; returns the borrow.
+inline uint64_t SubBorrow(uint64_t* out, const uint64_t* a,
+                          const uint64_t* b) {
+  uint64_t borrow = 0;
+  for (int i = 0; i < 4; ++i) {
+    const uint128_t d = static_cast<uint128_t>(a[i]) - b[i] - borrow;
+    out[i] = static_cast<uint64_t>(d);
+    borrow = static_cast<uint64_t>(d >> 64) & 1;
+  }
+  return borrow;
+}
+
+// |out| = |a| + |b|; returns the carry.
+inline uint64_t AddCarry(uint64_t* out, const uint64_t* a,
+                         const uint64_t* b) {
+  uint128_t carry = 0;
+  for (int i = 0; i < 4; ++i) {
+    carry += static_cast<uint128_t>(a[i]) + b[i];
+    out[i] = static_cast<uint64_t>(carry);
+    carry >>= 64;
+  }
+  return static_cast<uint64_t>(carry);
+}
+
+inline bool LessThan(const uint64_t* a, const uint64_t* b) {
+  uint64_t diff[4];
+  return SubBorrow(diff, a, b) != 0;
+}
+
+// Modular arithmetic on operands already reduced modulo m.
+
+void ModAdd(const Modulus& m, uint64_t* out, const uint64_t* a,
+            const uint64_t* b) {
+  uint64_t sum[4], diff[4];
+  const uint64_t carry = AddCarry(sum, a, b);
+  const uint64_t borrow = SubBorrow(diff, sum, m.m);
+  // The sum stays when it is below m: no carry out, and m did not fit.
+  Select(out, 0 - (borrow & (carry ^ 1)), sum, diff);
+}
+
+void ModSub(const Modulus& m, uint64_t* out, const uint64_t* a,
+            const uint64_t* b) {
+  uint64_t diff[4], masked[4];
+  const uint64_t mask = 0 - SubBorrow(diff, a, b);
+  for (int i = 0; i < 4; ++i) {
+    masked[i] = m.m[i] & mask;
+  }
+  AddCarry(out, diff, masked);
+}
+
+// |out| = |a| * |b| / 2^256 mod m, by word-serial Montgomery reduction.
+void MontMul(const Modulus& m, uint64_t* out, const uint64_t* a,
+             const uint64_t* b) {
+  uint64_t t[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < 4; ++i) {
+    uint128_t c = 0;
+    for (int j = 0; j < 4; ++j) {
+      c += static_cast<uint128_t>(a[j]) * b[i] + t[j];
+      t[j] = static_cast<uint64_t>(c);
+      c >>= 64;
+    }
+    c += t[4];
+    t[4] = static_cast<uint64_t>(c);
+    t[5] = static_cast<uint64_t>(c >> 64);
+
+    const uint64_t q = t[0] * m.m_inv;
+    c = static_cast<uint128_t>(q) * m.m[0] + t[0];
+    c >>= 64;
+    for (int j = 1; j < 4; ++j) {
+      c += static_cast<uint128_t>(q) * m.m[j] + t[j];
+      t[j - 1] = static_cast<uint64_t>(c);
+      c >>= 64;
+    }
+    c += t[4];
+    t[3] = static_cast<uint64_t>(c);
+    t[4] = t[5] + static_cast<uint64_t>(c >> 64);
+  }
+  // t < 2m.
+  uint64_t diff[4];
+  const uint64_t borrow = SubBorrow(diff, t, m.m);
+  Select(out, 0 - (borrow & (t[4] ^ 1)), t, diff);
+}
+
+inline void ToMont(const Modulus& m, uint64_t* out, const uint64_t* a) {
+  MontMul(m, out, a, m.rr);
+}
+
+inline void FromMont(const Modulus& m, uint64_t* out, const uint64_t* a) {
+  MontMul(m, out, a, kOne);
+}
+
+// |out| = |a|^(m - 2), the inverse of a non-zero |a|, both in the
+// Montgomery form. The exponent is public, so branching on it is fine.
+void MontInverse(const Modulus& m, uint64_t* out, const uint64_t* a) {
+  uint64_t exponent[4];
+  const uint64_t two[4] = {2, 0, 0, 0};
+  SubBorrow(exponent, m.m, two);
+  uint64_t result[4];
+  ToMont(m, result, kOne);
+  for (int bit = 255; bit >= 0; --bit) {
+    MontMul(m, result, result, result);
+    if ((exponent[bit / 64] >> (bit % 64)) & 1) {
+      MontMul(m, result, result, a);
+    }
+  }
+  Copy(out, result);
+}
+
+// Big-endian bytes <-> limbs.
+
+void Decode(const uint8_t* in, uint64_t* out) {
+  for (int i = 0; i < 4; ++i) {
+    uint64_t limb = 0;
+    for (int j = 0; j < 8; ++j) {
+      limb = (limb << 8) | in[(3 - i) * 8 + j];
+    }
+    out[i] = limb;
+  }
+}
+
+void Encode(const uint64_t* in, uint8_t* out) {
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      out[(3 - i) * 8 + j] = static_cast<uint8_t>(in[i] >> (56 - 8 * j));
+    }
+  }
+}
+
+// Field operations modulo p, in the Montgomery form.
+
+inline void FeMul(uint64_t* out, const uint64_t* a, const uint64_t* b) {
+  MontMul(kP, out, a, b);
+}
+
+inline void FeSqr(uint64_t* out, const uint64_t* a) {
+  MontMul(kP, out, a, a);
+}
+
+inline void FeAdd(uint64_t* out, const uint64_t* a, const uint64_t* b) {
+  ModAdd(kP, out, a, b);
+}
+
+inline void FeSub(uint64_t* out, const uint64_t* a, const uint64_t* b) {
+  ModSub(kP, out, a, b);
+}
+
+const uint64_t* MontOne() {
+  static const struct One {
+    One() { ToMont(kP, v, kOne); }
+    uint64_t v[4];
+  } one;
+  return one.v;
+}
+
+// Point arithmetic in Jacobian coordinates, with a = -3.
+
+void SetInfinity(JacobianPoint* r) {
+  Copy(r->x, MontOne());
+  Copy(r->y, MontOne());
+  memset(r->z, 0, sizeof(r->z));
+}
+
+void FromAffine(JacobianPoint* r, const Sm2Point& a) {
+  Copy(r->x, a.x);
+  Copy(r->y, a.y);
+  Copy(r->z, MontOne());
+}
+
+// dbl-2001-b. The point at infinity doubles to itself.
+void Double(JacobianPoint* r, const JacobianPoint& a) {
+  uint64_t delta[4], gamma[4], beta[4], alpha[4], t0[4], t1[4];
+  uint64_t x3[4], y3[4], z3[4];
+  FeSqr(delta, a.z);
+  FeSqr(gamma, a.y);
+  FeMul(beta, a.x, gamma);
+  FeSub(t0, a.x, delta);
+  FeAdd(t1, a.x, delta);
+  FeMul(alpha, t0, t1);
+  FeAdd(t0, alpha, alpha);
+  FeAdd(alpha, alpha, t0);
+
+  FeAdd(t0, a.y, a.z);
+  FeSqr(t0, t0);
+  FeSub(t0, t0, gamma);
+  FeSub(z3, t0, delta);
+
+  FeAdd(beta, beta, beta);
+  FeAdd(beta, beta, beta);
+  FeSqr(x3, alpha);
+  FeAdd(t0, beta, beta);
+  FeSub(x3, x3, t0);
+
+  FeSub(t0, beta, x3);
+  FeMul(t0, alpha, t0);
+  FeSqr(t1, gamma);
+  FeAdd(t1, t1, t1);
+  FeAdd(t1, t1, t1);
+  FeAdd(t1, t1, t1);
+  FeSub(y3, t0, t1);
+
+  Copy(r->x, x3);
+  Copy(r->y, y3);
+  Copy(r->z, z3);
+}
+
+// add-2007-bl, with every special case. Branches on the operands: only
+// for public points.
+void Add(JacobianPoint* r, const JacobianPoint& a, const JacobianPoint& b) {
+  if (IsZero(a.z)) {
+    *r = b;
+    return;
+  }
+  if (IsZero(b.z)) {
+    *r = a;
+    return;
+  }
+  uint64_t z1z1[4], z2z2[4], u1[4], u2[4], s1[4], s2[4], h[4], rr[4];
+  FeSqr(z1z1, a.z);
+  FeSqr(z2z2, b.z);
+  FeMul(u1, a.x, z2z2);
+  FeMul(u2, b.x, z1z1);
+  FeMul(s1, a.y, b.z);
+  FeMul(s1, s1, z2z2);
+  FeMul(s2, b.y, a.z);
+  FeMul(s2, s2, z1z1);
+  FeSub(h, u2, u1);
+  FeSub(rr, s2, s1);
+  if (IsZero(h)) {
+    if (IsZero(rr)) {
+      Double(r, a);
+    } else {
+      SetInfinity(r);
+    }
+    return;
+  }
+
+  uint64_t i[4], j[4], v[4], t[4], x3[4], y3[4], z3[4];
+  FeAdd(rr, rr, rr);
+  FeAdd(i, h, h);
+  FeSqr(i, i);
+  FeMul(j, h, i);
+  FeMul(v, u1, i);
+  FeSqr(x3, rr);
+  FeSub(x3, x3, j);
+  FeSub(x3, x3, v);
+  FeSub(x3, x3, v);
+  FeSub(t, v, x3);
+  FeMul(y3, rr, t);
+  FeMul(t, s1, j);
+  FeAdd(t, t, t);
+  FeSub(y3, y3, t);
+  FeAdd(z3, a.z, b.z);
+  FeSqr(z3, z3);
+  FeSub(z3, z3, z1z1);
+  FeSub(z3, z3, z2z2);
+  FeMul(z3, z3, h);
+
+  Copy(r->x, x3);
+  Copy(r->y, y3);
+  Copy(r->z, z3);
+}
+
+// madd-2007-bl: |r| = |a| + |b| when |use| is all ones, |a| when it is
+// zero, and |b| when |a| is at infinity, without branching on any of it.
+// |b| must not be |a| or -|a|, which the scalar multiplications below
+// rule out for scalars in [1, n - 1].
+void AddMixed(JacobianPoint* r, const JacobianPoint& a, const Sm2Point& b,
+              uint64_t use) {
+  uint64_t z1z1[4], u2[4], s2[4], h[4], hh[4], i[4], j[4], rr[4], v[4];
+  uint64_t t[4], x3[4], y3[4], z3[4];
+  FeSqr(z1z1, a.z);
+  FeMul(u2, b.x, z1z1);
+  FeMul(s2, b.y, a.z);
+  FeMul(s2, s2, z1z1);
+  FeSub(h, u2, a.x);
+  FeSqr(hh, h);
+  FeAdd(i, hh, hh);
+  FeAdd(i, i, i);
+  FeMul(j, h, i);
+  FeSub(rr, s2, a.y);
+  FeAdd(rr, rr, rr);
+  FeMul(v, a.x, i);
+  FeSqr(x3, rr);
+  FeSub(x3, x3, j);
+  FeSub(x3, x3, v);
+  FeSub(x3, x3, v);
+  FeSub(t, v, x3);
+  FeMul(y3, rr, t);
+  FeMul(t, a.y, j);
+  FeAdd(t, t, t);
+  FeSub(y3, y3, t);
+  FeAdd(z3, a.z, h);
+  FeSqr(z3, z3);
+  FeSub(z3, z3, z1z1);
+  FeSub(z3, z3, hh);
+
+  const uint64_t infinity = ZeroMask(a.z);
+  Select(x3, infinity, b.x, x3);
+  Select(y3, infinity, b.y, y3);
+  Select(z3, infinity, MontOne(), z3);
+  Select(r->x, use, x3, a.x);
+  Select(r->y, use, y3, a.y);
+  Select(r->z, use, z3, a.z);
+}
+
+// Affine forms of |count| points, none at infinity, with one inversion.
+void Normalize(const JacobianPoint* in, int count, Sm2Point* out) {
+  std::vector<uint64_t> prefix(4 * count);
+  uint64_t acc[4];
+  Copy(acc, MontOne());
+  for (int i = 0; i < count; ++i) {
+    Copy(&prefix[4 * i], acc);
+    FeMul(acc, acc, in[i].z);
+  }
+  uint64_t inv[4];
+  MontInverse(kP, inv, acc);
+  for (int i = count - 1; i >= 0; --i) {
+    uint64_t z_inv[4], z_inv2[4];
+    FeMul(z_inv, inv, &prefix[4 * i]);
+    FeMul(inv, inv, in[i].z);
+    FeSqr(z_inv2, z_inv);
+    FeMul(out[i].x, in[i].x, z_inv2);
+    FeMul(z_inv2, z_inv2, z_inv);
+    FeMul(out[i].y, in[i].y, z_inv2);
+  }
+}
+
+// Big-endian x and y of a point not at infinity.
+void PointToBytes(const JacobianPoint& a, uint8_t* x_out, uint8_t* y_out) {
+  Sm2Point affine;
+  Normalize(&a, 1, &affine);
+  uint64_t v[4];
+  FromMont(kP, v, affine.x);
+  Encode(v, x_out);
+  FromMont(kP, v, affine.y);
+  Encode(v, y_out);
+}
+
+// |table| times 1 .. kMultiples.
+void ComputeMultiples(const Sm2Point& point, Sm2Point* table) {
+  JacobianPoint jacobian[kMultiples];
+  FromAffine(&jacobian[0], point);
+  for (int i = 1; i < kMultiples; ++i) {
+    Add(&jacobian[i], jacobian[i - 1], jacobian[0]);
+  }
+  Normalize(jacobian, kMultiples, table);
+}
+
+// |out| = |table|[digit - 1], touching every entry; zero for digit 0.
+void Lookup(const Sm2Point* table, uint64_t digit, Sm2Point* out) {
+  memset(out, 0, sizeof(*out));
+  for (int i = 0; i < kMultiples; ++i) {
+    const uint64_t diff = static_cast<uint64_t>(i + 1) ^ digit;
+    const uint64_t mask = ((diff | (0 - diff)) >> 63) - 1;
+    for (int j = 0; j < 4; ++j) {
+      out->x[j] |= table[i].x[j] & mask;
+      out->y[j] |= table[i].y[j] & mask;
+    }
+  }
+}
+
+inline uint64_t Digit(const uint64_t* scalar, int i) {
+  return (scalar[i / 16] >> (4 * (i % 16))) & 0xf;
+}
+
+inline uint64_t NonZeroMask(uint64_t digit) {
+  return 0 - ((digit | (0 - digit)) >> 63);
+}
+
+// Row i holds 1 .. 15 times 16^i G, so that k G is one mixed addition
+// per 4-bit digit of k and no doubling.
+struct BaseTable {
+  BaseTable() {
+    std::vector<JacobianPoint> jacobian(kDigits * kMultiples);
+    JacobianPoint base;
+    ToMont(kP, base.x, kGx);
+    ToMont(kP, base.y, kGy);
+    Copy(base.z, MontOne());
+    for (int i = 0; i < kDigits; ++i) {
+      JacobianPoint* row = &jacobian[i * kMultiples];
+      row[0] = base;
+      for (int j = 1; j < kMultiples; ++j) {
+        Add(&row[j], row[j - 1], base);
+      }
+      Add(&base, row[kMultiples - 1], base);
+    }
+    Normalize(jacobian.data(), kDigits * kMultiples, &points[0][0]);
+  }
+
+  Sm2Point points[kDigits][kMultiples];
+};
+
+const BaseTable& GetBaseTable() {
+  static const BaseTable* table = new BaseTable;
+  return *table;
+}
+
+// |r| = |scalar| G.
+void MultiplyBase(const uint64_t* scalar, JacobianPoint* r) {
+  const BaseTable& table = GetBaseTable();
+  SetInfinity(r);
+  Sm2Point entry;
+  for (int i = 0; i < kDigits; ++i) {
+    const uint64_t digit = Digit(scalar, i);
+    Lookup(table.points[i], digit, &entry);
+    AddMixed(r, *r, entry, NonZeroMask(digit));
+  }
+}
+
+// |r| = |scalar| P, with |multiples| the output of ComputeMultiples(P):
+// a fixed 4-bit window, most significant digit first.
+void Multiply(const Sm2Point* multiples, const uint64_t* scalar,
+              JacobianPoint* r) {
+  SetInfinity(r);
+  Sm2Point entry;
+  for (int i = kDigits - 1; i >= 0; --i) {
+    if (i != kDigits - 1) {
+      for (int j = 0; j < 4; ++j) {
+        Double(r, *r);
+      }
+    }
+    const uint64_t digit = Digit(scalar, i);
+    Lookup(multiples, digit, &entry);
+    AddMixed(r, *r, entry, NonZeroMask(digit));
+  }
+}
+
+// Parses 0x04 || x || y and checks y^2 = x^3 + a x + b.
+bool DecodePoint(strings::StringPiece encoded, Sm2Point* point) {
+  if (encoded.size() != Sm2PublicKey::kEncodedSize || encoded[0] != 0x04) {
+    return false;
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(encoded.data());
+  uint64_t x[4], y[4];
+  Decode(bytes + 1, x);
+  Decode(bytes + 1 + kScalarSize, y);
+  if (!LessThan(x, kP.m) || !LessThan(y, kP.m)) {
+    return false;
+  }
+  ToMont(kP, point->x, x);
+  ToMont(kP, point->y, y);
+
+  uint64_t lhs[4], rhs[4], t[4];
+  FeSqr(lhs, point->y);
+  FeSqr(rhs, point->x);
+  ToMont(kP, t, kA);
+  FeAdd(rhs, rhs, t);
+  FeMul(rhs, rhs, point->x);
+  ToMont(kP, t, kB);
+  FeAdd(rhs, rhs, t);
+  FeSub(t, lhs, rhs);
+  return IsZero(t);
+}
+
+// A uniform scalar in [1, |bound| - 1].
+bool RandomScalar(const uint64_t* bound, uint64_t* out) {
+  uint8_t bytes[kScalarSize];
+  for (int attempt = 0; attempt < 64; ++attempt) {
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+      break;
+    }
+    Decode(bytes, out);
+    if (!IsZero(out) && LessThan(out, bound)) {
+      OPENSSL_cleanse(bytes, sizeof(bytes));
+      return true;
+    }
+  }
+  OPENSSL_cleanse(bytes, sizeof(bytes));
+  return false;
+}
+
+// A digest as an integer modulo n; 2n > 2^256, so once is enough.
+void ReduceDigest(const uint8_t* digest, uint64_t* e) {
+  Decode(digest, e);
+  uint64_t diff[4];
+  const uint64_t borrow = SubBorrow(diff, e, kN.m);
+  Select(e, 0 - borrow, e, diff);
+}
+
+// The x coordinate of |point| modulo n, in the usual form.
+void XModN(const JacobianPoint& point, uint64_t* x) {
+  uint8_t x_bytes[kScalarSize], y_bytes[kScalarSize];
+  PointToBytes(point, x_bytes, y_bytes);
+  ReduceDigest(x_bytes, x);
+}
+
+// The GB/T 32918.4 key derivation function, on SM3.
+void DeriveKey(const uint8_t* shared, size_t shared_size, uint8_t* out,
+               size_t size) {
+  uint8_t block[Sm3::kDigestSize];
+  for (uint32_t counter = 1; size > 0; ++counter) {
+    const uint8_t counter_bytes[4] = {
+      static_cast<uint8_t>(counter >> 24), static_cast<uint8_t>(counter >> 16),
+      static_cast<uint8_t>(counter >> 8), static_cast<uint8_t>(counter),
+    };
+    Sm3 sm3;
+    sm3.Update(shared, shared_size);
+    sm3.Update(counter_bytes, sizeof(counter_bytes));
+    sm3.Finish(block);
+    const size_t take = std::min(size, sizeof(block));
+    memcpy(out, block, take);
+    out += take;
+    size -= take;
+  }
+  OPENSSL_cleanse(block, sizeof(block));
+}
+
+base::Status RandomnessError() {
+  return base::Status(base::error::INTERNAL, "No randomness for SM2");
+}
+
+} // namespace
+
+// Sm2PublicKey
+
+const size_t Sm2PublicKey::kEncodedSize;
+const char Sm2PublicKey::kDefaultId[] = "1234567812345678";
+
+Sm2PublicKey::Sm2PublicKey(const Sm2Point& point)
+    : point_(new Sm2Point(point)),
+      multiples_(new Sm2Point[kMultiples]) {
+  ComputeMultiples(point, multiples_.get());
+  default_id_hash_ = IdentityHash(kDefaultId);
+}
+
+Sm2PublicKey::~Sm2PublicKey() {}
+
+// static
+std::unique_ptr<Sm2PublicKey> Sm2PublicKey::FromBytes(
+    strings::StringPiece encoded) {
+  Sm2Point point;
+  if (!DecodePoint(encoded, &point)) {
+    LOG(ERROR) << "Not an uncompressed SM2 point";
+    return nullptr;
+  }
+  return std::unique_ptr<Sm2PublicKey>(new Sm2PublicKey(point));
+}
+
+std::string Sm2PublicKey::ToBytes() const {
+  std::string encoded(kEncodedSize, '\0');
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(&encoded[0]);
+  bytes[0] = 0x04;
+  uint64_t v[4];
+  FromMont(kP, v, point_->x);
+  Encode(v, bytes + 1);
+  FromMont(kP, v, point_->y);
+  Encode(v, bytes + 1 + kScalarSize);
+  return encoded;
+}
+
+std::string Sm2PublicKey::IdentityHash(strings::StringPiece id) const {
+  const size_t id_bits = id.size() * 8;
+  const uint8_t entl[2] = {
+    static_cast<uint8_t>(id_bits >> 8), static_cast<uint8_t>(id_bits),
+  };
+  uint8_t curve[4 * kScalarSize];
+  Encode(kA, curve);
+  Encode(kB, curve + kScalarSize);
+  Encode(kGx, curve + 2 * kScalarSize);
+  Encode(kGy, curve + 3 * kScalarSize);
+  const std::string encoded = ToBytes();
+
+  Sm3 sm3;
+  sm3.Update(entl, sizeof(entl));
+  sm3.Update(id);
+  sm3.Update(curve, sizeof(curve));
+  sm3.Update(encoded.data() + 1, encoded.size() - 1);
+  std::string hash(Sm3::kDigestSize, '\0');
+  sm3.Finish(reinterpret_cast<uint8_t*>(&hash[0]));
+  return hash;
+}
+
+void Sm2PublicKey::MessageDigest(strings::StringPiece message,
+                                 strings::StringPiece id,
+                                 uint8_t* digest) const {
+  Sm3 sm3;
+  if (id == kDefaultId) {
+    sm3.Update(default_id_hash_);
+  } else {
+    sm3.Update(IdentityHash(id));
+  }
+  sm3.Update(message);
+  sm3.Finish(digest);
+}
+
+base::Status Sm2PublicKey::Encrypt(strings::StringPiece plaintext,
+                                   std::string* ciphertext) const {
+  const size_t header_size = kEncodedSize + Sm3::kDigestSize;
+  std::string out(header_size + plaintext.size(), '\0');
+  uint8_t* c1 = reinterpret_cast<uint8_t*>(&out[0]);
+  uint8_t* c3 = c1 + kEncodedSize;
+  uint8_t* c2 = c3 + Sm3::kDigestSize;
+
+  uint64_t k[4];
+  uint8_t shared[2 * kScalarSize];
+  while (true) {
+    if (!RandomScalar(kN.m, k)) {
+      return RandomnessError();
+    }
+    JacobianPoint point;
+    MultiplyBase(k, &point);
+    c1[0] = 0x04;
+    PointToBytes(point, c1 + 1, c1 + 1 + kScalarSize);
+    Multiply(multiples_.get(), k, &point);
+    PointToBytes(point, shared, shared + kScalarSize);
+
+    DeriveKey(shared, sizeof(shared), c2, plaintext.size());
+    uint8_t any = plaintext.empty() ? 1 : 0;
+    for (size_t i = 0; i < plaintext.size(); ++i) {
+      any |= c2[i];
+    }
+    // An all-zero mask would leak the plaintext: start over.
+    if (any != 0) {
+      break;
+    }
+  }
+  for (size_t i = 0; i < plaintext.size(); ++i) {
+    c2[i] ^= static_cast<uint8_t>(plaintext[i]);
+  }
+
+  Sm3 sm3;
+  sm3.Update(shared, kScalarSize);
+  sm3.Update(plaintext);
+  sm3.Update(shared + kScalarSize, kScalarSize);
+  sm3.Finish(c3);
+  OPENSSL_cleanse(k, sizeof(k));
+  OPENSSL_cleanse(shared, sizeof(shared));
+  ciphertext->swap(out);
+  return base::Status::OK;
+}
+
+base::Status Sm2PublicKey::Verify(strings::StringPiece message,
+                                  strings::StringPiece signature,
+                                  strings::StringPiece id) const {
+  if (id.size() > kMaxIdSize) {
+    return base::Status(base::error::INVALID_ARGUMENT, "SM2 ID too long");
+  }
+  uint8_t digest[Sm3::kDigestSize];
+  MessageDigest(message, id, digest);
+  return VerifyDigest(digest, signature);
+}
+
+base::Status Sm2PublicKey::VerifyDigest(const uint8_t* digest,
+                                        strings::StringPiece signature) const {
+  if (signature.size() != 2 * kScalarSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "SM2 signature must be 64 bytes");
+  }
+  const base::Status mismatch(base::error::DATA_LOSS,
+                              "SM2 signature mismatch");
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(signature.data());
+  uint64_t r[4], s[4], e[4], t[4];
+  Decode(bytes, r);
+  Decode(bytes + kScalarSize, s);
+  if (IsZero(r) || IsZero(s) || !LessThan(r, kN.m) || !LessThan(s, kN.m)) {
+    return mismatch;
+  }
+  ModAdd(kN, t, r, s);
+  if (IsZero(t)) {
+    return mismatch;
+  }
+
+  // (x1, y1) = s G + t P.
+  JacobianPoint sg, tp, sum;
+  MultiplyBase(s, &sg);
+  Multiply(multiples_.get(), t, &tp);
+  Add(&sum, sg, tp);
+  if (IsZero(sum.z)) {
+    return mismatch;
+  }
+
+  // r = e + x1 mod n, so x1 is r - e or r - e + n. Comparing X with
+  // x1 Z^2 spares the inversion back to affine coordinates.
+  ReduceDigest(digest, e);
+  uint64_t x1[4], z2[4], expected[4], diff[4];
+  ModSub(kN, x1, r, e);
+  FeSqr(z2, sum.z);
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    ToMont(kP, expected, x1);
+    FeMul(expected, expected, z2);
+    SubBorrow(diff, expected, sum.x);
+    if (IsZero(diff)) {
+      return base::Status::OK;
+    }
+    if (AddCarry(x1, x1, kN.m) != 0 || !LessThan(x1, kP.m)) {
+      break;
+    }
+  }
+  return mismatch;
+}
+
+// static
+void Sm2PublicKey::VerifyBatch(core::thread::ThreadPool* pool,
+                               const VerifyItem* items,
+                               int count,
+                               base::Status* statuses) {
+  auto verify_range = [items, count, statuses](int begin) {
+    const int end = std::min(count, begin + kVerifyBatchSize);
+    for (int i = begin; i < end; ++i) {
+      const VerifyItem& item = items[i];
+      statuses[i] = item.key->Verify(item.message, item.signature, item.id);
+    }
+  };
+
+  // Built here rather than by a worker, which would stall the others.
+  GetBaseTable();
+  if (pool == nullptr || count <= kVerifyBatchSize) {
+    for (int begin = 0; begin < count; begin += kVerifyBatchSize) {
+      verify_range(begin);
+    }
+    return;
+  }
+  const int num_ranges = (count + kVerifyBatchSize - 1) / kVerifyBatchSize;
+  core::BlockingCounter counter(num_ranges - 1);
+  for (int i = 1; i < num_ranges; ++i) {
+    pool->Schedule([&verify_range, &counter, i]() {
+      verify_range(i * kVerifyBatchSize);
+      counter.DecrementCount();
+    });
+  }
+  verify_range(0);
+  counter.Wait();
+}
+
+// Sm2PrivateKey
+
+const size_t Sm2PrivateKey::kEncodedSize;
+
+Sm2PrivateKey::Sm2PrivateKey(std::shared_ptr<SecureKeyBytes> secret)
+    : secret_(std::move(secret)) {
+  uint64_t d[4], inv[4];
+  memcpy(d, secret_->data(), sizeof(d));
+
+  // (1 + d)^-1 mod n, kept in the Montgomery form.
+  ModAdd(kN, inv, d, kOne);
+  ToMont(kN, inv, inv);
+  MontInverse(kN, inv, inv);
+  memcpy(secret_->data() + sizeof(d), inv, sizeof(inv));
+
+  JacobianPoint point;
+  MultiplyBase(d, &point);
+  Sm2Point affine;
+  Normalize(&point, 1, &affine);
+  public_key_.reset(new Sm2PublicKey(affine));
+  OPENSSL_cleanse(d, sizeof(d));
+  OPENSSL_cleanse(inv, sizeof(inv));
+}
+
+Sm2PrivateKey::~Sm2PrivateKey() {}
+
+// static
+std::unique_ptr<Sm2PrivateKey> Sm2PrivateKey::Generate() {
+  std::shared_ptr<SecureKeyBytes> secret =
+      SecureKeyBytes::Allocate(2 * kScalarSize);
+  if (!secret) {
+    return nullptr;
+  }
+  // d < n - 1, so that 1 + d is invertible.
+  uint64_t bound[4];
+  SubBorrow(bound, kN.m, kOne);
+  uint64_t d[4];
+  if (!RandomScalar(bound, d)) {
+    return nullptr;
+  }
+  memcpy(secret->data(), d, sizeof(d));
+  OPENSSL_cleanse(d, sizeof(d));
+  return std::unique_ptr<Sm2PrivateKey>(new Sm2PrivateKey(std::move(secret)));
+}
+
+// static
+std::unique_ptr<Sm2PrivateKey> Sm2PrivateKey::FromBytes(
+    strings::StringPiece encoded) {
+  if (encoded.size() != kEncodedSize) {
+    LOG(ERROR) << "SM2 private key must be 32 bytes, got " << encoded.size();
+    return nullptr;
+  }
+  uint64_t d[4], bound[4];
+  Decode(reinterpret_cast<const uint8_t*>(encoded.data()), d);
+  SubBorrow(bound, kN.m, kOne);
+  if (IsZero(d) || !LessThan(d, bound)) {
+    OPENSSL_cleanse(d, sizeof(d));
+    LOG(ERROR) << "SM2 private key out of range";
+    return nullptr;
+  }
+  std::shared_ptr<SecureKeyBytes> secret =
+      SecureKeyBytes::Allocate(2 * kScalarSize);
+  if (secret) {
+    memcpy(secret->data(), d, sizeof(d));
+  }
+  OPENSSL_cleanse(d, sizeof(d));
+  if (!secret) {
+    return nullptr;
+  }
+  return std::unique_ptr<Sm2PrivateKey>(new Sm2PrivateKey(std::move(secret)));
+}
+
+base::Status Sm2PrivateKey::Decrypt(strings::StringPiece ciphertext,
+                                    std::string* plaintext) const {
+  const size_t header_size = Sm2PublicKey::kEncodedSize + Sm3::kDigestSize;
+  if (ciphertext.size() < header_size) {
+    return base::Status(base::error::DATA_LOSS,
+                        "SM2 ciphertext shorter than its header");
+  }
+  Sm2Point c1;
+  if (!DecodePoint(ciphertext.substr(0, Sm2PublicKey::kEncodedSize), &c1)) {
+    return base::Status(base::error::DATA_LOSS,
+                        "SM2 ciphertext does not start with a curve point");
+  }
+  const uint8_t* c3 = reinterpret_cast<const uint8_t*>(ciphertext.data()) +
+                      Sm2PublicKey::kEncodedSize;
+  const uint8_t* c2 = c3 + Sm3::kDigestSize;
+  const size_t size = ciphertext.size() - header_size;
+
+  Sm2Point multiples[kMultiples];
+  ComputeMultiples(c1, multiples);
+  uint64_t d[4];
+  memcpy(d, secret_->data(), sizeof(d));
+  JacobianPoint point;
+  Multiply(multiples, d, &point);
+  OPENSSL_cleanse(d, sizeof(d));
+  uint8_t shared[2 * kScalarSize];
+  PointToBytes(point, shared, shared + kScalarSize);
+
+  std::string out(size, '\0');
+  uint8_t* m = reinterpret_cast<uint8_t*>(&out[0]);
+  DeriveKey(shared, sizeof(shared), m, size);
+  for (size_t i = 0; i < size; ++i) {
+    m[i] ^= c2[i];
+  }
+
+  uint8_t check[Sm3::kDigestSize];
+  Sm3 sm3;
+  sm3.Update(shared, kScalarSize);
+  sm3.Update(out);
+  sm3.Update(shared + kScalarSize, kScalarSize);
+  sm3.Finish(check);
+  OPENSSL_cleanse(shared, sizeof(shared));
+  uint8_t diff = 0;
+  for (size_t i = 0; i < sizeof(check); ++i) {
+    diff |= check[i] ^ c3[i];
+  }
+  if (diff != 0) {
+    OPENSSL_cleanse(&out[0], out.size());
+    return base::Status(base::error::DATA_LOSS,
+                        "SM2 ciphertext check value mismatch");
+  }
+  plaintext->swap(out);
+  return base::Status::OK;
+}
+
+base::Status Sm2PrivateKey::Sign(strings::StringPiece message,
+                                 std::string* signature,
+                                 strings::StringPiece id) const {
+  if (id.size() > kMaxIdSize) {
+    return base::Status(base::error::INVALID_ARGUMENT, "SM2 ID too long");
+  }
+  uint8_t digest[Sm3::kDigestSize];
+  public_key_->MessageDigest(message, id, digest);
+  uint64_t e[4];
+  ReduceDigest(digest, e);
+
+  uint64_t d[4], inv[4];
+  memcpy(d, secret_->data(), sizeof(d));
+  memcpy(inv, secret_->data() + sizeof(d), sizeof(inv));
+  uint64_t k[4], r[4], s[4], t[4];
+  while (true) {
+    if (!RandomScalar(kN.m, k)) {
+      OPENSSL_cleanse(d, sizeof(d));
+      OPENSSL_cleanse(inv, sizeof(inv));
+      return RandomnessError();
+    }
+    JacobianPoint point;
+    MultiplyBase(k, &point);
+    XModN(point, t);
+    // r = e + x1, retried when r = 0 or r + k = n.
+    ModAdd(kN, r, e, t);
+    ModAdd(kN, t, r, k);
+    if (IsZero(r) || IsZero(t)) {
+      continue;
+    }
+    // s = (1 + d)^-1 (k - r d). Montgomery products with one operand in
+    // the Montgomery form come out in the usual form.
+    ToMont(kN, t, r);
+    MontMul(kN, t, t, d);
+    ModSub(kN, t, k, t);
+    MontMul(kN, s, inv, t);
+    if (!IsZero(s)) {
+      break;
+    }
+  }
+  OPENSSL_cleanse(d, sizeof(d));
+  OPENSSL_cleanse(inv, sizeof(inv));
+  OPENSSL_cleanse(k, sizeof(k));
+
+  signature->assign(2 * kScalarSize, '\0');
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(&(*signature)[0]);
+  Encode(r, bytes);
+  Encode(s, bytes + kScalarSize);
+  return base::Status::OK;
+}
+
+} // namespace crypto
@@ -0,0 +1,135 @@
+#ifndef CRYPTO_SM2_H_
+#define CRYPTO_SM2_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "crypto/secure_key_arena.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// An affine point of the SM2 curve, in the form sm2.cc computes with.
+struct Sm2Point;
+
+// A public key on the curve recommended by GB/T 32918.5-2017.
+//
+// Encrypt() and Verify() multiply this key's point by a scalar on every
+// call; the multiples 1 .. 15 its window reads are computed once, when the
+// key is built, together with the identity hash Z of the default signer ID.
+// The multiples of the base point live in a process-wide table built on
+// first use. A key is immutable and can be shared between threads.
+class Sm2PublicKey {
+ public:
+  // 0x04 || x || y.
+  static const size_t kEncodedSize = 65;
+  // The ID GM/T 0009 assigns when the parties agreed on none.
+  static const char kDefaultId[];
+
+  // nullptr unless |encoded| is an uncompressed point on the curve.
+  static std::unique_ptr<Sm2PublicKey> FromBytes(strings::StringPiece encoded);
+  ~Sm2PublicKey();
+
+  std::string ToBytes() const;
+
+  // GB/T 32918.4 encryption. |ciphertext| is C1 || C3 || C2: the 65-byte
+  // ephemeral point, the 32-byte SM3 check value, then the masked
+  // plaintext.
+  base::Status Encrypt(strings::StringPiece plaintext,
+                       std::string* ciphertext) const;
+
+  // GB/T 32918.2 verification of a 64-byte r || s |signature| of
+  // |message| by the signer |id|. DATA_LOSS when it does not verify.
+  base::Status Verify(strings::StringPiece message,
+                      strings::StringPiece signature,
+                      strings::StringPiece id = kDefaultId) const;
+
+  // One signature of a batch. |id| is hashed as given, as by Verify();
+  // it starts out as kDefaultId.
+  struct VerifyItem {
+    VerifyItem() : key(nullptr), id(kDefaultId) {}
+
+    const Sm2PublicKey* key;
+    strings::StringPiece message;
+    strings::StringPiece signature;
+    strings::StringPiece id;
+  };
+  // Verifies |count| signatures and stores the result of each in
+  // |statuses|, split over the threads of |pool| (nullptr runs them on the
+  // calling thread). Returns once all are done.
+  static void VerifyBatch(core::thread::ThreadPool* pool,
+                          const VerifyItem* items,
+                          int count,
+                          base::Status* statuses);
+
+  // Z = SM3(ENTL || ID || a || b || xG || yG || xA || yA), the signer hash
+  // that is prepended to every message.
+  std::string IdentityHash(strings::StringPiece id) const;
+
+ private:
+  friend class Sm2PrivateKey;
+
+  explicit Sm2PublicKey(const Sm2Point& point);
+
+  base::Status VerifyDigest(const uint8_t* digest,
+                            strings::StringPiece signature) const;
+  // The digest e = SM3(Z || message).
+  void MessageDigest(strings::StringPiece message, strings::StringPiece id,
+                     uint8_t* digest) const;
+
+  std::unique_ptr<Sm2Point> point_;
+  // point_ times 1 .. 15.
+  std::unique_ptr<Sm2Point[]> multiples_;
+  std::string default_id_hash_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sm2PublicKey);
+};
+
+// A private key d, kept in a SecureKeyArena slot together with
+// (1 + d)^-1 mod n, the factor every signature needs.
+class Sm2PrivateKey {
+ public:
+  static const size_t kEncodedSize = 32;
+
+  // A fresh random key; nullptr when no randomness or no arena slot was
+  // available.
+  static std::unique_ptr<Sm2PrivateKey> Generate();
+  // nullptr unless |encoded| is a big-endian d in [1, n - 2].
+  static std::unique_ptr<Sm2PrivateKey> FromBytes(strings::StringPiece encoded);
+  ~Sm2PrivateKey();
+
+  const Sm2PublicKey& public_key() const { return *public_key_; }
+
+  // Reverses Sm2PublicKey::Encrypt(). DATA_LOSS when the check value does
+  // not match, in which case nothing is written to |plaintext|.
+  base::Status Decrypt(strings::StringPiece ciphertext,
+                       std::string* plaintext) const;
+
+  // A 64-byte r || s signature of |message| by the signer |id|.
+  base::Status Sign(strings::StringPiece message,
+                    std::string* signature,
+                    strings::StringPiece id = Sm2PublicKey::kDefaultId) const;
+
+ private:
+  explicit Sm2PrivateKey(std::shared_ptr<SecureKeyBytes> secret);
+
+  // d, then (1 + d)^-1 in the Montgomery form modulo n, as little-endian
+  // 64-bit limbs.
+  std::shared_ptr<SecureKeyBytes> secret_;
+  std::unique_ptr<Sm2PublicKey> public_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sm2PrivateKey);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SM2_H_
@@ -0,0 +1,28 @@
+#ifndef CRYPTO_SM3_H_
+#define CRYPTO_SM3_H_
+
+#include "base/macros.h"
+#include "crypto/digest.h"
+#include "strings/string_piece.h"
+
+#include <string>
+
+namespace crypto {
+
+// The SM3 hash of GB/T 32905-2016, fed incrementally. SM2 hashes its
+// signer identities, messages and key derivation with it.
+class Sm3 : public Digest {
+ public:
+  Sm3() : Digest(DigestEngine::kSm3) {}
+
+  // The digest of |data|, as kDigestSize raw bytes.
+  static std::string Hash(strings::StringPiece data) {
+    return Digest::Hash(DigestEngine::kSm3, data);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Sm3);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SM3_H_
@@ -0,0 +1,498 @@
+#include "crypto/sm4_encryptor.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = Sm4Engine::kBlockSize;
+// Blocks handed to a kernel per call; bounds the output scratch buffer.
+const size_t kChunkBlocks = 4096;
+// The GCM counter is the low 32 bits of the counter block, and its first
+// value encrypts the tag.
+const uint64_t kMaxGcmTextSize = (0xffffffffULL - 1) * kBlockSize;
+
+base::Status WriteError() {
+  return base::Status(base::error::INTERNAL, "Failed to write SM4 output");
+}
+
+bool TagsEqual(const uint8_t* a, const uint8_t* b, size_t size) {
+  uint8_t diff = 0;
+  for (size_t i = 0; i < size; ++i) {
+    diff |= a[i] ^ b[i];
+  }
+  return diff == 0;
+}
+
+inline void StoreBE64(uint8_t* p, uint64_t v) {
+  for (int i = 7; i >= 0; --i) {
+    p[i] = static_cast<uint8_t>(v);
+    v >>= 8;
+  }
+}
+
+} // namespace
+
+// Sm4Encryptor
+
+Sm4Encryptor::Sm4Encryptor(strings::StringPiece raw_key,
+                           const Sm4Engine::Kernels* kernels)
+    : key_ok_(Sm4Engine::ExpandKey(raw_key, &key_)),
+      kernels_(kernels) {
+}
+
+Sm4Encryptor::~Sm4Encryptor() {
+  OPENSSL_cleanse(&key_, sizeof(key_));
+}
+
+base::Status Sm4Encryptor::CheckReady() const {
+  if (!kernels_) {
+    return base::Status(base::error::UNIMPLEMENTED,
+                        "SM4 kernels not supported by this CPU");
+  }
+  if (!key_ok_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "SM4 key must be 128 bits");
+  }
+  return base::Status::OK;
+}
+
+base::Status Sm4Encryptor::CryptPadded(bool do_encrypt,
+                                       const std::string& chain,
+                                       io::InputStream* in,
+                                       io::OutputStream* out) {
+  base::Status status = CheckReady();
+  if (!status.ok()) {
+    return status;
+  }
+
+  const bool chained = !chain.empty();
+  uint8_t chain_block[kBlockSize];
+  if (chained) {
+    DCHECK_EQ(chain.size(), kBlockSize);
+    memcpy(chain_block, chain.data(), kBlockSize);
+  }
+  auto process = [&](const uint8_t* src, uint8_t* dst, size_t blocks) {
+    if (chained) {
+      (do_encrypt ? kernels_->cbc_encrypt : kernels_->cbc_decrypt)(
+          key_, chain_block, src, dst, blocks);
+    } else {
+      kernels_->ecb_crypt(do_encrypt ? key_.encrypt_keys : key_.decrypt_keys,
+                          src, dst, blocks);
+    }
+  };
+
+  // Left uninitialized: short messages should not pay for clearing it.
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[kChunkBlocks * kBlockSize]);
+  // Bytes of a block that is not complete yet. When decrypting, the last
+  // complete block also waits here: it holds the padding if the stream
+  // ends after it.
+  uint8_t carry[kBlockSize];
+  size_t carry_len = 0;
+  int64_t total = 0;
+
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t n = size;
+    total += size;
+    while (n > 0) {
+      if (carry_len == kBlockSize) {
+        process(carry, buffer.get(), 1);
+        if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+          return WriteError();
+        }
+        carry_len = 0;
+      }
+      if (carry_len > 0) {
+        size_t take = std::min(kBlockSize - carry_len, n);
+        memcpy(carry + carry_len, p, take);
+        carry_len += take;
+        p += take;
+        n -= take;
+        if (do_encrypt && carry_len == kBlockSize) {
+          process(carry, buffer.get(), 1);
+          if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+            return WriteError();
+          }
+          carry_len = 0;
+        }
+        continue;
+      }
+
+      size_t blocks = n / kBlockSize;
+      if (!do_encrypt && blocks > 0 && n % kBlockSize == 0) {
+        blocks--;
+      }
+      blocks = std::min(blocks, kChunkBlocks);
+      if (blocks == 0) {
+        memcpy(carry, p, n);
+        carry_len = n;
+        break;
+      }
+      process(p, buffer.get(), blocks);
+      if (!io::IOUtil::WriteToOutput(out, buffer.get(),
+                                     blocks * kBlockSize)) {
+        return WriteError();
+      }
+      p += blocks * kBlockSize;
+      n -= blocks * kBlockSize;
+    }
+  }
+
+  // Like the EVP path, an empty stream maps to an empty stream.
+  if (total == 0) {
+    return base::Status::OK;
+  }
+
+  if (do_encrypt) {
+    uint8_t pad = static_cast<uint8_t>(kBlockSize - carry_len);
+    memset(carry + carry_len, pad, pad);
+    process(carry, buffer.get(), 1);
+    if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize)) {
+      return WriteError();
+    }
+    return base::Status::OK;
+  }
+
+  if (carry_len != kBlockSize) {
+    return base::Status(base::error::DATA_LOSS,
+                        "SM4 ciphertext is not a whole number of blocks");
+  }
+  process(carry, buffer.get(), 1);
+  uint8_t pad = buffer[kBlockSize - 1];
+  bool bad = pad == 0 || pad > kBlockSize;
+  for (size_t i = kBlockSize - std::min<size_t>(pad, kBlockSize);
+       !bad && i < kBlockSize; ++i) {
+    bad = buffer[i] != pad;
+  }
+  if (bad) {
+    return base::Status(base::error::DATA_LOSS, "Bad SM4 padding");
+  }
+  if (!io::IOUtil::WriteToOutput(out, buffer.get(), kBlockSize - pad)) {
+    return WriteError();
+  }
+  return base::Status::OK;
+}
+
+base::Status Sm4Encryptor::CryptCounter(uint8_t* counter,
+                                        io::InputStream* in,
+                                        io::OutputStream* out) {
+  // Left uninitialized: short messages should not pay for clearing it.
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[kChunkBlocks * kBlockSize]);
+  // Keystream left over from a block that was only partly used.
+  uint8_t keystream[kBlockSize];
+  size_t keystream_used = kBlockSize;
+
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t n = size;
+    while (n > 0) {
+      if (keystream_used < kBlockSize) {
+        size_t take = std::min(kBlockSize - keystream_used, n);
+        for (size_t i = 0; i < take; ++i) {
+          buffer[i] = p[i] ^ keystream[keystream_used + i];
+        }
+        if (!io::IOUtil::WriteToOutput(out, buffer.get(), take)) {
+          return WriteError();
+        }
+        keystream_used += take;
+        p += take;
+        n -= take;
+        continue;
+      }
+
+      size_t blocks = std::min(n / kBlockSize, kChunkBlocks);
+      if (blocks == 0) {
+        // Encrypting a zero block yields the keystream for the tail.
+        memset(keystream, 0, kBlockSize);
+        kernels_->ctr_crypt(key_, counter, keystream, keystream, 1);
+        keystream_used = 0;
+        continue;
+      }
+      kernels_->ctr_crypt(key_, counter, p, buffer.get(), blocks);
+      if (!io::IOUtil::WriteToOutput(out, buffer.get(),
+                                     blocks * kBlockSize)) {
+        return WriteError();
+      }
+      p += blocks * kBlockSize;
+      n -= blocks * kBlockSize;
+    }
+  }
+  OPENSSL_cleanse(keystream, kBlockSize);
+  return base::Status::OK;
+}
+
+// Sm4EcbEncryptor
+
+Sm4EcbEncryptor::Sm4EcbEncryptor(strings::StringPiece raw_key,
+                                 const Sm4Engine::Kernels* kernels)
+    : Sm4Encryptor(raw_key, kernels) {
+}
+
+Sm4EcbEncryptor::~Sm4EcbEncryptor() {}
+
+base::Status Sm4EcbEncryptor::Encrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return CryptPadded(true, "", in, out);
+}
+
+base::Status Sm4EcbEncryptor::Decrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return CryptPadded(false, "", in, out);
+}
+
+// Sm4CbcEncryptor
+
+Sm4CbcEncryptor::Sm4CbcEncryptor(strings::StringPiece raw_key,
+                                 const std::string& iv,
+                                 const Sm4Engine::Kernels* kernels)
+    : Sm4Encryptor(raw_key, kernels),
+      iv_(iv.empty() ? std::string(kBlockSize, '\0') : iv) {
+}
+
+Sm4CbcEncryptor::~Sm4CbcEncryptor() {}
+
+base::Status Sm4CbcEncryptor::Encrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Crypt(true, iv_, in, out);
+}
+
+base::Status Sm4CbcEncryptor::Decrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Crypt(false, iv_, in, out);
+}
+
+base::Status Sm4CbcEncryptor::EncryptRecord(const AESBatchRecord& record) {
+  return Crypt(true, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status Sm4CbcEncryptor::DecryptRecord(const AESBatchRecord& record) {
+  return Crypt(false, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status Sm4CbcEncryptor::Crypt(bool do_encrypt,
+                                    const std::string& iv,
+                                    io::InputStream* in,
+                                    io::OutputStream* out) {
+  if (iv.size() != kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CBC iv must be 16 bytes");
+  }
+  return CryptPadded(do_encrypt, iv, in, out);
+}
+
+// Sm4CtrEncryptor
+
+Sm4CtrEncryptor::Sm4CtrEncryptor(strings::StringPiece raw_key,
+                                 const std::string& iv,
+                                 const Sm4Engine::Kernels* kernels)
+    : Sm4Encryptor(raw_key, kernels),
+      iv_(iv) {
+}
+
+Sm4CtrEncryptor::~Sm4CtrEncryptor() {}
+
+base::Status Sm4CtrEncryptor::Encrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  base::Status status = CheckReady();
+  if (!status.ok()) {
+    return status;
+  }
+  if (iv_.size() != kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CTR iv must be 16 bytes");
+  }
+  uint8_t counter[kBlockSize];
+  memcpy(counter, iv_.data(), kBlockSize);
+  return CryptCounter(counter, in, out);
+}
+
+base::Status Sm4CtrEncryptor::Decrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Encrypt(in, out);
+}
+
+// Sm4GcmEncryptor
+
+const int Sm4GcmEncryptor::kNonceSize;
+const int Sm4GcmEncryptor::kTagSize;
+
+Sm4GcmEncryptor::Sm4GcmEncryptor(strings::StringPiece raw_key,
+                                 const std::string& iv,
+                                 const std::string& aad,
+                                 const Sm4Engine::Kernels* kernels)
+    : Sm4Encryptor(raw_key, kernels),
+      iv_(iv),
+      iv_used_(false),
+      aad_(aad) {
+  LOG_IF(ERROR, iv_.size() != static_cast<size_t>(kNonceSize))
+      << "GCM nonce must be " << kNonceSize << " bytes";
+}
+
+Sm4GcmEncryptor::~Sm4GcmEncryptor() {}
+
+base::Status Sm4GcmEncryptor::Encrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  if (iv_used_.exchange(true)) {
+    return base::Status(base::error::FAILED_PRECONDITION,
+                        "GCM nonce already used; pass a fresh one");
+  }
+  return Crypt(true, iv_, in, out);
+}
+
+base::Status Sm4GcmEncryptor::Decrypt(io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Crypt(false, iv_, in, out);
+}
+
+base::Status Sm4GcmEncryptor::Encrypt(const std::string& nonce,
+                                      io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Crypt(true, nonce, in, out);
+}
+
+base::Status Sm4GcmEncryptor::Decrypt(const std::string& nonce,
+                                      io::InputStream* in,
+                                      io::OutputStream* out) {
+  return Crypt(false, nonce, in, out);
+}
+
+base::Status Sm4GcmEncryptor::EncryptRecord(const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Encrypt(record.input, record.output);
+  }
+  return Encrypt(record.iv, record.input, record.output);
+}
+
+base::Status Sm4GcmEncryptor::DecryptRecord(const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Decrypt(record.input, record.output);
+  }
+  return Decrypt(record.iv, record.input, record.output);
+}
+
+base::Status Sm4GcmEncryptor::Crypt(bool do_encrypt,
+                                    const std::string& nonce,
+                                    io::InputStream* input,
+                                    io::OutputStream* output) {
+  base::Status status = CheckReady();
+  if (!status.ok()) {
+    return status;
+  }
+  if (nonce.size() != static_cast<size_t>(kNonceSize)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "GCM nonce must be 12 bytes");
+  }
+
+  // H is the cipher of the zero block; the counter starts at nonce || 1,
+  // whose cipher masks the tag.
+  uint8_t hash_key[kBlockSize] = {0};
+  kernels_->ecb_crypt(key_.encrypt_keys, hash_key, hash_key, 1);
+  GHash ghash(hash_key);
+  OPENSSL_cleanse(hash_key, sizeof(hash_key));
+  uint8_t counter[kBlockSize] = {0};
+  memcpy(counter, nonce.data(), kNonceSize);
+  counter[kBlockSize - 1] = 1;
+  uint8_t tag_mask[kBlockSize] = {0};
+  kernels_->ctr_crypt(key_, counter, tag_mask, tag_mask, 1);
+
+  ghash.Update(reinterpret_cast<const uint8_t*>(aad_.data()), aad_.size());
+  ghash.PadTo16();
+
+  // Decrypt() keeps the last kTagSize bytes read back: they may be the tag.
+  const size_t chunk_size = kChunkBlocks * kBlockSize;
+  std::string buffer(chunk_size + kTagSize, '\0');
+  uint8_t* data = reinterpret_cast<uint8_t*>(&buffer[0]);
+  const size_t read_size = do_encrypt ? chunk_size : buffer.size();
+  size_t held = 0;
+  size_t size = 0;
+  uint64_t text_size = 0;
+  while (true) {
+    int n = io::IOUtil::ReadFromInput(input, data + held, read_size - held);
+    size = held + (n > 0 ? n : 0);
+    const bool last = size < read_size;
+    if (!do_encrypt) {
+      if (size < static_cast<size_t>(kTagSize)) {
+        return base::Status(base::error::DATA_LOSS,
+                            "SM4-GCM input shorter than a tag");
+      }
+      // Carried over to the next round, or the tag.
+      size -= kTagSize;
+      held = kTagSize;
+    }
+    if (text_size + size > kMaxGcmTextSize) {
+      return base::Status(base::error::OUT_OF_RANGE,
+                          "Too much data for one SM4-GCM nonce");
+    }
+    if (!do_encrypt) {
+      ghash.Update(data, size);
+    }
+    // Only the last round may end in a partial block.
+    const size_t blocks = size / kBlockSize;
+    kernels_->ctr_crypt(key_, counter, data, data, blocks);
+    const size_t tail = size % kBlockSize;
+    if (tail > 0) {
+      uint8_t block[kBlockSize] = {0};
+      memcpy(block, data + blocks * kBlockSize, tail);
+      kernels_->ctr_crypt(key_, counter, block, block, 1);
+      memcpy(data + blocks * kBlockSize, block, tail);
+      OPENSSL_cleanse(block, sizeof(block));
+    }
+    if (do_encrypt) {
+      ghash.Update(data, size);
+    }
+    if (size > 0 && !io::IOUtil::WriteToOutput(output, data, size)) {
+      return WriteError();
+    }
+    text_size += size;
+    if (last) {
+      break;
+    }
+    if (!do_encrypt) {
+      memmove(data, data + size, kTagSize);
+    }
+  }
+
+  // The lengths are in bits.
+  uint8_t lengths[16];
+  StoreBE64(lengths, static_cast<uint64_t>(aad_.size()) * 8);
+  StoreBE64(lengths + 8, text_size * 8);
+  ghash.PadTo16();
+  ghash.Update(lengths, sizeof(lengths));
+  uint8_t tag[kTagSize];
+  ghash.Finish(tag);
+  for (int i = 0; i < kTagSize; ++i) {
+    tag[i] ^= tag_mask[i];
+  }
+
+  if (do_encrypt) {
+    if (!io::IOUtil::WriteToOutput(output, tag, kTagSize)) {
+      return WriteError();
+    }
+    return base::Status::OK;
+  }
+  if (!TagsEqual(tag, data + size, kTagSize)) {
+    return base::Status(base::error::DATA_LOSS,
+                        "SM4-GCM authentication tag mismatch");
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
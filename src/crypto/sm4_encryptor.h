@@ -0,0 +1,170 @@
+#ifndef CRYPTO_SM4_ENCRYPTOR_H_
+#define CRYPTO_SM4_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/sm4_engine.h"
+#include "strings/string_piece.h"
+
+#include <atomic>
+#include <string>
+
+namespace crypto {
+
+// SM4 encryptors on the Sm4Engine kernels, behind the AESEncryptor
+// interface. The modes are laid out as their AES counterparts are: ECB and
+// CBC with PKCS#7 padding, CTR with a 128-bit big-endian counter, and GCM
+// with the ciphertext followed by a 16-byte tag. The key is expanded once
+// in the constructor; calls keep their chaining state on the stack, so an
+// encryptor can be shared between threads.
+class Sm4Encryptor : public AESEncryptor {
+ public:
+  virtual ~Sm4Encryptor() override;
+
+ protected:
+  Sm4Encryptor(strings::StringPiece raw_key,
+               const Sm4Engine::Kernels* kernels);
+
+  // OK, or why the key is unusable.
+  base::Status CheckReady() const;
+
+  // Pads and encrypts (or decrypts and unpads) the whole stream with
+  // |chain| as the chaining block; ECB passes an empty one.
+  base::Status CryptPadded(bool do_encrypt,
+                           const std::string& chain,
+                           io::InputStream* input,
+                           io::OutputStream* output);
+
+  // XORs the CTR keystream from |counter| into the whole stream.
+  base::Status CryptCounter(uint8_t* counter,
+                            io::InputStream* input,
+                            io::OutputStream* output);
+
+  Sm4Key key_;
+  bool key_ok_;
+  const Sm4Engine::Kernels* kernels_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Sm4Encryptor);
+};
+
+class Sm4EcbEncryptor : public Sm4Encryptor {
+ public:
+  // |kernels| defaults to the best set for this CPU.
+  explicit Sm4EcbEncryptor(strings::StringPiece raw_key,
+                           const Sm4Engine::Kernels* kernels =
+                               Sm4Engine::Get());
+  virtual ~Sm4EcbEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Sm4EcbEncryptor);
+};
+
+class Sm4CbcEncryptor : public Sm4Encryptor {
+ public:
+  // An empty |iv| is all zeros, as with SslCbcAESEncryptor.
+  Sm4CbcEncryptor(strings::StringPiece raw_key,
+                  const std::string& iv,
+                  const Sm4Engine::Kernels* kernels = Sm4Engine::Get());
+  virtual ~Sm4CbcEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ protected:
+  // From AESEncryptor
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
+ private:
+  base::Status Crypt(bool do_encrypt,
+                     const std::string& iv,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  std::string iv_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sm4CbcEncryptor);
+};
+
+class Sm4CtrEncryptor : public Sm4Encryptor {
+ public:
+  // |iv| is the 16-byte initial counter block.
+  Sm4CtrEncryptor(strings::StringPiece raw_key,
+                  const std::string& iv,
+                  const Sm4Engine::Kernels* kernels = Sm4Engine::Get());
+  virtual ~Sm4CtrEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ private:
+  std::string iv_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sm4CtrEncryptor);
+};
+
+// SM4-GCM (RFC 8998). As with SslGcmAESEncryptor, Decrypt() streams
+// plaintext out before the tag is checked, so callers must discard the
+// output when it fails, and the nonce given to the constructor seals one
+// message; later ones take a fresh nonce each.
+class Sm4GcmEncryptor : public Sm4Encryptor {
+ public:
+  static const int kNonceSize = 12;
+  static const int kTagSize = 16;
+
+  // |iv| is the 12-byte nonce, |aad| optional additional data that is
+  // authenticated but not encrypted.
+  Sm4GcmEncryptor(strings::StringPiece raw_key,
+                  const std::string& iv,
+                  const std::string& aad = "",
+                  const Sm4Engine::Kernels* kernels = Sm4Engine::Get());
+  virtual ~Sm4GcmEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // With |nonce| in place of the one the encryptor was built with.
+  base::Status Encrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+  base::Status Decrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+
+ protected:
+  // From AESEncryptor
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
+ private:
+  base::Status Crypt(bool do_encrypt,
+                     const std::string& nonce,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  std::string iv_;
+  // Set by the first Encrypt() under iv_.
+  std::atomic<bool> iv_used_;
+  std::string aad_;
+
+  DISALLOW_COPY_AND_ASSIGN(Sm4GcmEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SM4_ENCRYPTOR_H_
@@ -0,0 +1,81 @@
+#include "crypto/aes_encryptor.h"
+#include "crypto/sm4_encryptor.h"
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+// SM4 behind the AES factory interface, for tenants that must use the
+// Chinese national ciphers. Selected explicitly with GetFactory("sm4");
+// keys must be 128 bits, and Create*() return nullptr for any other key.
+class Sm4Factory : public AESFactory {
+ public:
+  Sm4Factory() {}
+  virtual ~Sm4Factory() override {}
+
+  // From AESFactory
+  virtual std::unique_ptr<AESEncryptor> CreateCBC(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    if (!IsSm4Key(*key)) {
+      return nullptr;
+    }
+    std::unique_ptr<Sm4CbcEncryptor> ret(new Sm4CbcEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateECB(std::unique_ptr<AESKey>& key) override {
+    if (!IsSm4Key(*key)) {
+      return nullptr;
+    }
+    std::unique_ptr<Sm4EcbEncryptor> ret(new Sm4EcbEncryptor(key->key()));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    if (!IsSm4Key(*key)) {
+      return nullptr;
+    }
+    std::unique_ptr<Sm4CtrEncryptor> ret(new Sm4CtrEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateGCM(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    if (!IsSm4Key(*key)) {
+      return nullptr;
+    }
+    std::unique_ptr<Sm4GcmEncryptor> ret(new Sm4GcmEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual bool AcceptsOptions(const std::string& encryptor_type) override {
+    return encryptor_type == "sm4";
+  }
+
+  // Never a candidate for "auto": the caller asked for AES.
+  virtual bool IsAES() const override {
+    return false;
+  }
+
+ private:
+  static bool IsSm4Key(const AESKey& key) {
+    LOG_IF(ERROR, key.key().size() != Sm4Engine::kKeySize)
+        << "SM4 key must be 128 bits, got " << key.key().size() * 8;
+    return key.key().size() == Sm4Engine::kKeySize;
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(Sm4Factory);
+};
+
+namespace { // register
+
+class Sm4Registrar {
+ public:
+  Sm4Registrar() {
+    AESFactory::Register("sm4", new Sm4Factory());
+  }
+};
+static Sm4Registrar registrar;
+} // namespace
+} // namespace crypto
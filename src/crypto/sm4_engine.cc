@@ -0,0 +1,604 @@
+#include "crypto/sm4_engine.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+
+#include <cpuid.h>
+#include <string.h>
+#include <algorithm>
+#include <immintrin.h>
+
+#include <glog/logging.h>
+
+// As in aesni_engine.cc, the SIMD kernels are compiled for their
+// instruction sets one function at a time.
+#define AVX2_TARGET __attribute__((target("aes,ssse3,avx2")))
+#define PCLMUL_TARGET __attribute__((target("pclmul")))
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = Sm4Engine::kBlockSize;
+const int kRounds = Sm4Key::kRounds;
+// Blocks per vector group, one per 32-bit lane of a ymm register.
+const size_t kGroupBlocks = 8;
+// Blocks the chained kernels work on at a time.
+const size_t kBatchBlocks = 2 * kGroupBlocks;
+
+const uint8_t kSbox[256] = {
+  0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7,
+  0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+  0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3,
+  0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+  0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a,
+  0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+  0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95,
+  0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+  0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba,
+  0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+  0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b,
+  0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+  0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2,
+  0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+  0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52,
+  0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+  0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5,
+  0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+  0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55,
+  0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+  0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60,
+  0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+  0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f,
+  0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+  0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f,
+  0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+  0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd,
+  0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+  0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e,
+  0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+  0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20,
+  0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48,
+};
+
+const uint32_t kFK[4] = {0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc};
+
+// The SM4 S-box is A(I(A(x))), with A an affine map and I the inversion
+// in GF(2^8) modulo x^8 + x^7 + x^6 + x^5 + x^4 + x^2 + 1. Moving I onto
+// the AES field, and undoing the affine map that follows the inversion in
+// the AES S-box, leaves S(x) = Post(AesSbox(Pre(x))) for two affine maps.
+// Each is stored as the images of the low and of the high nibble.
+const uint8_t kPreLow[16] = {
+  0x3e, 0xb2, 0x0e, 0x82, 0xbb, 0x37, 0x8b, 0x07,
+  0xa1, 0x2d, 0x91, 0x1d, 0x24, 0xa8, 0x14, 0x98,
+};
+const uint8_t kPreHigh[16] = {
+  0x00, 0xdc, 0x2e, 0xf2, 0xc5, 0x19, 0xeb, 0x37,
+  0x08, 0xd4, 0x26, 0xfa, 0xcd, 0x11, 0xe3, 0x3f,
+};
+const uint8_t kPostLow[16] = {
+  0x6c, 0xd4, 0xa6, 0x1e, 0x52, 0xea, 0x98, 0x20,
+  0x0b, 0xb3, 0xc1, 0x79, 0x35, 0x8d, 0xff, 0x47,
+};
+const uint8_t kPostHigh[16] = {
+  0x00, 0xe0, 0x50, 0xb0, 0x9d, 0x7d, 0xcd, 0x2d,
+  0xc0, 0x20, 0x90, 0x70, 0x5d, 0xbd, 0x0d, 0xed,
+};
+// AESENCLAST runs ShiftRows after SubBytes; bytes are moved by the inverse
+// first so that they come back where they were.
+const uint8_t kInvShiftRows[16] = {
+  0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3,
+};
+// SM4 words are big-endian.
+const uint8_t kByteSwap32[16] = {
+  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+};
+
+inline uint32_t Rotl(uint32_t v, int n) {
+  return (v << n) | (v >> (32 - n));
+}
+
+inline uint32_t LoadBE32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) << 24 |
+         static_cast<uint32_t>(p[1]) << 16 |
+         static_cast<uint32_t>(p[2]) << 8 |
+         static_cast<uint32_t>(p[3]);
+}
+
+inline void StoreBE32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+inline uint64_t LoadBE64(const uint8_t* p) {
+  return static_cast<uint64_t>(LoadBE32(p)) << 32 | LoadBE32(p + 4);
+}
+
+inline void StoreBE64(uint8_t* p, uint64_t v) {
+  StoreBE32(p, static_cast<uint32_t>(v >> 32));
+  StoreBE32(p + 4, static_cast<uint32_t>(v));
+}
+
+inline uint32_t SubWord(uint32_t v) {
+  return static_cast<uint32_t>(kSbox[v >> 24]) << 24 |
+         static_cast<uint32_t>(kSbox[(v >> 16) & 0xff]) << 16 |
+         static_cast<uint32_t>(kSbox[(v >> 8) & 0xff]) << 8 |
+         static_cast<uint32_t>(kSbox[v & 0xff]);
+}
+
+inline void XorBlock(uint8_t* out, const uint8_t* a, const uint8_t* b) {
+  for (size_t i = 0; i < kBlockSize; ++i) {
+    out[i] = a[i] ^ b[i];
+  }
+}
+
+// CPUID
+
+struct CpuFeatures {
+  bool avx2;
+  bool pclmul;
+};
+
+uint64_t ReadXCR0() {
+  uint32_t eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+}
+
+CpuFeatures DetectFeatures() {
+  CpuFeatures features = {false, false};
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return features;
+  }
+  const bool ssse3 = ecx & (1u << 9);
+  const bool aes = ecx & (1u << 25);
+  const bool osxsave = ecx & (1u << 27);
+  features.pclmul = ecx & (1u << 1);
+  if (!ssse3 || !aes || !osxsave || __get_cpuid_max(0, nullptr) < 7) {
+    return features;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  // The OS has to save the xmm and ymm state.
+  features.avx2 = (ebx & (1u << 5)) && (ReadXCR0() & 0x6) == 0x6;
+  return features;
+}
+
+const CpuFeatures& Features() {
+  static const CpuFeatures features = DetectFeatures();
+  return features;
+}
+
+// Portable kernel
+
+// The S-box followed by the round's linear transform L, for a byte in the
+// low position. L commutes with rotations, so the byte at bit 8 * k
+// contributes Rotl(table[b], 8 * k).
+struct RoundTable {
+  RoundTable() {
+    for (int i = 0; i < 256; ++i) {
+      const uint32_t b = kSbox[i];
+      t[i] = b ^ Rotl(b, 2) ^ Rotl(b, 10) ^ Rotl(b, 18) ^ Rotl(b, 24);
+    }
+  }
+  uint32_t t[256];
+};
+
+const uint32_t* GetRoundTable() {
+  static const RoundTable table;
+  return table.t;
+}
+
+inline uint32_t RoundFunc(const uint32_t* t, uint32_t v) {
+  return t[v & 0xff] ^ Rotl(t[(v >> 8) & 0xff], 8) ^
+         Rotl(t[(v >> 16) & 0xff], 16) ^ Rotl(t[v >> 24], 24);
+}
+
+inline void CryptBlock(const uint32_t* rk, const uint32_t* t,
+                       const uint8_t* in, uint8_t* out) {
+  uint32_t x0 = LoadBE32(in);
+  uint32_t x1 = LoadBE32(in + 4);
+  uint32_t x2 = LoadBE32(in + 8);
+  uint32_t x3 = LoadBE32(in + 12);
+  for (int i = 0; i < kRounds; i += 4) {
+    x0 ^= RoundFunc(t, x1 ^ x2 ^ x3 ^ rk[i]);
+    x1 ^= RoundFunc(t, x2 ^ x3 ^ x0 ^ rk[i + 1]);
+    x2 ^= RoundFunc(t, x3 ^ x0 ^ x1 ^ rk[i + 2]);
+    x3 ^= RoundFunc(t, x0 ^ x1 ^ x2 ^ rk[i + 3]);
+  }
+  StoreBE32(out, x3);
+  StoreBE32(out + 4, x2);
+  StoreBE32(out + 8, x1);
+  StoreBE32(out + 12, x0);
+}
+
+void EcbPortable(const uint32_t* rk, const uint8_t* in, uint8_t* out,
+                 size_t blocks) {
+  const uint32_t* t = GetRoundTable();
+  for (; blocks > 0; --blocks) {
+    CryptBlock(rk, t, in, out);
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+}
+
+// The chained modes are written once, on top of a kernel set's ECB.
+
+// Every block depends on the previous ciphertext: one block at a time, on
+// the portable kernel whatever the level.
+void CbcEncrypt(const Sm4Key& key, uint8_t* chain, const uint8_t* in,
+                uint8_t* out, size_t blocks) {
+  const uint32_t* t = GetRoundTable();
+  for (; blocks > 0; --blocks) {
+    XorBlock(chain, chain, in);
+    CryptBlock(key.encrypt_keys, t, chain, chain);
+    memcpy(out, chain, kBlockSize);
+    in += kBlockSize;
+    out += kBlockSize;
+  }
+}
+
+template <Sm4Engine::BlockFunc kEcb>
+void CbcDecrypt(const Sm4Key& key, uint8_t* chain, const uint8_t* in,
+                uint8_t* out, size_t blocks) {
+  uint8_t plain[kBatchBlocks * kBlockSize];
+  while (blocks > 0) {
+    const size_t n = std::min(blocks, kBatchBlocks);
+    kEcb(key.decrypt_keys, in, plain, n);
+    // Back to front, so that |in| may equal |out|.
+    uint8_t next_chain[kBlockSize];
+    memcpy(next_chain, in + (n - 1) * kBlockSize, kBlockSize);
+    for (size_t i = n - 1; i > 0; --i) {
+      XorBlock(out + i * kBlockSize, plain + i * kBlockSize,
+               in + (i - 1) * kBlockSize);
+    }
+    XorBlock(out, plain, chain);
+    memcpy(chain, next_chain, kBlockSize);
+    in += n * kBlockSize;
+    out += n * kBlockSize;
+    blocks -= n;
+  }
+}
+
+template <Sm4Engine::BlockFunc kEcb>
+void CtrCrypt(const Sm4Key& key, uint8_t* chain, const uint8_t* in,
+              uint8_t* out, size_t blocks) {
+  uint8_t keystream[kBatchBlocks * kBlockSize];
+  uint64_t high = LoadBE64(chain);
+  uint64_t low = LoadBE64(chain + 8);
+  while (blocks > 0) {
+    const size_t n = std::min(blocks, kBatchBlocks);
+    for (size_t i = 0; i < n; ++i) {
+      StoreBE64(keystream + i * kBlockSize, high);
+      StoreBE64(keystream + i * kBlockSize + 8, low);
+      high += ++low == 0;
+    }
+    kEcb(key.encrypt_keys, keystream, keystream, n);
+    for (size_t i = 0; i < n * kBlockSize; i += 8) {
+      uint64_t a, b;
+      memcpy(&a, in + i, 8);
+      memcpy(&b, keystream + i, 8);
+      a ^= b;
+      memcpy(out + i, &a, 8);
+    }
+    in += n * kBlockSize;
+    out += n * kBlockSize;
+    blocks -= n;
+  }
+  StoreBE64(chain, high);
+  StoreBE64(chain + 8, low);
+}
+
+// AVX2 kernel
+
+AVX2_TARGET inline __m256i Broadcast(const uint8_t* table) {
+  return _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+// An affine map of every byte, from the images of the two nibbles.
+AVX2_TARGET inline __m256i Affine(__m256i x, __m256i low, __m256i high) {
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  const __m256i lo = _mm256_and_si256(x, mask);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi32(x, 4), mask);
+  return _mm256_xor_si256(_mm256_shuffle_epi8(low, lo),
+                          _mm256_shuffle_epi8(high, hi));
+}
+
+AVX2_TARGET inline __m256i Rotl256(__m256i v, int n) {
+  return _mm256_or_si256(_mm256_slli_epi32(v, n),
+                         _mm256_srli_epi32(v, 32 - n));
+}
+
+// The round function T = L(S(x)) on every 32-bit lane.
+AVX2_TARGET inline __m256i RoundFunc256(__m256i x) {
+  x = Affine(x, Broadcast(kPreLow), Broadcast(kPreHigh));
+  x = _mm256_shuffle_epi8(x, Broadcast(kInvShiftRows));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = _mm_aesenclast_si128(_mm256_castsi256_si128(x), zero);
+  const __m128i hi = _mm_aesenclast_si128(_mm256_extracti128_si256(x, 1),
+                                          zero);
+  x = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  x = Affine(x, Broadcast(kPostLow), Broadcast(kPostHigh));
+  return _mm256_xor_si256(
+      _mm256_xor_si256(x, Rotl256(x, 2)),
+      _mm256_xor_si256(_mm256_xor_si256(Rotl256(x, 10), Rotl256(x, 18)),
+                       Rotl256(x, 24)));
+}
+
+// Turns four registers of two blocks each (blocks i and i + 4 of a group
+// in register i) into four registers of one word of all eight blocks, and
+// back: the 4x4 word transpose is its own inverse.
+AVX2_TARGET inline void Transpose(__m256i* x) {
+  const __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]);
+  const __m256i t1 = _mm256_unpacklo_epi32(x[2], x[3]);
+  const __m256i t2 = _mm256_unpackhi_epi32(x[0], x[1]);
+  const __m256i t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+  x[0] = _mm256_unpacklo_epi64(t0, t1);
+  x[1] = _mm256_unpackhi_epi64(t0, t1);
+  x[2] = _mm256_unpacklo_epi64(t2, t3);
+  x[3] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+// Runs kGroups groups of 8 blocks through the rounds side by side.
+template <int kGroups>
+AVX2_TARGET inline void CryptGroups(const uint32_t* rk, const uint8_t* in,
+                                    uint8_t* out) {
+  const __m256i swap = Broadcast(kByteSwap32);
+  __m256i x[kGroups][4];
+  for (int g = 0; g < kGroups; ++g) {
+    const uint8_t* p = in + g * kGroupBlocks * kBlockSize;
+    for (int i = 0; i < 4; ++i) {
+      const __m128i lo =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+      const __m128i hi =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16 + 64));
+      x[g][i] = _mm256_shuffle_epi8(
+          _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), swap);
+    }
+    Transpose(x[g]);
+  }
+
+  for (int r = 0; r < kRounds; ++r) {
+    const __m256i round_key = _mm256_set1_epi32(rk[r]);
+    const int a = r & 3;
+    for (int g = 0; g < kGroups; ++g) {
+      const __m256i t = _mm256_xor_si256(
+          _mm256_xor_si256(x[g][(a + 1) & 3], x[g][(a + 2) & 3]),
+          _mm256_xor_si256(x[g][(a + 3) & 3], round_key));
+      x[g][a] = _mm256_xor_si256(x[g][a], RoundFunc256(t));
+    }
+  }
+
+  for (int g = 0; g < kGroups; ++g) {
+    // The output is the last four words in reverse order.
+    __m256i y[4] = {x[g][3], x[g][2], x[g][1], x[g][0]};
+    Transpose(y);
+    uint8_t* p = out + g * kGroupBlocks * kBlockSize;
+    for (int i = 0; i < 4; ++i) {
+      const __m256i v = _mm256_shuffle_epi8(y[i], swap);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i * 16),
+                       _mm256_castsi256_si128(v));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i * 16 + 64),
+                       _mm256_extracti128_si256(v, 1));
+    }
+  }
+}
+
+AVX2_TARGET void EcbAVX2(const uint32_t* rk, const uint8_t* in, uint8_t* out,
+                         size_t blocks) {
+  for (; blocks >= 2 * kGroupBlocks; blocks -= 2 * kGroupBlocks) {
+    CryptGroups<2>(rk, in, out);
+    in += 2 * kGroupBlocks * kBlockSize;
+    out += 2 * kGroupBlocks * kBlockSize;
+  }
+  if (blocks >= kGroupBlocks) {
+    CryptGroups<1>(rk, in, out);
+    in += kGroupBlocks * kBlockSize;
+    out += kGroupBlocks * kBlockSize;
+    blocks -= kGroupBlocks;
+  }
+  EcbPortable(rk, in, out, blocks);
+}
+
+const Sm4Engine::Kernels kPortableKernels = {
+  Sm4Engine::kPortable,
+  "portable",
+  EcbPortable,
+  CbcEncrypt,
+  CbcDecrypt<EcbPortable>,
+  CtrCrypt<EcbPortable>,
+};
+
+const Sm4Engine::Kernels kAVX2Kernels = {
+  Sm4Engine::kAVX2,
+  "avx2",
+  EcbAVX2,
+  CbcEncrypt,
+  CbcDecrypt<EcbAVX2>,
+  CtrCrypt<EcbAVX2>,
+};
+
+// GHASH
+
+// Multiplies |x| by |h| in GF(2^128) with the bit order of GCM, one bit of
+// |x| at a time; masks instead of branches keep it constant time.
+void MultiplyPortable(uint64_t* x, const uint64_t* h) {
+  uint64_t z0 = 0, z1 = 0;
+  uint64_t v0 = h[0], v1 = h[1];
+  for (int i = 0; i < 128; ++i) {
+    const uint64_t word = i < 64 ? x[0] : x[1];
+    const uint64_t bit = (word >> (63 - (i & 63))) & 1;
+    const uint64_t mask = 0 - bit;
+    z0 ^= v0 & mask;
+    z1 ^= v1 & mask;
+    const uint64_t carry = 0 - (v1 & 1);
+    v1 = (v1 >> 1) | (v0 << 63);
+    v0 = (v0 >> 1) ^ (0xe100000000000000ULL & carry);
+  }
+  x[0] = z0;
+  x[1] = z1;
+}
+
+// The carry-less multiplication and reduction of Intel's GCM white paper,
+// on byte-reflected operands: loading the big-endian halves as the high
+// and low quadword yields exactly that.
+PCLMUL_TARGET void MultiplyPclmul(uint64_t* x, const uint64_t* h) {
+  const __m128i a = _mm_set_epi64x(x[0], x[1]);
+  const __m128i b = _mm_set_epi64x(h[0], h[1]);
+  __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                              _mm_clmulepi64_si128(a, b, 0x01));
+  __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+  lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+  hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+  // The reflected product is one bit short: shift the 256 bits left by 1.
+  __m128i lo_carry = _mm_srli_epi32(lo, 31);
+  __m128i hi_carry = _mm_srli_epi32(hi, 31);
+  lo = _mm_slli_epi32(lo, 1);
+  hi = _mm_slli_epi32(hi, 1);
+  const __m128i cross = _mm_srli_si128(lo_carry, 12);
+  hi_carry = _mm_slli_si128(hi_carry, 4);
+  lo_carry = _mm_slli_si128(lo_carry, 4);
+  lo = _mm_or_si128(lo, lo_carry);
+  hi = _mm_or_si128(_mm_or_si128(hi, hi_carry), cross);
+
+  // Reduction modulo x^128 + x^7 + x^2 + x + 1.
+  __m128i t = _mm_xor_si128(
+      _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)),
+      _mm_slli_epi32(lo, 25));
+  const __m128i t_high = _mm_srli_si128(t, 4);
+  t = _mm_slli_si128(t, 12);
+  lo = _mm_xor_si128(lo, t);
+  __m128i u = _mm_xor_si128(
+      _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)),
+      _mm_xor_si128(_mm_srli_epi32(lo, 7), t_high));
+  lo = _mm_xor_si128(lo, u);
+  hi = _mm_xor_si128(hi, lo);
+
+  x[0] = static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_srli_si128(hi, 8)));
+  x[1] = static_cast<uint64_t>(_mm_cvtsi128_si64(hi));
+}
+
+} // namespace
+
+const int Sm4Key::kRounds;
+const size_t Sm4Engine::kBlockSize;
+const size_t Sm4Engine::kKeySize;
+
+// static
+const Sm4Engine::Kernels* Sm4Engine::Get() {
+  const Kernels* kernels = Get(kAVX2);
+  return kernels ? kernels : Get(kPortable);
+}
+
+// static
+const Sm4Engine::Kernels* Sm4Engine::Get(Level level) {
+  switch (level) {
+    case kPortable:
+      return &kPortableKernels;
+    case kAVX2:
+      return Features().avx2 ? &kAVX2Kernels : nullptr;
+  }
+  return nullptr;
+}
+
+// static
+bool Sm4Engine::ExpandKey(strings::StringPiece raw_key, Sm4Key* key) {
+  if (raw_key.size() != kKeySize) {
+    LOG(ERROR) << "SM4 key must be 128 bits, got " << raw_key.size() * 8;
+    return false;
+  }
+  const uint8_t* raw = reinterpret_cast<const uint8_t*>(raw_key.data());
+  uint32_t k[4];
+  for (int i = 0; i < 4; ++i) {
+    k[i] = LoadBE32(raw + 4 * i) ^ kFK[i];
+  }
+  for (int i = 0; i < kRounds; ++i) {
+    // Byte j of CK[i] is (4 * i + j) * 7 mod 256.
+    uint32_t ck = 0;
+    for (int j = 0; j < 4; ++j) {
+      ck = (ck << 8) | (((4 * i + j) * 7) & 0xff);
+    }
+    const uint32_t b = SubWord(k[1] ^ k[2] ^ k[3] ^ ck);
+    const uint32_t rk = k[0] ^ b ^ Rotl(b, 13) ^ Rotl(b, 23);
+    key->encrypt_keys[i] = rk;
+    key->decrypt_keys[kRounds - 1 - i] = rk;
+    k[0] = k[1];
+    k[1] = k[2];
+    k[2] = k[3];
+    k[3] = rk;
+  }
+  OPENSSL_cleanse(k, sizeof(k));
+  return true;
+}
+
+// GHash
+
+const size_t GHash::kBlockSize;
+
+GHash::GHash(const uint8_t* key)
+    : buffered_(0),
+      accelerated_(Features().pclmul) {
+  key_[0] = LoadBE64(key);
+  key_[1] = LoadBE64(key + 8);
+  hash_[0] = hash_[1] = 0;
+}
+
+GHash::~GHash() {
+  OPENSSL_cleanse(key_, sizeof(key_));
+  OPENSSL_cleanse(hash_, sizeof(hash_));
+  OPENSSL_cleanse(buffer_, sizeof(buffer_));
+}
+
+void GHash::Blocks(const uint8_t* data, size_t blocks) {
+  for (; blocks > 0; --blocks) {
+    hash_[0] ^= LoadBE64(data);
+    hash_[1] ^= LoadBE64(data + 8);
+    if (accelerated_) {
+      MultiplyPclmul(hash_, key_);
+    } else {
+      MultiplyPortable(hash_, key_);
+    }
+    data += kBlockSize;
+  }
+}
+
+void GHash::Update(const uint8_t* data, size_t size) {
+  if (buffered_ > 0) {
+    const size_t take = std::min(kBlockSize - buffered_, size);
+    memcpy(buffer_ + buffered_, data, take);
+    buffered_ += take;
+    data += take;
+    size -= take;
+    if (buffered_ < kBlockSize) {
+      return;
+    }
+    Blocks(buffer_, 1);
+    buffered_ = 0;
+  }
+  const size_t blocks = size / kBlockSize;
+  Blocks(data, blocks);
+  data += blocks * kBlockSize;
+  size -= blocks * kBlockSize;
+  memcpy(buffer_, data, size);
+  buffered_ = size;
+}
+
+void GHash::PadTo16() {
+  if (buffered_ > 0) {
+    memset(buffer_ + buffered_, 0, kBlockSize - buffered_);
+    Blocks(buffer_, 1);
+    buffered_ = 0;
+  }
+}
+
+void GHash::Finish(uint8_t* digest) {
+  PadTo16();
+  StoreBE64(digest, hash_[0]);
+  StoreBE64(digest + 8, hash_[1]);
+}
+
+} // namespace crypto
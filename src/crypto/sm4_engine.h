@@ -0,0 +1,110 @@
+#ifndef CRYPTO_SM4_ENGINE_H_
+#define CRYPTO_SM4_ENGINE_H_
+
+#include "base/macros.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace crypto {
+
+// Expanded SM4 round keys. Decryption runs the same rounds with the keys
+// in reverse order.
+struct Sm4Key {
+  static const int kRounds = 32;
+
+  uint32_t encrypt_keys[kRounds];
+  uint32_t decrypt_keys[kRounds];
+};
+
+// SM4 (GB/T 32907-2016) kernels: a table-driven portable kernel, and an
+// AVX2 kernel that keeps the state of 8 blocks in four ymm registers, one
+// 32-bit word of every block per register, with two such groups (16
+// blocks) in flight per iteration.
+//
+// The SM4 S-box is an affine transform of the inversion in GF(2^8), like
+// the AES one, so the AVX2 kernel computes it for 32 bytes at a time with
+// two AESENCLAST instructions, framed by affine maps evaluated as nibble
+// lookups (PSHUFB). The best kernel set is picked once, through CPUID.
+class Sm4Engine {
+ public:
+  enum Level {
+    kPortable,
+    kAVX2,
+  };
+
+  static const size_t kBlockSize = 16;
+  static const size_t kKeySize = 16;
+
+  // |blocks| counts 16-byte blocks; |in| may equal |out|. |round_keys| is
+  // Sm4Key::encrypt_keys or Sm4Key::decrypt_keys.
+  typedef void (*BlockFunc)(const uint32_t* round_keys,
+                            const uint8_t* in,
+                            uint8_t* out,
+                            size_t blocks);
+  // |chain| is the CBC IV, or the big-endian CTR counter block, and is
+  // updated so that consecutive calls continue the same stream.
+  typedef void (*ChainFunc)(const Sm4Key& key,
+                            uint8_t* chain,
+                            const uint8_t* in,
+                            uint8_t* out,
+                            size_t blocks);
+
+  struct Kernels {
+    Level level;
+    const char* name;
+    BlockFunc ecb_crypt;
+    ChainFunc cbc_encrypt;
+    ChainFunc cbc_decrypt;
+    ChainFunc ctr_crypt;
+  };
+
+  // The fastest kernel set the CPU runs; never nullptr.
+  static const Kernels* Get();
+  // The kernel set for |level|, nullptr when the CPU lacks it (kAVX2 also
+  // needs AES-NI).
+  static const Kernels* Get(Level level);
+
+  // Expands a 128-bit |raw_key|, the only size SM4 has.
+  static bool ExpandKey(strings::StringPiece raw_key, Sm4Key* key);
+
+ private:
+  Sm4Engine() = delete;
+  DISALLOW_COPY_AND_ASSIGN(Sm4Engine);
+};
+
+// GHASH, the universal hash of GCM, fed incrementally. Runs on PCLMULQDQ
+// when the CPU has it, bit by bit otherwise.
+class GHash {
+ public:
+  static const size_t kBlockSize = 16;
+
+  // |key| is the 16-byte hash key H, the block cipher applied to zeros.
+  explicit GHash(const uint8_t* key);
+  ~GHash();
+
+  void Update(const uint8_t* data, size_t size);
+  // Pads what was fed so far with zeros to a multiple of 16 bytes, as GCM
+  // does after the AAD and the ciphertext.
+  void PadTo16();
+  void Finish(uint8_t* digest);
+
+  // Forces the bit-by-bit path, for tests.
+  void DisableAcceleration() { accelerated_ = false; }
+
+ private:
+  void Blocks(const uint8_t* data, size_t blocks);
+
+  // Big-endian halves of H and of the running hash.
+  uint64_t key_[2];
+  uint64_t hash_[2];
+  uint8_t buffer_[kBlockSize];
+  size_t buffered_;
+  bool accelerated_;
+
+  DISALLOW_COPY_AND_ASSIGN(GHash);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SM4_ENGINE_H_
@@ -1,6 +1,8 @@
 #include "crypto/aes_encryptor.h"
 #include "crypto/ssl_cbc_aes_encryptor.h"
+#include "crypto/ssl_ctr_aes_encryptor.h"
 #include "crypto/ssl_ecb_aes_encryptor.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
 
 namespace crypto {
 
@@ -12,19 +14,25 @@ class SslAESFactory : public AESFactory {
   // From AESFactory
   virtual std::unique_ptr<AESEncryptor> CreateCBC(std::unique_ptr<AESKey>& key,
                                                   const std::string& iv) override {
-    std::unique_ptr<SslCbcAESEncryptor> ret(new SslCbcAESEncryptor(key->raw_key(), iv));
+    std::unique_ptr<SslCbcAESEncryptor> ret(new SslCbcAESEncryptor(key->key(), iv));
     return std::move(ret);
   }
   
   virtual std::unique_ptr<AESEncryptor> CreateECB(std::unique_ptr<AESKey>& key) override {
-    std::unique_ptr<SslEcbAESEncryptor> ret(new SslEcbAESEncryptor(key->raw_key()));
+    std::unique_ptr<SslEcbAESEncryptor> ret(new SslEcbAESEncryptor(key->key()));
     return std::move(ret);
   }
 
-  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key) override {
-    (void)key;
-    //TODO(wqx):
-    return nullptr;
+  virtual std::unique_ptr<AESEncryptor> CreateCTR(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    std::unique_ptr<SslCtrAESEncryptor> ret(new SslCtrAESEncryptor(key->key(), iv));
+    return std::move(ret);
+  }
+
+  virtual std::unique_ptr<AESEncryptor> CreateGCM(std::unique_ptr<AESKey>& key,
+                                                  const std::string& iv) override {
+    std::unique_ptr<SslGcmAESEncryptor> ret(new SslGcmAESEncryptor(key->key(), iv));
+    return std::move(ret);
   }
 
   virtual bool AcceptsOptions(const std::string& encryptor_type) override {
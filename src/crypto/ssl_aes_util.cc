@@ -1,7 +1,8 @@
 #include "crypto/ssl_aes_util.h"
 #include "crypto/openssl_util.h"
+#include "crypto/ssl_cipher_stream.h"
+#include "crypto/ssl_cipher_context_pool.h"
 
-#include "third_party/boringssl/include/openssl/aes.h"
 #include "third_party/boringssl/include/openssl/evp.h"
 
 #include "base/location.h"
@@ -11,8 +12,14 @@
 #include "io/output_stream.h"
 #include "io/io_util.h"
 
+#include "system/blocking_counter.h"
+#include "system/threadpool.h"
+
+#include <string.h>
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -28,43 +35,16 @@ enum Cipher {
   kDecrypt,
 };
 
-const EVP_CIPHER* CBCGetCipherForKey(const std::string& key) {
-  switch (key.length()) {
-    case 16: return EVP_aes_128_cbc();
-    case 32: return EVP_aes_256_cbc();
-    default:
-      return nullptr;
-  }
-}
-
-const EVP_CIPHER* ECBGetCipherForKey(const std::string& key) {
-  switch (key.length()) {
-    case 16: return EVP_aes_128_ecb();
-    case 32: return EVP_aes_256_ecb();
-    default: return nullptr;
-  }
-}
-
-class ScopedCipherCTX {
- public:
-  explicit ScopedCipherCTX() {
-    EVP_CIPHER_CTX_init(&ctx_);
-  }
-  ~ScopedCipherCTX() {
-    EVP_CIPHER_CTX_cleanup(&ctx_);
-    crypto::ClearOpenSSLERRStack(FROM_HERE);
-  }
-  EVP_CIPHER_CTX* get() { return &ctx_; }
+const int kCounterBlockSize = 16;
 
- private:
-  EVP_CIPHER_CTX ctx_;
-};
+// EVP_CipherUpdate() takes an int length.
+const size_t kMaxUpdateSize = 1 << 30;
 
 } // namespace
 
 // CBC ECB
 bool CryptInternalNoCounter(Cipher cip,
-                            const std::string& raw_key,
+                            strings::StringPiece raw_key,
                             const EVP_CIPHER* cipher,
                             io::InputStream* in,
                             io::OutputStream* out,
@@ -77,107 +57,398 @@ bool CryptInternalNoCounter(Cipher cip,
     LOG(ERROR) << "EVP_CIPHER Empty";
     return false;
   }
-  bool do_cbc = false;
   bool do_encrypt = cip == kEncrypt ? true : false;
 
-  if (!iv.empty() && iv.size() == 16) { // CBC
-    do_cbc = true;
-    if (EVP_CIPHER_iv_length(cipher) != iv.length()) {
+  const uint8_t* iv_ptr = nullptr;
+  if (!iv.empty()) { // CBC
+    if (static_cast<size_t>(EVP_CIPHER_iv_length(cipher)) != iv.length()) {
       LOG(ERROR) << "EVP_CIPHER_iv_length != " << iv.length();
       return false;
-    } 
-  } else {
-    do_cbc = false;
+    }
+    iv_ptr = reinterpret_cast<const uint8_t*>(iv.data());
   }
 
-
   ScopedCipherCTX ctx;
   if (!EVP_CipherInit_ex(ctx.get(), cipher, nullptr,
                          reinterpret_cast<const uint8_t*>(raw_key.data()),
-                do_cbc ? reinterpret_cast<const uint8_t*>(iv.data()) : nullptr,
+                         iv_ptr,
                          do_encrypt)) {
     LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
     return false;
   }
 
-  int last_block = false;
-  while (true) {
-    char in_buffer[AES_BLOCK_SIZE] = {0};
-    char out_buffer[AES_BLOCK_SIZE * 2] = {0};
-    int in_buffer_len = 0;
+  return SslCipherStream::Crypt(ctx.get(), in, out);
+}
 
-    in_buffer_len = AES_BLOCK_SIZE;
+// CBC decryption and ECB, segment by segment on a thread pool.
+bool ParallelCryptNoCounter(Cipher cip,
+                            core::thread::ThreadPool* pool,
+                            int parallelism,
+                            strings::StringPiece raw_key,
+                            const EVP_CIPHER* cipher,
+                            io::InputStream* in,
+                            io::OutputStream* out,
+                            size_t segment_size,
+                            const std::string& iv="") {
+  CHECK(pool != nullptr);
+  CHECK_GT(parallelism, 0);
+  CHECK(segment_size > 0 && segment_size % kCounterBlockSize == 0 &&
+        segment_size <= kMaxUpdateSize);
+  if (raw_key.empty()) {
+    LOG(ERROR) << "AES Key Empty";
+    return false;
+  }
+  if (!cipher) {
+    LOG(ERROR) << "EVP_CIPHER Empty";
+    return false;
+  }
+  bool do_encrypt = cip == kEncrypt ? true : false;
+  bool chained = EVP_CIPHER_mode(cipher) == EVP_CIPH_CBC_MODE;
+  // The ciphertext block in front of the current window, i.e. the IV of
+  // its first segment. An empty CBC iv means all zeros, as in
+  // CryptInternalNoCounter().
+  std::string previous = iv;
+  if (chained && previous.empty()) {
+    previous.assign(EVP_CIPHER_iv_length(cipher), '\0');
+  }
+  if (chained &&
+      static_cast<size_t>(EVP_CIPHER_iv_length(cipher)) != previous.length()) {
+    LOG(ERROR) << "EVP_CIPHER_iv_length != " << previous.length();
+    return false;
+  }
 
-    int ret = io::IOUtil::ReadFromInput(in, (void*)in_buffer, in_buffer_len);
-    if (ret == 0) { // No input data
-      return true;
-    } else if (ret < in_buffer_len) {
-      last_block = true;
-    } else if (ret == in_buffer_len) {
-      if (!io::IOUtil::PeekInput(in)) {
-        last_block = true;
-      } 
-    }
+  SslCipherContextPool contexts(cipher, raw_key, do_encrypt, parallelism);
+  if (!contexts.ok()) {
+    return false;
+  }
 
-    uint8_t* out_ptr = reinterpret_cast<uint8_t*>(out_buffer);
-    int out_len;
-    if (!EVP_CipherUpdate(ctx.get(),
-                          out_ptr,
-                          &out_len,
-                          (const uint8_t*)in_buffer,
-                          (size_t)ret)) {
-      LOG(ERROR) << "CipherUpdate: in_buffer_len: " << ret << ", bytes ERROR";
-      return false;
+  std::vector<std::string> inputs(parallelism);
+  std::vector<std::string> outputs(parallelism);
+  std::vector<char> ok(parallelism, 0);
+
+  bool started = false;
+  bool done = false;
+  while (!done) {
+    int num_segments = 0;
+    while (num_segments < parallelism) {
+      std::string& segment = inputs[num_segments];
+      segment.resize(segment_size);
+      int size = io::IOUtil::ReadFromInput(in, &segment[0], segment_size);
+      segment.resize(size);
+      if (size > 0) {
+        num_segments++;
+      }
+      if (static_cast<size_t>(size) < segment_size) {
+        done = true;
+        break;
+      }
+    }
+    // A full window may end exactly at the end of the stream, in which case
+    // its last segment carries the padding.
+    if (!done && !io::IOUtil::PeekInput(in)) {
+      done = true;
+    }
+    if (num_segments == 0) {
+      if (started) {
+        // The stream ended after a peek said otherwise; the padding went
+        // unhandled.
+        LOG(ERROR) << "Input stream ended unexpectedly";
+        return false;
+      }
+      break;
     }
+    started = true;
 
-    int tail_len = 0;
-    if (last_block) {
-      // padding
-      if (!EVP_CipherFinal_ex(ctx.get(), out_ptr + out_len, &tail_len)) {
+    auto crypt_segment = [&](int i) {
+      ok[i] = 0;
+      const std::string& segment = inputs[i];
+      const uint8_t* segment_iv = nullptr;
+      if (chained) {
+        const std::string& prev = i == 0 ? previous : inputs[i - 1];
+        segment_iv = reinterpret_cast<const uint8_t*>(prev.data()) +
+                     prev.size() - kCounterBlockSize;
+      }
+      SslCipherContextPool::Lease ctx(&contexts, segment_iv);
+      if (!ctx.get()) {
+        return;
+      }
+      bool last = done && i == num_segments - 1;
+      EVP_CIPHER_CTX_set_padding(ctx.get(), last ? 1 : 0);
+
+      std::string& result = outputs[i];
+      result.resize(segment.size() + kCounterBlockSize);
+      uint8_t* result_ptr = reinterpret_cast<uint8_t*>(&result[0]);
+      int update_len = 0;
+      if (!EVP_CipherUpdate(ctx.get(), result_ptr, &update_len,
+                            reinterpret_cast<const uint8_t*>(segment.data()),
+                            segment.size())) {
+        LOG(ERROR) << "EVP_CipherUpdate: in_len: " << segment.size()
+                   << ", ERROR";
+        return;
+      }
+      int final_len = 0;
+      if (last &&
+          !EVP_CipherFinal_ex(ctx.get(), result_ptr + update_len, &final_len)) {
         LOG(ERROR) << "EVP_CipherFinal_ex: ERROR";
+        return;
+      }
+      result.resize(update_len + final_len);
+      ok[i] = 1;
+    };
+
+    core::BlockingCounter counter(num_segments - 1);
+    for (int i = 1; i < num_segments; ++i) {
+      pool->Schedule([&crypt_segment, &counter, i]() {
+        crypt_segment(i);
+        counter.DecrementCount();
+      });
+    }
+    crypt_segment(0);
+    counter.Wait();
+
+    for (int i = 0; i < num_segments; ++i) {
+      if (!ok[i]) {
+        return false;
+      }
+      if (!outputs[i].empty() &&
+          !io::IOUtil::WriteToOutput(out, outputs[i].data(),
+                                     outputs[i].size())) {
         return false;
       }
     }
-    
-    if (!io::IOUtil::WriteToOutput(out, out_ptr, out_len + tail_len)) {
-      return false;
+    if (chained) {
+      previous.swap(inputs[num_segments - 1]);
     }
+  }
+  return true;
+}
+
+// CTR: positions a context keyed for CTR at byte |offset| of the keystream.
+bool SeekCounterCipher(EVP_CIPHER_CTX* ctx,
+                       const std::string& iv,
+                       uint64_t offset) {
+  if (iv.size() != static_cast<size_t>(kCounterBlockSize)) {
+    LOG(ERROR) << "CTR iv must be " << kCounterBlockSize << " bytes";
+    return false;
+  }
 
-    if (last_block) { // the last block
-      return true;
+  uint8_t counter[kCounterBlockSize];
+  SslAESUtil::CTRCounterAt(iv, offset, counter);
+  if (!EVP_CipherInit_ex(ctx, nullptr, nullptr, nullptr, counter, 1)) {
+    LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
+    return false;
+  }
+
+  int skip = static_cast<int>(offset % kCounterBlockSize);
+  if (skip > 0) {
+    uint8_t junk[kCounterBlockSize] = {0};
+    int junk_len;
+    if (!EVP_CipherUpdate(ctx, junk, &junk_len, junk, skip)) {
+      LOG(ERROR) << "EVP_CipherUpdate: ERROR";
+      return false;
     }
   }
   return true;
 }
 
-bool SslAESUtil::CBCEncrypt(const std::string& raw_key,
+bool InitCounterCipher(EVP_CIPHER_CTX* ctx,
+                       strings::StringPiece raw_key,
+                       const std::string& iv,
+                       uint64_t offset) {
+  const EVP_CIPHER* cipher = SslAESUtil::CTRCipher(raw_key);
+  if (!cipher) {
+    LOG(ERROR) << "EVP_CIPHER Empty";
+    return false;
+  }
+  if (!EVP_CipherInit_ex(ctx, cipher, nullptr,
+                         reinterpret_cast<const uint8_t*>(raw_key.data()),
+                         nullptr,
+                         1)) {
+    LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
+    return false;
+  }
+  return SeekCounterCipher(ctx, iv, offset);
+}
+
+bool CryptInternalCounter(strings::StringPiece raw_key,
+                          const std::string& iv,
+                          io::InputStream* in,
+                          io::OutputStream* out) {
+  ScopedCipherCTX ctx;
+  if (!InitCounterCipher(ctx.get(), raw_key, iv, 0)) {
+    return false;
+  }
+  return SslCipherStream::Crypt(ctx.get(), in, out);
+}
+
+bool SslAESUtil::CBCEncrypt(strings::StringPiece raw_key,
                             const std::string& iv,
                             io::InputStream* in,
                             io::OutputStream* out) {
-  return CryptInternalNoCounter(kEncrypt, raw_key, CBCGetCipherForKey(raw_key), 
+  return CryptInternalNoCounter(kEncrypt, raw_key, SslAESUtil::CBCCipher(raw_key), 
                                 in, out, iv);
 }
 
-bool SslAESUtil::CBCDecrypt(const std::string& raw_key,
+bool SslAESUtil::CBCDecrypt(strings::StringPiece raw_key,
                             const std::string& iv,
                             io::InputStream* in,
                             io::OutputStream* out) {
-  return CryptInternalNoCounter(kDecrypt, raw_key, CBCGetCipherForKey(raw_key),
+  return CryptInternalNoCounter(kDecrypt, raw_key, SslAESUtil::CBCCipher(raw_key),
                                 in, out, iv);
 }
 
-bool SslAESUtil::ECBEncrypt(const std::string& raw_key,
+bool SslAESUtil::ECBEncrypt(strings::StringPiece raw_key,
                             io::InputStream* in,
                             io::OutputStream* out) {
-  return CryptInternalNoCounter(kEncrypt, raw_key, ECBGetCipherForKey(raw_key),
+  return CryptInternalNoCounter(kEncrypt, raw_key, SslAESUtil::ECBCipher(raw_key),
                                 in, out);
 }
 
-bool SslAESUtil::ECBDecrypt(const std::string& raw_key,
+bool SslAESUtil::ECBDecrypt(strings::StringPiece raw_key,
                             io::InputStream* in,
                             io::OutputStream* out) {
-  return CryptInternalNoCounter(kDecrypt, raw_key, ECBGetCipherForKey(raw_key),
+  return CryptInternalNoCounter(kDecrypt, raw_key, SslAESUtil::ECBCipher(raw_key),
                                 in, out);
 }
 
+const size_t SslAESUtil::kParallelSegmentSize;
+
+bool SslAESUtil::ParallelCBCDecrypt(core::thread::ThreadPool* pool,
+                                    int parallelism,
+                                    strings::StringPiece raw_key,
+                                    const std::string& iv,
+                                    io::InputStream* in,
+                                    io::OutputStream* out,
+                                    size_t segment_size) {
+  return ParallelCryptNoCounter(kDecrypt, pool, parallelism, raw_key,
+                                SslAESUtil::CBCCipher(raw_key),
+                                in, out, segment_size, iv);
+}
+
+bool SslAESUtil::ParallelECBEncrypt(core::thread::ThreadPool* pool,
+                                    int parallelism,
+                                    strings::StringPiece raw_key,
+                                    io::InputStream* in,
+                                    io::OutputStream* out,
+                                    size_t segment_size) {
+  return ParallelCryptNoCounter(kEncrypt, pool, parallelism, raw_key,
+                                SslAESUtil::ECBCipher(raw_key),
+                                in, out, segment_size);
+}
+
+bool SslAESUtil::ParallelECBDecrypt(core::thread::ThreadPool* pool,
+                                    int parallelism,
+                                    strings::StringPiece raw_key,
+                                    io::InputStream* in,
+                                    io::OutputStream* out,
+                                    size_t segment_size) {
+  return ParallelCryptNoCounter(kDecrypt, pool, parallelism, raw_key,
+                                SslAESUtil::ECBCipher(raw_key),
+                                in, out, segment_size);
+}
+
+bool SslAESUtil::CTREncrypt(strings::StringPiece raw_key,
+                            const std::string& iv,
+                            io::InputStream* in,
+                            io::OutputStream* out) {
+  return CryptInternalCounter(raw_key, iv, in, out);
+}
+
+bool SslAESUtil::CTRDecrypt(strings::StringPiece raw_key,
+                            const std::string& iv,
+                            io::InputStream* in,
+                            io::OutputStream* out) {
+  return CryptInternalCounter(raw_key, iv, in, out);
+}
+
+bool SslAESUtil::CTRCryptAt(strings::StringPiece raw_key,
+                            const std::string& iv,
+                            uint64_t offset,
+                            const void* in,
+                            size_t length,
+                            void* out) {
+  ScopedCipherCTX ctx;
+  if (!InitCounterCipher(ctx.get(), raw_key, iv, 0)) {
+    return false;
+  }
+  return CTRCryptAt(ctx.get(), iv, offset, in, length, out);
+}
+
+bool SslAESUtil::CTRCryptAt(EVP_CIPHER_CTX* ctx,
+                            const std::string& iv,
+                            uint64_t offset,
+                            const void* in,
+                            size_t length,
+                            void* out) {
+  if (!SeekCounterCipher(ctx, iv, offset)) {
+    return false;
+  }
+
+  const uint8_t* in_ptr = reinterpret_cast<const uint8_t*>(in);
+  uint8_t* out_ptr = reinterpret_cast<uint8_t*>(out);
+  while (length > 0) {
+    int chunk = static_cast<int>(std::min(length, kMaxUpdateSize));
+    int out_len;
+    if (!EVP_CipherUpdate(ctx, out_ptr, &out_len, in_ptr, chunk)) {
+      LOG(ERROR) << "EVP_CipherUpdate: in_len: " << chunk << ", ERROR";
+      return false;
+    }
+    in_ptr += chunk;
+    out_ptr += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+void SslAESUtil::CTRCounterAt(const std::string& iv,
+                              uint64_t offset,
+                              uint8_t* counter) {
+  DCHECK_EQ(iv.size(), static_cast<size_t>(kCounterBlockSize));
+  memcpy(counter, iv.data(), kCounterBlockSize);
+
+  // 128-bit big-endian addition of the block index.
+  uint64_t carry = offset / kCounterBlockSize;
+  for (int i = kCounterBlockSize - 1; i >= 0 && carry != 0; --i) {
+    uint64_t sum = counter[i] + (carry & 0xff);
+    counter[i] = static_cast<uint8_t>(sum);
+    carry = (carry >> 8) + (sum >> 8);
+  }
+}
+
+// static
+const EVP_CIPHER* SslAESUtil::CBCCipher(strings::StringPiece raw_key) {
+  switch (raw_key.length()) {
+    case 16: return EVP_aes_128_cbc();
+    case 32: return EVP_aes_256_cbc();
+    default: return nullptr;
+  }
+}
+
+// static
+const EVP_CIPHER* SslAESUtil::ECBCipher(strings::StringPiece raw_key) {
+  switch (raw_key.length()) {
+    case 16: return EVP_aes_128_ecb();
+    case 32: return EVP_aes_256_ecb();
+    default: return nullptr;
+  }
+}
+
+// static
+const EVP_CIPHER* SslAESUtil::CTRCipher(strings::StringPiece raw_key) {
+  switch (raw_key.length()) {
+    case 16: return EVP_aes_128_ctr();
+    case 32: return EVP_aes_256_ctr();
+    default: return nullptr;
+  }
+}
+
+// static
+const EVP_CIPHER* SslAESUtil::GCMCipher(strings::StringPiece raw_key) {
+  switch (raw_key.length()) {
+    case 16: return EVP_aes_128_gcm();
+    case 32: return EVP_aes_256_gcm();
+    default: return nullptr;
+  }
+}
+
 } // namespace crypto
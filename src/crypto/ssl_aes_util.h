@@ -2,36 +2,113 @@
 #define CRYPTO_SSL_AES_UTIL_H_
 
 #include "base/macros.h"
+#include "strings/string_piece.h"
 
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
 
+#include "third_party/boringssl/include/openssl/evp.h"
+
 namespace io {
 class InputStream;
 class OutputStream;
 } // namespace io
 
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
 namespace crypto {
 
 class SslAESUtil {
  public:
-  static bool CBCEncrypt(const std::string& raw_key,
+  static bool CBCEncrypt(strings::StringPiece raw_key,
                          const std::string& iv,
                          io::InputStream* in,
                          io::OutputStream* out);
-  static bool CBCDecrypt(const std::string& raw_key,
+  static bool CBCDecrypt(strings::StringPiece raw_key,
                          const std::string& iv,
                          io::InputStream* in,
                          io::OutputStream* out);
 
-  static bool ECBEncrypt(const std::string& raw_key,
+  static bool ECBEncrypt(strings::StringPiece raw_key,
+                         io::InputStream* in,
+                         io::OutputStream* out);
+  static bool ECBDecrypt(strings::StringPiece raw_key,
+                         io::InputStream* in,
+                         io::OutputStream* out);
+
+  // Multi-threaded variants of the modes whose blocks do not depend on the
+  // previous output. The input is read in windows of |parallelism|
+  // segments of |segment_size| bytes (a multiple of 16); the segments of a
+  // window are processed concurrently on |pool| and written to |out| in
+  // order. Only the final segment deals with padding, so the output is
+  // identical to the single-threaded functions above.
+  static const size_t kParallelSegmentSize = 1 << 20;
+
+  static bool ParallelCBCDecrypt(core::thread::ThreadPool* pool,
+                                 int parallelism,
+                                 strings::StringPiece raw_key,
+                                 const std::string& iv,
+                                 io::InputStream* in,
+                                 io::OutputStream* out,
+                                 size_t segment_size = kParallelSegmentSize);
+  static bool ParallelECBEncrypt(core::thread::ThreadPool* pool,
+                                 int parallelism,
+                                 strings::StringPiece raw_key,
+                                 io::InputStream* in,
+                                 io::OutputStream* out,
+                                 size_t segment_size = kParallelSegmentSize);
+  static bool ParallelECBDecrypt(core::thread::ThreadPool* pool,
+                                 int parallelism,
+                                 strings::StringPiece raw_key,
+                                 io::InputStream* in,
+                                 io::OutputStream* out,
+                                 size_t segment_size = kParallelSegmentSize);
+
+  // CTR. |iv| is the initial 128-bit big-endian counter block; the
+  // keystream for byte |offset| of the stream only depends on |iv| and
+  // |offset|, so any range can be processed on its own.
+  static bool CTREncrypt(strings::StringPiece raw_key,
+                         const std::string& iv,
                          io::InputStream* in,
                          io::OutputStream* out);
-  static bool ECBDecrypt(const std::string& raw_key,
+  static bool CTRDecrypt(strings::StringPiece raw_key,
+                         const std::string& iv,
                          io::InputStream* in,
                          io::OutputStream* out);
+  // XORs the keystream for stream bytes [offset, offset + length) into
+  // |in| and stores the result in |out|. |in| may equal |out|.
+  static bool CTRCryptAt(strings::StringPiece raw_key,
+                         const std::string& iv,
+                         uint64_t offset,
+                         const void* in,
+                         size_t length,
+                         void* out);
+  // Same as above on a context keyed with CTRCipher(), e.g. one handed out
+  // by SslCipherContextPool. Only the counter is reset.
+  static bool CTRCryptAt(EVP_CIPHER_CTX* ctx,
+                         const std::string& iv,
+                         uint64_t offset,
+                         const void* in,
+                         size_t length,
+                         void* out);
+  // Stores the counter block for byte |offset| of the stream in
+  // |counter|, which must hold 16 bytes.
+  static void CTRCounterAt(const std::string& iv,
+                           uint64_t offset,
+                           uint8_t* counter);
+
+  // The EVP ciphers for |raw_key|'s length, nullptr unless it is 128 or
+  // 256 bits long.
+  static const EVP_CIPHER* CBCCipher(strings::StringPiece raw_key);
+  static const EVP_CIPHER* ECBCipher(strings::StringPiece raw_key);
+  static const EVP_CIPHER* CTRCipher(strings::StringPiece raw_key);
+  static const EVP_CIPHER* GCMCipher(strings::StringPiece raw_key);
 
-  // TODO(wqx):
-  // CTR
  private:
   SslAESUtil() = delete;
   DISALLOW_COPY_AND_ASSIGN(SslAESUtil);
@@ -1,30 +1,55 @@
 #include "crypto/ssl_cbc_aes_encryptor.h"
 #include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_cipher_stream.h"
 
 #include <memory>
 #include <glog/logging.h>
 
 namespace crypto {
 
-SslCbcAESEncryptor::SslCbcAESEncryptor(const std::string& raw_key,
+SslCbcAESEncryptor::SslCbcAESEncryptor(strings::StringPiece raw_key,
                                        const std::string& iv)
     : iv_(iv),
-      key_(AESKey::FromBytesBuffer(raw_key.data(), raw_key.size())) {
+      encrypt_pool_(SslAESUtil::CBCCipher(raw_key), raw_key, true),
+      decrypt_pool_(SslAESUtil::CBCCipher(raw_key), raw_key, false) {
 }
 
 SslCbcAESEncryptor::~SslCbcAESEncryptor() {}
 
 base::Status SslCbcAESEncryptor::Encrypt(io::InputStream* in,
                                          io::OutputStream* out) {
-  if (SslAESUtil::CBCEncrypt(key_->raw_key(), iv_, in, out)) {
-    return base::Status::OK;
-  }
-  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+  return Crypt(&encrypt_pool_, iv_, in, out);
 }
 
 base::Status SslCbcAESEncryptor::Decrypt(io::InputStream* in,
                                          io::OutputStream* out) {
-  if (SslAESUtil::CBCDecrypt(key_->raw_key(), iv_, in, out)) {
+  return Crypt(&decrypt_pool_, iv_, in, out);
+}
+
+base::Status SslCbcAESEncryptor::EncryptRecord(const AESBatchRecord& record) {
+  return Crypt(&encrypt_pool_, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status SslCbcAESEncryptor::DecryptRecord(const AESBatchRecord& record) {
+  return Crypt(&decrypt_pool_, record.iv.empty() ? iv_ : record.iv,
+               record.input, record.output);
+}
+
+base::Status SslCbcAESEncryptor::Crypt(SslCipherContextPool* pool,
+                                       const std::string& iv,
+                                       io::InputStream* in,
+                                       io::OutputStream* out) {
+  if (!iv.empty() && iv.size() != 16) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CBC iv must be 16 bytes");
+  }
+  // Pooled contexts remember the last IV they were given, so an empty one
+  // has to be spelled out.
+  static const uint8_t kZeroIV[16] = {0};
+  SslCipherContextPool::Lease ctx(pool,
+      iv.empty() ? kZeroIV : reinterpret_cast<const uint8_t*>(iv.data()));
+  if (ctx.get() && SslCipherStream::Crypt(ctx.get(), in, out)) {
     return base::Status::OK;
   }
   return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
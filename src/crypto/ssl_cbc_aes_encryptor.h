@@ -4,14 +4,19 @@
 #include "base/macros.h"
 #include "crypto/aes_key.h"
 #include "crypto/aes_encryptor.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "strings/string_piece.h"
 
 #include <string>
 
 namespace crypto {
 
+// The key is expanded once per direction when the encryptor is built; each
+// call leases a keyed context from a pool and only resets its IV, so one
+// encryptor can serve many concurrent callers.
 class SslCbcAESEncryptor : public AESEncryptor {
  public:
-  SslCbcAESEncryptor(const std::string& raw_key, const std::string& iv);
+  SslCbcAESEncryptor(strings::StringPiece raw_key, const std::string& iv);
   virtual ~SslCbcAESEncryptor() override;
 
   // From AESEncryptor;
@@ -20,9 +25,22 @@ class SslCbcAESEncryptor : public AESEncryptor {
   virtual base::Status Decrypt(io::InputStream* input,
                                io::OutputStream* output) override;
 
+ protected:
+  // From AESEncryptor
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
  private:
+  base::Status Crypt(SslCipherContextPool* pool,
+                     const std::string& iv,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
   std::string iv_;
-  std::unique_ptr<AESKey> key_;
+  SslCipherContextPool encrypt_pool_;
+  SslCipherContextPool decrypt_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslCbcAESEncryptor);
 };
 
 } // namespace crypto
@@ -0,0 +1,101 @@
+#include "crypto/ssl_cipher_context_pool.h"
+#include "crypto/openssl_util.h"
+
+#include "base/location.h"
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+SslCipherContextPool::SslCipherContextPool(const EVP_CIPHER* cipher,
+                                           strings::StringPiece raw_key,
+                                           bool do_encrypt,
+                                           size_t max_idle)
+    : keyed_(nullptr),
+      max_idle_(max_idle) {
+  if (!cipher) {
+    LOG(ERROR) << "EVP_CIPHER Empty";
+    return;
+  }
+  if (raw_key.size() != static_cast<size_t>(EVP_CIPHER_key_length(cipher))) {
+    LOG(ERROR) << "EVP_CIPHER_key_length != " << raw_key.size();
+    return;
+  }
+  keyed_ = EVP_CIPHER_CTX_new();
+  if (!EVP_CipherInit_ex(keyed_, cipher, nullptr,
+                         reinterpret_cast<const uint8_t*>(raw_key.data()),
+                         nullptr,
+                         do_encrypt)) {
+    LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
+    EVP_CIPHER_CTX_free(keyed_);
+    keyed_ = nullptr;
+    ClearOpenSSLERRStack(FROM_HERE);
+  }
+}
+
+SslCipherContextPool::~SslCipherContextPool() {
+  for (EVP_CIPHER_CTX* ctx : idle_) {
+    EVP_CIPHER_CTX_free(ctx);
+  }
+  if (keyed_) {
+    EVP_CIPHER_CTX_free(keyed_);
+  }
+}
+
+EVP_CIPHER_CTX* SslCipherContextPool::Acquire() {
+  if (!keyed_) {
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    if (!idle_.empty()) {
+      EVP_CIPHER_CTX* ctx = idle_.back();
+      idle_.pop_back();
+      return ctx;
+    }
+  }
+  // Copying carries the key schedule over instead of expanding it again.
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  if (!EVP_CIPHER_CTX_copy(ctx, keyed_)) {
+    LOG(ERROR) << "EVP_CIPHER_CTX_copy: ERROR";
+    EVP_CIPHER_CTX_free(ctx);
+    return nullptr;
+  }
+  return ctx;
+}
+
+void SslCipherContextPool::Release(EVP_CIPHER_CTX* ctx) {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    if (idle_.size() < max_idle_) {
+      idle_.push_back(ctx);
+      return;
+    }
+  }
+  EVP_CIPHER_CTX_free(ctx);
+}
+
+SslCipherContextPool::Lease::Lease(SslCipherContextPool* pool,
+                                   const uint8_t* iv,
+                                   int do_encrypt)
+    : pool_(pool),
+      ctx_(pool->Acquire()) {
+  if (!ctx_) {
+    return;
+  }
+  // Keeps the key; resets the IV and any buffered block.
+  if (!EVP_CipherInit_ex(ctx_, nullptr, nullptr, nullptr, iv, do_encrypt)) {
+    LOG(ERROR) << "EVP_CipherInit_ex: ERROR";
+    pool_->Release(ctx_);
+    ctx_ = nullptr;
+  }
+}
+
+SslCipherContextPool::Lease::~Lease() {
+  if (ctx_) {
+    pool_->Release(ctx_);
+  }
+  ClearOpenSSLERRStack(FROM_HERE);
+}
+
+} // namespace crypto
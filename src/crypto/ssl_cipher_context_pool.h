@@ -0,0 +1,66 @@
+#ifndef CRYPTO_SSL_CIPHER_CONTEXT_POOL_H_
+#define CRYPTO_SSL_CIPHER_CONTEXT_POOL_H_
+
+#include "base/macros.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "third_party/boringssl/include/openssl/evp.h"
+
+namespace crypto {
+
+// A set of EVP cipher contexts that all carry the same expanded key.
+//
+// The key schedule is computed once, in the constructor. Every Lease hands
+// out an idle context (or a copy of the keyed one when all are busy) whose
+// IV and cipher state have been reset, and gives it back to the pool when
+// it goes out of scope, so concurrent callers can share one encryptor.
+class SslCipherContextPool {
+ public:
+  // Keeps at most |max_idle| contexts around between calls.
+  SslCipherContextPool(const EVP_CIPHER* cipher,
+                       strings::StringPiece raw_key,
+                       bool do_encrypt,
+                       size_t max_idle = 16);
+  ~SslCipherContextPool();
+
+  // False when the cipher or the key was rejected.
+  bool ok() const { return keyed_ != nullptr; }
+
+  class Lease {
+   public:
+    // Resets the context to |iv| (may be null) and to |do_encrypt|, where
+    // -1 keeps the direction the pool was built with.
+    Lease(SslCipherContextPool* pool, const uint8_t* iv, int do_encrypt = -1);
+    ~Lease();
+
+    // nullptr when no context could be prepared.
+    EVP_CIPHER_CTX* get() const { return ctx_; }
+
+   private:
+    SslCipherContextPool* pool_;
+    EVP_CIPHER_CTX* ctx_;
+
+    DISALLOW_COPY_AND_ASSIGN(Lease);
+  };
+
+ private:
+  EVP_CIPHER_CTX* Acquire();
+  void Release(EVP_CIPHER_CTX* ctx);
+
+  EVP_CIPHER_CTX* keyed_;
+  const size_t max_idle_;
+
+  std::mutex mu_;
+  std::vector<EVP_CIPHER_CTX*> idle_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslCipherContextPool);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_CIPHER_CONTEXT_POOL_H_
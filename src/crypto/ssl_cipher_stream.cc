@@ -0,0 +1,176 @@
+#include "crypto/ssl_cipher_stream.h"
+#include "crypto/openssl_util.h"
+
+#include "base/location.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+// Used only when the output stream hands out less than two blocks at once.
+const int kBounceBufferSize = 4096;
+
+} // namespace
+
+ScopedCipherCTX::ScopedCipherCTX()
+    : ctx_(EVP_CIPHER_CTX_new()) {
+  CHECK(ctx_ != nullptr);
+}
+
+ScopedCipherCTX::~ScopedCipherCTX() {
+  EVP_CIPHER_CTX_free(ctx_);
+  ClearOpenSSLERRStack(FROM_HERE);
+}
+
+// static
+bool SslCipherStream::Crypt(EVP_CIPHER_CTX* ctx,
+                            io::InputStream* in,
+                            io::OutputStream* out) {
+  int64_t bytes_read = 0;
+  if (!UpdateAll(ctx, in, out, &bytes_read)) {
+    return false;
+  }
+  if (bytes_read == 0) { // No input data
+    return true;
+  }
+  return Final(ctx, out);
+}
+
+// static
+bool SslCipherStream::UpdateAll(EVP_CIPHER_CTX* ctx,
+                                io::InputStream* in,
+                                io::OutputStream* out,
+                                int64_t* bytes_read) {
+  *bytes_read = 0;
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    if (size <= 0) {
+      continue;
+    }
+    if (!Update(ctx, data, size, out)) {
+      return false;
+    }
+    *bytes_read += size;
+  }
+  return true;
+}
+
+// static
+bool SslCipherStream::UpdateAllButTrailer(EVP_CIPHER_CTX* ctx,
+                                          io::InputStream* in,
+                                          io::OutputStream* out,
+                                          uint8_t* trailer,
+                                          int trailer_size) {
+  // |trailer| always holds the last |held| bytes seen so far.
+  int held = 0;
+  const void* data;
+  int size;
+  while (in->Next(&data, &size)) {
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(data);
+    if (held + size <= trailer_size) {
+      memcpy(trailer + held, ptr, size);
+      held += size;
+      continue;
+    }
+
+    // Everything but the last |trailer_size| bytes is released, oldest
+    // (the held bytes) first.
+    int release = held + size - trailer_size;
+    int from_held = std::min(held, release);
+    if (from_held > 0) {
+      if (!Update(ctx, trailer, from_held, out)) {
+        return false;
+      }
+      memmove(trailer, trailer + from_held, held - from_held);
+      held -= from_held;
+    }
+    int from_chunk = release - from_held;
+    if (from_chunk > 0 && !Update(ctx, ptr, from_chunk, out)) {
+      return false;
+    }
+    memcpy(trailer + held, ptr + from_chunk, size - from_chunk);
+    held += size - from_chunk;
+  }
+  if (held != trailer_size) {
+    LOG(ERROR) << "Input is shorter than its " << trailer_size
+               << " bytes trailer";
+    return false;
+  }
+  return true;
+}
+
+// static
+bool SslCipherStream::Update(EVP_CIPHER_CTX* ctx,
+                             const void* data,
+                             int size,
+                             io::OutputStream* out) {
+  // EVP_CipherUpdate() may emit up to one block more than it consumes.
+  const int slack = EVP_CIPHER_CTX_block_size(ctx);
+  const uint8_t* in_ptr = reinterpret_cast<const uint8_t*>(data);
+  int remaining = size;
+
+  while (remaining > 0) {
+    void* out_data;
+    int out_size;
+    if (!out->Next(&out_data, &out_size)) {
+      return false;
+    }
+
+    int in_len;
+    int out_len = 0;
+    if (out_size >= 2 * slack) {
+      in_len = std::min(remaining, out_size - slack);
+      if (!EVP_CipherUpdate(ctx,
+                            reinterpret_cast<uint8_t*>(out_data),
+                            &out_len,
+                            in_ptr,
+                            in_len)) {
+        LOG(ERROR) << "EVP_CipherUpdate: in_len: " << in_len << ", ERROR";
+        out->BackUp(out_size);
+        return false;
+      }
+      out->BackUp(out_size - out_len);
+    } else {
+      out->BackUp(out_size);
+      uint8_t bounce[kBounceBufferSize + EVP_MAX_BLOCK_LENGTH];
+      in_len = std::min(remaining, kBounceBufferSize);
+      if (!EVP_CipherUpdate(ctx, bounce, &out_len, in_ptr, in_len)) {
+        LOG(ERROR) << "EVP_CipherUpdate: in_len: " << in_len << ", ERROR";
+        return false;
+      }
+      if (!io::IOUtil::WriteToOutput(out, bounce, out_len)) {
+        return false;
+      }
+    }
+    in_ptr += in_len;
+    remaining -= in_len;
+  }
+  return true;
+}
+
+// static
+bool SslCipherStream::Final(EVP_CIPHER_CTX* ctx, io::OutputStream* out) {
+  uint8_t tail[EVP_MAX_BLOCK_LENGTH];
+  int tail_len = 0;
+  if (!EVP_CipherFinal_ex(ctx, tail, &tail_len)) {
+    LOG(ERROR) << "EVP_CipherFinal_ex: ERROR";
+    return false;
+  }
+  if (tail_len == 0) {
+    return true;
+  }
+  return io::IOUtil::WriteToOutput(out, tail, tail_len);
+}
+
+} // namespace crypto
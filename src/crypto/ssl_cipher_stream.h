@@ -0,0 +1,76 @@
+#ifndef CRYPTO_SSL_CIPHER_STREAM_H_
+#define CRYPTO_SSL_CIPHER_STREAM_H_
+
+#include "base/macros.h"
+
+#include <stdint.h>
+
+#include "third_party/boringssl/include/openssl/evp.h"
+
+namespace io {
+class InputStream;
+class OutputStream;
+} // namespace io
+
+namespace crypto {
+
+class ScopedCipherCTX {
+ public:
+  ScopedCipherCTX();
+  ~ScopedCipherCTX();
+
+  EVP_CIPHER_CTX* get() { return ctx_; }
+
+ private:
+  EVP_CIPHER_CTX* ctx_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedCipherCTX);
+};
+
+// Drives an initialised EVP cipher context over a pair of zero-copy streams.
+//
+// Every buffer returned by |in->Next()| is handed to EVP_CipherUpdate() in
+// one piece and the result is written straight into the buffer returned by
+// |out->Next()|; the partial-block tail is carried across chunks by the
+// cipher context itself. Only when the output stream hands out a buffer too
+// small to hold a block of slack does the data go through a bounce buffer.
+class SslCipherStream {
+ public:
+  // Runs |ctx| over all of |in| and finishes with EVP_CipherFinal_ex().
+  // An empty input produces an empty output.
+  static bool Crypt(EVP_CIPHER_CTX* ctx,
+                    io::InputStream* in,
+                    io::OutputStream* out);
+
+  // Feeds all of |in| through EVP_CipherUpdate() into |out| without
+  // finishing the cipher. |*bytes_read| receives the input length.
+  static bool UpdateAll(EVP_CIPHER_CTX* ctx,
+                        io::InputStream* in,
+                        io::OutputStream* out,
+                        int64_t* bytes_read);
+
+  // Like UpdateAll(), but keeps the last |trailer_size| bytes of |in| (an
+  // AEAD tag, say) out of the cipher and copies them to |trailer|. Fails if
+  // |in| is shorter than |trailer_size|.
+  static bool UpdateAllButTrailer(EVP_CIPHER_CTX* ctx,
+                                  io::InputStream* in,
+                                  io::OutputStream* out,
+                                  uint8_t* trailer,
+                                  int trailer_size);
+
+  // Feeds |size| bytes from |data| through EVP_CipherUpdate() into |out|.
+  static bool Update(EVP_CIPHER_CTX* ctx,
+                     const void* data,
+                     int size,
+                     io::OutputStream* out);
+
+  // Flushes the final (padded) block of |ctx| into |out|.
+  static bool Final(EVP_CIPHER_CTX* ctx, io::OutputStream* out);
+
+ private:
+  SslCipherStream() = delete;
+  DISALLOW_COPY_AND_ASSIGN(SslCipherStream);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_CIPHER_STREAM_H_
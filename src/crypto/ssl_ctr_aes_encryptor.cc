@@ -0,0 +1,116 @@
+#include "crypto/ssl_ctr_aes_encryptor.h"
+#include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_cipher_stream.h"
+
+#include "system/blocking_counter.h"
+#include "system/threadpool.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kCounterBlockSize = 16;
+const size_t kRangeAlignment = 16;
+
+} // namespace
+
+SslCtrAESEncryptor::SslCtrAESEncryptor(strings::StringPiece raw_key,
+                                       const std::string& iv)
+    : iv_(iv),
+      pool_(SslAESUtil::CTRCipher(raw_key), raw_key, true) {
+  DCHECK(!raw_key.empty());
+}
+
+SslCtrAESEncryptor::~SslCtrAESEncryptor() {}
+
+base::Status SslCtrAESEncryptor::Encrypt(io::InputStream* in,
+                                         io::OutputStream* out) {
+  if (iv_.size() != kCounterBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "CTR iv must be 16 bytes");
+  }
+  // The counter block for offset 0 is the iv itself.
+  SslCipherContextPool::Lease ctx(&pool_,
+                                  reinterpret_cast<const uint8_t*>(iv_.data()));
+  if (ctx.get() && SslCipherStream::Crypt(ctx.get(), in, out)) {
+    return base::Status::OK;
+  }
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+base::Status SslCtrAESEncryptor::Decrypt(io::InputStream* in,
+                                         io::OutputStream* out) {
+  return Encrypt(in, out);
+}
+
+base::Status SslCtrAESEncryptor::EncryptRange(uint64_t offset,
+                                              const void* input,
+                                              size_t length,
+                                              void* output) {
+  SslCipherContextPool::Lease ctx(&pool_, nullptr);
+  if (ctx.get() && SslAESUtil::CTRCryptAt(ctx.get(), iv_, offset,
+                                          input, length, output)) {
+    return base::Status::OK;
+  }
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+base::Status SslCtrAESEncryptor::DecryptRange(uint64_t offset,
+                                              const void* input,
+                                              size_t length,
+                                              void* output) {
+  return EncryptRange(offset, input, length, output);
+}
+
+base::Status SslCtrAESEncryptor::ParallelCrypt(
+    core::thread::ThreadPool* pool,
+    int num_ranges,
+    const void* input,
+    size_t length,
+    void* output) {
+  CHECK(pool != nullptr);
+  CHECK_GT(num_ranges, 0);
+
+  size_t range_size = (length + num_ranges - 1) / num_ranges;
+  range_size = (range_size + kRangeAlignment - 1) / kRangeAlignment
+               * kRangeAlignment;
+  if (range_size == 0 || num_ranges == 1) {
+    return EncryptRange(0, input, length, output);
+  }
+  num_ranges = static_cast<int>((length + range_size - 1) / range_size);
+
+  const uint8_t* in_ptr = reinterpret_cast<const uint8_t*>(input);
+  uint8_t* out_ptr = reinterpret_cast<uint8_t*>(output);
+  std::vector<char> ok(num_ranges, 0);
+
+  auto crypt_range = [&](int i) {
+    size_t offset = i * range_size;
+    size_t len = std::min(range_size, length - offset);
+    ok[i] = EncryptRange(offset, in_ptr + offset, len, out_ptr + offset).ok();
+  };
+
+  core::BlockingCounter counter(num_ranges - 1);
+  for (int i = 1; i < num_ranges; ++i) {
+    pool->Schedule([&crypt_range, &counter, i]() {
+      crypt_range(i);
+      counter.DecrementCount();
+    });
+  }
+  crypt_range(0);
+  counter.Wait();
+
+  for (int i = 0; i < num_ranges; ++i) {
+    if (!ok[i]) {
+      return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+    }
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
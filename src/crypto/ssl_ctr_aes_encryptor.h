@@ -0,0 +1,69 @@
+#ifndef CRYPTO_SSL_CTR_AES_ENCRYPTOR_H_
+#define CRYPTO_SSL_CTR_AES_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_key.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// AES-CTR. Encryption and decryption are the same operation, and the
+// keystream at any byte offset can be computed directly, so besides the
+// streaming AESEncryptor interface a range of the stream can be processed
+// without touching its prefix. The key is expanded once; calls lease keyed
+// contexts from a pool and only move the counter.
+class SslCtrAESEncryptor : public AESEncryptor {
+ public:
+  // |iv| is the 16-byte initial counter block.
+  SslCtrAESEncryptor(strings::StringPiece raw_key, const std::string& iv);
+  virtual ~SslCtrAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // Encrypts |length| bytes of plaintext that sit at byte |offset| of the
+  // stream.
+  base::Status EncryptRange(uint64_t offset,
+                            const void* input,
+                            size_t length,
+                            void* output);
+  // Decrypts |length| bytes of ciphertext that sit at byte |offset| of the
+  // stream, without touching the bytes before |offset|.
+  base::Status DecryptRange(uint64_t offset,
+                            const void* input,
+                            size_t length,
+                            void* output);
+
+  // Splits the buffer into |num_ranges| block-aligned ranges and processes
+  // them concurrently on |pool|. The result is identical to Encrypt() (or
+  // Decrypt()) over the whole buffer. |input| may equal |output|.
+  base::Status ParallelCrypt(core::thread::ThreadPool* pool,
+                             int num_ranges,
+                             const void* input,
+                             size_t length,
+                             void* output);
+
+ private:
+  std::string iv_;
+  SslCipherContextPool pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslCtrAESEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_CTR_AES_ENCRYPTOR_H_
@@ -1,12 +1,14 @@
 #include "crypto/ssl_ecb_aes_encryptor.h"
 #include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_cipher_stream.h"
 
 #include <glog/logging.h>
 
 namespace crypto {
 
-SslEcbAESEncryptor::SslEcbAESEncryptor(const std::string& raw_key)
-    : key_(AESKey::FromBytesBuffer(raw_key.data(), raw_key.length())) {
+SslEcbAESEncryptor::SslEcbAESEncryptor(strings::StringPiece raw_key)
+    : encrypt_pool_(SslAESUtil::ECBCipher(raw_key), raw_key, true),
+      decrypt_pool_(SslAESUtil::ECBCipher(raw_key), raw_key, false) {
   DCHECK(!raw_key.empty());
 }
 
@@ -14,19 +16,22 @@ SslEcbAESEncryptor::~SslEcbAESEncryptor() {}
 
 base::Status SslEcbAESEncryptor::Encrypt(io::InputStream* input,
                                          io::OutputStream* output) {
-  if (SslAESUtil::ECBEncrypt(key_->raw_key(), input, output)) {
-    return base::Status::OK;
-  }
-  return base::Status(base::error::INTERNAL, "Maybe Error occur in SSL");
+  return Crypt(&encrypt_pool_, input, output);
 }
 
 base::Status SslEcbAESEncryptor::Decrypt(io::InputStream* input,
                                          io::OutputStream* output) {
-  if (SslAESUtil::ECBDecrypt(key_->raw_key(), input, output)) {
+  return Crypt(&decrypt_pool_, input, output);
+}
+
+base::Status SslEcbAESEncryptor::Crypt(SslCipherContextPool* pool,
+                                       io::InputStream* input,
+                                       io::OutputStream* output) {
+  SslCipherContextPool::Lease ctx(pool, nullptr);
+  if (ctx.get() && SslCipherStream::Crypt(ctx.get(), input, output)) {
     return base::Status::OK;
   }
   return base::Status(base::error::INTERNAL, "Maybe Error occur in SSL");
 }
 
-
 } // namespace crypto
@@ -4,6 +4,8 @@
 #include "base/macros.h"
 #include "crypto/aes_key.h"
 #include "crypto/aes_encryptor.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "strings/string_piece.h"
 
 #include <string>
 
@@ -11,7 +13,7 @@ namespace crypto {
 
 class SslEcbAESEncryptor : public AESEncryptor {
  public:
-  SslEcbAESEncryptor(const std::string& raw_key);
+  SslEcbAESEncryptor(strings::StringPiece raw_key);
   virtual ~SslEcbAESEncryptor() override;
 
   // From AESEncryptor   
@@ -21,7 +23,14 @@ class SslEcbAESEncryptor : public AESEncryptor {
                                io::OutputStream* output) override;
 
  private:
-  std::unique_ptr<AESKey> key_;
+  base::Status Crypt(SslCipherContextPool* pool,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  SslCipherContextPool encrypt_pool_;
+  SslCipherContextPool decrypt_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslEcbAESEncryptor);
 };
 
 } // namespace crypto
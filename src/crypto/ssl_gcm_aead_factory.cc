@@ -0,0 +1,37 @@
+#include "crypto/aead_factory.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
+
+namespace crypto {
+
+class SslGcmAEADFactory : public AEADFactory {
+ public:
+  SslGcmAEADFactory() {}
+  virtual ~SslGcmAEADFactory() override {}
+
+  // From AEADFactory
+  virtual std::unique_ptr<AESEncryptor> Create(std::unique_ptr<AESKey>& key,
+                                               const std::string& iv,
+                                               const std::string& aad) override {
+    std::unique_ptr<SslGcmAESEncryptor> ret(new SslGcmAESEncryptor(key->key(), iv, aad));
+    return std::move(ret);
+  }
+
+  virtual bool AcceptsOptions(const std::string& aead_type) override {
+    return aead_type == "aes_gcm";
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SslGcmAEADFactory);
+};
+
+namespace { // register
+
+class SslGcmAEADRegistrar {
+ public:
+  SslGcmAEADRegistrar() {
+    AEADFactory::Register("aes_gcm", new SslGcmAEADFactory());
+  }
+};
+static SslGcmAEADRegistrar registrar;
+} // namespace
+} // namespace crypto
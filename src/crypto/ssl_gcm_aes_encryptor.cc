@@ -0,0 +1,138 @@
+#include "crypto/ssl_gcm_aes_encryptor.h"
+#include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_cipher_stream.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include <stdint.h>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+base::Status SslError() {
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+} // namespace
+
+const int SslGcmAESEncryptor::kNonceSize;
+const int SslGcmAESEncryptor::kTagSize;
+
+SslGcmAESEncryptor::SslGcmAESEncryptor(strings::StringPiece raw_key,
+                                       const std::string& iv,
+                                       const std::string& aad)
+    : iv_(iv),
+      iv_used_(false),
+      aad_(aad),
+      pool_(SslAESUtil::GCMCipher(raw_key), raw_key, true) {
+  LOG_IF(ERROR, iv_.size() != static_cast<size_t>(kNonceSize))
+      << "GCM nonce must be " << kNonceSize << " bytes";
+}
+
+SslGcmAESEncryptor::~SslGcmAESEncryptor() {}
+
+bool SslGcmAESEncryptor::AddAAD(EVP_CIPHER_CTX* ctx) {
+  if (aad_.empty()) {
+    return true;
+  }
+  int aad_len;
+  if (!EVP_CipherUpdate(ctx, nullptr, &aad_len,
+                        reinterpret_cast<const uint8_t*>(aad_.data()),
+                        aad_.size())) {
+    LOG(ERROR) << "EVP_CipherUpdate(aad): ERROR";
+    return false;
+  }
+  return true;
+}
+
+base::Status SslGcmAESEncryptor::Encrypt(io::InputStream* in,
+                                         io::OutputStream* out) {
+  if (iv_used_.exchange(true)) {
+    return base::Status(base::error::FAILED_PRECONDITION,
+                        "GCM nonce already used; pass a fresh one");
+  }
+  return Encrypt(iv_, in, out);
+}
+
+base::Status SslGcmAESEncryptor::Decrypt(io::InputStream* in,
+                                         io::OutputStream* out) {
+  return Decrypt(iv_, in, out);
+}
+
+base::Status SslGcmAESEncryptor::EncryptRecord(const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Encrypt(record.input, record.output);
+  }
+  return Encrypt(record.iv, record.input, record.output);
+}
+
+base::Status SslGcmAESEncryptor::DecryptRecord(const AESBatchRecord& record) {
+  if (record.iv.empty()) {
+    return Decrypt(record.input, record.output);
+  }
+  return Decrypt(record.iv, record.input, record.output);
+}
+
+base::Status SslGcmAESEncryptor::Encrypt(const std::string& nonce,
+                                         io::InputStream* in,
+                                         io::OutputStream* out) {
+  if (nonce.size() != static_cast<size_t>(kNonceSize)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "GCM nonce must be 12 bytes");
+  }
+  SslCipherContextPool::Lease ctx(
+      &pool_, reinterpret_cast<const uint8_t*>(nonce.data()), 1);
+  if (!ctx.get() || !AddAAD(ctx.get())) {
+    return SslError();
+  }
+  int64_t bytes_read;
+  if (!SslCipherStream::UpdateAll(ctx.get(), in, out, &bytes_read) ||
+      !SslCipherStream::Final(ctx.get(), out)) {
+    return SslError();
+  }
+
+  uint8_t tag[kTagSize];
+  if (!EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, kTagSize, tag)) {
+    LOG(ERROR) << "EVP_CTRL_GCM_GET_TAG: ERROR";
+    return SslError();
+  }
+  if (!io::IOUtil::WriteToOutput(out, tag, kTagSize)) {
+    return SslError();
+  }
+  return base::Status::OK;
+}
+
+base::Status SslGcmAESEncryptor::Decrypt(const std::string& nonce,
+                                         io::InputStream* in,
+                                         io::OutputStream* out) {
+  if (nonce.size() != static_cast<size_t>(kNonceSize)) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "GCM nonce must be 12 bytes");
+  }
+  SslCipherContextPool::Lease ctx(
+      &pool_, reinterpret_cast<const uint8_t*>(nonce.data()), 0);
+  if (!ctx.get() || !AddAAD(ctx.get())) {
+    return SslError();
+  }
+  uint8_t tag[kTagSize];
+  if (!SslCipherStream::UpdateAllButTrailer(ctx.get(), in, out,
+                                            tag, kTagSize)) {
+    return SslError();
+  }
+  if (!EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, kTagSize, tag)) {
+    LOG(ERROR) << "EVP_CTRL_GCM_SET_TAG: ERROR";
+    return SslError();
+  }
+  if (!SslCipherStream::Final(ctx.get(), out)) {
+    return base::Status(base::error::DATA_LOSS,
+                        "GCM authentication tag mismatch");
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
@@ -0,0 +1,72 @@
+#ifndef CRYPTO_SSL_GCM_AES_ENCRYPTOR_H_
+#define CRYPTO_SSL_GCM_AES_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "strings/string_piece.h"
+
+#include <atomic>
+#include <string>
+
+namespace crypto {
+
+// AES-GCM. Encrypt() writes the ciphertext followed by a 16-byte tag, and
+// Decrypt() expects the same layout: authentication happens in the same
+// pass as the cipher, so no separate MAC over the output is needed.
+//
+// The expanded key and the GHASH tables are computed once, when the
+// encryptor is built; every call leases a keyed context from a pool and
+// only sets the nonce. Decrypt() streams plaintext out before the tag
+// is checked, so callers must discard the output when it fails.
+//
+// A (key, nonce) pair must never seal two messages, so the nonce given to
+// the constructor seals one: a second Encrypt() fails. A keyed encryptor
+// that is kept around takes a fresh nonce per message instead, through
+// the nonce overloads or the |iv| of a batch record.
+class SslGcmAESEncryptor : public AESEncryptor {
+ public:
+  static const int kNonceSize = 12;
+  static const int kTagSize = 16;
+
+  // |iv| is the 12-byte nonce, |aad| optional additional data that is
+  // authenticated but not encrypted.
+  SslGcmAESEncryptor(strings::StringPiece raw_key,
+                     const std::string& iv,
+                     const std::string& aad = "");
+  virtual ~SslGcmAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // With |nonce| in place of the one the encryptor was built with.
+  base::Status Encrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+  base::Status Decrypt(const std::string& nonce,
+                       io::InputStream* input,
+                       io::OutputStream* output);
+
+ protected:
+  // From AESEncryptor
+  virtual base::Status EncryptRecord(const AESBatchRecord& record) override;
+  virtual base::Status DecryptRecord(const AESBatchRecord& record) override;
+
+ private:
+  // Feeds the AAD into a freshly leased context.
+  bool AddAAD(EVP_CIPHER_CTX* ctx);
+
+  std::string iv_;
+  // Set by the first Encrypt() under iv_.
+  std::atomic<bool> iv_used_;
+  std::string aad_;
+  SslCipherContextPool pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslGcmAESEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_GCM_AES_ENCRYPTOR_H_
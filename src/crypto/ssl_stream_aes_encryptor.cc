@@ -0,0 +1,265 @@
+#include "crypto/ssl_stream_aes_encryptor.h"
+#include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_cipher_context_pool.h"
+
+#include "third_party/boringssl/include/openssl/crypto.h"
+#include "third_party/boringssl/include/openssl/hmac.h"
+#include "third_party/boringssl/include/openssl/rand.h"
+
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include "system/threadpool.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+base::Status SslError() {
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+// HKDF-SHA256 (RFC 5869) with an empty info, for |size| <= 32 bytes: one
+// extract and one expand block.
+bool DeriveKey(const SecureKeyBytes& key, const std::string& salt,
+               uint8_t* out, size_t size) {
+  uint8_t prk[EVP_MAX_MD_SIZE];
+  uint8_t block[EVP_MAX_MD_SIZE];
+  unsigned int prk_size = 0;
+  unsigned int block_size = 0;
+  const uint8_t counter = 1;
+  bool ok =
+      HMAC(EVP_sha256(), salt.data(), salt.size(), key.data(), key.size(),
+           prk, &prk_size) != nullptr &&
+      HMAC(EVP_sha256(), prk, prk_size, &counter, 1, block,
+           &block_size) != nullptr &&
+      size <= block_size;
+  if (ok) {
+    memcpy(out, block, size);
+  }
+  OPENSSL_cleanse(prk, sizeof(prk));
+  OPENSSL_cleanse(block, sizeof(block));
+  return ok;
+}
+
+// One segment on its way through the window.
+struct Slot {
+  std::string input;
+  std::string output;
+  bool busy = false;
+  bool ok = false;
+};
+
+} // namespace
+
+const int SslStreamAESEncryptor::kSaltSize;
+const int SslStreamAESEncryptor::kNoncePrefixSize;
+const int SslStreamAESEncryptor::kHeaderSize;
+const int SslStreamAESEncryptor::kTagSize;
+const size_t SslStreamAESEncryptor::kDefaultSegmentSize;
+
+SslStreamAESEncryptor::SslStreamAESEncryptor(strings::StringPiece raw_key,
+                                             core::thread::ThreadPool* pool,
+                                             int window,
+                                             size_t segment_size)
+    : pool_(pool),
+      window_(window > 0 ? window : 1),
+      segment_size_(segment_size > 0 ? segment_size : kDefaultSegmentSize) {
+  if (SslAESUtil::GCMCipher(raw_key)) {
+    key_ = SecureKeyBytes::Allocate(raw_key.size());
+    if (key_) {
+      memcpy(key_->data(), raw_key.data(), raw_key.size());
+    }
+  } else {
+    LOG(ERROR) << "AES key must be 128 or 256 bits, got "
+               << raw_key.size() * 8;
+  }
+}
+
+SslStreamAESEncryptor::~SslStreamAESEncryptor() {}
+
+base::Status SslStreamAESEncryptor::Encrypt(io::InputStream* input,
+                                            io::OutputStream* output) {
+  // A fresh salt and nonce per stream, so one encryptor can seal any
+  // number of them.
+  std::string header(kHeaderSize, '\0');
+  if (RAND_bytes(reinterpret_cast<uint8_t*>(&header[0]), header.size()) != 1) {
+    return SslError();
+  }
+  if (!io::IOUtil::WriteToOutput(output, header.data(), header.size())) {
+    return base::Status(base::error::INTERNAL, "Failed to write output");
+  }
+  return Crypt(true, header, input, output);
+}
+
+base::Status SslStreamAESEncryptor::Decrypt(io::InputStream* input,
+                                            io::OutputStream* output) {
+  std::string header(kHeaderSize, '\0');
+  int size = io::IOUtil::ReadFromInput(input, &header[0], header.size());
+  if (size != kHeaderSize) {
+    return base::Status(base::error::DATA_LOSS, "Stream truncated");
+  }
+  return Crypt(false, header, input, output);
+}
+
+base::Status SslStreamAESEncryptor::Crypt(bool do_encrypt,
+                                          const std::string& header,
+                                          io::InputStream* input,
+                                          io::OutputStream* output) {
+  if (!key_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "AES key must be 128 or 256 bits");
+  }
+  std::shared_ptr<SecureKeyBytes> subkey =
+      SecureKeyBytes::Allocate(key_->size());
+  if (!subkey ||
+      !DeriveKey(*key_, header.substr(0, kSaltSize), subkey->data(),
+                 subkey->size())) {
+    return SslError();
+  }
+  SslCipherContextPool contexts(SslAESUtil::GCMCipher(subkey->piece()),
+                                subkey->piece(), true, window_);
+  if (!contexts.ok()) {
+    return SslError();
+  }
+  const std::string prefix = header.substr(kSaltSize);
+
+  // Seals (or opens) one segment; runs on the pool.
+  auto crypt_segment = [do_encrypt, &prefix, &contexts](Slot* slot,
+                                                       uint32_t counter,
+                                                       bool last) -> bool {
+    uint8_t nonce[kNoncePrefixSize + 5];
+    memcpy(nonce, prefix.data(), kNoncePrefixSize);
+    for (int i = 0; i < 4; ++i) {
+      nonce[kNoncePrefixSize + i] = static_cast<uint8_t>(counter >> (24 - 8 * i));
+    }
+    nonce[kNoncePrefixSize + 4] = last ? 1 : 0;
+    SslCipherContextPool::Lease ctx(&contexts, nonce, do_encrypt ? 1 : 0);
+    if (!ctx.get()) {
+      return false;
+    }
+    const std::string& in = slot->input;
+    std::string& out = slot->output;
+    size_t size = do_encrypt ? in.size() : in.size() - kTagSize;
+    out.resize(do_encrypt ? size + kTagSize : size);
+    uint8_t* out_ptr = reinterpret_cast<uint8_t*>(&out[0]);
+    int len = 0;
+    if (size > 0 &&
+        !EVP_CipherUpdate(ctx.get(), out_ptr, &len,
+                          reinterpret_cast<const uint8_t*>(in.data()), size)) {
+      LOG(ERROR) << "EVP_CipherUpdate: in_len: " << size << ", ERROR";
+      return false;
+    }
+    if (!do_encrypt &&
+        !EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, kTagSize,
+                             const_cast<char*>(in.data()) + size)) {
+      return false;
+    }
+    uint8_t final_block[kTagSize];
+    if (!EVP_CipherFinal_ex(ctx.get(), final_block, &len)) {
+      return false;
+    }
+    if (do_encrypt &&
+        !EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, kTagSize,
+                             out_ptr + size)) {
+      LOG(ERROR) << "EVP_CTRL_GCM_GET_TAG: ERROR";
+      return false;
+    }
+    return true;
+  };
+
+  std::vector<Slot> slots(window_);
+  std::mutex mu;
+  std::condition_variable done;
+  uint64_t scheduled = 0;
+  uint64_t retired = 0;
+
+  // Waits for the oldest segment in flight and, when |write|, writes it.
+  auto retire = [&](bool write) -> base::Status {
+    Slot& slot = slots[retired % window_];
+    {
+      std::unique_lock<std::mutex> l(mu);
+      done.wait(l, [&slot]() { return !slot.busy; });
+    }
+    retired++;
+    if (!write) {
+      return base::Status::OK;
+    }
+    if (!slot.ok) {
+      return do_encrypt ? SslError() :
+          base::Status(base::error::DATA_LOSS,
+                       "Stream segment authentication failed");
+    }
+    if (!slot.output.empty() &&
+        !io::IOUtil::WriteToOutput(output, slot.output.data(),
+                                   slot.output.size())) {
+      return base::Status(base::error::INTERNAL, "Failed to write output");
+    }
+    return base::Status::OK;
+  };
+
+  const size_t read_size = do_encrypt ? segment_size_ :
+                                        segment_size_ + kTagSize;
+  base::Status status;
+  bool last = false;
+  while (!last) {
+    if (scheduled - retired == static_cast<uint64_t>(window_)) {
+      status = retire(true);
+      if (!status.ok()) {
+        break;
+      }
+    }
+    if (scheduled > 0xffffffffULL) {
+      status = base::Status(base::error::OUT_OF_RANGE,
+                            "Too many segments for one stream");
+      break;
+    }
+    Slot* slot = &slots[scheduled % window_];
+    slot->input.resize(read_size);
+    int size = io::IOUtil::ReadFromInput(input, &slot->input[0], read_size);
+    slot->input.resize(size > 0 ? size : 0);
+    // A full segment is the last one only when nothing follows it.
+    last = slot->input.size() < read_size || !io::IOUtil::PeekInput(input);
+    if (!do_encrypt && slot->input.size() < static_cast<size_t>(kTagSize)) {
+      status = base::Status(base::error::DATA_LOSS, "Stream truncated");
+      break;
+    }
+
+    const uint32_t counter = static_cast<uint32_t>(scheduled);
+    slot->busy = true;
+    scheduled++;
+    if (!pool_) {
+      slot->ok = crypt_segment(slot, counter, last);
+      slot->busy = false;
+      continue;
+    }
+    const bool is_last = last;
+    pool_->Schedule([&crypt_segment, &mu, &done, slot, counter, is_last]() {
+      bool ok = crypt_segment(slot, counter, is_last);
+      std::lock_guard<std::mutex> l(mu);
+      slot->ok = ok;
+      slot->busy = false;
+      done.notify_all();
+    });
+  }
+
+  // Writes what is left in order, or after an error just waits for it.
+  while (retired < scheduled) {
+    base::Status s = retire(status.ok());
+    if (status.ok()) {
+      status = s;
+    }
+  }
+  return status;
+}
+
+} // namespace crypto
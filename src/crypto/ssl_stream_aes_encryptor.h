@@ -0,0 +1,80 @@
+#ifndef CRYPTO_SSL_STREAM_AES_ENCRYPTOR_H_
+#define CRYPTO_SSL_STREAM_AES_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/secure_key_arena.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace crypto {
+
+// Online AEAD over one long stream (the STREAM construction on AES-GCM).
+//
+// Every Encrypt() draws a random 32-byte salt and a random 7-byte stream
+// nonce and writes them in front of the stream. As in Tink's streaming
+// AEAD, the segments are sealed under a subkey HKDF-SHA256(key, salt) of
+// the key's size, so a stream nonce only has to be unique under its own
+// subkey; a 7-byte nonce drawn under the long-lived key would collide after
+// about 2^28 streams. The plaintext is cut into |segment_size| segments,
+// each sealed on its own as ciphertext || 16-byte tag. Segment i uses the
+// nonce
+//   stream nonce (7 bytes) || i (big-endian u32) || last flag (1 byte),
+// so dropping, reordering or truncating segments fails authentication, and
+// the final segment (possibly empty) is the only one with the flag set.
+//
+// Segments are sealed concurrently on |pool| while the caller's thread
+// reads ahead and writes finished segments out in order; at most |window|
+// segments are in flight, so memory stays at about 2 * window segments
+// however long the stream is. Decrypt() writes a segment out only once its
+// tag has been checked.
+class SslStreamAESEncryptor : public AESEncryptor {
+ public:
+  static const int kSaltSize = 32;
+  static const int kNoncePrefixSize = 7;
+  // The salt, then the stream nonce.
+  static const int kHeaderSize = kSaltSize + kNoncePrefixSize;
+  static const int kTagSize = 16;
+  static const size_t kDefaultSegmentSize = 1 << 20;
+
+  // Without a |pool| segments are sealed one at a time on the caller's
+  // thread.
+  SslStreamAESEncryptor(strings::StringPiece raw_key,
+                        core::thread::ThreadPool* pool = nullptr,
+                        int window = 8,
+                        size_t segment_size = kDefaultSegmentSize);
+  virtual ~SslStreamAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+ private:
+  // |header| is the salt and the stream nonce.
+  base::Status Crypt(bool do_encrypt,
+                     const std::string& header,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+
+  std::shared_ptr<SecureKeyBytes> key_;
+  core::thread::ThreadPool* pool_;
+  const int window_;
+  const size_t segment_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslStreamAESEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_STREAM_AES_ENCRYPTOR_H_
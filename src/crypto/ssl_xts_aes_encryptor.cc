@@ -0,0 +1,378 @@
+#include "crypto/ssl_xts_aes_encryptor.h"
+#include "crypto/ssl_aes_util.h"
+
+#include "files/file_system.h"
+#include "io/input_stream.h"
+#include "io/output_stream.h"
+#include "io/io_util.h"
+
+#include "system/blocking_counter.h"
+#include "system/threadpool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace crypto {
+
+namespace {
+
+const size_t kBlockSize = 16;
+// Sectors whose initial tweaks are encrypted with one call; also how many
+// sectors Encrypt() and Decrypt() read at a time.
+const size_t kTweakBatch = 16;
+// EVP_CipherUpdate() takes an int length.
+const size_t kMaxUpdateSize = 1 << 30;
+
+base::Status SslError() {
+  return base::Status(base::error::INTERNAL, "Maybe error occur in SSL");
+}
+
+strings::StringPiece DataKey(strings::StringPiece raw_key) {
+  return raw_key.substr(0, raw_key.size() / 2);
+}
+
+strings::StringPiece TweakKey(strings::StringPiece raw_key) {
+  return raw_key.substr(raw_key.size() / 2);
+}
+
+// IEEE 1619 requires the data key and the tweak key to differ. Compared
+// without an early exit.
+bool IsKeyPair(strings::StringPiece raw_key) {
+  if (raw_key.size() != 32 && raw_key.size() != 64) {
+    return false;
+  }
+  strings::StringPiece data = DataKey(raw_key);
+  strings::StringPiece tweak = TweakKey(raw_key);
+  uint8_t diff = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    diff |= data[i] ^ tweak[i];
+  }
+  return diff != 0;
+}
+
+uint64_t LoadLE64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; --i) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+void StoreLE64(uint8_t* p, uint64_t v) {
+  for (int i = 0; i < 8; ++i) {
+    p[i] = static_cast<uint8_t>(v >> (8 * i));
+  }
+}
+
+// Multiplies the tweak by x in GF(2^128), in IEEE 1619's little-endian
+// representation.
+void MulAlpha(uint64_t* lo, uint64_t* hi) {
+  uint64_t carry = *hi >> 63;
+  *hi = (*hi << 1) | (*lo >> 63);
+  *lo = (*lo << 1) ^ (0x87 & (0 - carry));
+}
+
+// Adds one to a 16-byte little-endian sector number.
+void NextSector(uint8_t* number) {
+  for (size_t i = 0; i < kBlockSize && ++number[i] == 0; ++i) {
+  }
+}
+
+void SectorNumber(uint64_t sector, uint8_t* number) {
+  StoreLE64(number, sector);
+  memset(number + 8, 0, 8);
+}
+
+// |size| is a multiple of 16.
+void XorBlocks(uint8_t* out, const uint8_t* a, const uint8_t* b,
+               size_t size) {
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    x ^= y;
+    memcpy(out + i, &x, 8);
+  }
+}
+
+bool EcbCrypt(EVP_CIPHER_CTX* ctx, const uint8_t* in, uint8_t* out,
+              size_t size) {
+  while (size > 0) {
+    int chunk = static_cast<int>(std::min(size, kMaxUpdateSize));
+    int out_len;
+    if (!EVP_CipherUpdate(ctx, out, &out_len, in, chunk) ||
+        out_len != chunk) {
+      LOG(ERROR) << "EVP_CipherUpdate: in_len: " << chunk << ", ERROR";
+      return false;
+    }
+    in += chunk;
+    out += chunk;
+    size -= chunk;
+  }
+  return true;
+}
+
+// Runs one sector of |size| >= 16 bytes whose encrypted initial tweak is
+// |t0|. |mask| has room for a tweak per block of the sector.
+bool CryptSector(EVP_CIPHER_CTX* ctx,
+                 bool do_encrypt,
+                 const uint8_t* t0,
+                 const uint8_t* in,
+                 size_t size,
+                 uint8_t* out,
+                 uint8_t* mask) {
+  const size_t blocks = size / kBlockSize;
+  const size_t tail = size % kBlockSize;
+  // With ciphertext stealing the last full block goes with the tail.
+  const size_t bulk = (tail ? blocks - 1 : blocks) * kBlockSize;
+
+  uint64_t lo = LoadLE64(t0);
+  uint64_t hi = LoadLE64(t0 + 8);
+  for (size_t i = 0; i < blocks; ++i) {
+    StoreLE64(mask + i * kBlockSize, lo);
+    StoreLE64(mask + i * kBlockSize + 8, hi);
+    MulAlpha(&lo, &hi);
+  }
+
+  XorBlocks(out, in, mask, bulk);
+  if (!EcbCrypt(ctx, out, out, bulk)) {
+    return false;
+  }
+  XorBlocks(out, out, mask, bulk);
+  if (tail == 0) {
+    return true;
+  }
+
+  // Ciphertext stealing over the last full block and the tail.
+  const uint8_t* last_in = in + bulk;
+  uint8_t* last_out = out + bulk;
+  const uint8_t* t_prev = mask + bulk;
+  uint8_t t_last[kBlockSize];
+  StoreLE64(t_last, lo);
+  StoreLE64(t_last + 8, hi);
+  // Encrypting: |first| runs under the last full block's tweak, |second|
+  // under the next one. Decrypting swaps the two.
+  const uint8_t* t_first = do_encrypt ? t_prev : t_last;
+  const uint8_t* t_second = do_encrypt ? t_last : t_prev;
+
+  uint8_t first[kBlockSize], second[kBlockSize];
+  XorBlocks(first, last_in, t_first, kBlockSize);
+  if (!EcbCrypt(ctx, first, first, kBlockSize)) {
+    return false;
+  }
+  XorBlocks(first, first, t_first, kBlockSize);
+  memcpy(second, last_in + kBlockSize, tail);
+  memcpy(second + tail, first + tail, kBlockSize - tail);
+  XorBlocks(second, second, t_second, kBlockSize);
+  if (!EcbCrypt(ctx, second, second, kBlockSize)) {
+    return false;
+  }
+  XorBlocks(second, second, t_second, kBlockSize);
+  memcpy(last_out + kBlockSize, first, tail);
+  memcpy(last_out, second, kBlockSize);
+  return true;
+}
+
+} // namespace
+
+const size_t SslXtsAESEncryptor::kDefaultSectorSize;
+
+SslXtsAESEncryptor::SslXtsAESEncryptor(strings::StringPiece raw_key,
+                                       const std::string& iv,
+                                       size_t sector_size)
+    : iv_(iv),
+      sector_size_(sector_size),
+      key_ok_(IsKeyPair(raw_key)),
+      encrypt_pool_(SslAESUtil::ECBCipher(DataKey(raw_key)),
+                    DataKey(raw_key), true),
+      decrypt_pool_(SslAESUtil::ECBCipher(DataKey(raw_key)),
+                    DataKey(raw_key), false),
+      tweak_pool_(SslAESUtil::ECBCipher(TweakKey(raw_key)),
+                  TweakKey(raw_key), true) {
+  DCHECK_GE(sector_size_, kBlockSize);
+  LOG_IF(ERROR, !key_ok_)
+      << "XTS needs a 32- or 64-byte pair of two different keys";
+}
+
+SslXtsAESEncryptor::~SslXtsAESEncryptor() {}
+
+base::Status SslXtsAESEncryptor::Encrypt(io::InputStream* input,
+                                         io::OutputStream* output) {
+  return Crypt(true, input, output);
+}
+
+base::Status SslXtsAESEncryptor::Decrypt(io::InputStream* input,
+                                         io::OutputStream* output) {
+  return Crypt(false, input, output);
+}
+
+base::Status SslXtsAESEncryptor::Crypt(bool do_encrypt,
+                                       io::InputStream* input,
+                                       io::OutputStream* output) {
+  if (iv_.size() != kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "XTS iv must be 16 bytes");
+  }
+  uint8_t number[kBlockSize];
+  memcpy(number, iv_.data(), kBlockSize);
+
+  std::string buffer(sector_size_ * kTweakBatch, '\0');
+  uint8_t* data = reinterpret_cast<uint8_t*>(&buffer[0]);
+  while (true) {
+    int size = io::IOUtil::ReadFromInput(input, data, buffer.size());
+    if (size <= 0) {
+      return base::Status::OK;
+    }
+    RETURN_IF_ERROR(CryptSectors(do_encrypt, number, data, size, data));
+    if (!io::IOUtil::WriteToOutput(output, data, size)) {
+      return base::Status(base::error::INTERNAL, "Failed to write output");
+    }
+    if (static_cast<size_t>(size) < buffer.size()) {
+      return base::Status::OK;
+    }
+    for (size_t i = 0; i < kTweakBatch; ++i) {
+      NextSector(number);
+    }
+  }
+}
+
+base::Status SslXtsAESEncryptor::EncryptSectors(uint64_t first_sector,
+                                                const void* input,
+                                                size_t length,
+                                                void* output) {
+  uint8_t number[kBlockSize];
+  SectorNumber(first_sector, number);
+  return CryptSectors(true, number,
+                      reinterpret_cast<const uint8_t*>(input), length,
+                      reinterpret_cast<uint8_t*>(output));
+}
+
+base::Status SslXtsAESEncryptor::DecryptSectors(uint64_t first_sector,
+                                                const void* input,
+                                                size_t length,
+                                                void* output) {
+  uint8_t number[kBlockSize];
+  SectorNumber(first_sector, number);
+  return CryptSectors(false, number,
+                      reinterpret_cast<const uint8_t*>(input), length,
+                      reinterpret_cast<uint8_t*>(output));
+}
+
+base::Status SslXtsAESEncryptor::ParallelCryptSectors(
+    core::thread::ThreadPool* pool,
+    int num_ranges,
+    bool do_encrypt,
+    uint64_t first_sector,
+    const void* input,
+    size_t length,
+    void* output) {
+  CHECK(pool != nullptr);
+  CHECK_GT(num_ranges, 0);
+
+  const size_t num_sectors = (length + sector_size_ - 1) / sector_size_;
+  const size_t range_sectors = (num_sectors + num_ranges - 1) / num_ranges;
+  if (num_ranges == 1 || num_sectors <= range_sectors) {
+    return do_encrypt ?
+        EncryptSectors(first_sector, input, length, output) :
+        DecryptSectors(first_sector, input, length, output);
+  }
+  num_ranges = static_cast<int>((num_sectors + range_sectors - 1) /
+                                range_sectors);
+
+  const uint8_t* in_ptr = reinterpret_cast<const uint8_t*>(input);
+  uint8_t* out_ptr = reinterpret_cast<uint8_t*>(output);
+  const size_t range_size = range_sectors * sector_size_;
+  std::vector<base::Status> statuses(num_ranges);
+
+  auto crypt_range = [&](int i) {
+    size_t offset = i * range_size;
+    size_t len = std::min(range_size, length - offset);
+    uint8_t number[kBlockSize];
+    SectorNumber(first_sector + i * range_sectors, number);
+    statuses[i] = CryptSectors(do_encrypt, number, in_ptr + offset, len,
+                               out_ptr + offset);
+  };
+
+  core::BlockingCounter counter(num_ranges - 1);
+  for (int i = 1; i < num_ranges; ++i) {
+    pool->Schedule([&crypt_range, &counter, i]() {
+      crypt_range(i);
+      counter.DecrementCount();
+    });
+  }
+  crypt_range(0);
+  counter.Wait();
+
+  for (const base::Status& status : statuses) {
+    RETURN_IF_ERROR(status);
+  }
+  return base::Status::OK;
+}
+
+base::Status SslXtsAESEncryptor::ParallelCryptSectors(
+    core::thread::ThreadPool* pool,
+    int num_ranges,
+    bool do_encrypt,
+    uint64_t first_sector,
+    files::ReadOnlyMemoryRegion* region,
+    void* output) {
+  return ParallelCryptSectors(pool, num_ranges, do_encrypt, first_sector,
+                              region->data(), region->length(), output);
+}
+
+base::Status SslXtsAESEncryptor::CryptSectors(bool do_encrypt,
+                                              const uint8_t* tweak,
+                                              const uint8_t* input,
+                                              size_t length,
+                                              uint8_t* output) {
+  if (!key_ok_) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "XTS key must be two different AES keys");
+  }
+  if (length % sector_size_ != 0 && length % sector_size_ < kBlockSize) {
+    return base::Status(base::error::INVALID_ARGUMENT,
+                        "XTS sectors must be at least 16 bytes");
+  }
+  if (length == 0) {
+    return base::Status::OK;
+  }
+  SslCipherContextPool::Lease data(do_encrypt ? &encrypt_pool_ :
+                                                &decrypt_pool_, nullptr);
+  SslCipherContextPool::Lease tweaks(&tweak_pool_, nullptr);
+  if (!data.get() || !tweaks.get()) {
+    return SslError();
+  }
+  EVP_CIPHER_CTX_set_padding(data.get(), 0);
+  EVP_CIPHER_CTX_set_padding(tweaks.get(), 0);
+
+  uint8_t number[kBlockSize];
+  memcpy(number, tweak, kBlockSize);
+  uint8_t initial[kTweakBatch * kBlockSize];
+  std::vector<uint8_t> mask(sector_size_);
+
+  const size_t num_sectors = (length + sector_size_ - 1) / sector_size_;
+  for (size_t first = 0; first < num_sectors; first += kTweakBatch) {
+    const size_t batch = std::min(kTweakBatch, num_sectors - first);
+    for (size_t i = 0; i < batch; ++i) {
+      memcpy(initial + i * kBlockSize, number, kBlockSize);
+      NextSector(number);
+    }
+    if (!EcbCrypt(tweaks.get(), initial, initial, batch * kBlockSize)) {
+      return SslError();
+    }
+    for (size_t i = 0; i < batch; ++i) {
+      size_t offset = (first + i) * sector_size_;
+      size_t size = std::min(sector_size_, length - offset);
+      if (!CryptSector(data.get(), do_encrypt, initial + i * kBlockSize,
+                       input + offset, size, output + offset, &mask[0])) {
+        return SslError();
+      }
+    }
+  }
+  return base::Status::OK;
+}
+
+} // namespace crypto
@@ -0,0 +1,111 @@
+#ifndef CRYPTO_SSL_XTS_AES_ENCRYPTOR_H_
+#define CRYPTO_SSL_XTS_AES_ENCRYPTOR_H_
+
+#include "base/macros.h"
+#include "crypto/aes_encryptor.h"
+#include "crypto/ssl_cipher_context_pool.h"
+#include "strings/string_piece.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace core {
+namespace thread {
+class ThreadPool;
+} // namespace thread
+} // namespace core
+
+namespace files {
+class ReadOnlyMemoryRegion;
+} // namespace files
+
+namespace crypto {
+
+// XTS-AES (IEEE 1619) for sector- or page-granular storage: every sector is
+// encrypted on its own under its sector number, and the ciphertext has
+// exactly the size of the plaintext. A sector shorter than the others (the
+// last one) uses ciphertext stealing, so only sectors under 16 bytes are
+// rejected.
+//
+// Sectors are run through the keyed ECB contexts in bulk: the initial
+// tweaks of a batch of sectors are encrypted with one call, every tweak of
+// a sector is derived from its initial tweak up front, and the whole sector
+// then goes through AES in one pass, so all AES lanes stay busy.
+class SslXtsAESEncryptor : public AESEncryptor {
+ public:
+  static const size_t kDefaultSectorSize = 4096;
+
+  // |raw_key| is the data key followed by the tweak key: 32 bytes for
+  // XTS-AES-128, 64 for XTS-AES-256 (see AESKey::CreateXTS()). A pair
+  // whose two keys are equal is rejected. |iv| is the 16-byte little-endian
+  // number of the first sector Encrypt() and Decrypt() see; the sectors
+  // that follow are numbered consecutively.
+  SslXtsAESEncryptor(strings::StringPiece raw_key,
+                     const std::string& iv,
+                     size_t sector_size = kDefaultSectorSize);
+  virtual ~SslXtsAESEncryptor() override;
+
+  // From AESEncryptor
+  virtual base::Status Encrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+  virtual base::Status Decrypt(io::InputStream* input,
+                               io::OutputStream* output) override;
+
+  // Encrypts the |length| bytes of consecutive sectors at |input|, the
+  // first of which is sector |first_sector|. |input| may equal |output|,
+  // so pages can be encrypted in place.
+  base::Status EncryptSectors(uint64_t first_sector,
+                              const void* input,
+                              size_t length,
+                              void* output);
+  base::Status DecryptSectors(uint64_t first_sector,
+                              const void* input,
+                              size_t length,
+                              void* output);
+
+  // Splits the sectors into |num_ranges| runs and processes them
+  // concurrently on |pool|. The result is identical to EncryptSectors() (or
+  // DecryptSectors()) over the whole buffer.
+  base::Status ParallelCryptSectors(core::thread::ThreadPool* pool,
+                                    int num_ranges,
+                                    bool do_encrypt,
+                                    uint64_t first_sector,
+                                    const void* input,
+                                    size_t length,
+                                    void* output);
+  // Same, reading straight from a mapped file.
+  base::Status ParallelCryptSectors(core::thread::ThreadPool* pool,
+                                    int num_ranges,
+                                    bool do_encrypt,
+                                    uint64_t first_sector,
+                                    files::ReadOnlyMemoryRegion* region,
+                                    void* output);
+
+  size_t sector_size() const { return sector_size_; }
+
+ private:
+  base::Status Crypt(bool do_encrypt,
+                     io::InputStream* input,
+                     io::OutputStream* output);
+  // Runs the sectors that follow the sector numbered |tweak| (16 bytes,
+  // little-endian).
+  base::Status CryptSectors(bool do_encrypt,
+                            const uint8_t* tweak,
+                            const uint8_t* input,
+                            size_t length,
+                            uint8_t* output);
+
+  std::string iv_;
+  const size_t sector_size_;
+  // Whether |raw_key| was an XTS key pair of two different keys.
+  const bool key_ok_;
+  SslCipherContextPool encrypt_pool_;
+  SslCipherContextPool decrypt_pool_;
+  SslCipherContextPool tweak_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(SslXtsAESEncryptor);
+};
+
+} // namespace crypto
+#endif // CRYPTO_SSL_XTS_AES_ENCRYPTOR_H_
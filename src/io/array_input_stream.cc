@@ -1,12 +1,15 @@
 #include "io/array_input_stream.h"
 
+#include <limits.h>
+#include <algorithm>
+
 #include <glog/logging.h>
 
 namespace io {
 
 ArrayInputStream::ArrayInputStream(const void* data,
-                                   int size,
-				   int block_size)
+                                   int64_t size,
+				   int64_t block_size)
     : data_(reinterpret_cast<const uint8_t*>(data)),
       size_(size),
       block_size_(block_size > 0 ? block_size : size),
@@ -17,8 +20,23 @@ ArrayInputStream::ArrayInputStream(const void* data,
 ArrayInputStream::~ArrayInputStream() {}
 
 bool ArrayInputStream::Next(const void** data, int* size) {
+  int64_t window;
+  if (!NextWindow(data, &window, INT_MAX)) {
+    return false;
+  }
+  *size = static_cast<int>(window);
+  return true;
+}
+
+bool ArrayInputStream::Next64(const void** data, int64_t* size) {
+  return NextWindow(data, size, size_);
+}
+
+bool ArrayInputStream::NextWindow(const void** data, int64_t* size,
+                                  int64_t max_size) {
   if (position_ < size_) {
-    last_returned_size_ = std::min(block_size_, size_ - position_);
+    last_returned_size_ = std::min(std::min(block_size_, max_size),
+                                   size_ - position_);
     *data = data_ + position_;
     *size = last_returned_size_;
     position_ += last_returned_size_;
@@ -30,6 +48,10 @@ bool ArrayInputStream::Next(const void** data, int* size) {
 }
 
 void ArrayInputStream::BackUp(int count) {
+  BackUp64(count);
+}
+
+void ArrayInputStream::BackUp64(int64_t count) {
   CHECK_GT(last_returned_size_, 0)
 	  << "BackUp() can only be called after a successful Next()";
   CHECK_LE(count, last_returned_size_);
@@ -40,6 +62,10 @@ void ArrayInputStream::BackUp(int count) {
 }
 
 bool ArrayInputStream::Skip(int count) {
+  return Skip64(count);
+}
+
+bool ArrayInputStream::Skip64(int64_t count) {
   CHECK_GE(count, 0);
   last_returned_size_ = 0;
   if (count > size_ - position_) {
@@ -8,7 +8,7 @@ namespace io {
 
 class ArrayInputStream : public InputStream {
  public:
-  ArrayInputStream(const void* data, int size, int block_size = -1);
+  ArrayInputStream(const void* data, int64_t size, int64_t block_size = -1);
   virtual ~ArrayInputStream() override;
 
   virtual bool Next(const void** data, int* size) override;
@@ -16,13 +16,19 @@ class ArrayInputStream : public InputStream {
   virtual bool Skip(int count) override;
   virtual int64_t ByteCount() const override;
 
+  virtual bool Next64(const void** data, int64_t* size) override;
+  virtual void BackUp64(int64_t count) override;
+  virtual bool Skip64(int64_t count) override;
+
  private:
+  bool NextWindow(const void** data, int64_t* size, int64_t max_size);
+
   const uint8_t* const data_;
-  const int size_;
-  const int block_size_;
+  const int64_t size_;
+  const int64_t block_size_;
 
-  int position_;
-  int last_returned_size_;
+  int64_t position_;
+  int64_t last_returned_size_;
 
   DISALLOW_COPY_AND_ASSIGN(ArrayInputStream);
 };
@@ -1,9 +1,14 @@
 #include "io/array_output_stream.h"
+
+#include <limits.h>
+#include <algorithm>
+
 #include <glog/logging.h>
 
 namespace io {
 
-ArrayOutputStream::ArrayOutputStream(void* data, int size, int block_size)
+ArrayOutputStream::ArrayOutputStream(void* data, int64_t size,
+                                     int64_t block_size)
     : data_(reinterpret_cast<uint8_t*>(data)),
       size_(size),
       block_size_(block_size > 0 ? block_size : size),
@@ -14,8 +19,23 @@ ArrayOutputStream::ArrayOutputStream(void* data, int size, int block_size)
 ArrayOutputStream::~ArrayOutputStream() {}
 
 bool ArrayOutputStream::Next(void** data, int* size) {
+  int64_t window;
+  if (!NextWindow(data, &window, INT_MAX)) {
+    return false;
+  }
+  *size = static_cast<int>(window);
+  return true;
+}
+
+bool ArrayOutputStream::Next64(void** data, int64_t* size) {
+  return NextWindow(data, size, size_);
+}
+
+bool ArrayOutputStream::NextWindow(void** data, int64_t* size,
+                                   int64_t max_size) {
   if (position_ < size_) {
-    last_returned_size_ = std::min(block_size_, size_ - position_);
+    last_returned_size_ = std::min(std::min(block_size_, max_size),
+                                   size_ - position_);
     *data = data_ + position_;
     *size = last_returned_size_;
     position_ += last_returned_size_;
@@ -27,6 +47,10 @@ bool ArrayOutputStream::Next(void** data, int* size) {
 }
 
 void ArrayOutputStream::BackUp(int count) {
+  BackUp64(count);
+}
+
+void ArrayOutputStream::BackUp64(int64_t count) {
   CHECK_GT(last_returned_size_, 0) 
 	  << "BackUp() can only be called after a successful Next().";
   CHECK_LE(count, last_returned_size_);
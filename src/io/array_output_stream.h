@@ -7,7 +7,7 @@ namespace io {
 
 class ArrayOutputStream : public OutputStream {
  public:
-  ArrayOutputStream(void* data, int size, int block_size = -1);
+  ArrayOutputStream(void* data, int64_t size, int64_t block_size = -1);
   ~ArrayOutputStream();
 
   // From OutputStream
@@ -15,13 +15,18 @@ class ArrayOutputStream : public OutputStream {
   virtual void BackUp(int count) override;
   virtual int64_t ByteCount() const override;
 
+  virtual bool Next64(void** data, int64_t* size) override;
+  virtual void BackUp64(int64_t count) override;
+
  private:
+  bool NextWindow(void** data, int64_t* size, int64_t max_size);
+
   uint8_t* const data_;
-  const int size_;
-  const int block_size_;
+  const int64_t size_;
+  const int64_t block_size_;
 
-  int position_;
-  int last_returned_size_;
+  int64_t position_;
+  int64_t last_returned_size_;
 
   DISALLOW_COPY_AND_ASSIGN(ArrayOutputStream);
 };
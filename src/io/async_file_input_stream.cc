@@ -0,0 +1,292 @@
+#include "io/async_file_input_stream.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace io {
+
+namespace {
+
+int close_no_eintr(int fd) {
+  int result;
+  do {
+    result = close(fd);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+}  // namespace
+
+const int AsyncFileInputStream::kDefaultBlockSize;
+const int AsyncFileInputStream::kDefaultQueueDepth;
+
+AsyncFileInputStream::AsyncFileInputStream(int file_descriptor,
+                                           int block_size,
+                                           int queue_depth)
+    : file_(file_descriptor),
+      block_size_(block_size > 0 ? block_size : kDefaultBlockSize),
+      head_(0),
+      has_current_(false),
+      backup_bytes_(0),
+      next_offset_(0),
+      start_offset_(0),
+      position_(0),
+      close_on_delete_(false),
+      is_closed_(false),
+      failed_(false),
+      errno_(0) {
+  queue_depth = std::max(queue_depth, 1);
+  const off_t offset = lseek(file_, 0, SEEK_CUR);
+  if (offset != static_cast<off_t>(-1)) {
+    ring_ = IoUring::Create(queue_depth);
+  }
+  if (!ring_) {
+    fallback_.reset(new FileInputStream(file_, block_size_));
+    return;
+  }
+
+  slots_.resize(queue_depth);
+  for (Slot& slot : slots_) {
+    slot.buffer = BufferPool::Default()->Get(block_size_);
+    CHECK(slot.buffer != nullptr) << "Out of memory";
+    slot.offset = 0;
+    slot.in_flight = false;
+    slot.result = 0;
+  }
+  start_offset_ = offset;
+  if (!Restart(start_offset_)) {
+    failed_ = true;
+  }
+}
+
+AsyncFileInputStream::~AsyncFileInputStream() {
+  if (!ring_) {
+    return;
+  }
+  Drain();
+  if (close_on_delete_ && !is_closed_) {
+    if (!Close()) {
+      LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  }
+}
+
+bool AsyncFileInputStream::Close() {
+  if (fallback_) {
+    return fallback_->Close();
+  }
+  CHECK(!is_closed_);
+
+  Drain();
+  is_closed_ = true;
+  if (close_no_eintr(file_) != 0) {
+    errno_ = errno;
+    return false;
+  }
+  return true;
+}
+
+void AsyncFileInputStream::SetCloseOnDelete(bool value) {
+  if (fallback_) {
+    fallback_->SetCloseOnDelete(value);
+  } else {
+    close_on_delete_ = value;
+  }
+}
+
+int AsyncFileInputStream::GetErrno() {
+  return fallback_ ? fallback_->GetErrno() : errno_;
+}
+
+bool AsyncFileInputStream::Queue(int index, uint64_t offset) {
+  Slot& slot = slots_[index];
+  slot.offset = offset;
+  slot.iov.iov_base = slot.buffer.get();
+  slot.iov.iov_len = block_size_;
+  slot.result = 0;
+  if (!ring_->PrepareRead(file_, &slot.iov, offset, index)) {
+    errno_ = EBUSY;
+    return false;
+  }
+  slot.in_flight = true;
+  return true;
+}
+
+bool AsyncFileInputStream::Restart(uint64_t offset) {
+  Drain();
+  head_ = 0;
+  has_current_ = false;
+  backup_bytes_ = 0;
+  next_offset_ = offset;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (!Queue(i, next_offset_)) {
+      return false;
+    }
+    next_offset_ += block_size_;
+  }
+  if (!ring_->Submit()) {
+    errno_ = errno;
+    return false;
+  }
+  return true;
+}
+
+bool AsyncFileInputStream::WaitFor(int index) {
+  while (slots_[index].in_flight) {
+    IoUring::Completion completion;
+    if (!ring_->WaitCompletion(&completion)) {
+      errno_ = errno;
+      return false;
+    }
+    Slot& slot = slots_[completion.user_data];
+    slot.in_flight = false;
+    slot.result = completion.result;
+  }
+  return true;
+}
+
+void AsyncFileInputStream::Drain() {
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    CHECK(WaitFor(i)) << "Lost a read in flight: " << strerror(errno_);
+  }
+}
+
+bool AsyncFileInputStream::Recycle() {
+  const Slot& slot = slots_[head_];
+  has_current_ = false;
+  // After a short read the queued offsets no longer follow the data, so
+  // read on from where it stopped. At the end of the file this is also
+  // how the stream learns that nothing more comes.
+  if (slot.result < block_size_) {
+    return Restart(slot.offset + slot.result);
+  }
+  if (!Queue(head_, next_offset_)) {
+    return false;
+  }
+  next_offset_ += block_size_;
+  if (!ring_->Submit()) {
+    errno_ = errno;
+    return false;
+  }
+  head_ = (head_ + 1) % slots_.size();
+  return true;
+}
+
+bool AsyncFileInputStream::Next(const void** data, int* size) {
+  if (fallback_) {
+    return fallback_->Next(data, size);
+  }
+  if (failed_) {
+    return false;
+  }
+
+  if (backup_bytes_ > 0) {
+    const Slot& slot = slots_[head_];
+    *data = slot.buffer.get() + slot.result - backup_bytes_;
+    *size = backup_bytes_;
+    position_ += backup_bytes_;
+    backup_bytes_ = 0;
+    return true;
+  }
+
+  if ((has_current_ && !Recycle()) || !WaitFor(head_)) {
+    failed_ = true;
+    return false;
+  }
+  const Slot& slot = slots_[head_];
+  if (slot.result <= 0) {
+    if (slot.result < 0) {
+      errno_ = -slot.result;
+      failed_ = true;
+    }
+    return false;
+  }
+  has_current_ = true;
+  *data = slot.buffer.get();
+  *size = slot.result;
+  position_ += slot.result;
+  return true;
+}
+
+void AsyncFileInputStream::BackUp(int count) {
+  if (fallback_) {
+    fallback_->BackUp(count);
+    return;
+  }
+  CHECK(has_current_ && backup_bytes_ == 0)
+    << " BackUp() can only be called after Next().";
+  CHECK_LE(count, slots_[head_].result)
+    << " Can't back up over more bytes than were returned by the last call"
+       " to Next().";
+  CHECK_GE(count, 0)
+    << " Parameter to BackUp() can't be negative.";
+
+  backup_bytes_ = count;
+  position_ -= count;
+}
+
+bool AsyncFileInputStream::Skip(int count) {
+  if (fallback_) {
+    return fallback_->Skip(count);
+  }
+  CHECK_GE(count, 0);
+
+  if (failed_) {
+    return false;
+  }
+
+  if (backup_bytes_ >= count) {
+    backup_bytes_ -= count;
+    position_ += count;
+    return true;
+  }
+  count -= backup_bytes_;
+  position_ += backup_bytes_;
+  backup_bytes_ = 0;
+
+  // Short skips are mostly over data already on its way.
+  if (static_cast<int64_t>(count) <=
+      static_cast<int64_t>(block_size_) *
+          static_cast<int64_t>(slots_.size())) {
+    const void* data;
+    int size;
+    while (count > 0) {
+      if (!Next(&data, &size)) {
+        return false;
+      }
+      if (size > count) {
+        BackUp(size - count);
+        size = count;
+      }
+      count -= size;
+    }
+    return true;
+  }
+
+  uint64_t target = start_offset_ + position_ + count;
+  bool past_end = false;
+  struct stat st;
+  if (fstat(file_, &st) == 0 && S_ISREG(st.st_mode) &&
+      target > static_cast<uint64_t>(st.st_size)) {
+    target = std::max<uint64_t>(st.st_size, start_offset_ + position_);
+    past_end = true;
+  }
+  if (!Restart(target)) {
+    failed_ = true;
+    return false;
+  }
+  position_ = target - start_offset_;
+  return !past_end;
+}
+
+int64_t AsyncFileInputStream::ByteCount() const {
+  return fallback_ ? fallback_->ByteCount() : position_;
+}
+
+} // namespace io
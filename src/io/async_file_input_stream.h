@@ -0,0 +1,94 @@
+#ifndef CRYPTO_IO_ASYNC_FILE_INPUT_STREAM_H_
+#define CRYPTO_IO_ASYNC_FILE_INPUT_STREAM_H_
+
+#include "base/macros.h"
+#include "io/buffer_pool.h"
+#include "io/file_input_stream.h"
+#include "io/input_stream.h"
+#include "io/io_uring.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <memory>
+#include <vector>
+
+namespace io {
+
+// A FileInputStream that keeps |queue_depth| reads of |block_size| bytes
+// in flight through io_uring ahead of the reader, so that the disk works
+// while the caller decrypts or hashes the last block.
+//
+// Reads go to explicit offsets from where the descriptor was at
+// construction, and the descriptor's own offset is left alone. Where
+// io_uring is missing, or the descriptor cannot seek, the stream is a
+// plain FileInputStream with the same block size.
+class AsyncFileInputStream : public InputStream {
+ public:
+  static const int kDefaultBlockSize = 64 << 10;
+  static const int kDefaultQueueDepth = 4;
+
+  explicit AsyncFileInputStream(int file_descriptor, int block_size = -1,
+                                int queue_depth = kDefaultQueueDepth);
+  virtual ~AsyncFileInputStream() override;
+
+  bool Close();
+
+  void SetCloseOnDelete(bool value);
+
+  int GetErrno();
+
+  // False when the stream fell back to FileInputStream.
+  bool async() const { return ring_ != nullptr; }
+
+  // From InputStream
+  virtual bool Next(const void** data, int* size) override;
+  virtual void BackUp(int count) override;
+  virtual bool Skip(int count) override;
+  virtual int64_t ByteCount() const override;
+
+ private:
+  struct Slot {
+    BufferPool::Buffer buffer;
+    struct iovec iov;
+    uint64_t offset;
+    bool in_flight;
+    int result;
+  };
+
+  // Queues a read of slot |index| at |offset|.
+  bool Queue(int index, uint64_t offset);
+  // Drops whatever is in flight and reads on from file offset |offset|.
+  bool Restart(uint64_t offset);
+  // Blocks until slot |index| has completed.
+  bool WaitFor(int index);
+  // Waits out every read in flight; their buffers may not be freed
+  // before.
+  void Drain();
+  // Hands the consumed head slot back to the read-ahead queue.
+  bool Recycle();
+
+  const int file_;
+  const int block_size_;
+  std::unique_ptr<IoUring> ring_;
+  std::unique_ptr<FileInputStream> fallback_;
+
+  std::vector<Slot> slots_;
+  // The slot Next() reads from, and whether its data was handed out.
+  int head_;
+  bool has_current_;
+  int backup_bytes_;
+  // File offset of the next read to queue, and of the first byte.
+  uint64_t next_offset_;
+  uint64_t start_offset_;
+  int64_t position_;
+
+  bool close_on_delete_;
+  bool is_closed_;
+  bool failed_;
+  int errno_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileInputStream);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_ASYNC_FILE_INPUT_STREAM_H_
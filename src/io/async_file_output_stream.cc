@@ -0,0 +1,256 @@
+#include "io/async_file_output_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace io {
+
+namespace {
+
+int close_no_eintr(int fd) {
+  int result;
+  do {
+    result = close(fd);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+}  // namespace
+
+const int AsyncFileOutputStream::kDefaultBlockSize;
+const int AsyncFileOutputStream::kDefaultQueueDepth;
+
+AsyncFileOutputStream::AsyncFileOutputStream(int file_descriptor,
+                                             int block_size,
+                                             int queue_depth)
+    : file_(file_descriptor),
+      block_size_(block_size > 0 ? block_size : kDefaultBlockSize),
+      current_(-1),
+      buffer_used_(0),
+      batch_size_(1),
+      next_offset_(0),
+      position_(0),
+      close_on_delete_(false),
+      is_closed_(false),
+      failed_(false),
+      errno_(0) {
+  queue_depth = std::max(queue_depth, 1);
+  const off_t offset = lseek(file_, 0, SEEK_CUR);
+  const int flags = fcntl(file_, F_GETFL);
+  // O_APPEND ignores the offsets, and the kernel may reorder the blocks.
+  if (offset != static_cast<off_t>(-1) && flags != -1 &&
+      !(flags & O_APPEND)) {
+    ring_ = IoUring::Create(queue_depth);
+  }
+  if (!ring_) {
+    fallback_.reset(new FileOutputStream(file_, block_size_));
+    return;
+  }
+
+  slots_.resize(queue_depth);
+  for (int i = queue_depth - 1; i >= 0; --i) {
+    slots_[i].buffer = BufferPool::Default()->Get(block_size_);
+    CHECK(slots_[i].buffer != nullptr) << "Out of memory";
+    slots_[i].offset = 0;
+    slots_[i].in_flight = false;
+    free_slots_.push_back(i);
+  }
+  batch_size_ = std::max(queue_depth / 2, 1);
+  next_offset_ = offset;
+}
+
+AsyncFileOutputStream::~AsyncFileOutputStream() {
+  // After Close() the fd may already belong to someone else.
+  if (!ring_ || is_closed_) {
+    return;
+  }
+  Flush();
+  if (close_on_delete_) {
+    if (!Close()) {
+      LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  }
+}
+
+bool AsyncFileOutputStream::Close() {
+  if (fallback_) {
+    return fallback_->Close();
+  }
+  CHECK(!is_closed_);
+
+  bool flush_succeeded = Flush();
+  is_closed_ = true;
+  if (close_no_eintr(file_) != 0) {
+    errno_ = errno;
+    return false;
+  }
+  return flush_succeeded;
+}
+
+bool AsyncFileOutputStream::Flush() {
+  if (fallback_) {
+    return fallback_->Flush();
+  }
+  if (current_ >= 0) {
+    if (buffer_used_ > 0 && !failed_) {
+      if (!Queue(current_, buffer_used_)) {
+        failed_ = true;
+      }
+    } else {
+      free_slots_.push_back(current_);
+    }
+    current_ = -1;
+    buffer_used_ = 0;
+  }
+  if (!WaitAll()) {
+    failed_ = true;
+  }
+  if (failed_) {
+    return false;
+  }
+  if (lseek(file_, next_offset_, SEEK_SET) == static_cast<off_t>(-1)) {
+    errno_ = errno;
+    failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+void AsyncFileOutputStream::SetCloseOnDelete(bool value) {
+  if (fallback_) {
+    fallback_->SetCloseOnDelete(value);
+  } else {
+    close_on_delete_ = value;
+  }
+}
+
+int AsyncFileOutputStream::GetErrno() {
+  return fallback_ ? fallback_->GetErrno() : errno_;
+}
+
+bool AsyncFileOutputStream::Queue(int index, int size) {
+  Slot& slot = slots_[index];
+  slot.offset = next_offset_;
+  slot.iov.iov_base = slot.buffer.get();
+  slot.iov.iov_len = size;
+  next_offset_ += size;
+  position_ += size;
+  if (!PrepareWrite(index)) {
+    return false;
+  }
+  if (ring_->pending() >= batch_size_ && !ring_->Submit()) {
+    errno_ = errno;
+    return false;
+  }
+  return true;
+}
+
+bool AsyncFileOutputStream::PrepareWrite(int index) {
+  Slot& slot = slots_[index];
+  if (!ring_->PrepareWrite(file_, &slot.iov, slot.offset, index)) {
+    errno_ = EBUSY;
+    return false;
+  }
+  slot.in_flight = true;
+  return true;
+}
+
+bool AsyncFileOutputStream::WaitOne() {
+  IoUring::Completion completion;
+  CHECK(ring_->WaitCompletion(&completion))
+    << "Lost a write in flight: " << strerror(errno);
+  const int index = completion.user_data;
+  Slot& slot = slots_[index];
+  slot.in_flight = false;
+  if (completion.result <= 0) {
+    errno_ = completion.result < 0 ? -completion.result : EIO;
+    return false;
+  }
+  if (static_cast<size_t>(completion.result) < slot.iov.iov_len) {
+    slot.iov.iov_base =
+        static_cast<uint8_t*>(slot.iov.iov_base) + completion.result;
+    slot.iov.iov_len -= completion.result;
+    slot.offset += completion.result;
+    return PrepareWrite(index);
+  }
+  free_slots_.push_back(index);
+  return true;
+}
+
+bool AsyncFileOutputStream::WaitAll() {
+  bool ok = true;
+  while (true) {
+    bool in_flight = false;
+    for (const Slot& slot : slots_) {
+      in_flight |= slot.in_flight;
+    }
+    if (!in_flight) {
+      return ok;
+    }
+    ok &= WaitOne();
+  }
+}
+
+bool AsyncFileOutputStream::Next(void** data, int* size) {
+  if (fallback_) {
+    return fallback_->Next(data, size);
+  }
+  if (failed_) {
+    return false;
+  }
+
+  if (current_ >= 0 && buffer_used_ == block_size_) {
+    const int full = current_;
+    current_ = -1;
+    if (!Queue(full, block_size_)) {
+      failed_ = true;
+      return false;
+    }
+  }
+  if (current_ < 0) {
+    while (free_slots_.empty()) {
+      if (!WaitOne()) {
+        failed_ = true;
+        return false;
+      }
+    }
+    current_ = free_slots_.back();
+    free_slots_.pop_back();
+    buffer_used_ = 0;
+  }
+
+  *data = slots_[current_].buffer.get() + buffer_used_;
+  *size = block_size_ - buffer_used_;
+  buffer_used_ = block_size_;
+  return true;
+}
+
+void AsyncFileOutputStream::BackUp(int count) {
+  if (fallback_) {
+    fallback_->BackUp(count);
+    return;
+  }
+  CHECK_GE(count, 0);
+  CHECK(current_ >= 0 && buffer_used_ == block_size_)
+    << " BackUp() can only be called after Next().";
+  CHECK_LE(count, buffer_used_)
+    << " Can't back up over more bytes than were returned by the last call"
+       " to Next().";
+
+  buffer_used_ -= count;
+}
+
+int64_t AsyncFileOutputStream::ByteCount() const {
+  if (fallback_) {
+    return fallback_->ByteCount();
+  }
+  return position_ + (current_ >= 0 ? buffer_used_ : 0);
+}
+
+} // namespace io
@@ -0,0 +1,91 @@
+#ifndef CRYPTO_IO_ASYNC_FILE_OUTPUT_STREAM_H_
+#define CRYPTO_IO_ASYNC_FILE_OUTPUT_STREAM_H_
+
+#include "base/macros.h"
+#include "io/buffer_pool.h"
+#include "io/file_output_stream.h"
+#include "io/io_uring.h"
+#include "io/output_stream.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <memory>
+#include <vector>
+
+namespace io {
+
+// A FileOutputStream that writes each filled block through io_uring and
+// hands out the next buffer at once, with up to |queue_depth| blocks
+// written behind the caller. Writes are submitted to the kernel in
+// batches of half the queue.
+//
+// Blocks go to explicit offsets from where the descriptor was at
+// construction; Flush() waits for them and moves the descriptor past the
+// data. Where io_uring is missing, or the descriptor cannot seek or is in
+// append mode, the stream is a plain FileOutputStream.
+class AsyncFileOutputStream : public OutputStream {
+ public:
+  static const int kDefaultBlockSize = 64 << 10;
+  static const int kDefaultQueueDepth = 4;
+
+  explicit AsyncFileOutputStream(int file_descriptor, int block_size = -1,
+                                 int queue_depth = kDefaultQueueDepth);
+  virtual ~AsyncFileOutputStream() override;
+
+  bool Close();
+
+  // Writes out what Next() handed out and waits until the kernel has it.
+  bool Flush();
+
+  void SetCloseOnDelete(bool value);
+
+  int GetErrno();
+
+  // False when the stream fell back to FileOutputStream.
+  bool async() const { return ring_ != nullptr; }
+
+  // From OutputStream
+  virtual bool Next(void** data, int* size) override;
+  virtual void BackUp(int count) override;
+  virtual int64_t ByteCount() const override;
+
+ private:
+  struct Slot {
+    BufferPool::Buffer buffer;
+    struct iovec iov;
+    uint64_t offset;
+    bool in_flight;
+  };
+
+  // Queues |size| bytes of slot |index| at the end of the data.
+  bool Queue(int index, int size);
+  bool PrepareWrite(int index);
+  // Reaps one completion, and requeues what a short write left.
+  bool WaitOne();
+  bool WaitAll();
+
+  const int file_;
+  const int block_size_;
+  std::unique_ptr<IoUring> ring_;
+  std::unique_ptr<FileOutputStream> fallback_;
+
+  std::vector<Slot> slots_;
+  std::vector<int> free_slots_;
+  // The slot being filled, or -1, and the bytes of it handed out.
+  int current_;
+  int buffer_used_;
+  unsigned batch_size_;
+  // File offset of the next block, and bytes written or queued.
+  uint64_t next_offset_;
+  int64_t position_;
+
+  bool close_on_delete_;
+  bool is_closed_;
+  bool failed_;
+  int errno_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFileOutputStream);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_ASYNC_FILE_OUTPUT_STREAM_H_
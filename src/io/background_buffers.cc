@@ -0,0 +1,133 @@
+#include "io/background_buffers.h"
+
+#include "system/env.h"
+
+#include <glog/logging.h>
+
+namespace io {
+
+BackgroundBuffers::BackgroundBuffers(core::Env* env,
+                                     const std::string& name,
+                                     BufferPool* pool,
+                                     int count,
+                                     int capacity,
+                                     bool thread_starts_with_buffers,
+                                     std::function<bool(Buffer*)> work)
+    : capacity_(capacity),
+      work_(std::move(work)),
+      busy_(false),
+      paused_(false),
+      stopping_(false),
+      stopped_(false) {
+  CHECK_GT(count, 0);
+  CHECK_GT(capacity, 0);
+  for (int i = 0; i < count; ++i) {
+    storage_.push_back(pool->Get(capacity));
+    CHECK(storage_.back() != nullptr) << "Out of memory";
+    Buffer buffer = {storage_.back().get(), 0};
+    if (thread_starts_with_buffers) {
+      to_thread_.push_back(buffer);
+    } else {
+      to_caller_.push_back(buffer);
+    }
+  }
+  thread_.reset(env->StartThread(core::ThreadOptions(), name,
+                                 [this]() { Run(); }));
+}
+
+BackgroundBuffers::~BackgroundBuffers() {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    stopping_ = true;
+  }
+  cond_var_.notify_all();
+  thread_.reset();
+}
+
+void BackgroundBuffers::Run() {
+  std::unique_lock<std::mutex> l(mu_);
+  while (true) {
+    while (!stopping_ && (paused_ || to_thread_.empty())) {
+      cond_var_.wait(l);
+    }
+    if (stopping_) {
+      return;
+    }
+    Buffer buffer = to_thread_.front();
+    to_thread_.pop_front();
+    busy_ = true;
+    l.unlock();
+
+    const bool more = work_(&buffer);
+
+    l.lock();
+    busy_ = false;
+    to_caller_.push_back(buffer);
+    stopped_ = !more;
+    cond_var_.notify_all();
+    if (stopped_) {
+      return;
+    }
+  }
+}
+
+bool BackgroundBuffers::Take(Buffer* buffer) {
+  std::unique_lock<std::mutex> l(mu_);
+  while (to_caller_.empty() && !stopped_) {
+    cond_var_.wait(l);
+  }
+  if (to_caller_.empty()) {
+    return false;
+  }
+  *buffer = to_caller_.front();
+  to_caller_.pop_front();
+  return true;
+}
+
+bool BackgroundBuffers::TryTake(Buffer* buffer) {
+  std::lock_guard<std::mutex> l(mu_);
+  if (to_caller_.empty()) {
+    return false;
+  }
+  *buffer = to_caller_.front();
+  to_caller_.pop_front();
+  return true;
+}
+
+void BackgroundBuffers::Give(const Buffer& buffer) {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    to_thread_.push_back(buffer);
+  }
+  cond_var_.notify_all();
+}
+
+void BackgroundBuffers::Pause() {
+  std::unique_lock<std::mutex> l(mu_);
+  paused_ = true;
+  while (busy_) {
+    cond_var_.wait(l);
+  }
+}
+
+void BackgroundBuffers::Resume() {
+  {
+    std::lock_guard<std::mutex> l(mu_);
+    paused_ = false;
+  }
+  cond_var_.notify_all();
+}
+
+void BackgroundBuffers::WaitIdle() {
+  std::unique_lock<std::mutex> l(mu_);
+  while (busy_ || (!to_thread_.empty() && !stopped_ && !paused_)) {
+    cond_var_.wait(l);
+  }
+}
+
+bool BackgroundBuffers::stopped() {
+  std::lock_guard<std::mutex> l(mu_);
+  return stopped_;
+}
+
+} // namespace io
@@ -0,0 +1,93 @@
+#ifndef CRYPTO_IO_BACKGROUND_BUFFERS_H_
+#define CRYPTO_IO_BACKGROUND_BUFFERS_H_
+
+#include "base/macros.h"
+#include "io/buffer_pool.h"
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace core {
+class Env;
+class Thread;
+} // namespace core
+
+namespace io {
+
+// A fixed set of buffers passed back and forth between the caller and a
+// helper thread, which runs |work| on every buffer it is given. For
+// read-ahead the thread starts with all buffers and fills them; for
+// write-behind the caller starts with them and the thread drains what
+// it is given. Either way the caller computes on one buffer while the
+// thread does I/O on the others.
+//
+// All methods but the constructor are for the one caller thread.
+class BackgroundBuffers {
+ public:
+  struct Buffer {
+    uint8_t* data;
+    // Bytes of data. |work| sets it; a negative size is an error.
+    int size;
+  };
+
+  // |work| gets every buffer given to the thread, and returns false to
+  // stop the thread once that buffer is handed back. The buffers come
+  // from |pool|.
+  BackgroundBuffers(core::Env* env, const std::string& name,
+                    BufferPool* pool, int count, int capacity,
+                    bool thread_starts_with_buffers,
+                    std::function<bool(Buffer*)> work);
+  // Stops the thread after the buffer it is working on; what it was
+  // given beyond that is dropped.
+  ~BackgroundBuffers();
+
+  int capacity() const { return capacity_; }
+
+  // Blocks until the thread hands back a buffer. False when it stopped
+  // and has none left.
+  bool Take(Buffer* buffer);
+  // Takes a buffer only when one is ready.
+  bool TryTake(Buffer* buffer);
+  // Hands |buffer| to the thread.
+  void Give(const Buffer& buffer);
+
+  // Blocks until the thread finishes the buffer it is working on, and
+  // keeps it from picking up another until Resume(), so that the caller
+  // may use the underlying stream itself.
+  void Pause();
+  void Resume();
+  // Blocks until the thread has no buffer to work on.
+  void WaitIdle();
+  // True once |work| returned false.
+  bool stopped();
+
+ private:
+  void Run();
+
+  const int capacity_;
+  const std::function<bool(Buffer*)> work_;
+  std::vector<BufferPool::Buffer> storage_;
+
+  std::mutex mu_;
+  std::condition_variable cond_var_;
+  std::deque<Buffer> to_thread_;
+  std::deque<Buffer> to_caller_;
+  bool busy_;
+  bool paused_;
+  bool stopping_;
+  bool stopped_;
+
+  // Last, so that the thread is joined before the rest goes away.
+  std::unique_ptr<core::Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(BackgroundBuffers);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_BACKGROUND_BUFFERS_H_
@@ -0,0 +1,236 @@
+#include "io/buffer_pool.h"
+
+#include "base/mem.h"
+
+#include <sys/mman.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace io {
+
+namespace {
+
+const size_t kHugePageSize = 2 << 20;
+
+// Set once the thread's cache is destroyed. Buffers released later in the
+// thread's exit, by other thread_local destructors, bypass the cache; a
+// plain bool needs no destructor of its own and stays readable until the
+// thread is gone.
+thread_local bool thread_cache_destroyed = false;
+
+} // namespace
+
+const size_t BufferPool::kMinClassSize;
+const size_t BufferPool::kMaxClassSize;
+const int BufferPool::kNumClasses;
+
+// The buffers a thread released to the Default() pool, handed back to its
+// shared lists when the thread exits.
+struct BufferPool::ThreadCache {
+  ~ThreadCache() {
+    thread_cache_destroyed = true;
+    BufferPool* pool = BufferPool::Default();
+    for (int c = 0; c < kNumClasses; ++c) {
+      for (uint8_t* buffer : lists[c]) {
+        --pool->cached_[c];
+        if (!pool->PushShared(c, buffer)) {
+          pool->FreeClass(c, buffer);
+        }
+      }
+    }
+  }
+
+  std::vector<uint8_t*> lists[kNumClasses];
+};
+
+void BufferPool::Deleter::operator()(uint8_t* buffer) const {
+  pool->Release(buffer, size);
+}
+
+// static
+BufferPool* BufferPool::Default() {
+  static BufferPool* pool = new BufferPool(Options(), true);
+  return pool;
+}
+
+BufferPool::BufferPool() : BufferPool(Options(), false) {}
+
+BufferPool::BufferPool(const Options& options)
+    : BufferPool(options, false) {}
+
+BufferPool::BufferPool(const Options& options, bool thread_caching)
+    : options_(options),
+      thread_caching_(thread_caching && options.thread_cache_size > 0),
+      hits_(0),
+      misses_(0),
+      unpooled_bytes_(0) {
+  for (int c = 0; c < kNumClasses; ++c) {
+    in_use_[c] = 0;
+    cached_[c] = 0;
+  }
+}
+
+BufferPool::~BufferPool() {
+  Trim();
+  for (int c = 0; c < kNumClasses; ++c) {
+    DCHECK_EQ(0, in_use_[c].load()) << "Buffers outlive their pool";
+  }
+}
+
+// static
+int BufferPool::ClassOf(size_t size) {
+  if (size > kMaxClassSize) {
+    return -1;
+  }
+  int size_class = 0;
+  while ((kMinClassSize << size_class) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+// static
+BufferPool::ThreadCache* BufferPool::GetThreadCache() {
+  if (thread_cache_destroyed) {
+    return nullptr;
+  }
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+uint8_t* BufferPool::AllocateClass(int size_class) {
+  const size_t size = kMinClassSize << size_class;
+  const bool huge = options_.huge_pages && size >= kHugePageSize;
+  uint8_t* buffer = static_cast<uint8_t*>(base::aligned_malloc(
+      size, huge ? static_cast<int>(kHugePageSize) : options_.alignment));
+  if (buffer && huge) {
+    // Only a hint; without THP the buffer is on small pages.
+    madvise(buffer, size, MADV_HUGEPAGE);
+  }
+  return buffer;
+}
+
+void BufferPool::FreeClass(int size_class, uint8_t* buffer) {
+  base::aligned_free(buffer);
+}
+
+uint8_t* BufferPool::PopShared(int size_class) {
+  std::lock_guard<std::mutex> l(mu_);
+  if (free_[size_class].empty()) {
+    return nullptr;
+  }
+  uint8_t* buffer = free_[size_class].back();
+  free_[size_class].pop_back();
+  --cached_[size_class];
+  return buffer;
+}
+
+bool BufferPool::PushShared(int size_class, uint8_t* buffer) {
+  std::lock_guard<std::mutex> l(mu_);
+  if (free_[size_class].size() >=
+      static_cast<size_t>(std::max(options_.max_free_per_class, 0))) {
+    return false;
+  }
+  free_[size_class].push_back(buffer);
+  ++cached_[size_class];
+  return true;
+}
+
+uint8_t* BufferPool::Allocate(size_t size) {
+  const int size_class = ClassOf(size);
+  if (size_class < 0) {
+    uint8_t* buffer = static_cast<uint8_t*>(
+        base::aligned_malloc(size, options_.alignment));
+    if (buffer) {
+      unpooled_bytes_ += size;
+    }
+    return buffer;
+  }
+
+  uint8_t* buffer = nullptr;
+  ThreadCache* cache = thread_caching_ ? GetThreadCache() : nullptr;
+  if (cache) {
+    std::vector<uint8_t*>& list = cache->lists[size_class];
+    if (!list.empty()) {
+      buffer = list.back();
+      list.pop_back();
+      --cached_[size_class];
+    }
+  }
+  if (!buffer) {
+    buffer = PopShared(size_class);
+  }
+  if (buffer) {
+    ++hits_;
+  } else {
+    buffer = AllocateClass(size_class);
+    if (!buffer) {
+      return nullptr;
+    }
+    ++misses_;
+  }
+  ++in_use_[size_class];
+  return buffer;
+}
+
+void BufferPool::Release(uint8_t* buffer, size_t size) {
+  if (!buffer) {
+    return;
+  }
+  const int size_class = ClassOf(size);
+  if (size_class < 0) {
+    base::aligned_free(buffer);
+    unpooled_bytes_ -= size;
+    return;
+  }
+
+  --in_use_[size_class];
+  ThreadCache* cache = thread_caching_ ? GetThreadCache() : nullptr;
+  if (cache) {
+    std::vector<uint8_t*>& list = cache->lists[size_class];
+    if (list.size() < static_cast<size_t>(options_.thread_cache_size)) {
+      list.push_back(buffer);
+      ++cached_[size_class];
+      return;
+    }
+  }
+  if (!PushShared(size_class, buffer)) {
+    FreeClass(size_class, buffer);
+  }
+}
+
+BufferPool::Buffer BufferPool::Get(size_t size) {
+  return Buffer(Allocate(size), Deleter{this, size});
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.bytes_in_use = unpooled_bytes_;
+  stats.bytes_cached = 0;
+  for (int c = 0; c < kNumClasses; ++c) {
+    ClassStats class_stats;
+    class_stats.buffer_size = kMinClassSize << c;
+    class_stats.in_use = in_use_[c];
+    class_stats.cached = cached_[c];
+    stats.bytes_in_use += class_stats.in_use * class_stats.buffer_size;
+    stats.bytes_cached += class_stats.cached * class_stats.buffer_size;
+    stats.classes.push_back(class_stats);
+  }
+  return stats;
+}
+
+void BufferPool::Trim() {
+  std::lock_guard<std::mutex> l(mu_);
+  for (int c = 0; c < kNumClasses; ++c) {
+    for (uint8_t* buffer : free_[c]) {
+      FreeClass(c, buffer);
+    }
+    cached_[c] -= free_[c].size();
+    free_[c].clear();
+  }
+}
+
+} // namespace io
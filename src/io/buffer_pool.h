@@ -0,0 +1,117 @@
+#ifndef CRYPTO_IO_BUFFER_POOL_H_
+#define CRYPTO_IO_BUFFER_POOL_H_
+
+#include "base/macros.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace io {
+
+// Buffers for the stream adaptors, kept in power-of-two size classes from
+// kMinClassSize to kMaxClassSize so that short-lived streams reuse them
+// instead of going to the allocator each time. A released buffer first
+// goes to a small cache of the releasing thread (Default() pool only),
+// then to the pool's shared lists, and is freed once those are full.
+// Larger requests are allocated and freed directly.
+class BufferPool {
+ public:
+  static const size_t kMinClassSize = 4 << 10;
+  static const size_t kMaxClassSize = 4 << 20;
+  static const int kNumClasses = 11;
+
+  struct Options {
+    // Of every buffer; base::aligned_malloc() takes care of it.
+    int alignment = 64;
+    // Classes of 2 MiB and up are 2 MiB aligned and asked to be backed
+    // by transparent huge pages.
+    bool huge_pages = false;
+    // Buffers a thread keeps per class.
+    int thread_cache_size = 4;
+    // Buffers the shared lists keep per class.
+    int max_free_per_class = 64;
+  };
+
+  struct ClassStats {
+    size_t buffer_size;
+    // Buffers handed out and not yet released.
+    int64_t in_use;
+    // Released buffers kept for reuse, thread caches included.
+    int64_t cached;
+  };
+
+  struct Stats {
+    std::vector<ClassStats> classes;
+    // Requests served from a cache, and those that allocated.
+    int64_t hits;
+    int64_t misses;
+    int64_t bytes_in_use;
+    int64_t bytes_cached;
+  };
+
+  // Gives a buffer back to its pool, or deletes an unpooled one.
+  struct Deleter {
+    BufferPool* pool;
+    size_t size;
+    void operator()(uint8_t* buffer) const;
+  };
+  typedef std::unique_ptr<uint8_t, Deleter> Buffer;
+
+  // The process-wide pool, with the default options. Never destroyed.
+  static BufferPool* Default();
+
+  BufferPool();
+  explicit BufferPool(const Options& options);
+  // Every buffer must have been released.
+  ~BufferPool();
+
+  // A buffer of at least |size| bytes, nullptr when out of memory.
+  uint8_t* Allocate(size_t size);
+  // |size| as given to Allocate().
+  void Release(uint8_t* buffer, size_t size);
+
+  // Allocate() into a Buffer that calls Release().
+  Buffer Get(size_t size);
+
+  Stats GetStats() const;
+
+  // Frees the buffers in the shared lists; thread caches are left alone.
+  void Trim();
+
+ private:
+  struct ThreadCache;
+
+  BufferPool(const Options& options, bool thread_caching);
+
+  // The class of |size|, or -1 past kMaxClassSize.
+  static int ClassOf(size_t size);
+  // The calling thread's cache, nullptr once it was destroyed.
+  static ThreadCache* GetThreadCache();
+
+  uint8_t* AllocateClass(int size_class);
+  void FreeClass(int size_class, uint8_t* buffer);
+  // Takes from, or adds to, the shared list of |size_class|.
+  uint8_t* PopShared(int size_class);
+  bool PushShared(int size_class, uint8_t* buffer);
+
+  const Options options_;
+  const bool thread_caching_;
+
+  mutable std::mutex mu_;
+  std::vector<uint8_t*> free_[kNumClasses];
+
+  std::atomic<int64_t> in_use_[kNumClasses];
+  std::atomic<int64_t> cached_[kNumClasses];
+  std::atomic<int64_t> hits_;
+  std::atomic<int64_t> misses_;
+  std::atomic<int64_t> unpooled_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_BUFFER_POOL_H_
@@ -1,5 +1,7 @@
 #include "io/copy_input_stream.h"
 
+#include "system/env.h"
+
 #include <glog/logging.h>
 
 namespace io {
@@ -28,21 +30,58 @@ CopyInputStreamAdaptor::CopyInputStreamAdaptor(
       owns_copy_stream_(false),
       failed_(false),
       position_(0),
+      pool_(BufferPool::Default()),
       buffer_size_(block_size > 0 ? block_size : kDefaultBlockSize),
       buffer_used_(0),
-      backup_bytes_(0) {
+      backup_bytes_(0),
+      has_current_(false) {
 }
   
 CopyInputStreamAdaptor::~CopyInputStreamAdaptor() {
+  // The thread may be in the middle of a Read().
+  read_ahead_.reset();
   if (owns_copy_stream_) {
     delete copy_stream_;
   }
 }
   
+void CopyInputStreamAdaptor::SetBufferPool(BufferPool* pool) {
+  CHECK(!read_ahead_ && buffer_.get() == NULL)
+    << " SetBufferPool() must come before SetReadAhead() and Next().";
+  pool_ = pool;
+}
+
+void CopyInputStreamAdaptor::SetReadAhead(int num_buffers, core::Env* env) {
+  CHECK(!read_ahead_ && buffer_.get() == NULL)
+    << " SetReadAhead() must come before the first Next().";
+  read_ahead_.reset(new BackgroundBuffers(
+      env, "read_ahead", pool_, num_buffers, buffer_size_, true,
+      [this](BackgroundBuffers::Buffer* buffer) {
+        buffer->size = copy_stream_->Read(buffer->data, buffer_size_);
+        return buffer->size > 0;
+      }));
+}
+
+void CopyInputStreamAdaptor::StopReadAhead() {
+  if (!read_ahead_) {
+    return;
+  }
+  // The buffers, current_ among them, go with the thread.
+  read_ahead_.reset();
+  has_current_ = false;
+  buffer_used_ = 0;
+  backup_bytes_ = 0;
+  failed_ = true;
+}
+
 bool CopyInputStreamAdaptor::Next(const void** data, int* size) {
     if (failed_) {
       return false;
     }
+
+    if (read_ahead_) {
+      return NextReadAhead(data, size);
+    }
   
     AllocateBufferIfNeeded();
   
@@ -69,7 +108,7 @@ bool CopyInputStreamAdaptor::Next(const void** data, int* size) {
 }
   
 void CopyInputStreamAdaptor::BackUp(int count) {
-    CHECK(backup_bytes_ == 0 && buffer_.get() != NULL)
+    CHECK(backup_bytes_ == 0 && (buffer_.get() != NULL || has_current_))
       << " BackUp() can only be called after Next().";
     CHECK_LE(count, buffer_used_)
       << " Can't back up over more bytes than were returned by the last call"
@@ -94,6 +133,10 @@ bool CopyInputStreamAdaptor::Skip(int count) {
   
     count -= backup_bytes_;
     backup_bytes_ = 0;
+
+    if (read_ahead_) {
+      return SkipReadAhead(count);
+    }
   
     int skipped = copy_stream_->Skip(count);
     position_ += skipped;
@@ -106,7 +149,8 @@ int64_t CopyInputStreamAdaptor::ByteCount() const {
   
 void CopyInputStreamAdaptor::AllocateBufferIfNeeded() {
   if (buffer_.get() == NULL) {
-    buffer_.reset(new uint8_t[buffer_size_]);
+    buffer_ = pool_->Get(buffer_size_);
+    CHECK(buffer_.get() != NULL) << "Out of memory";
   }
 }
   
@@ -116,4 +160,72 @@ void CopyInputStreamAdaptor::FreeBuffer() {
   buffer_.reset();
 }
 
+bool CopyInputStreamAdaptor::NextReadAhead(const void** data, int* size) {
+  if (backup_bytes_ > 0) {
+    *data = current_.data + buffer_used_ - backup_bytes_;
+    *size = backup_bytes_;
+    backup_bytes_ = 0;
+    return true;
+  }
+
+  if (has_current_) {
+    read_ahead_->Give(current_);
+    has_current_ = false;
+  }
+  // Once the thread stopped at the end, or an error, nothing comes back.
+  if (!read_ahead_->Take(&current_)) {
+    return false;
+  }
+  if (current_.size <= 0) {
+    if (current_.size < 0) {
+      failed_ = true;
+    }
+    read_ahead_->Give(current_);
+    return false;
+  }
+  has_current_ = true;
+  buffer_used_ = current_.size;
+  position_ += buffer_used_;
+
+  *data = current_.data;
+  *size = buffer_used_;
+  return true;
+}
+
+bool CopyInputStreamAdaptor::SkipReadAhead(int count) {
+  // Skips what the thread read already, then the rest on the copy
+  // stream itself while the thread waits.
+  if (has_current_) {
+    read_ahead_->Give(current_);
+    has_current_ = false;
+  }
+  read_ahead_->Pause();
+  BackgroundBuffers::Buffer buffer;
+  while (count > 0 && read_ahead_->TryTake(&buffer)) {
+    if (buffer.size <= 0) {
+      if (buffer.size < 0) {
+        failed_ = true;
+      }
+      read_ahead_->Give(buffer);
+      read_ahead_->Resume();
+      return false;
+    }
+    position_ += buffer.size;
+    if (buffer.size > count) {
+      current_ = buffer;
+      has_current_ = true;
+      buffer_used_ = buffer.size;
+      backup_bytes_ = buffer.size - count;
+      read_ahead_->Resume();
+      return true;
+    }
+    count -= buffer.size;
+    read_ahead_->Give(buffer);
+  }
+  int skipped = count > 0 ? copy_stream_->Skip(count) : 0;
+  position_ += skipped;
+  read_ahead_->Resume();
+  return skipped == count;
+}
+
 } // namespace io
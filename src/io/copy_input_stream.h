@@ -1,10 +1,16 @@
 #ifndef CRYPTO_IO_COPY_INPUT_STREAM_H_
 #define CRYPTO_IO_COPY_INPUT_STREAM_H_
 
+#include "io/background_buffers.h"
+#include "io/buffer_pool.h"
 #include "io/input_stream.h"
 
 #include <memory>
 
+namespace core {
+class Env;
+} // namespace core
+
 namespace io {
 
 class CopyInputStream {
@@ -23,6 +29,21 @@ class CopyInputStreamAdaptor : public InputStream {
 
   void SetOwnsCopyStream(bool value) { owns_copy_stream_ = value; }
 
+  // Where the buffers come from, BufferPool::Default() unless set. Call
+  // before SetReadAhead() and before the first Next(); the buffers in
+  // hand are never moved to another pool.
+  void SetBufferPool(BufferPool* pool);
+
+  // Reads up to |num_buffers| blocks ahead on a thread of |env|, so that
+  // the copy stream's Read() runs while the caller works on the block
+  // Next() returned. Call before the first Next(); from then on the copy
+  // stream is only used on that thread, but for Skip().
+  void SetReadAhead(int num_buffers, core::Env* env);
+  // Waits for the Read() in progress and stops the read-ahead thread, so
+  // that the copy stream can be closed under it. What it read is dropped,
+  // and Next() and Skip() fail from then on.
+  void StopReadAhead();
+
   // From InputStream
   bool Next(const void** data, int* size);
   void BackUp(int count);
@@ -32,6 +53,8 @@ class CopyInputStreamAdaptor : public InputStream {
  private:
   void AllocateBufferIfNeeded();
   void FreeBuffer();
+  bool NextReadAhead(const void** data, int* size);
+  bool SkipReadAhead(int count);
 
   CopyInputStream* copy_stream_;
   bool owns_copy_stream_;
@@ -40,12 +63,18 @@ class CopyInputStreamAdaptor : public InputStream {
 
   int64_t position_;
 
-  std::unique_ptr<uint8_t[]> buffer_;
+  BufferPool* pool_;
+  BufferPool::Buffer buffer_;
   const int buffer_size_;
 
   int buffer_used_;
   int backup_bytes_;
 
+  // In read-ahead mode, the buffers and the one Next() returned last.
+  std::unique_ptr<BackgroundBuffers> read_ahead_;
+  BackgroundBuffers::Buffer current_;
+  bool has_current_;
+
   DISALLOW_COPY_AND_ASSIGN(CopyInputStreamAdaptor);
 };
 
@@ -1,5 +1,7 @@
 #include "io/copy_output_stream.h"
 
+#include "system/env.h"
+
 #include <glog/logging.h>
 
 namespace io {
@@ -14,22 +16,73 @@ CopyOutputStreamAdaptor::CopyOutputStreamAdaptor(
       owns_copying_stream_(false),
       failed_(false),
       position_(0),
+      pool_(BufferPool::Default()),
       buffer_size_(block_size > 0 ? block_size : kDefaultBlockSize),
-      buffer_used_(0) {
+      buffer_used_(0),
+      has_current_(false) {
 }
   
 CopyOutputStreamAdaptor::~CopyOutputStreamAdaptor() {
-  WriteBuffer();
+  Flush();
+  write_behind_.reset();
     if (owns_copying_stream_) {
       delete copying_stream_;
     }
 }
   
+void CopyOutputStreamAdaptor::SetBufferPool(BufferPool* pool) {
+  CHECK(!write_behind_ && buffer_.get() == NULL)
+    << " SetBufferPool() must come before SetWriteBehind() and Next().";
+  pool_ = pool;
+}
+
+void CopyOutputStreamAdaptor::SetWriteBehind(int num_buffers,
+                                             core::Env* env) {
+  CHECK(!write_behind_ && buffer_.get() == NULL)
+    << " SetWriteBehind() must come before the first Next().";
+  write_behind_.reset(new BackgroundBuffers(
+      env, "write_behind", pool_, num_buffers, buffer_size_, false,
+      [this](BackgroundBuffers::Buffer* buffer) {
+        const bool written = copying_stream_->Write(buffer->data,
+                                                    buffer->size);
+        buffer->size = written ? 0 : -1;
+        return written;
+      }));
+}
+
+void CopyOutputStreamAdaptor::StopWriteBehind() {
+  if (!write_behind_) {
+    return;
+  }
+  write_behind_->WaitIdle();
+  // The buffers, current_ among them, go with the thread.
+  write_behind_.reset();
+  has_current_ = false;
+  buffer_used_ = 0;
+  failed_ = true;
+}
+
 bool CopyOutputStreamAdaptor::Flush() {
-    return WriteBuffer();
+    bool flushed = WriteBuffer();
+    if (write_behind_) {
+      write_behind_->WaitIdle();
+      if (write_behind_->stopped()) {
+        failed_ = true;
+        flushed = false;
+      }
+    }
+    return flushed;
 }
   
 bool CopyOutputStreamAdaptor::Next(void** data, int* size) {
+    if (failed_) {
+      return false;
+    }
+
+    if (write_behind_) {
+      return NextWriteBehind(data, size);
+    }
+
     if (buffer_used_ == buffer_size_) {
       if (!WriteBuffer()) return false;
     }
@@ -63,6 +116,20 @@ void CopyOutputStreamAdaptor::BackUp(int count) {
     }
   
     if (buffer_used_ == 0) return true;
+
+    if (write_behind_) {
+      // The thread stops at the first failed Write().
+      if (write_behind_->stopped()) {
+        failed_ = true;
+        return false;
+      }
+      current_.size = buffer_used_;
+      write_behind_->Give(current_);
+      has_current_ = false;
+      position_ += buffer_used_;
+      buffer_used_ = 0;
+      return true;
+    }
   
     if (copying_stream_->Write(buffer_.get(), buffer_used_)) {
       position_ += buffer_used_;
@@ -77,7 +144,8 @@ void CopyOutputStreamAdaptor::BackUp(int count) {
   
 void CopyOutputStreamAdaptor::AllocateBufferIfNeeded() {
     if (buffer_ == NULL) {
-      buffer_.reset(new uint8_t[buffer_size_]);
+      buffer_ = pool_->Get(buffer_size_);
+      CHECK(buffer_ != NULL) << "Out of memory";
     }
   }
   
@@ -86,4 +154,26 @@ void CopyOutputStreamAdaptor::AllocateBufferIfNeeded() {
     buffer_.reset();
   }
 
+bool CopyOutputStreamAdaptor::NextWriteBehind(void** data, int* size) {
+  if (buffer_used_ == buffer_size_) {
+    if (!WriteBuffer()) return false;
+  }
+  if (failed_) {
+    return false;
+  }
+
+  if (!has_current_) {
+    if (!write_behind_->Take(&current_) || current_.size < 0) {
+      failed_ = true;
+      return false;
+    }
+    has_current_ = true;
+  }
+
+  *data = current_.data + buffer_used_;
+  *size = buffer_size_ - buffer_used_;
+  buffer_used_ = buffer_size_;
+  return true;
+}
+
 } // namespace io
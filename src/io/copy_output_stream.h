@@ -2,10 +2,16 @@
 #define CRYPTO_IO_COPY_OUTPUT_STREAM_H_
 
 #include "base/macros.h"
+#include "io/background_buffers.h"
+#include "io/buffer_pool.h"
 #include "io/output_stream.h"
 
 #include <memory>
 
+namespace core {
+class Env;
+} // namespace core
+
 namespace io {
 
 class CopyOutputStream {
@@ -24,6 +30,21 @@ class CopyOutputStreamAdaptor : public OutputStream {
   bool Flush();
   
   void SetOwnsCopyingStream(bool value) { owns_copying_stream_ = value; }
+
+  // Where the buffers come from, BufferPool::Default() unless set. Call
+  // before SetWriteBehind() and before the first Next(); the buffers in
+  // hand are never moved to another pool.
+  void SetBufferPool(BufferPool* pool);
+
+  // Writes filled blocks on a thread of |env| with up to |num_buffers|
+  // blocks in hand, so that the copy stream's Write() runs while the
+  // caller fills the next one. Call before the first Next(); Flush() then
+  // also waits for the thread to write everything out.
+  void SetWriteBehind(int num_buffers, core::Env* env);
+  // Waits for the Write() calls already handed to the thread and stops
+  // it, so that the copy stream can be closed under it. What was not
+  // flushed is dropped, and Next() and Flush() fail from then on.
+  void StopWriteBehind();
   
   // From OutputStream
   bool Next(void** data, int* size);
@@ -34,6 +55,7 @@ class CopyOutputStreamAdaptor : public OutputStream {
   bool WriteBuffer();
   void AllocateBufferIfNeeded();
   void FreeBuffer();
+  bool NextWriteBehind(void** data, int* size);
   
   CopyOutputStream* copying_stream_;
   bool owns_copying_stream_;
@@ -42,10 +64,16 @@ class CopyOutputStreamAdaptor : public OutputStream {
   
   int64_t position_;
   
-  std::unique_ptr<uint8_t[]> buffer_;
+  BufferPool* pool_;
+  BufferPool::Buffer buffer_;
   const int buffer_size_;
   
   int buffer_used_;
+
+  // In write-behind mode, the buffers and the one being filled.
+  std::unique_ptr<BackgroundBuffers> write_behind_;
+  BackgroundBuffers::Buffer current_;
+  bool has_current_;
   
   DISALLOW_COPY_AND_ASSIGN(CopyOutputStreamAdaptor);
 };
@@ -34,6 +34,8 @@ FileInputStream::FileInputStream(int file_descriptor, int block_size)
 FileInputStream::~FileInputStream() {}
 
 bool FileInputStream::Close() {
+  // The read-ahead thread may be inside read() on the descriptor.
+  impl_.StopReadAhead();
   return copying_input_.Close();
 }
 
@@ -5,6 +5,8 @@
 #include "io/input_stream.h"
 #include "io/copy_input_stream.h"
 
+#include <atomic>
+
 namespace io {
 
 class FileInputStream : public InputStream {
@@ -17,6 +19,12 @@ class FileInputStream : public InputStream {
   void SetCloseOnDelete(bool value) { copying_input_.SetCloseOnDelete(value); }
   
   int GetErrno() { return copying_input_.GetErrno(); }
+
+  // See CopyInputStreamAdaptor::SetReadAhead(). Close() stops the thread
+  // before it closes the file.
+  void SetReadAhead(int num_buffers, core::Env* env) {
+    impl_.SetReadAhead(num_buffers, env);
+  }
   
   // From InputStream
   bool Next(const void** data, int* size);
@@ -32,7 +40,7 @@ class FileInputStream : public InputStream {
     
     bool Close();
     void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
-    int GetErrno() { return errno_; } 
+    int GetErrno() { return errno_.load(); }
     
     // From CopyInputStream
     int Read(void* buffer, int size);
@@ -43,7 +51,8 @@ class FileInputStream : public InputStream {
     bool close_on_delete_;
     bool is_closed_;
     
-    int errno_;
+    // Set by Read() on the read-ahead thread, if there is one.
+    std::atomic<int> errno_;
     
     bool previous_seek_failed_;
     
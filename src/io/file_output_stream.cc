@@ -36,6 +36,8 @@ FileOutputStream::~FileOutputStream() {
 
 bool FileOutputStream::Close() {
   bool flush_succeeded = impl_.Flush();
+  // Nothing may reach the write-behind thread once the fd is closed.
+  impl_.StopWriteBehind();
   return copying_output_.Close() && flush_succeeded;
 }
 
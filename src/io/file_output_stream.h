@@ -4,6 +4,8 @@
 #include "io/output_stream.h"
 #include "io/copy_output_stream.h"
 
+#include <atomic>
+
 namespace io {
 
 class FileOutputStream : public OutputStream {
@@ -18,6 +20,12 @@ class FileOutputStream : public OutputStream {
   void SetCloseOnDelete(bool value) { copying_output_.SetCloseOnDelete(value); }
   
   int GetErrno() { return copying_output_.GetErrno(); }
+
+  // See CopyOutputStreamAdaptor::SetWriteBehind(). Close() stops the
+  // thread before it closes the file.
+  void SetWriteBehind(int num_buffers, core::Env* env) {
+    impl_.SetWriteBehind(num_buffers, env);
+  }
   
   bool Next(void** data, int* size);
   void BackUp(int count);
@@ -31,7 +39,7 @@ class FileOutputStream : public OutputStream {
     
     bool Close();
     void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
-    int GetErrno() { return errno_; } 
+    int GetErrno() { return errno_.load(); }
     
     bool Write(const void* buffer, int size);
     
@@ -40,7 +48,8 @@ class FileOutputStream : public OutputStream {
     bool close_on_delete_;
     bool is_closed_;
     
-    int errno_;
+    // Set by Write() on the write-behind thread, if there is one.
+    std::atomic<int> errno_;
     
     DISALLOW_COPY_AND_ASSIGN(CopyFileOutputStream);
   };
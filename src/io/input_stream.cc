@@ -1,7 +1,38 @@
 #include "io/input_stream.h"
 
+#include <limits.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
 namespace io {
 
 InputStream::~InputStream() {}
 
+bool InputStream::Next64(const void** data, int64_t* size) {
+  int int_size;
+  if (!Next(data, &int_size)) {
+    return false;
+  }
+  *size = int_size;
+  return true;
+}
+
+void InputStream::BackUp64(int64_t count) {
+  CHECK_LE(count, INT_MAX);
+  BackUp(static_cast<int>(count));
+}
+
+bool InputStream::Skip64(int64_t count) {
+  CHECK_GE(count, 0);
+  while (count > 0) {
+    const int step = static_cast<int>(std::min<int64_t>(count, INT_MAX));
+    if (!Skip(step)) {
+      return false;
+    }
+    count -= step;
+  }
+  return true;
+}
+
 } // namespace io
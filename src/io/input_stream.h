@@ -31,6 +31,14 @@ class InputStream {
   virtual bool Skip(int count) = 0;
   virtual int64_t ByteCount() const = 0;
 
+  // The same with 64-bit sizes, for streams over more than 2 GiB. A
+  // stream that overrides them may hand out windows past kint32max from
+  // Next64(), while Next() never returns more than fits an int. The
+  // defaults go through the calls above.
+  virtual bool Next64(const void** data, int64_t* size);
+  virtual void BackUp64(int64_t count);
+  virtual bool Skip64(int64_t count);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(InputStream);
 };
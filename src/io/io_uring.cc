@@ -0,0 +1,193 @@
+#include "io/io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace io {
+
+namespace {
+
+void* MapRing(int fd, size_t size, off_t offset) {
+  void* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, offset);
+  return ring == MAP_FAILED ? nullptr : ring;
+}
+
+template <typename T>
+T* At(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+} // namespace
+
+IoUring::IoUring()
+    : fd_(-1),
+      sq_ring_(nullptr),
+      sq_ring_size_(0),
+      cq_ring_(nullptr),
+      cq_ring_size_(0),
+      sqes_(nullptr),
+      sqes_size_(0),
+      sq_local_tail_(0),
+      sq_submitted_(0) {}
+
+IoUring::~IoUring() {
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+// static
+std::unique_ptr<IoUring> IoUring::Create(unsigned entries) {
+#ifdef __NR_io_uring_setup
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    VLOG(1) << "io_uring_setup() failed: " << strerror(errno);
+    return nullptr;
+  }
+
+  std::unique_ptr<IoUring> ring(new IoUring);
+  ring->fd_ = fd;
+  ring->sq_ring_size_ = params.sq_off.array +
+                        params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size_ = params.cq_off.cqes +
+                        params.cq_entries * sizeof(struct io_uring_cqe);
+  // Kernels since 5.4 share one mapping between both rings.
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->sq_ring_size_ = ring->cq_ring_size_ =
+        std::max(ring->sq_ring_size_, ring->cq_ring_size_);
+  }
+  ring->sq_ring_ = MapRing(fd, ring->sq_ring_size_, IORING_OFF_SQ_RING);
+  if (!ring->sq_ring_) {
+    return nullptr;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring_ = ring->sq_ring_;
+  } else {
+    ring->cq_ring_ = MapRing(fd, ring->cq_ring_size_, IORING_OFF_CQ_RING);
+    if (!ring->cq_ring_) {
+      return nullptr;
+    }
+  }
+  ring->sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes_ = static_cast<struct io_uring_sqe*>(
+      MapRing(fd, ring->sqes_size_, IORING_OFF_SQES));
+  if (!ring->sqes_) {
+    return nullptr;
+  }
+
+  ring->sq_head_ = At<unsigned>(ring->sq_ring_, params.sq_off.head);
+  ring->sq_tail_ = At<unsigned>(ring->sq_ring_, params.sq_off.tail);
+  ring->sq_mask_ = *At<unsigned>(ring->sq_ring_, params.sq_off.ring_mask);
+  ring->sq_entries_ = params.sq_entries;
+  ring->sq_array_ = At<unsigned>(ring->sq_ring_, params.sq_off.array);
+  ring->cq_head_ = At<unsigned>(ring->cq_ring_, params.cq_off.head);
+  ring->cq_tail_ = At<unsigned>(ring->cq_ring_, params.cq_off.tail);
+  ring->cq_mask_ = *At<unsigned>(ring->cq_ring_, params.cq_off.ring_mask);
+  ring->cqes_ = At<struct io_uring_cqe>(ring->cq_ring_, params.cq_off.cqes);
+  ring->sq_local_tail_ = ring->sq_submitted_ = *ring->sq_tail_;
+  return ring;
+#else
+  return nullptr;
+#endif
+}
+
+bool IoUring::PrepareRead(int fd, const struct iovec* iov, uint64_t offset,
+                          uint64_t user_data) {
+  return Prepare(IORING_OP_READV, fd, iov, offset, user_data);
+}
+
+bool IoUring::PrepareWrite(int fd, const struct iovec* iov, uint64_t offset,
+                           uint64_t user_data) {
+  return Prepare(IORING_OP_WRITEV, fd, iov, offset, user_data);
+}
+
+bool IoUring::Prepare(uint8_t opcode, int fd, const struct iovec* iov,
+                      uint64_t offset, uint64_t user_data) {
+  const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (sq_local_tail_ - head >= sq_entries_) {
+    return false;
+  }
+  const unsigned index = sq_local_tail_ & sq_mask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = 1;
+  sqe->user_data = user_data;
+  sq_array_[index] = index;
+  ++sq_local_tail_;
+  return true;
+}
+
+int IoUring::Enter(unsigned to_submit, unsigned min_complete) {
+  int result;
+  do {
+    result = syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                     min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+                     nullptr, 0);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+bool IoUring::Submit() {
+  while (pending() > 0) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    int submitted = Enter(pending(), 0);
+    if (submitted < 0) {
+      return false;
+    }
+    if (submitted == 0) {
+      errno = EBUSY;
+      return false;
+    }
+    sq_submitted_ += submitted;
+  }
+  return true;
+}
+
+bool IoUring::PeekCompletion(Completion* completion) {
+  const unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  const struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+  completion->user_data = cqe->user_data;
+  completion->result = cqe->res;
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool IoUring::WaitCompletion(Completion* completion) {
+  if (!Submit()) {
+    return false;
+  }
+  while (!PeekCompletion(completion)) {
+    if (Enter(0, 1) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace io
@@ -0,0 +1,82 @@
+#ifndef CRYPTO_IO_IO_URING_H_
+#define CRYPTO_IO_IO_URING_H_
+
+#include "base/macros.h"
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <memory>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace io {
+
+// A minimal io_uring instance on the raw system calls, enough for the
+// async file streams: queue vectored reads and writes at given offsets,
+// submit them in one call, and reap completions. Not thread-safe.
+class IoUring {
+ public:
+  struct Completion {
+    uint64_t user_data;
+    // Bytes transferred, or -errno.
+    int32_t result;
+  };
+
+  // A ring with room for |entries| requests, or nullptr when the kernel
+  // has no io_uring or does not let this process use it.
+  static std::unique_ptr<IoUring> Create(unsigned entries);
+  ~IoUring();
+
+  // Queue a readv()/writev() of |iov| at |offset| of |fd|. |iov| must
+  // stay valid until the request completes. False when the submission
+  // queue is full.
+  bool PrepareRead(int fd, const struct iovec* iov, uint64_t offset,
+                   uint64_t user_data);
+  bool PrepareWrite(int fd, const struct iovec* iov, uint64_t offset,
+                    uint64_t user_data);
+
+  // Hands every queued request to the kernel. Returns false and sets
+  // errno when the kernel refuses them.
+  bool Submit();
+  // Submits what is queued, then blocks until a completion is there.
+  bool WaitCompletion(Completion* completion);
+  // Takes a completion if one is there, without a system call.
+  bool PeekCompletion(Completion* completion);
+
+  // Requests queued but not submitted.
+  unsigned pending() const { return sq_local_tail_ - sq_submitted_; }
+
+ private:
+  IoUring();
+
+  bool Prepare(uint8_t opcode, int fd, const struct iovec* iov,
+               uint64_t offset, uint64_t user_data);
+  int Enter(unsigned to_submit, unsigned min_complete);
+
+  int fd_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  unsigned sq_local_tail_;
+  unsigned sq_submitted_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_IO_URING_H_
@@ -69,4 +69,58 @@ bool IOUtil::WriteToOutput(OutputStream* output,
   }
 }
 
+int64_t IOUtil::ReadFromInput64(InputStream* input,
+                                void* data,
+                                int64_t size) {
+  uint8_t* out = reinterpret_cast<uint8_t*>(data);
+  int64_t out_size = size;
+
+  const void* in;
+  int64_t in_size = 0;
+
+  while (true) {
+    if (!input->Next64(&in, &in_size)) {
+      return size - out_size;
+    }
+
+    if (out_size <= in_size) {
+      memcpy(out, in, out_size);
+      if (in_size > out_size) {
+        input->BackUp64(in_size - out_size);
+      }
+      return size;
+    }
+
+    memcpy(out, in, in_size);
+    out += in_size;
+    out_size -= in_size;
+  }
+}
+
+bool IOUtil::WriteToOutput64(OutputStream* output,
+                             const void* data,
+                             int64_t size) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+  int64_t in_size = size;
+
+  void* out;
+  int64_t out_size;
+
+  while (true) {
+    if (!output->Next64(&out, &out_size)) {
+      return false;
+    }
+
+    if (in_size <= out_size) {
+      memcpy(out, in, in_size);
+      output->BackUp64(out_size - in_size);
+      return true;
+    }
+
+    memcpy(out, in, out_size);
+    in += out_size;
+    in_size -= out_size;
+  }
+}
+
 } // namespace io
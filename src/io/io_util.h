@@ -16,6 +16,14 @@ class IOUtil {
                             int size);
   static bool PeekInput(InputStream* input);
 
+  // The same over 64-bit sizes, through Next64() and BackUp64().
+  static int64_t ReadFromInput64(InputStream* input,
+                                 void* data,
+                                 int64_t size);
+  static bool WriteToOutput64(OutputStream* output,
+                              const void* data,
+                              int64_t size);
+
  private:
   IOUtil();
 };
@@ -0,0 +1,152 @@
+#include "io/mapped_file_input_stream.h"
+
+#include "files/file_system.h"
+#include "system/env.h"
+
+#include <limits.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace io {
+
+namespace {
+
+// Passes |advice| for [|begin|, |end|) of the mapping at |data|. These are
+// only hints, so a failure, say for a region that is not a mapping at
+// all, is ignored.
+void Advise(const uint8_t* data, uint64_t begin, uint64_t end, int advice) {
+  static const uintptr_t kPageMask = sysconf(_SC_PAGESIZE) - 1;
+  const uintptr_t first =
+      reinterpret_cast<uintptr_t>(data + begin) & ~kPageMask;
+  const uintptr_t last = reinterpret_cast<uintptr_t>(data + end);
+  if (last > first) {
+    madvise(reinterpret_cast<void*>(first), last - first, advice);
+  }
+}
+
+} // namespace
+
+const int MappedFileInputStream::kDefaultBlockSize;
+const int MappedFileInputStream::kDefaultReadAhead;
+
+MappedFileInputStream::MappedFileInputStream(
+    std::unique_ptr<files::ReadOnlyMemoryRegion> region,
+    int64_t block_size,
+    int read_ahead)
+    : region_(std::move(region)),
+      data_(region_ ? reinterpret_cast<const uint8_t*>(region_->data())
+                    : nullptr),
+      size_(region_ ? region_->length() : 0),
+      block_size_(block_size > 0 ? block_size : kDefaultBlockSize),
+      read_ahead_(std::max(read_ahead, 0)),
+      position_(0),
+      last_returned_size_(0),
+      advised_(0) {
+  if (size_ > 0) {
+    Advise(data_, 0, size_, MADV_SEQUENTIAL);
+    AdviseAhead();
+  }
+}
+
+MappedFileInputStream::~MappedFileInputStream() {}
+
+// static
+base::Status MappedFileInputStream::Open(
+    core::Env* env,
+    const std::string& fname,
+    std::unique_ptr<MappedFileInputStream>* result,
+    int64_t block_size) {
+  uint64_t size = 0;
+  base::Status status = env->GetFileSize(fname, &size);
+  if (!status.ok()) {
+    return status;
+  }
+  std::unique_ptr<files::ReadOnlyMemoryRegion> region;
+  if (size > 0) {
+    status = env->NewReadOnlyMemoryRegionFromFile(fname, &region);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  result->reset(new MappedFileInputStream(std::move(region), block_size));
+  return base::Status::OK;
+}
+
+void MappedFileInputStream::AdviseAhead() {
+  if (read_ahead_ == 0 || advised_ == size_ ||
+      position_ + read_ahead_ / 2 < advised_) {
+    return;
+  }
+  const uint64_t begin = std::max(position_, advised_);
+  const uint64_t end = std::min(size_, position_ + read_ahead_);
+  if (begin < end) {
+    Advise(data_, begin, end, MADV_WILLNEED);
+  }
+  advised_ = end;
+}
+
+bool MappedFileInputStream::Next(const void** data, int* size) {
+  int64_t window;
+  if (!NextWindow(data, &window, INT_MAX)) {
+    return false;
+  }
+  *size = static_cast<int>(window);
+  return true;
+}
+
+bool MappedFileInputStream::Next64(const void** data, int64_t* size) {
+  return NextWindow(data, size, block_size_);
+}
+
+bool MappedFileInputStream::NextWindow(const void** data, int64_t* size,
+                                       int64_t max_size) {
+  if (position_ < size_) {
+    last_returned_size_ = static_cast<int64_t>(std::min<uint64_t>(
+        std::min(block_size_, max_size), size_ - position_));
+    *data = data_ + position_;
+    *size = last_returned_size_;
+    position_ += last_returned_size_;
+    AdviseAhead();
+    return true;
+  } else {
+    last_returned_size_ = 0;
+    return false;
+  }
+}
+
+void MappedFileInputStream::BackUp(int count) {
+  BackUp64(count);
+}
+
+void MappedFileInputStream::BackUp64(int64_t count) {
+  CHECK_GT(last_returned_size_, 0)
+      << "BackUp() can only be called after a successful Next()";
+  CHECK_LE(count, last_returned_size_);
+  CHECK_GE(count, 0);
+  position_ -= count;
+  last_returned_size_ = 0;
+}
+
+bool MappedFileInputStream::Skip(int count) {
+  return Skip64(count);
+}
+
+bool MappedFileInputStream::Skip64(int64_t count) {
+  CHECK_GE(count, 0);
+  last_returned_size_ = 0;
+  if (static_cast<uint64_t>(count) > size_ - position_) {
+    position_ = size_;
+    return false;
+  }
+  position_ += count;
+  return true;
+}
+
+int64_t MappedFileInputStream::ByteCount() const {
+  return position_;
+}
+
+} // namespace io
@@ -0,0 +1,83 @@
+#ifndef CRYPTO_IO_MAPPED_FILE_INPUT_STREAM_H_
+#define CRYPTO_IO_MAPPED_FILE_INPUT_STREAM_H_
+
+#include "base/macros.h"
+#include "base/status.h"
+#include "io/input_stream.h"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace core {
+class Env;
+} // namespace core
+
+namespace files {
+class ReadOnlyMemoryRegion;
+} // namespace files
+
+namespace io {
+
+// An InputStream over a ReadOnlyMemoryRegion, normally a file mapped by
+// Env::NewReadOnlyMemoryRegionFromFile(). Next() returns slices of the
+// mapping itself, so unlike FileInputStream no byte is copied into a
+// buffer, and Skip() and BackUp() only move the position.
+//
+// Next64() hands out up to |block_size| bytes, which may be set past
+// kint32max to read a large file in one window; Next() stops at kint32max.
+//
+// The mapping is advised as read sequentially, and the |read_ahead| bytes
+// past the position are asked for with MADV_WILLNEED, so that the pages a
+// reader touches next are mostly in memory by then.
+class MappedFileInputStream : public InputStream {
+ public:
+  static const int kDefaultBlockSize = 1 << 20;
+  static const int kDefaultReadAhead = 8 << 20;
+
+  // Takes ownership of |region|; a nullptr region is an empty stream.
+  explicit MappedFileInputStream(
+      std::unique_ptr<files::ReadOnlyMemoryRegion> region,
+      int64_t block_size = kDefaultBlockSize,
+      int read_ahead = kDefaultReadAhead);
+  virtual ~MappedFileInputStream() override;
+
+  // Maps |fname| through |env|. An empty file, which cannot be mapped,
+  // gives an empty stream.
+  static base::Status Open(core::Env* env,
+                           const std::string& fname,
+                           std::unique_ptr<MappedFileInputStream>* result,
+                           int64_t block_size = kDefaultBlockSize);
+
+  uint64_t size() const { return size_; }
+
+  virtual bool Next(const void** data, int* size) override;
+  virtual void BackUp(int count) override;
+  virtual bool Skip(int count) override;
+  virtual int64_t ByteCount() const override;
+
+  virtual bool Next64(const void** data, int64_t* size) override;
+  virtual void BackUp64(int64_t count) override;
+  virtual bool Skip64(int64_t count) override;
+
+ private:
+  bool NextWindow(const void** data, int64_t* size, int64_t max_size);
+  // Advises the window past position_ once the last one is half used.
+  void AdviseAhead();
+
+  std::unique_ptr<files::ReadOnlyMemoryRegion> region_;
+  const uint8_t* data_;
+  const uint64_t size_;
+  const int64_t block_size_;
+  const uint64_t read_ahead_;
+
+  uint64_t position_;
+  int64_t last_returned_size_;
+  // The end of the last window advised with MADV_WILLNEED.
+  uint64_t advised_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFileInputStream);
+};
+
+} // namespace io
+#endif // CRYPTO_IO_MAPPED_FILE_INPUT_STREAM_H_
@@ -1,9 +1,27 @@
 #include "io/output_stream.h"
 
+#include <limits.h>
+
+#include <glog/logging.h>
+
 namespace io {
 
 OutputStream::~OutputStream() {}
 
+bool OutputStream::Next64(void** data, int64_t* size) {
+  int int_size;
+  if (!Next(data, &int_size)) {
+    return false;
+  }
+  *size = int_size;
+  return true;
+}
+
+void OutputStream::BackUp64(int64_t count) {
+  CHECK_LE(count, INT_MAX);
+  BackUp(static_cast<int>(count));
+}
+
 bool OutputStream::WriteAliasedRaw(const void* /* data */,
 		                   int /* size */) {
   return false;
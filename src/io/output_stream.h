@@ -38,6 +38,10 @@ class OutputStream {
   virtual void BackUp(int count) = 0;
   virtual int64_t ByteCount() const = 0;
 
+  // The same with 64-bit sizes, as in InputStream.
+  virtual bool Next64(void** data, int64_t* size);
+  virtual void BackUp64(int64_t count);
+
   virtual bool WriteAliasedRaw(const void* data, int size);
   virtual bool AllowsAliasing() const { return false; }
 
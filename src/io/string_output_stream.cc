@@ -13,22 +13,39 @@ StringOutputStream::~StringOutputStream() {
 }
   
 bool StringOutputStream::Next(void** data, int* size) {
+  int64_t window;
+  if (!NextWindow(data, &window, std::numeric_limits<int>::max())) {
+    return false;
+  }
+  *size = static_cast<int>(window);
+  return true;
+}
+
+bool StringOutputStream::Next64(void** data, int64_t* size) {
+  return NextWindow(data, size, std::numeric_limits<int64_t>::max());
+}
+
+bool StringOutputStream::NextWindow(void** data, int64_t* size,
+                                    int64_t max_size) {
   CHECK(target_ != NULL);
   size_t old_size = target_->size();
+  size_t new_size;
   
   if (old_size < target_->capacity()) {
-    base::STLStringResizeUninitialized(target_, target_->capacity());
+    new_size = target_->capacity();
   } else {
-    if (old_size > std::numeric_limits<int>::max() / 2) {
-      LOG(ERROR) << "Cannot allocate buffer larger than kint32max for "
-                   << "StringOutputStream.";
+    if (old_size > target_->max_size() / 2) {
+      LOG(ERROR) << "Cannot grow the string of StringOutputStream past "
+                 << "max_size().";
       return false; 
     } 
-    base::STLStringResizeUninitialized(
-          target_,
-          std::max(old_size * 2,
-                   (size_t)kMinimumSize + 0));  // "+ 0" works around GCC4 weirdness.
+    new_size = std::max(old_size * 2,
+                        (size_t)kMinimumSize + 0);  // "+ 0" works around GCC4 weirdness.
   }              
+  if (new_size - old_size > static_cast<uint64_t>(max_size)) {
+    new_size = old_size + max_size;
+  }
+  base::STLStringResizeUninitialized(target_, new_size);
     
   *data = mutable_string_data(target_) + old_size;
   *size = target_->size() - old_size;
@@ -36,9 +53,13 @@ bool StringOutputStream::Next(void** data, int* size) {
 } 
 
 void StringOutputStream::BackUp(int count) {
+  BackUp64(count);
+}
+
+void StringOutputStream::BackUp64(int64_t count) {
   CHECK_GE(count, 0);
   CHECK(target_ != NULL);
-  CHECK_LE(count, target_->size());
+  CHECK_LE(static_cast<uint64_t>(count), target_->size());
   target_->resize(target_->size() - count);
 }
   
@@ -62,11 +83,20 @@ LazyStringOutputStream::~LazyStringOutputStream() {
 }
   
 bool LazyStringOutputStream::Next(void** data, int* size) {
+  SetStringIfNeeded();
+  return StringOutputStream::Next(data, size);
+}
+
+bool LazyStringOutputStream::Next64(void** data, int64_t* size) {
+  SetStringIfNeeded();
+  return StringOutputStream::Next64(data, size);
+}
+
+void LazyStringOutputStream::SetStringIfNeeded() {
   if (!string_is_set_) {
     SetString(callback_->Run());
     string_is_set_ = true;
   }
-  return StringOutputStream::Next(data, size);
 }
   
 int64_t LazyStringOutputStream::ByteCount() const {
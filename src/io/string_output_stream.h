@@ -19,10 +19,17 @@ class StringOutputStream : public OutputStream {
   void BackUp(int count);
   int64_t ByteCount() const;
 
+  // Grows the string past kint32max; Next() does too, but never hands
+  // out more than kint32max bytes at once.
+  bool Next64(void** data, int64_t* size);
+  void BackUp64(int64_t count);
+
  protected:
   void SetString(std::string* target);
 
  private:
+  bool NextWindow(void** data, int64_t* size, int64_t max_size);
+
   DISALLOW_COPY_AND_ASSIGN(StringOutputStream);
   static const int kMinimumSize = 16;
   std::string* target_;
@@ -34,9 +41,12 @@ class LazyStringOutputStream : public StringOutputStream {
   ~LazyStringOutputStream();
 
   bool Next(void** data, int* size);
+  bool Next64(void** data, int64_t* size);
   int64_t ByteCount() const;
 
  private:
+  void SetStringIfNeeded();
+
   const std::unique_ptr<base::ResultCallback<std::string*> > callback_;
   bool string_is_set_;
 
@@ -0,0 +1,48 @@
+#ifndef CORE_SYSTEM_BLOCKING_COUNTER_H_
+#define CORE_SYSTEM_BLOCKING_COUNTER_H_
+
+#include <mutex>
+#include <condition_variable>
+
+#include "base/macros.h"
+
+#include <glog/logging.h>
+
+namespace core {
+
+// Lets one thread wait until |initial_count| pieces of work, typically
+// scheduled on a core::thread::ThreadPool, have called DecrementCount().
+class BlockingCounter {
+ public:
+  explicit BlockingCounter(int initial_count) : count_(initial_count) {
+    CHECK_GE(count_, 0);
+  }
+
+  ~BlockingCounter() {}
+
+  void DecrementCount() {
+    std::lock_guard<std::mutex> l(mu_);
+    --count_;
+    CHECK_GE(count_, 0);
+    if (count_ == 0) {
+      cond_var_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> l(mu_);
+    while (count_ > 0) {
+      cond_var_.wait(l);
+    }
+  }
+
+ private:
+  int count_;
+  std::mutex mu_;
+  std::condition_variable cond_var_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockingCounter);
+};
+
+} // namespace core
+#endif // CORE_SYSTEM_BLOCKING_COUNTER_H_
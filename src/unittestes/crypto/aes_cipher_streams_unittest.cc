@@ -0,0 +1,140 @@
+#include "crypto/aes_cipher_streams.h"
+#include "crypto/aes_key.h"
+#include "crypto/ssl_aes_util.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/array_input_stream.h"
+#include "io/array_output_stream.h"
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+// Writes |text| through |output| the way a serializer would: fills each
+// buffer from Next() up to |piece| bytes and backs up the rest.
+void Produce(const std::string& text, int piece, io::OutputStream* output) {
+  size_t written = 0;
+  while (written < text.size()) {
+    void* data;
+    int size;
+    ASSERT_TRUE(output->Next(&data, &size));
+    int n = std::min<int>(std::min(size, piece), text.size() - written);
+    memcpy(data, text.data() + written, n);
+    written += n;
+    output->BackUp(size - n);
+  }
+}
+
+std::string Consume(io::InputStream* input) {
+  std::string text;
+  const void* data;
+  int size;
+  while (input->Next(&data, &size)) {
+    text.append(static_cast<const char*>(data), size);
+  }
+  return text;
+}
+
+std::string Expected(AESStreamMode mode, const std::string& raw_key,
+                     const std::string& iv, const std::string& text) {
+  std::string cipher;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  if (mode == kAESStreamCTR) {
+    EXPECT_TRUE(SslAESUtil::CTREncrypt(raw_key, iv, &input, &output));
+  } else {
+    SslGcmAESEncryptor gcm(raw_key, iv);
+    EXPECT_TRUE(gcm.Encrypt(&input, &output).ok());
+  }
+  return cipher;
+}
+
+} // namespace
+
+TEST(AESCipherStreams, MatchEncryptors) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  const std::string raw_key = key->raw_key();
+  struct {
+    AESStreamMode mode;
+    std::string iv;
+  } const kModes[] = {{kAESStreamCTR, "16 bytes init iv"},
+                      {kAESStreamGCM, "12 byte iv!!"}};
+
+  for (const auto& m : kModes) {
+    for (int size : {0, 1, 15, 16, 17, 1000, 100000}) {
+      const std::string text = MakeText(size);
+      const std::string expected = Expected(m.mode, raw_key, m.iv, text);
+      for (int block : {1, 7, 16, 4096}) {
+        std::string cipher;
+        {
+          io::StringOutputStream sink(&cipher);
+          EncryptingOutputStream output(m.mode, raw_key, m.iv, &sink);
+          ASSERT_TRUE(output.ok());
+          Produce(text, block * 3 + 1, &output);
+          EXPECT_EQ(size, output.ByteCount());
+          EXPECT_TRUE(output.Close());
+          EXPECT_EQ(size, output.ByteCount());
+        }
+        EXPECT_EQ(expected, cipher) << "size " << size << " block " << block;
+
+        io::ArrayInputStream source(cipher.data(), cipher.size(), block);
+        DecryptingInputStream input(m.mode, raw_key, m.iv, &source, 4000);
+        EXPECT_EQ(text, Consume(&input))
+            << "size " << size << " block " << block;
+        EXPECT_TRUE(input.status().ok());
+        EXPECT_EQ(size, input.ByteCount());
+      }
+    }
+  }
+}
+
+TEST(AESCipherStreams, BackUpAndSkip) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string iv("16 bytes init iv");
+  const std::string text = MakeText(5000);
+  const std::string cipher = Expected(kAESStreamCTR, key->raw_key(), iv, text);
+
+  io::ArrayInputStream source(cipher.data(), cipher.size(), 1000);
+  DecryptingInputStream input(kAESStreamCTR, key->raw_key(), iv, &source);
+  const void* data;
+  int size;
+  ASSERT_TRUE(input.Next(&data, &size));
+  input.BackUp(size - 10);
+  EXPECT_EQ(10, input.ByteCount());
+  EXPECT_TRUE(input.Skip(2990));
+  EXPECT_EQ(3000, input.ByteCount());
+  EXPECT_EQ(text.substr(3000), Consume(&input));
+}
+
+TEST(AESCipherStreams, GcmTagMismatch) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string iv("12 byte iv!!");
+  const std::string text = MakeText(3000);
+  std::string cipher = Expected(kAESStreamGCM, key->raw_key(), iv, text);
+  cipher[cipher.size() - 1] ^= 1;
+
+  io::ArrayInputStream source(cipher.data(), cipher.size(), 100);
+  DecryptingInputStream input(kAESStreamGCM, key->raw_key(), iv, &source);
+  Consume(&input);
+  EXPECT_EQ(base::error::DATA_LOSS, input.status().error_code());
+
+  // Too short to hold a tag.
+  io::ArrayInputStream short_source(cipher.data(), 10);
+  DecryptingInputStream short_input(kAESStreamGCM, key->raw_key(), iv,
+                                    &short_source);
+  EXPECT_EQ("", Consume(&short_input));
+  EXPECT_EQ(base::error::DATA_LOSS, short_input.status().error_code());
+}
+
+} // namespace crypto
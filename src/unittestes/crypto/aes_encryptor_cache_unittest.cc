@@ -0,0 +1,101 @@
+#include "crypto/aes_encryptor_cache.h"
+#include "crypto/ssl_aes_util.h"
+
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+TEST(AESEncryptorCache, HitsAndMisses) {
+  AESFactory* factory;
+  EXPECT_TRUE(AESFactory::GetFactory("ssl_aes", &factory).ok());
+  AESEncryptorCache cache(factory, 64);
+
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string iv("16 bytes init iv");
+  const std::string other_iv("other 16B iv !!!");
+  std::shared_ptr<AESEncryptor> cbc = cache.GetCBC(key, iv);
+  EXPECT_TRUE(cbc);
+  EXPECT_TRUE(cache.GetCBC(key, iv));
+
+  // The same bytes under another AESKey hit the same entry.
+  std::unique_ptr<AESKey> same = AESKey::FromHexString(key->ToHexString());
+  EXPECT_TRUE(cache.GetCBC(same, iv));
+
+  // Another IV shares the entry; another mode does not.
+  std::shared_ptr<AESEncryptor> other = cache.GetCBC(key, other_iv);
+  std::shared_ptr<AESEncryptor> ecb = cache.GetECB(key);
+  EXPECT_NE(cbc, ecb);
+  EXPECT_EQ(ecb, cache.GetECB(key));
+
+  AESEncryptorCache::Stats stats = cache.stats();
+  EXPECT_EQ(4u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(0u, stats.evictions);
+  EXPECT_EQ(2u, stats.size);
+
+  // Each lookup encrypts and decrypts under its own IV.
+  const std::string text("Hello, World");
+  const std::string* ivs[] = {&iv, &other_iv};
+  AESEncryptor* encryptors[] = {cbc.get(), other.get()};
+  for (int i = 0; i < 2; ++i) {
+    std::string cipher, expected, plain;
+    io::StringInputStream input(text.data(), text.size());
+    io::StringOutputStream output(&cipher);
+    EXPECT_TRUE(encryptors[i]->Encrypt(&input, &output).ok());
+    io::StringInputStream input1(text.data(), text.size());
+    io::StringOutputStream output1(&expected);
+    EXPECT_TRUE(SslAESUtil::CBCEncrypt(key->key(), *ivs[i], &input1,
+                                       &output1));
+    EXPECT_EQ(expected, cipher);
+
+    io::StringInputStream input2(cipher.data(), cipher.size());
+    io::StringOutputStream output2(&plain);
+    EXPECT_TRUE(encryptors[i]->Decrypt(&input2, &output2).ok());
+    EXPECT_EQ(text, plain);
+  }
+}
+
+TEST(AESEncryptorCache, RefusesNonceModes) {
+  AESFactory* factory;
+  EXPECT_TRUE(AESFactory::GetFactory("ssl_aes", &factory).ok());
+  AESEncryptorCache cache(factory, 64);
+
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  EXPECT_FALSE(cache.Get(AESFactory::kCTR, key, "16 bytes init iv"));
+  EXPECT_FALSE(cache.Get(AESFactory::kGCM, key, "12 bytes iv."));
+  EXPECT_EQ(0u, cache.stats().size);
+}
+
+TEST(AESEncryptorCache, EvictsLeastRecentlyUsed) {
+  AESFactory* factory;
+  EXPECT_TRUE(AESFactory::GetFactory("ssl_aes", &factory).ok());
+  AESEncryptorCache cache(factory, 2, 1);
+
+  std::unique_ptr<AESKey> key1 = AESKey::Create(128);
+  std::unique_ptr<AESKey> key2 = AESKey::Create(128);
+  std::unique_ptr<AESKey> key3 = AESKey::Create(256);
+  std::shared_ptr<AESEncryptor> ecb1 = cache.GetECB(key1);
+  cache.GetECB(key2);
+  EXPECT_EQ(ecb1, cache.GetECB(key1));
+  // key2 is now the oldest.
+  cache.GetECB(key3);
+
+  AESEncryptorCache::Stats stats = cache.stats();
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(2u, stats.size);
+  EXPECT_EQ(ecb1, cache.GetECB(key1));
+  EXPECT_EQ(2u, cache.stats().hits);
+
+  cache.GetECB(key2);
+  EXPECT_EQ(4u, cache.stats().misses);
+  EXPECT_EQ(2u, cache.stats().evictions);
+}
+
+} // namespace crypto
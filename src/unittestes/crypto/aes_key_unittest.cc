@@ -1,7 +1,10 @@
 #include "crypto/aes_key.h"
+#include "crypto/secure_key_arena.h"
 
 #include "strings/string_encode.h"
 
+#include <string.h>
+
 #include <glog/logging.h>
 
 #include <gtest/gtest.h>
@@ -19,4 +22,58 @@ TEST(AESKey, Constructor) {
   EXPECT_EQ(hex_string1, hex_string2);
 }
 
+TEST(AESKey, CloneSharesBytes) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  EXPECT_TRUE(key);
+  EXPECT_EQ(32u, key->key().size());
+  EXPECT_EQ(key->raw_key(), key->key().as_string());
+
+  std::unique_ptr<AESKey> clone = key->Clone();
+  EXPECT_EQ(key->key().data(), clone->key().data());
+  key.reset();
+  EXPECT_EQ(strings::HexEncode(clone->raw_key()), clone->ToHexString());
+}
+
+TEST(AESKey, FromBytesBuffer) {
+  const std::string bytes("0123456789abcdef");
+  std::unique_ptr<AESKey> key = AESKey::FromBytesBuffer(bytes.data(),
+                                                        bytes.size());
+  EXPECT_TRUE(key);
+  EXPECT_EQ(bytes, key->raw_key());
+  EXPECT_FALSE(AESKey::FromBytesBuffer(bytes.data(), 15));
+}
+
+TEST(AESKey, XTSKeyPairs) {
+  // 512 bits are only an XTS key pair, never a single AES key.
+  EXPECT_FALSE(AESKey::Create(512));
+  EXPECT_FALSE(AESKey::FromBytesBuffer(std::string(64, 'k').data(), 64));
+  EXPECT_FALSE(AESKey::CreateXTS(128));
+  for (int bits : {256, 512}) {
+    std::unique_ptr<AESKey> key = AESKey::CreateXTS(bits);
+    ASSERT_TRUE(key);
+    const size_t half = bits / 16;
+    EXPECT_EQ(2 * half, key->key().size());
+    EXPECT_NE(key->raw_key().substr(0, half), key->raw_key().substr(half));
+  }
+}
+
+TEST(SecureKeyArena, ReleaseWipesAndReuses) {
+  SecureKeyArena arena;
+  uint8_t* slot = arena.Allocate(32);
+  EXPECT_TRUE(slot != nullptr);
+  EXPECT_EQ(1u, arena.slots_in_use());
+  memset(slot, 0xa5, 32);
+  arena.Release(slot);
+  EXPECT_EQ(0u, arena.slots_in_use());
+
+  uint8_t* again = arena.Allocate(16);
+  EXPECT_EQ(slot, again);
+  for (size_t i = 0; i < SecureKeyArena::kSlotSize; ++i) {
+    EXPECT_EQ(0, again[i]);
+  }
+  arena.Release(again);
+
+  EXPECT_TRUE(arena.Allocate(SecureKeyArena::kSlotSize + 1) == nullptr);
+}
+
 }
@@ -0,0 +1,104 @@
+#include "crypto/chacha20_engine.h"
+
+#include "strings/string_encode.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+std::vector<const ChaCha20Engine::Kernels*> AllKernels() {
+  std::vector<const ChaCha20Engine::Kernels*> all;
+  for (ChaCha20Engine::Level level : {ChaCha20Engine::kPortable,
+                                      ChaCha20Engine::kSSSE3,
+                                      ChaCha20Engine::kAVX2}) {
+    const ChaCha20Engine::Kernels* kernels = ChaCha20Engine::Get(level);
+    if (kernels) {
+      all.push_back(kernels);
+    }
+  }
+  return all;
+}
+
+std::string Bytes(const std::string& hex) {
+  return strings::HexDecode(hex);
+}
+
+const uint8_t* U8(const std::string& s) {
+  return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+} // namespace
+
+// RFC 8439, 2.3.2.
+TEST(ChaCha20Engine, BlockFunction) {
+  const std::string key = Bytes("000102030405060708090a0b0c0d0e0f"
+                                "101112131415161718191a1b1c1d1e1f");
+  const std::string nonce = Bytes("000000090000004a00000000");
+  const std::string expected = Bytes(
+      "10f1e7e4d13b5915500fdd1fa32071c4c7d1f4c733c068030422aa9ac3d46c4e"
+      "d2826446079faa0914c2d705d98b02a2b5129cd1de164eb9cbd083e8a2503c4e");
+  ASSERT_NE(nullptr, ChaCha20Engine::Get());
+  for (const ChaCha20Engine::Kernels* kernels : AllKernels()) {
+    ChaCha20State state;
+    state.Init(U8(key), U8(nonce), 1);
+    std::string block(64, '\0');
+    uint8_t* data = reinterpret_cast<uint8_t*>(&block[0]);
+    kernels->xor_keystream(&state, data, data, 1);
+    EXPECT_EQ(expected, block) << kernels->name;
+    EXPECT_EQ(2u, state.counter);
+  }
+}
+
+TEST(ChaCha20Engine, KernelsAgree) {
+  const std::string key = Bytes("c0ffee00000000000000000000000000"
+                                "0000000000000000000000000000beef");
+  const std::string nonce = Bytes("0102030405060708090a0b0c");
+  std::string text(64 * 37 + 13, '\0');
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = static_cast<char>(i * 7);
+  }
+
+  std::string expected;
+  for (const ChaCha20Engine::Kernels* kernels : AllKernels()) {
+    // Split at odd block counts so the wide kernels also hit their tails,
+    // and start near the counter wrap.
+    for (size_t first : {0, 1, 3, 9, 17}) {
+      ChaCha20State state;
+      state.Init(U8(key), U8(nonce), 0xfffffff0u);
+      std::string out = text;
+      uint8_t* data = reinterpret_cast<uint8_t*>(&out[0]);
+      ChaCha20Engine::Crypt(kernels, &state, data, data, first * 64);
+      ChaCha20Engine::Crypt(kernels, &state, data + first * 64,
+                            data + first * 64, text.size() - first * 64);
+      if (expected.empty()) {
+        expected = out;
+      }
+      EXPECT_EQ(expected, out) << kernels->name << " " << first;
+    }
+  }
+}
+
+// RFC 8439, 2.5.2.
+TEST(Poly1305, Vector) {
+  const std::string key = Bytes("85d6be7857556d337f4452fe42d506a8"
+                                "0103808afb0db2fd4abff6af4149f51b");
+  const std::string message("Cryptographic Forum Research Group");
+  const std::string expected = Bytes("a8061dc1305136c6c22b8baf0c0127a9");
+  for (size_t split : {0, 1, 15, 16, 17, 34}) {
+    Poly1305 mac(U8(key));
+    mac.Update(U8(message), split);
+    mac.Update(U8(message) + split, message.size() - split);
+    std::string tag(16, '\0');
+    mac.Finish(reinterpret_cast<uint8_t*>(&tag[0]));
+    EXPECT_EQ(expected, tag) << split;
+  }
+}
+
+} // namespace crypto
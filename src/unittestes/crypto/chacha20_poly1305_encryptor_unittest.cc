@@ -0,0 +1,109 @@
+#include "crypto/chacha20_poly1305_encryptor.h"
+#include "crypto/aead_factory.h"
+#include "crypto/aes_key.h"
+#include "crypto/aesni_engine.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "strings/string_encode.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+// RFC 8439, 2.8.2.
+TEST(ChaCha20Poly1305Encryptor, Vector) {
+  const std::string key = strings::HexDecode(
+      "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f");
+  const std::string nonce = strings::HexDecode("070000004041424344454647");
+  const std::string aad = strings::HexDecode("50515253c0c1c2c3c4c5c6c7");
+  const std::string text("Ladies and Gentlemen of the class of '99: If I "
+                         "could offer you only one tip for the future, "
+                         "sunscreen would be it.");
+  const std::string expected = strings::HexDecode(
+      "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+      "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+      "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+      "3ff4def08e4b7a9de576d26586cec64b6116"
+      "1ae10b594f09e26a7e902ecbd0600691");
+
+  for (ChaCha20Engine::Level level : {ChaCha20Engine::kPortable,
+                                      ChaCha20Engine::kSSSE3,
+                                      ChaCha20Engine::kAVX2}) {
+    const ChaCha20Engine::Kernels* kernels = ChaCha20Engine::Get(level);
+    if (!kernels) {
+      continue;
+    }
+    ChaCha20Poly1305Encryptor aead(key, nonce, aad, kernels);
+    std::string cipher, plain;
+    EXPECT_TRUE(Crypt(&aead, true, text, &cipher, 7).ok());
+    EXPECT_EQ(expected, cipher) << kernels->name;
+    EXPECT_TRUE(Crypt(&aead, false, cipher, &plain, 5).ok());
+    EXPECT_EQ(text, plain) << kernels->name;
+  }
+}
+
+TEST(ChaCha20Poly1305Encryptor, RoundTripAndTamper) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  for (int size : {0, 1, 63, 64, 65, 16 << 10, (16 << 10) + 16, 100000}) {
+    // One message per nonce.
+    ChaCha20Poly1305Encryptor aead(key->key(), "12 byte iv!!");
+    std::string text(size, '\0');
+    for (int i = 0; i < size; ++i) {
+      text[i] = static_cast<char>(i * 31);
+    }
+    std::string cipher, plain;
+    EXPECT_TRUE(Crypt(&aead, true, text, &cipher, 4000).ok());
+    EXPECT_EQ(size + ChaCha20Poly1305Encryptor::kTagSize, cipher.size());
+    EXPECT_TRUE(Crypt(&aead, false, cipher, &plain, 999).ok());
+    EXPECT_EQ(text, plain) << size;
+
+    cipher[cipher.size() / 2] ^= 0x20;
+    EXPECT_EQ(base::error::DATA_LOSS,
+              Crypt(&aead, false, cipher, &plain).error_code()) << size;
+  }
+  ChaCha20Poly1305Encryptor aead(key->key(), "12 byte iv!!");
+  std::string cipher, plain;
+  EXPECT_EQ(base::error::DATA_LOSS,
+            Crypt(&aead, false, "short", &plain).error_code());
+  EXPECT_TRUE(Crypt(&aead, true, "text", &cipher).ok());
+  EXPECT_EQ(base::error::FAILED_PRECONDITION,
+            Crypt(&aead, true, "text", &cipher).error_code());
+
+  std::unique_ptr<AESKey> short_key = AESKey::Create(128);
+  ChaCha20Poly1305Encryptor bad(short_key->key(), "12 byte iv!!");
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            Crypt(&bad, true, "text", &plain).error_code());
+}
+
+TEST(AEADFactory, Registry) {
+  AEADFactory* factory = nullptr;
+  EXPECT_TRUE(AEADFactory::GetFactory("chacha20_poly1305", &factory).ok());
+  ASSERT_TRUE(factory);
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  std::unique_ptr<AESEncryptor> aead = factory->Create(key, "12 byte iv!!",
+                                                       "header");
+  ChaCha20Poly1305Encryptor direct(key->key(), "12 byte iv!!", "header");
+  std::string from_factory, expected;
+  EXPECT_TRUE(Crypt(aead.get(), true, "payload", &from_factory).ok());
+  EXPECT_TRUE(Crypt(&direct, true, "payload", &expected).ok());
+  EXPECT_EQ(expected, from_factory);
+
+  EXPECT_TRUE(AEADFactory::GetFactory("aes_gcm", &factory).ok());
+  EXPECT_FALSE(AEADFactory::GetFactory("sm4_gcm", &factory).ok());
+
+  // "auto" only falls back to ChaCha20 without hardware AES.
+  AEADFactory* preferred = nullptr;
+  EXPECT_TRUE(AEADFactory::GetFactory("auto", &preferred).ok());
+  EXPECT_TRUE(AEADFactory::GetFactory(AEADFactory::AutoType(),
+                                      &factory).ok());
+  EXPECT_EQ(factory, preferred);
+  EXPECT_EQ(std::string(AesNiEngine::Supported() ? "aes_gcm" :
+                                                   "chacha20_poly1305"),
+            AEADFactory::AutoType());
+}
+
+} // namespace crypto
@@ -0,0 +1,24 @@
+#include "unittestes/crypto/crypto_test.h"
+#include "io/array_input_stream.h"
+#include "io/string_output_stream.h"
+
+namespace crypto {
+
+std::string MakeText(size_t size, int seed) {
+  std::string text;
+  for (size_t i = 0; i < size; ++i) {
+    text.push_back(static_cast<char>(i * 31 + seed + i / 251));
+  }
+  return text;
+}
+
+base::Status Crypt(AESEncryptor* encryptor, bool do_encrypt,
+                   const std::string& in, std::string* out, int chunk) {
+  out->clear();
+  io::ArrayInputStream input(in.data(), in.size(), chunk);
+  io::StringOutputStream output(out);
+  return do_encrypt ? encryptor->Encrypt(&input, &output) :
+                      encryptor->Decrypt(&input, &output);
+}
+
+} // namespace crypto
@@ -0,0 +1,22 @@
+#ifndef CRYPTO_UNITTESTES_CRYPTO_TEST_H_
+#define CRYPTO_UNITTESTES_CRYPTO_TEST_H_
+
+#include "base/status.h"
+#include "crypto/aes_encryptor.h"
+
+#include <stddef.h>
+#include <string>
+
+namespace crypto {
+
+// |size| bytes that do not repeat every 256 bytes; a different |seed|
+// gives different text.
+std::string MakeText(size_t size, int seed = 0);
+
+// Runs |in| through |encryptor| into |out|, handing it over |chunk| bytes
+// at a time (all at once by default).
+base::Status Crypt(AESEncryptor* encryptor, bool do_encrypt,
+                   const std::string& in, std::string* out, int chunk = -1);
+
+} // namespace crypto
+#endif // CRYPTO_UNITTESTES_CRYPTO_TEST_H_
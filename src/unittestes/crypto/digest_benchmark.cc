@@ -0,0 +1,105 @@
+// Throughput of the digest kernels, one large message at a time and over
+// many small objects, hashed one by one or side by side with
+// Digest::HashStreams().
+//
+// Usage: digest_benchmark [object_size_in_bytes]
+//
+#include "crypto/digest.h"
+#include "crypto/digest_engine.h"
+
+#include "io/array_input_stream.h"
+#include "system/env.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crypto {
+namespace {
+
+// Every measurement is repeated until at least this many bytes went
+// through.
+const int64_t kMinBytesPerRun = 256LL << 20;
+const int kLargeSize = 1 << 20;
+// Objects per HashStreams() call.
+const int kBatch = 64;
+
+double GBps(int64_t bytes, uint64_t start) {
+  uint64_t elapsed = std::max<uint64_t>(
+      1, core::Env::Default()->NowMicros() - start);
+  return static_cast<double>(bytes) / elapsed / 1000.0;
+}
+
+double Serial(const DigestEngine::Kernels* kernels, const std::string& data) {
+  const int64_t iterations = std::max<int64_t>(
+      1, kMinBytesPerRun / data.size());
+  uint8_t out[Digest::kDigestSize];
+  uint64_t start = core::Env::Default()->NowMicros();
+  for (int64_t i = 0; i < iterations; ++i) {
+    io::ArrayInputStream input(data.data(), data.size());
+    Digest digest(kernels->algorithm, kernels);
+    digest.Update(&input);
+    digest.Finish(out);
+  }
+  return GBps(data.size() * iterations, start);
+}
+
+double Batched(const DigestEngine::Kernels* kernels, const std::string& data) {
+  const int64_t iterations = std::max<int64_t>(
+      1, kMinBytesPerRun / (data.size() * kBatch));
+  std::vector<std::string> digests(kBatch);
+  uint64_t start = core::Env::Default()->NowMicros();
+  for (int64_t i = 0; i < iterations; ++i) {
+    std::vector<std::unique_ptr<io::ArrayInputStream>> streams;
+    std::vector<io::InputStream*> inputs;
+    for (int j = 0; j < kBatch; ++j) {
+      streams.emplace_back(new io::ArrayInputStream(data.data(),
+                                                    data.size()));
+      inputs.push_back(streams.back().get());
+    }
+    Digest::HashStreams(kernels->algorithm, inputs.data(), kBatch,
+                        digests.data(), kernels);
+  }
+  return GBps(data.size() * kBatch * iterations, start);
+}
+
+void RunBenchmarks(int object_size) {
+  const std::string large(kLargeSize, 'x');
+  const std::string small(object_size, 'x');
+  printf("GB/s; objects of %d bytes, %d per batch\n", object_size, kBatch);
+  printf("%-16s %10s %10s %10s\n", "", "1mib", "objects", "batched");
+  for (DigestEngine::Algorithm algorithm : {DigestEngine::kSha256,
+                                            DigestEngine::kSm3}) {
+    for (DigestEngine::Level level : {DigestEngine::kPortable,
+                                      DigestEngine::kAVX2,
+                                      DigestEngine::kSHANI}) {
+      const DigestEngine::Kernels* kernels =
+          DigestEngine::Get(algorithm, level);
+      if (!kernels) {
+        continue;
+      }
+      const std::string name = std::string(
+          algorithm == DigestEngine::kSha256 ? "sha256_" : "sm3_") +
+          kernels->name;
+      printf("%-16s %10.3f %10.3f %10.3f\n", name.c_str(),
+             Serial(kernels, large), Serial(kernels, small),
+             Batched(kernels, small));
+    }
+  }
+}
+
+} // namespace
+} // namespace crypto
+
+int main(int argc, char** argv) {
+  int object_size = 4096;
+  if (argc > 1) {
+    object_size = atoi(argv[1]);
+  }
+  crypto::RunBenchmarks(object_size);
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "crypto/digest.h"
+#include "crypto/digest_engine.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/array_input_stream.h"
+#include "strings/string_encode.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+// Every kernel set of |algorithm| the CPU runs.
+std::vector<const DigestEngine::Kernels*> AllKernels(
+    DigestEngine::Algorithm algorithm) {
+  std::vector<const DigestEngine::Kernels*> all;
+  for (DigestEngine::Level level : {DigestEngine::kPortable,
+                                    DigestEngine::kAVX2,
+                                    DigestEngine::kSHANI}) {
+    const DigestEngine::Kernels* kernels = DigestEngine::Get(algorithm, level);
+    if (kernels) {
+      all.push_back(kernels);
+    }
+  }
+  return all;
+}
+
+std::string HashWith(const DigestEngine::Kernels* kernels,
+                     const std::string& data) {
+  Digest digest(kernels->algorithm, kernels);
+  digest.Update(data);
+  std::string out(Digest::kDigestSize, '\0');
+  digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+  return out;
+}
+
+} // namespace
+
+// FIPS 180-4 examples, and the million-'a' message of FIPS 180-2.
+TEST(Digest, Sha256Vectors) {
+  for (const DigestEngine::Kernels* kernels :
+       AllKernels(DigestEngine::kSha256)) {
+    EXPECT_EQ(strings::HexDecode("e3b0c44298fc1c149afbf4c8996fb924"
+                                 "27ae41e4649b934ca495991b7852b855"),
+              HashWith(kernels, "")) << kernels->name;
+    EXPECT_EQ(strings::HexDecode("ba7816bf8f01cfea414140de5dae2223"
+                                 "b00361a396177a9cb410ff61f20015ad"),
+              HashWith(kernels, "abc")) << kernels->name;
+    EXPECT_EQ(strings::HexDecode("248d6a61d20638b8e5c026930c3e6039"
+                                 "a33ce45964ff2167f6ecedd419db06c1"),
+              HashWith(kernels, "abcdbcdecdefdefgefghfghighijhijki"
+                                "jkljklmklmnlmnomnopnopq"))
+        << kernels->name;
+    EXPECT_EQ(strings::HexDecode("cdc76e5c9914fb9281a1c7e284d73e67"
+                                 "f1809a48a497200e046d39ccc7112cd0"),
+              HashWith(kernels, std::string(1000000, 'a')))
+        << kernels->name;
+  }
+}
+
+TEST(Digest, KernelsAgree) {
+  for (DigestEngine::Algorithm algorithm : {DigestEngine::kSha256,
+                                            DigestEngine::kSm3}) {
+    const DigestEngine::Kernels* portable =
+        DigestEngine::Get(algorithm, DigestEngine::kPortable);
+    for (const DigestEngine::Kernels* kernels : AllKernels(algorithm)) {
+      for (int size : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 4097}) {
+        const std::string text = MakeText(size, size);
+        EXPECT_EQ(HashWith(portable, text), HashWith(kernels, text))
+            << kernels->name << " " << size;
+      }
+    }
+  }
+}
+
+TEST(Digest, InputStream) {
+  const std::string text = MakeText(10000, 7);
+  for (DigestEngine::Algorithm algorithm : {DigestEngine::kSha256,
+                                            DigestEngine::kSm3}) {
+    const std::string expected = Digest::Hash(algorithm, text);
+    for (int block_size : {1, 63, 64, 100, 4096, -1}) {
+      io::ArrayInputStream input(text.data(), text.size(), block_size);
+      Digest digest(algorithm);
+      EXPECT_EQ(10000, digest.Update(&input));
+      std::string out(Digest::kDigestSize, '\0');
+      digest.Finish(reinterpret_cast<uint8_t*>(&out[0]));
+      EXPECT_EQ(expected, out) << block_size;
+    }
+    io::ArrayInputStream input(text.data(), text.size(), 333);
+    EXPECT_EQ(expected, Digest::Hash(algorithm, &input));
+  }
+}
+
+// More streams than lanes, of sizes that end lanes at different steps,
+// read in buffers that split blocks.
+TEST(Digest, HashStreams) {
+  const int sizes[] = {0, 1, 55, 56, 63, 64, 65, 200, 1000, 5000, 70000,
+                       3, 128, 129, 4096, 100, 0, 7, 64, 300000};
+  const int block_sizes[] = {-1, 1, 17, 64, 100, 4096};
+  const int count = sizeof(sizes) / sizeof(sizes[0]);
+  std::vector<std::string> texts;
+  for (int i = 0; i < count; ++i) {
+    texts.push_back(MakeText(sizes[i], i));
+  }
+
+  for (DigestEngine::Algorithm algorithm : {DigestEngine::kSha256,
+                                            DigestEngine::kSm3}) {
+    for (const DigestEngine::Kernels* kernels : AllKernels(algorithm)) {
+      std::vector<std::unique_ptr<io::ArrayInputStream>> streams;
+      std::vector<io::InputStream*> inputs;
+      for (int i = 0; i < count; ++i) {
+        streams.emplace_back(new io::ArrayInputStream(
+            texts[i].data(), texts[i].size(), block_sizes[i % 6]));
+        inputs.push_back(streams.back().get());
+      }
+      std::vector<std::string> digests(count);
+      Digest::HashStreams(algorithm, inputs.data(), count, digests.data(),
+                          kernels);
+      for (int i = 0; i < count; ++i) {
+        EXPECT_EQ(Digest::Hash(algorithm, texts[i]), digests[i])
+            << kernels->name << " " << i;
+      }
+    }
+  }
+}
+
+} // namespace crypto
@@ -0,0 +1,214 @@
+#include "crypto/encrypted_container.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+class StringWritableFile : public files::WritableFile {
+ public:
+  explicit StringWritableFile(std::string* data) : data_(data) {}
+
+  base::Status Append(const strings::StringPiece& data) override {
+    data_->append(data.data(), data.size());
+    return base::Status::OK;
+  }
+  base::Status Close() override { return base::Status::OK; }
+  base::Status Flush() override { return base::Status::OK; }
+  base::Status Sync() override { return base::Status::OK; }
+
+ private:
+  std::string* data_;
+};
+
+class StringRandomAccessFile : public files::RandomAccessFile {
+ public:
+  explicit StringRandomAccessFile(const std::string& data) : data_(data) {}
+
+  base::Status Read(uint64_t offset, size_t n, strings::StringPiece* result,
+                    char* scratch) const override {
+    if (offset > data_.size()) {
+      offset = data_.size();
+    }
+    size_t size = std::min<size_t>(n, data_.size() - offset);
+    memcpy(scratch, data_.data() + offset, size);
+    *result = strings::StringPiece(scratch, size);
+    if (size < n) {
+      return base::Status(base::error::OUT_OF_RANGE, "short read");
+    }
+    return base::Status::OK;
+  }
+
+ private:
+  std::string data_;
+};
+
+std::string Seal(const std::string& raw_key, size_t segment_size,
+                 const std::string& text, size_t chunk,
+                 core::thread::ThreadPool* pool = nullptr) {
+  std::string container;
+  std::unique_ptr<EncryptedContainerWriter> writer;
+  EXPECT_TRUE(EncryptedContainerWriter::New(
+      raw_key, segment_size,
+      std::unique_ptr<files::WritableFile>(new StringWritableFile(&container)),
+      pool, &writer).ok());
+  for (size_t i = 0; i < text.size(); i += chunk) {
+    EXPECT_TRUE(writer->Append(text.substr(i, chunk)).ok());
+  }
+  EXPECT_TRUE(writer->Close().ok());
+  return container;
+}
+
+base::Status OpenReader(const std::string& raw_key,
+                        const std::string& container,
+                        core::thread::ThreadPool* pool,
+                        std::unique_ptr<EncryptedContainerReader>* reader) {
+  return EncryptedContainerReader::Open(
+      raw_key,
+      std::unique_ptr<files::RandomAccessFile>(
+          new StringRandomAccessFile(container)),
+      container.size(), pool, reader);
+}
+
+} // namespace
+
+TEST(EncryptedContainer, RandomAccess) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  const std::string raw_key = key->raw_key();
+  core::thread::ThreadPool pool(core::Env::Default(), "container", 4);
+  const size_t kSegmentSize = 1000;
+
+  for (size_t size : {0, 1, 999, 1000, 1001, 25000, 25999}) {
+    const std::string text = MakeText(size);
+    const std::string container = Seal(raw_key, kSegmentSize, text, 777);
+    for (core::thread::ThreadPool* p : {&pool,
+                                        static_cast<core::thread::ThreadPool*>(
+                                            nullptr)}) {
+      std::unique_ptr<EncryptedContainerReader> reader;
+      ASSERT_TRUE(OpenReader(raw_key, container, p, &reader).ok());
+      EXPECT_EQ(size, reader->size());
+
+      std::string scratch(size + 10, '\0');
+      strings::StringPiece result;
+      EXPECT_TRUE(reader->Read(0, size, &result, &scratch[0]).ok());
+      EXPECT_EQ(text, result.ToString());
+
+      const uint64_t kRanges[][2] = {{0, 1}, {999, 2}, {1000, 1000},
+                                     {1, 998}, {500, 12000}, {24000, 1999}};
+      for (const uint64_t* range : kRanges) {
+        if (range[0] + range[1] > size) {
+          continue;
+        }
+        EXPECT_TRUE(reader->Read(range[0], range[1], &result,
+                                 &scratch[0]).ok());
+        EXPECT_EQ(text.substr(range[0], range[1]), result.ToString())
+            << "size " << size << " offset " << range[0];
+      }
+
+      // Past the end: the existing bytes with OUT_OF_RANGE.
+      base::Status s = reader->Read(size / 2, size + 1, &result,
+                                    &scratch[0]);
+      EXPECT_EQ(base::error::OUT_OF_RANGE, s.error_code());
+      EXPECT_EQ(text.substr(size / 2), result.ToString());
+    }
+  }
+}
+
+TEST(EncryptedContainer, SealsOnPool) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  const std::string raw_key = key->raw_key();
+  core::thread::ThreadPool pool(core::Env::Default(), "container", 4);
+  const size_t kSegmentSize = 1000;
+
+  // One segment per Append, more than a batch in one Append, and a
+  // buffered head followed by whole segments.
+  for (size_t chunk : {1000, 40500, 1700}) {
+    const std::string text = MakeText(40500);
+    const std::string container =
+        Seal(raw_key, kSegmentSize, text, chunk, &pool);
+    std::unique_ptr<EncryptedContainerReader> reader;
+    ASSERT_TRUE(OpenReader(raw_key, container, nullptr, &reader).ok());
+    EXPECT_EQ(text.size(), reader->size());
+    std::string scratch(text.size(), '\0');
+    strings::StringPiece result;
+    EXPECT_TRUE(reader->Read(0, text.size(), &result, &scratch[0]).ok());
+    EXPECT_EQ(text, result.ToString()) << "chunk " << chunk;
+  }
+}
+
+TEST(EncryptedContainer, ClosedOnDestruction) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string raw_key = key->raw_key();
+  const std::string text = MakeText(2500);
+  std::string container;
+  {
+    std::unique_ptr<EncryptedContainerWriter> writer;
+    ASSERT_TRUE(EncryptedContainerWriter::New(
+        raw_key, 1000,
+        std::unique_ptr<files::WritableFile>(
+            new StringWritableFile(&container)),
+        nullptr, &writer).ok());
+    EXPECT_TRUE(writer->Append(text).ok());
+  }
+  std::unique_ptr<EncryptedContainerReader> reader;
+  ASSERT_TRUE(OpenReader(raw_key, container, nullptr, &reader).ok());
+  std::string scratch(text.size(), '\0');
+  strings::StringPiece result;
+  EXPECT_TRUE(reader->Read(0, text.size(), &result, &scratch[0]).ok());
+  EXPECT_EQ(text, result.ToString());
+}
+
+TEST(EncryptedContainer, DetectsTampering) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string raw_key = key->raw_key();
+  const std::string text = MakeText(4096);
+  const std::string container = Seal(raw_key, 1024, text, 4096);
+  const size_t kSealedSize = 1024 + EncryptedContainer::kTagSize;
+  std::unique_ptr<EncryptedContainerReader> reader;
+  std::string scratch(4096, '\0');
+  strings::StringPiece result;
+
+  // A flipped ciphertext bit fails reads of its segment only.
+  std::string flipped = container;
+  flipped[EncryptedContainer::kHeaderSize + kSealedSize + 5] ^= 1;
+  ASSERT_TRUE(OpenReader(raw_key, flipped, nullptr, &reader).ok());
+  EXPECT_TRUE(reader->Read(0, 1024, &result, &scratch[0]).ok());
+  EXPECT_EQ(base::error::DATA_LOSS,
+            reader->Read(1000, 100, &result, &scratch[0]).error_code());
+  EXPECT_EQ(0u, result.size());
+
+  // Swapped segments.
+  std::string swapped = container;
+  swapped.replace(EncryptedContainer::kHeaderSize, kSealedSize,
+                  container, EncryptedContainer::kHeaderSize + kSealedSize,
+                  kSealedSize);
+  ASSERT_TRUE(OpenReader(raw_key, swapped, nullptr, &reader).ok());
+  EXPECT_FALSE(reader->Read(0, 10, &result, &scratch[0]).ok());
+
+  // A touched header or index, a truncated file, or the wrong key.
+  std::string header = container;
+  header[20] ^= 1;
+  EXPECT_FALSE(OpenReader(raw_key, header, nullptr, &reader).ok());
+  std::string index = container;
+  index[container.size() - EncryptedContainer::kTrailerSize - 20] ^= 1;
+  EXPECT_FALSE(OpenReader(raw_key, index, nullptr, &reader).ok());
+  EXPECT_FALSE(OpenReader(raw_key, container.substr(0, container.size() - 1),
+                          nullptr, &reader).ok());
+  std::unique_ptr<AESKey> other = AESKey::Create(128);
+  EXPECT_FALSE(OpenReader(other->raw_key(), container, nullptr,
+                          &reader).ok());
+}
+
+} // namespace crypto
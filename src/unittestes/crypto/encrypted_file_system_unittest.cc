@@ -0,0 +1,93 @@
+#include "crypto/encrypted_file_system.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "files/linux/linux_file_system.h"
+#include "system/env.h"
+
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+std::string TestPath(const std::string& name) {
+  return testing::TempDir() + "enc_fs_" + std::to_string(getpid()) + "_" +
+         name;
+}
+
+} // namespace
+
+TEST(EncryptedFileSystem, EnvRoundTrip) {
+  core::Env* env = core::Env::Default();
+  const std::string path = TestPath("round_trip");
+  const std::string uri = "enc://" + path;
+
+  // Nothing works before the master key is set.
+  EXPECT_EQ(base::error::FAILED_PRECONDITION,
+            core::WriteStringToFile(env, uri, "x").error_code());
+  EncryptedFileSystem::SetMasterKey(AESKey::Create(256));
+
+  // Several segments with a short tail.
+  const std::string text = MakeText(300000);
+  EXPECT_TRUE(core::WriteStringToFile(env, uri, text).ok());
+
+  uint64_t size;
+  EXPECT_TRUE(env->GetFileSize(uri, &size).ok());
+  EXPECT_EQ(text.size(), size);
+  files::FileStatistics stat;
+  EXPECT_TRUE(env->Stat(uri, &stat).ok());
+  EXPECT_EQ(static_cast<int64_t>(text.size()), stat.length);
+
+  std::string read;
+  EXPECT_TRUE(core::ReadFileToString(env, uri, &read).ok());
+  EXPECT_EQ(text, read);
+
+  // The bytes on disk are not the plaintext.
+  std::string raw;
+  EXPECT_TRUE(core::ReadFileToString(env, "file://" + path, &raw).ok());
+  EXPECT_GT(raw.size(), text.size());
+  EXPECT_EQ(std::string::npos, raw.find(text.substr(0, 64)));
+
+  std::unique_ptr<files::RandomAccessFile> file;
+  EXPECT_TRUE(env->NewRandomAccessFile(uri, &file).ok());
+  std::string scratch(1000, '\0');
+  StringPiece result;
+  EXPECT_TRUE(file->Read(65530, 1000, &result, &scratch[0]).ok());
+  EXPECT_EQ(text.substr(65530, 1000), result.ToString());
+
+  // Another master key cannot open the file.
+  EncryptedFileSystem::SetMasterKey(AESKey::Create(256));
+  EXPECT_EQ(base::error::DATA_LOSS,
+            core::ReadFileToString(env, uri, &read).error_code());
+
+  EXPECT_TRUE(env->DeleteFile(uri).ok());
+  EXPECT_FALSE(env->FileExists(uri));
+}
+
+TEST(EncryptedFileSystem, OverBaseFileSystem) {
+  files::LocalLinuxFileSystem local;
+  EncryptedFileSystem fs(&local, AESKey::Create(128));
+  const std::string path = TestPath("empty");
+
+  std::unique_ptr<files::WritableFile> file;
+  EXPECT_TRUE(fs.NewWritableFile(path, &file).ok());
+  EXPECT_TRUE(file->Close().ok());
+  uint64_t size = 1;
+  EXPECT_TRUE(fs.GetFileSize(path, &size).ok());
+  EXPECT_EQ(0u, size);
+  std::unique_ptr<files::RandomAccessFile> reader;
+  EXPECT_TRUE(fs.NewRandomAccessFile(path, &reader).ok());
+
+  std::unique_ptr<files::WritableFile> appendable;
+  EXPECT_EQ(base::error::UNIMPLEMENTED,
+            fs.NewAppendableFile(path, &appendable).error_code());
+  EXPECT_TRUE(fs.DeleteFile(path).ok());
+}
+
+} // namespace crypto
@@ -0,0 +1,153 @@
+#include "crypto/hash_tree.h"
+#include "crypto/digest.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+std::string TestPath(const std::string& name) {
+  return "file://" + testing::TempDir() + "hash_tree_" +
+         std::to_string(getpid()) + "_" + name;
+}
+
+std::string Sha256(const std::string& data) {
+  return Digest::Hash(DigestEngine::kSha256, data);
+}
+
+std::string Leaf(const std::string& chunk, uint64_t index) {
+  std::string suffix(8, '\0');
+  for (int i = 0; i < 8; ++i) {
+    suffix[i] = static_cast<char>(index >> (8 * i));
+  }
+  return Sha256(chunk + suffix + std::string(1, '\x00'));
+}
+
+std::string Node(const std::string& left, const std::string& right) {
+  return Sha256(left + right + "\x01");
+}
+
+} // namespace
+
+// Three chunks, by hand from the layout in hash_tree.h.
+TEST(HashTree, Layout) {
+  const std::string text = MakeText(250);
+  std::unique_ptr<HashTree> tree =
+      HashTree::Build(DigestEngine::kSha256, text.data(), text.size(), 100);
+  ASSERT_TRUE(tree);
+  EXPECT_EQ(3u, tree->num_chunks());
+
+  const std::string top = Node(Node(Leaf(text.substr(0, 100), 0),
+                                    Leaf(text.substr(100, 100), 1)),
+                               Leaf(text.substr(200), 2));
+  // Size 250 and chunk size 100, little-endian, then the root tag.
+  const std::string geometry("\xfa\0\0\0\0\0\0\0\x64\0\0\0\x02", 13);
+  EXPECT_EQ(Sha256(top + geometry), tree->root());
+}
+
+TEST(HashTree, PoolAgrees) {
+  const std::string text = MakeText(1000003);
+  core::thread::ThreadPool pool(core::Env::Default(), "hash_tree", 4);
+  for (DigestEngine::Algorithm algorithm : {DigestEngine::kSha256,
+                                            DigestEngine::kSm3}) {
+    for (size_t chunk_size : {size_t(64), size_t(1000), size_t(4096)}) {
+      std::unique_ptr<HashTree> serial = HashTree::Build(
+          algorithm, text.data(), text.size(), chunk_size);
+      std::unique_ptr<HashTree> parallel = HashTree::Build(
+          algorithm, text.data(), text.size(), chunk_size, &pool);
+      ASSERT_TRUE(serial && parallel);
+      EXPECT_EQ(serial->root(), parallel->root()) << chunk_size;
+    }
+  }
+
+  std::unique_ptr<HashTree> a = HashTree::Build(
+      DigestEngine::kSha256, text.data(), text.size(), 1000);
+  std::unique_ptr<HashTree> b = HashTree::Build(
+      DigestEngine::kSha256, text.data(), text.size(), 1024);
+  std::unique_ptr<HashTree> c = HashTree::Build(
+      DigestEngine::kSha256, text.data(), text.size() - 1, 1000);
+  EXPECT_NE(a->root(), b->root());
+  EXPECT_NE(a->root(), c->root());
+}
+
+TEST(HashTree, VerifyChunks) {
+  const size_t kChunk = 512;
+  for (size_t size : {size_t(0), size_t(1), size_t(512), size_t(513),
+                      size_t(512 * 5), size_t(512 * 8 + 3)}) {
+    const std::string text = MakeText(size);
+    std::unique_ptr<HashTree> tree = HashTree::Build(
+        DigestEngine::kSm3, text.data(), text.size(), kChunk);
+    ASSERT_TRUE(tree);
+    for (uint64_t i = 0; i < tree->num_chunks(); ++i) {
+      const std::string chunk = text.substr(i * kChunk, kChunk);
+      EXPECT_TRUE(tree->VerifyChunk(i, chunk).ok());
+      const std::vector<std::string> proof = tree->Proof(i);
+      EXPECT_TRUE(HashTree::VerifyProof(DigestEngine::kSm3, tree->root(),
+                                        size, kChunk, i, chunk, proof).ok())
+          << size << " " << i;
+
+      std::string tampered = chunk + "x";
+      EXPECT_EQ(base::error::DATA_LOSS,
+                tree->VerifyChunk(i, tampered).error_code());
+      if (!chunk.empty()) {
+        tampered = chunk;
+        tampered[tampered.size() / 2] ^= 0x20;
+        EXPECT_EQ(base::error::DATA_LOSS,
+                  tree->VerifyChunk(i, tampered).error_code());
+        EXPECT_EQ(base::error::DATA_LOSS,
+                  HashTree::VerifyProof(DigestEngine::kSm3, tree->root(),
+                                        size, kChunk, i, tampered, proof)
+                      .error_code());
+      }
+      if (!proof.empty()) {
+        std::vector<std::string> bad_proof = proof;
+        bad_proof.back()[0] ^= 0x01;
+        EXPECT_EQ(base::error::DATA_LOSS,
+                  HashTree::VerifyProof(DigestEngine::kSm3, tree->root(),
+                                        size, kChunk, i, chunk, bad_proof)
+                      .error_code());
+        bad_proof.pop_back();
+        EXPECT_FALSE(HashTree::VerifyProof(DigestEngine::kSm3, tree->root(),
+                                           size, kChunk, i, chunk, bad_proof)
+                         .ok());
+      }
+    }
+    EXPECT_EQ(base::error::INVALID_ARGUMENT,
+              tree->VerifyChunk(tree->num_chunks(), "").error_code());
+  }
+}
+
+TEST(HashTree, BuildFromFile) {
+  core::Env* env = core::Env::Default();
+  core::thread::ThreadPool pool(env, "hash_tree", 2);
+  for (size_t size : {size_t(0), size_t(300000)}) {
+    const std::string path = TestPath(std::to_string(size));
+    const std::string text = MakeText(size);
+    ASSERT_TRUE(core::WriteStringToFile(env, path, text).ok());
+    std::unique_ptr<HashTree> tree;
+    ASSERT_TRUE(HashTree::BuildFromFile(env, path, DigestEngine::kSha256,
+                                        4096, &pool, &tree).ok());
+    std::unique_ptr<HashTree> expected = HashTree::Build(
+        DigestEngine::kSha256, text.data(), text.size(), 4096);
+    EXPECT_EQ(expected->root(), tree->root());
+    EXPECT_TRUE(env->DeleteFile(path).ok());
+  }
+
+  std::unique_ptr<HashTree> tree;
+  EXPECT_FALSE(HashTree::BuildFromFile(env, TestPath("missing"),
+                                       DigestEngine::kSha256, 4096, nullptr,
+                                       &tree).ok());
+}
+
+} // namespace crypto
@@ -0,0 +1,225 @@
+#include "crypto/sm2.h"
+#include "crypto/sm3.h"
+
+#include "strings/string_encode.h"
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+const char kPrivateKeyHex[] =
+    "3945208F7B2144B13F36E38AC6D39F95889393692860B51A42FB81EF4DF7C5B8";
+
+std::unique_ptr<Sm2PrivateKey> TestKey() {
+  std::unique_ptr<Sm2PrivateKey> key =
+      Sm2PrivateKey::FromBytes(strings::HexDecode(kPrivateKeyHex));
+  CHECK(key);
+  return key;
+}
+
+} // namespace
+
+// GB/T 32905-2016, appendix A.
+TEST(Sm3, StandardVectors) {
+  EXPECT_EQ(strings::HexDecode("66c7f0f462eeedd9d1f2d46bdc10e4e2"
+                               "4167c4875cf2f7a2297da02b8f4ba8e0"),
+            Sm3::Hash("abc"));
+  std::string abcd;
+  for (int i = 0; i < 16; ++i) {
+    abcd += "abcd";
+  }
+  EXPECT_EQ(strings::HexDecode("debe9ff92275b8a138604889c18e5a4d"
+                               "6fdb70e5387e5765293dcba39c0c5732"),
+            Sm3::Hash(abcd));
+
+  // Fed in pieces that straddle the block boundary.
+  Sm3 sm3;
+  sm3.Update(abcd.substr(0, 3));
+  sm3.Update(abcd.substr(3, 60));
+  sm3.Update(abcd.substr(63));
+  std::string digest(Sm3::kDigestSize, '\0');
+  sm3.Finish(reinterpret_cast<uint8_t*>(&digest[0]));
+  EXPECT_EQ(Sm3::Hash(abcd), digest);
+}
+
+// The key pair of GB/T 32918.5-2017, appendix A.2. The signature and the
+// ciphertext below were produced by OpenSSL with this key.
+TEST(Sm2, KnownAnswers) {
+  std::unique_ptr<Sm2PrivateKey> key = TestKey();
+  EXPECT_EQ(strings::HexDecode(
+                "0409F9DF311E5421A150DD7D161E4BC5C672179FAD1833FC076BB08FF356"
+                "F35020CCEA490CE26775A52DC6EA718CC1AA600AED05FBF35E084A6632F6"
+                "072DA9AD13"),
+            key->public_key().ToBytes());
+
+  EXPECT_TRUE(key->public_key().Verify("message digest", strings::HexDecode(
+      "93FDBF1E806E4F3F44109725D8EC9154023D8574301A7585002E26F1CC98314D"
+      "6264F84438DF2DD8719F071FA950017DDDAB1C8C6946DC29566742F629D814B7"))
+      .ok());
+
+  std::string plaintext;
+  ASSERT_TRUE(key->Decrypt(strings::HexDecode(
+      "04121E5F551BCFC79B5499531AFE7A39F526D03B103137D9546A3CD5E5E170ADDC"
+      "DAF5DC1DEE4D331F8B23695AA885C63BF7190E343FDA3EB61FBB15D10BC4A5C3DE"
+      "1B2F7D7C1BAAC698B28559BF0BD32E76FF44896F02CA22783F97525C18DD2865B0"
+      "F4080688EDC11DFEE8D72E573B6099BCDE"), &plaintext).ok());
+  std::string expected;
+  for (int i = 0; i < 19; ++i) {
+    expected.push_back(static_cast<char>(i * 7));
+  }
+  EXPECT_EQ(expected, plaintext);
+}
+
+TEST(Sm2, SignVerify) {
+  std::unique_ptr<Sm2PrivateKey> key = Sm2PrivateKey::Generate();
+  ASSERT_TRUE(key);
+  std::unique_ptr<Sm2PublicKey> public_key =
+      Sm2PublicKey::FromBytes(key->public_key().ToBytes());
+  ASSERT_TRUE(public_key);
+
+  for (const std::string& message : {std::string(), std::string("abc"),
+                                     std::string(10000, 'm')}) {
+    std::string signature;
+    ASSERT_TRUE(key->Sign(message, &signature).ok());
+    ASSERT_EQ(64u, signature.size());
+    EXPECT_TRUE(public_key->Verify(message, signature).ok());
+
+    EXPECT_EQ(base::error::DATA_LOSS,
+              public_key->Verify(message + "x", signature).error_code());
+    EXPECT_EQ(base::error::DATA_LOSS,
+              public_key->Verify(message, signature, "another id")
+                  .error_code());
+    for (size_t at : {size_t(0), size_t(31), size_t(32), size_t(63)}) {
+      std::string tampered = signature;
+      tampered[at] ^= 0x10;
+      EXPECT_FALSE(public_key->Verify(message, tampered).ok());
+    }
+    EXPECT_EQ(base::error::INVALID_ARGUMENT,
+              public_key->Verify(message, signature.substr(1)).error_code());
+  }
+
+  std::string signature;
+  ASSERT_TRUE(key->Sign("abc", &signature, "alice@example.com").ok());
+  EXPECT_TRUE(public_key->Verify("abc", signature, "alice@example.com").ok());
+  EXPECT_FALSE(public_key->Verify("abc", signature).ok());
+}
+
+TEST(Sm2, EncryptDecrypt) {
+  std::unique_ptr<Sm2PrivateKey> key = TestKey();
+  for (size_t size : {0, 1, 31, 32, 33, 1000}) {
+    std::string message(size, 'p');
+    std::string ciphertext, plaintext;
+    ASSERT_TRUE(key->public_key().Encrypt(message, &ciphertext).ok());
+    ASSERT_EQ(97 + size, ciphertext.size());
+    ASSERT_TRUE(key->Decrypt(ciphertext, &plaintext).ok());
+    EXPECT_EQ(message, plaintext);
+
+    plaintext = "untouched";
+    for (size_t at : {size_t(70), size_t(96), ciphertext.size() - 1}) {
+      std::string tampered = ciphertext;
+      tampered[at] ^= 0x01;
+      EXPECT_EQ(base::error::DATA_LOSS,
+                key->Decrypt(tampered, &plaintext).error_code());
+    }
+    EXPECT_EQ("untouched", plaintext);
+  }
+
+  std::string plaintext;
+  EXPECT_EQ(base::error::DATA_LOSS,
+            key->Decrypt(std::string(96, '\x04'), &plaintext).error_code());
+  std::string ciphertext;
+  ASSERT_TRUE(key->public_key().Encrypt("abc", &ciphertext).ok());
+  // C1 moved off the curve.
+  ciphertext[64] ^= 0x01;
+  EXPECT_EQ(base::error::DATA_LOSS,
+            key->Decrypt(ciphertext, &plaintext).error_code());
+}
+
+TEST(Sm2, VerifyBatch) {
+  std::unique_ptr<Sm2PrivateKey> keys[] = {Sm2PrivateKey::Generate(),
+                                           Sm2PrivateKey::Generate()};
+  const int kCount = 150;
+  std::vector<std::string> messages(kCount), signatures(kCount);
+  std::vector<Sm2PublicKey::VerifyItem> items(kCount);
+  for (int i = 0; i < kCount; ++i) {
+    const Sm2PrivateKey& key = *keys[i % 2];
+    messages[i] = "message " + std::to_string(i);
+    ASSERT_TRUE(key.Sign(messages[i], &signatures[i]).ok());
+    items[i].key = &key.public_key();
+    items[i].message = messages[i];
+    items[i].signature = signatures[i];
+  }
+  // Every seventh entry is checked against the wrong key.
+  for (int i = 0; i < kCount; i += 7) {
+    items[i].key = &keys[(i + 1) % 2]->public_key();
+  }
+
+  core::thread::ThreadPool pool(core::Env::Default(), "sm2_verify", 4);
+  for (core::thread::ThreadPool* p : {&pool,
+                                      (core::thread::ThreadPool*)nullptr}) {
+    std::vector<base::Status> statuses(kCount);
+    Sm2PublicKey::VerifyBatch(p, items.data(), kCount, statuses.data());
+    for (int i = 0; i < kCount; ++i) {
+      EXPECT_EQ(i % 7 != 0, statuses[i].ok()) << i;
+    }
+  }
+}
+
+TEST(Sm2, VerifyBatchEmptyId) {
+  std::unique_ptr<Sm2PrivateKey> owned = TestKey();
+  const Sm2PrivateKey& key = *owned;
+  std::string with_empty, with_default;
+  ASSERT_TRUE(key.Sign("abc", &with_empty, "").ok());
+  ASSERT_TRUE(key.Sign("abc", &with_default).ok());
+
+  Sm2PublicKey::VerifyItem items[2];
+  items[0].key = items[1].key = &key.public_key();
+  items[0].message = items[1].message = "abc";
+  items[0].signature = with_empty;
+  items[1].signature = with_default;
+  items[0].id = items[1].id = "";
+  base::Status statuses[2];
+  Sm2PublicKey::VerifyBatch(nullptr, items, 2, statuses);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(key.public_key().Verify("abc", items[i].signature, "").ok(),
+              statuses[i].ok()) << i;
+  }
+  EXPECT_TRUE(statuses[0].ok());
+  EXPECT_FALSE(statuses[1].ok());
+}
+
+TEST(Sm2, Rejects) {
+  const std::string encoded = TestKey()->public_key().ToBytes();
+  EXPECT_TRUE(Sm2PublicKey::FromBytes(encoded));
+  EXPECT_FALSE(Sm2PublicKey::FromBytes(encoded.substr(1)));
+  std::string compressed = encoded;
+  compressed[0] = 0x02;
+  EXPECT_FALSE(Sm2PublicKey::FromBytes(compressed));
+  std::string off_curve = encoded;
+  off_curve[64] ^= 0x01;
+  EXPECT_FALSE(Sm2PublicKey::FromBytes(off_curve));
+
+  EXPECT_FALSE(Sm2PrivateKey::FromBytes(std::string(32, '\0')));
+  EXPECT_FALSE(Sm2PrivateKey::FromBytes(std::string(31, '\x01')));
+  // n - 1: 1 + d would not be invertible.
+  EXPECT_FALSE(Sm2PrivateKey::FromBytes(strings::HexDecode(
+      "FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFF7203DF6B21C6052B53BBF40939D54122")));
+  EXPECT_TRUE(Sm2PrivateKey::FromBytes(strings::HexDecode(
+      "FFFFFFFEFFFFFFFFFFFFFFFFFFFFFFFF7203DF6B21C6052B53BBF40939D54121")));
+
+  std::string signature;
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            TestKey()->Sign("abc", &signature, std::string(8192, 'i'))
+                .error_code());
+}
+
+} // namespace crypto
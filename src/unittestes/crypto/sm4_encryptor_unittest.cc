@@ -0,0 +1,225 @@
+#include "crypto/sm4_encryptor.h"
+#include "crypto/sm4_engine.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/array_input_stream.h"
+#include "io/string_output_stream.h"
+#include "strings/string_encode.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+const uint8_t* Bytes(const std::string& s) {
+  return reinterpret_cast<const uint8_t*>(s.data());
+}
+
+uint8_t* Bytes(std::string* s) {
+  return reinterpret_cast<uint8_t*>(&(*s)[0]);
+}
+
+} // namespace
+
+// GB/T 32907-2016, appendix A.
+TEST(Sm4Engine, StandardVectors) {
+  const std::string raw_key =
+      strings::HexDecode("0123456789abcdeffedcba9876543210");
+  Sm4Key key;
+  ASSERT_TRUE(Sm4Engine::ExpandKey(raw_key, &key));
+  const Sm4Engine::Kernels* kernels = Sm4Engine::Get(Sm4Engine::kPortable);
+
+  std::string block = raw_key;
+  kernels->ecb_crypt(key.encrypt_keys, Bytes(block), Bytes(&block), 1);
+  EXPECT_EQ(strings::HexDecode("681edf34d206965e86b3e94f536e4246"), block);
+  kernels->ecb_crypt(key.decrypt_keys, Bytes(block), Bytes(&block), 1);
+  EXPECT_EQ(raw_key, block);
+
+  for (int i = 0; i < 1000000; ++i) {
+    kernels->ecb_crypt(key.encrypt_keys, Bytes(block), Bytes(&block), 1);
+  }
+  EXPECT_EQ(strings::HexDecode("595298c7c6fd271f0402f804c33d3f66"), block);
+
+  EXPECT_FALSE(Sm4Engine::ExpandKey(std::string(32, 'k'), &key));
+}
+
+TEST(Sm4Engine, KernelsAgree) {
+  const Sm4Engine::Kernels* portable = Sm4Engine::Get(Sm4Engine::kPortable);
+  const Sm4Engine::Kernels* avx2 = Sm4Engine::Get(Sm4Engine::kAVX2);
+  if (!avx2) {
+    LOG(INFO) << "No AVX2 kernels on this CPU";
+    return;
+  }
+  std::unique_ptr<AESKey> raw_key = AESKey::Create(128);
+  Sm4Key key;
+  ASSERT_TRUE(Sm4Engine::ExpandKey(raw_key->key(), &key));
+  const std::string iv = strings::HexDecode("f0e1d2c3b4a5968778695a4b3c2d1eff");
+
+  // Whole groups of 8 and 16 blocks, and every kind of tail.
+  for (int blocks : {1, 7, 8, 9, 15, 16, 17, 24, 33, 100}) {
+    const std::string text = MakeText(blocks * 16);
+    for (const uint32_t* rk : {key.encrypt_keys, key.decrypt_keys}) {
+      std::string expected = text, actual = text;
+      portable->ecb_crypt(rk, Bytes(text), Bytes(&expected), blocks);
+      avx2->ecb_crypt(rk, Bytes(actual), Bytes(&actual), blocks);
+      EXPECT_EQ(expected, actual) << "ecb " << blocks;
+    }
+
+    const Sm4Engine::ChainFunc Sm4Engine::Kernels::* funcs[] = {
+        &Sm4Engine::Kernels::cbc_encrypt,
+        &Sm4Engine::Kernels::cbc_decrypt,
+        &Sm4Engine::Kernels::ctr_crypt,
+    };
+    for (auto func : funcs) {
+      std::string expected = text, actual = text;
+      std::string expected_chain = iv, actual_chain = iv;
+      (portable->*func)(key, Bytes(&expected_chain), Bytes(text),
+                        Bytes(&expected), blocks);
+      // In place.
+      (avx2->*func)(key, Bytes(&actual_chain), Bytes(actual),
+                    Bytes(&actual), blocks);
+      EXPECT_EQ(expected, actual) << "chained " << blocks;
+      EXPECT_EQ(expected_chain, actual_chain) << "chained " << blocks;
+    }
+  }
+}
+
+TEST(GHash, AcceleratedMatchesPortable) {
+  const std::string key = strings::HexDecode("66e94bd4ef8a2c3b884cfa59ca342b2e");
+  for (int size : {0, 1, 15, 16, 17, 100, 4096}) {
+    const std::string text = MakeText(size);
+    GHash fast(Bytes(key));
+    GHash slow(Bytes(key));
+    slow.DisableAcceleration();
+    std::string fast_digest(16, '\0'), slow_digest(16, '\0');
+    // Fed in uneven pieces.
+    for (int i = 0; i < size; i += 7) {
+      fast.Update(Bytes(text) + i, std::min(7, size - i));
+    }
+    slow.Update(Bytes(text), text.size());
+    fast.Finish(Bytes(&fast_digest));
+    slow.Finish(Bytes(&slow_digest));
+    EXPECT_EQ(slow_digest, fast_digest) << "size " << size;
+  }
+}
+
+TEST(Sm4Encryptor, RoundTrip) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string iv = MakeText(16);
+  for (Sm4Engine::Level level : {Sm4Engine::kPortable, Sm4Engine::kAVX2}) {
+    const Sm4Engine::Kernels* kernels = Sm4Engine::Get(level);
+    if (!kernels) {
+      continue;
+    }
+    for (int size : {0, 1, 16, 31, 32, 1000, 70000}) {
+      // GCM seals one message per nonce.
+      std::unique_ptr<AESEncryptor> encryptors[] = {
+          std::unique_ptr<AESEncryptor>(
+              new Sm4EcbEncryptor(key->key(), kernels)),
+          std::unique_ptr<AESEncryptor>(
+              new Sm4CbcEncryptor(key->key(), iv, kernels)),
+          std::unique_ptr<AESEncryptor>(
+              new Sm4CtrEncryptor(key->key(), iv, kernels)),
+          std::unique_ptr<AESEncryptor>(
+              new Sm4GcmEncryptor(key->key(), iv.substr(0, 12), "aad",
+                                  kernels)),
+      };
+      const std::string text = MakeText(size);
+      for (auto& encryptor : encryptors) {
+        std::string cipher, plain;
+        EXPECT_TRUE(Crypt(encryptor.get(), true, text, &cipher, 1000).ok());
+        EXPECT_TRUE(Crypt(encryptor.get(), false, cipher, &plain, 1000).ok());
+        EXPECT_EQ(text, plain) << "size " << size;
+      }
+    }
+  }
+}
+
+// RFC 8998, appendix A.1.
+TEST(Sm4GcmEncryptor, RFCVector) {
+  const std::string key =
+      strings::HexDecode("0123456789abcdeffedcba9876543210");
+  const std::string iv = strings::HexDecode("00001234567800000000abcd");
+  const std::string aad =
+      strings::HexDecode("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+  const std::string text = strings::HexDecode(
+      "aaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbccccccccccccccccdddddddddddddddd"
+      "eeeeeeeeeeeeeeeeffffffffffffffffeeeeeeeeeeeeeeeeaaaaaaaaaaaaaaaa");
+  const std::string expected = strings::HexDecode(
+      "17f399f08c67d5ee19d0dc9969c4bb7d5fd46fd3756489069157b282bb200735"
+      "d82710ca5c22f0ccfa7cbf93d496ac15a56834cbcf98c397b4024a2691233b8d"
+      "83de3541e4c2b58177e065a9bf7b62ec");
+  Sm4GcmEncryptor gcm(key, iv, aad);
+  std::string cipher, plain;
+  EXPECT_TRUE(Crypt(&gcm, true, text, &cipher).ok());
+  EXPECT_EQ(expected, cipher);
+  EXPECT_TRUE(Crypt(&gcm, false, cipher, &plain).ok());
+  EXPECT_EQ(text, plain);
+
+  cipher[5] ^= 1;
+  EXPECT_EQ(base::error::DATA_LOSS,
+            Crypt(&gcm, false, cipher, &plain).error_code());
+
+  // The nonce is spent; the same message again needs it passed in.
+  EXPECT_EQ(base::error::FAILED_PRECONDITION,
+            Crypt(&gcm, true, text, &cipher).error_code());
+  cipher.clear();
+  io::ArrayInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(gcm.Encrypt(iv, &input, &output).ok());
+  EXPECT_EQ(expected, cipher);
+}
+
+TEST(Sm4Encryptor, Rejects) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  Sm4EcbEncryptor ecb(key->key());
+  std::string out;
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            Crypt(&ecb, true, "text", &out).error_code());
+
+  std::unique_ptr<AESKey> key128 = AESKey::Create(128);
+  Sm4CbcEncryptor cbc(key128->key(), std::string(16, '\0'));
+  std::string cipher;
+  EXPECT_TRUE(Crypt(&cbc, true, "text", &cipher).ok());
+  EXPECT_EQ(base::error::DATA_LOSS,
+            Crypt(&cbc, false, cipher.substr(1), &out).error_code());
+}
+
+TEST(Sm4Factory, RejectsOtherKeySizes) {
+  AESFactory* sm4 = nullptr;
+  ASSERT_TRUE(AESFactory::GetFactory("sm4", &sm4).ok());
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  const std::string iv(16, '\0');
+  EXPECT_FALSE(sm4->CreateCBC(key, iv));
+  EXPECT_FALSE(sm4->CreateECB(key));
+  EXPECT_FALSE(sm4->CreateCTR(key, iv));
+  EXPECT_FALSE(sm4->CreateGCM(key, iv.substr(0, 12)));
+
+  std::unique_ptr<AESKey> key128 = AESKey::Create(128);
+  EXPECT_TRUE(sm4->CreateECB(key128));
+}
+
+TEST(Sm4Factory, NotAnAutoCandidate) {
+  AESFactory* sm4 = nullptr;
+  ASSERT_TRUE(AESFactory::GetFactory("sm4", &sm4).ok());
+  ASSERT_TRUE(sm4);
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  std::unique_ptr<AESEncryptor> ctr = sm4->CreateCTR(key, MakeText(16));
+  std::string cipher, plain;
+  EXPECT_TRUE(Crypt(ctr.get(), true, "hello sm4", &cipher).ok());
+  EXPECT_TRUE(Crypt(ctr.get(), false, cipher, &plain).ok());
+  EXPECT_EQ("hello sm4", plain);
+
+  AESFactory* fastest = nullptr;
+  ASSERT_TRUE(AESFactory::GetFactory("auto", AESFactory::kECB, 128,
+                                     &fastest).ok());
+  EXPECT_NE(sm4, fastest);
+}
+
+} // namespace crypto
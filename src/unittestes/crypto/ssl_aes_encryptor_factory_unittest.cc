@@ -67,4 +67,77 @@ TEST(SslAESFactory, ECBTest) {
 
 }
 
+TEST(SslAESFactory, CTRTest) {
+  AESFactory* factory;
+  EXPECT_TRUE(AESFactory::GetFactory("ssl_aes", &factory).ok());
+
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  EXPECT_TRUE(key);
+  const std::string iv("16 bytes init iv");
+  const std::string text("Hello, World");
+  std::string cipher;
+  std::unique_ptr<AESEncryptor> ctr_encryptor = factory->CreateCTR(key, iv);
+  EXPECT_TRUE(ctr_encryptor);
+
+  // CTR Encrypt
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(ctr_encryptor->Encrypt(&input, &output).ok());
+  EXPECT_EQ(text.size(), cipher.size());
+
+  // CTR Decrypt
+  std::string plain;
+  io::StringInputStream input1(cipher.data(), cipher.size());
+  io::StringOutputStream output1(&plain);
+  EXPECT_TRUE(ctr_encryptor->Decrypt(&input1, &output1).ok());
+  EXPECT_EQ(text, plain);
+}
+
+TEST(AESFactory, AutoTest) {
+  AESFactory* fastest;
+  EXPECT_TRUE(AESFactory::GetFactory("auto", &fastest).ok());
+  // The choice is made once and then served from the snapshot.
+  AESFactory* again;
+  EXPECT_TRUE(AESFactory::GetFactory("auto", AESFactory::kCBC, 128,
+                                     &again).ok());
+  EXPECT_EQ(fastest, again);
+  EXPECT_FALSE(AESFactory::GetFactory("auto", AESFactory::kCBC, 192,
+                                      &again).ok());
+
+  // "auto" cannot be taken by a provider.
+  AESFactory* ssl_factory;
+  EXPECT_TRUE(AESFactory::GetFactory("ssl_aes", &ssl_factory).ok());
+  AESFactory::Register("auto", ssl_factory);
+
+  const AESFactory::Mode kModes[] = {
+    AESFactory::kCBC, AESFactory::kECB, AESFactory::kCTR, AESFactory::kGCM,
+  };
+  for (AESFactory::Mode mode : kModes) {
+    for (int key_size : {128, 256}) {
+      AESFactory* factory;
+      EXPECT_TRUE(AESFactory::GetFactory("auto", mode, key_size,
+                                         &factory).ok());
+    }
+  }
+
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  AESFactory* factory;
+  EXPECT_TRUE(AESFactory::GetFactory("auto", AESFactory::kCTR, 256,
+                                     &factory).ok());
+  const std::string iv("16 bytes init iv");
+  const std::string text("Hello, World");
+  std::unique_ptr<AESEncryptor> ctr_encryptor = factory->CreateCTR(key, iv);
+  EXPECT_TRUE(ctr_encryptor);
+
+  std::string cipher;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(ctr_encryptor->Encrypt(&input, &output).ok());
+  std::string plain;
+  io::StringInputStream input1(cipher.data(), cipher.size());
+  io::StringOutputStream output1(&plain);
+  EXPECT_TRUE(ctr_encryptor->Decrypt(&input1, &output1).ok());
+  EXPECT_EQ(text, plain);
+}
+
 } // namespace crypto
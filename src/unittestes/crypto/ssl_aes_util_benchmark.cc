@@ -0,0 +1,105 @@
+// Throughput of the SslAESUtil streaming engine (and of the parallel CBC
+// decryption) for 1 KiB .. 1 GiB inputs.
+//
+// Usage: ssl_aes_util_benchmark [max_size_in_mib]
+//
+#include "crypto/ssl_aes_util.h"
+#include "crypto/aes_key.h"
+
+#include "io/array_input_stream.h"
+#include "io/array_output_stream.h"
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace crypto {
+namespace {
+
+// Every size is repeated until at least this many bytes went through.
+const int64_t kMinBytesPerRun = 256LL << 20;
+
+typedef std::function<bool(io::InputStream*, io::OutputStream*)> CryptFunc;
+
+double BenchmarkGBps(const CryptFunc& crypt,
+                     const std::vector<char>& input,
+                     int64_t size,
+                     std::vector<char>* output) {
+  core::Env* env = core::Env::Default();
+  int64_t iterations = std::max<int64_t>(1, kMinBytesPerRun / size);
+  uint64_t start = env->NowMicros();
+  for (int64_t i = 0; i < iterations; ++i) {
+    io::ArrayInputStream in(input.data(), static_cast<int>(size));
+    io::ArrayOutputStream out(output->data(), static_cast<int>(output->size()));
+    if (!crypt(&in, &out)) {
+      fprintf(stderr, "crypt failed at size %lld\n", (long long)size);
+      exit(1);
+    }
+  }
+  uint64_t elapsed = std::max<uint64_t>(1, env->NowMicros() - start);
+  return static_cast<double>(size * iterations) / elapsed / 1000.0;
+}
+
+void RunBenchmarks(int64_t max_size) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string raw_key = key->raw_key();
+  const std::string iv("16 bytes init iv");
+
+  std::vector<char> input(max_size, 'x');
+  std::vector<char> output(max_size + 32);
+  std::vector<char> plain(max_size + 32);
+
+  const int parallelism = std::max(1u, std::thread::hardware_concurrency());
+  core::thread::ThreadPool pool(core::Env::Default(), "bench", parallelism);
+
+  printf("%12s %14s %14s %14s %14s\n",
+         "size", "cbc_enc GB/s", "cbc_dec GB/s", "ecb_enc GB/s",
+         "par_dec GB/s");
+  for (int64_t size = 1024; size <= max_size; size *= 4) {
+    CryptFunc cbc_encrypt = [&](io::InputStream* in, io::OutputStream* out) {
+      return SslAESUtil::CBCEncrypt(raw_key, iv, in, out);
+    };
+    CryptFunc ecb_encrypt = [&](io::InputStream* in, io::OutputStream* out) {
+      return SslAESUtil::ECBEncrypt(raw_key, in, out);
+    };
+    double cbc_enc = BenchmarkGBps(cbc_encrypt, input, size, &output);
+
+    // Padding adds one block to the ciphertext.
+    std::vector<char> cipher(output.begin(), output.begin() + size + 16);
+    CryptFunc cbc_decrypt = [&](io::InputStream* in, io::OutputStream* out) {
+      return SslAESUtil::CBCDecrypt(raw_key, iv, in, out);
+    };
+    double cbc_dec = BenchmarkGBps(cbc_decrypt, cipher, size + 16, &plain);
+    double ecb_enc = BenchmarkGBps(ecb_encrypt, input, size, &output);
+
+    CryptFunc parallel_decrypt = [&](io::InputStream* in,
+                                     io::OutputStream* out) {
+      return SslAESUtil::ParallelCBCDecrypt(&pool, parallelism,
+                                            raw_key, iv, in, out);
+    };
+    double par_dec = BenchmarkGBps(parallel_decrypt, cipher, size + 16, &plain);
+
+    printf("%12lld %14.3f %14.3f %14.3f %14.3f\n",
+           (long long)size, cbc_enc, cbc_dec, ecb_enc, par_dec);
+  }
+}
+
+} // namespace
+} // namespace crypto
+
+int main(int argc, char** argv) {
+  int64_t max_size = 1LL << 30;
+  if (argc > 1) {
+    max_size = atoll(argv[1]) << 20;
+  }
+  crypto::RunBenchmarks(max_size);
+  return 0;
+}
@@ -3,12 +3,16 @@
 
 #include "crypto/openssl_util.h"
 
+#include "io/array_input_stream.h"
+#include "io/array_output_stream.h"
 #include "io/string_input_stream.h"
 #include "io/string_output_stream.h"
 
 #include "strings/string_encode.h"
+#include "system/threadpool.h"
 
 #include <memory>
+#include <vector>
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -71,4 +75,116 @@ TEST(ECBCrypt, TEST) {
 
 
 
+TEST(CBCCrypt, ChunkedStreams) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  EXPECT_TRUE(key);
+  std::string raw_key = key->raw_key();
+  const std::string iv("16 bytes init ve");
+
+  std::string text;
+  for (int i = 0; i < 1000; ++i) {
+    text.push_back(static_cast<char>(i * 7));
+  }
+
+  std::string expected;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&expected);
+  EXPECT_TRUE(SslAESUtil::CBCEncrypt(raw_key, iv, &input, &output));
+  EXPECT_EQ(1008u, expected.size());
+
+  // Feed odd-sized input chunks into tiny output buffers so that the
+  // partial block tail and the bounce buffer are both exercised.
+  const int kBlockSizes[] = {1, 5, 16, 23, 64, 4096};
+  for (int in_block : kBlockSizes) {
+    for (int out_block : kBlockSizes) {
+      std::vector<char> buffer(expected.size());
+      io::ArrayInputStream chunked_input(text.data(), text.size(), in_block);
+      io::ArrayOutputStream chunked_output(buffer.data(), buffer.size(),
+                                           out_block);
+      EXPECT_TRUE(SslAESUtil::CBCEncrypt(raw_key, iv,
+                                         &chunked_input, &chunked_output));
+      EXPECT_EQ(static_cast<int64_t>(expected.size()), chunked_output.ByteCount());
+      EXPECT_EQ(expected, std::string(buffer.data(), buffer.size()));
+
+      std::string plain;
+      io::ArrayInputStream cipher_input(expected.data(), expected.size(),
+                                        in_block);
+      io::StringOutputStream plain_output(&plain);
+      EXPECT_TRUE(SslAESUtil::CBCDecrypt(raw_key, iv,
+                                         &cipher_input, &plain_output));
+      EXPECT_EQ(text, plain);
+    }
+  }
+}
+
+TEST(ParallelCrypt, MatchesSequential) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  EXPECT_TRUE(key);
+  std::string raw_key = key->raw_key();
+  const std::string iv("16 bytes init ve");
+  core::thread::ThreadPool pool(core::Env::Default(), "aes", 4);
+
+  // Small segments so that windows, segment edges and an input ending
+  // exactly on a window boundary are all covered.
+  const size_t kSegmentSize = 64;
+  const int kParallelism = 3;
+  const int kSizes[] = {0, 1, 15, 16, 63, 64, 65, 176, 191, 192, 193, 1000};
+  for (int size : kSizes) {
+    std::string text;
+    for (int i = 0; i < size; ++i) {
+      text.push_back(static_cast<char>(i * 13));
+    }
+
+    std::string cbc_cipher;
+    io::StringInputStream input(text.data(), text.size());
+    io::StringOutputStream output(&cbc_cipher);
+    EXPECT_TRUE(SslAESUtil::CBCEncrypt(raw_key, iv, &input, &output));
+
+    std::string plain;
+    io::ArrayInputStream cipher_input(cbc_cipher.data(), cbc_cipher.size(), 7);
+    io::StringOutputStream plain_output(&plain);
+    EXPECT_TRUE(SslAESUtil::ParallelCBCDecrypt(&pool, kParallelism,
+                                               raw_key, iv,
+                                               &cipher_input, &plain_output,
+                                               kSegmentSize));
+    EXPECT_EQ(text, plain);
+
+    std::string ecb_expected;
+    io::StringInputStream input1(text.data(), text.size());
+    io::StringOutputStream output1(&ecb_expected);
+    EXPECT_TRUE(SslAESUtil::ECBEncrypt(raw_key, &input1, &output1));
+
+    std::string ecb_cipher;
+    io::StringInputStream input2(text.data(), text.size());
+    io::StringOutputStream output2(&ecb_cipher);
+    EXPECT_TRUE(SslAESUtil::ParallelECBEncrypt(&pool, kParallelism, raw_key,
+                                               &input2, &output2,
+                                               kSegmentSize));
+    EXPECT_EQ(ecb_expected, ecb_cipher);
+
+    std::string ecb_plain;
+    io::StringInputStream input3(ecb_cipher.data(), ecb_cipher.size());
+    io::StringOutputStream output3(&ecb_plain);
+    EXPECT_TRUE(SslAESUtil::ParallelECBDecrypt(&pool, kParallelism, raw_key,
+                                               &input3, &output3,
+                                               kSegmentSize));
+    EXPECT_EQ(text, ecb_plain);
+  }
+
+  // Bad padding in the final segment is still detected.
+  std::string text(300, 'p');
+  std::string cipher;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(SslAESUtil::CBCEncrypt(raw_key, iv, &input, &output));
+  cipher.resize(cipher.size() - 16);
+  std::string plain;
+  io::StringInputStream input1(cipher.data(), cipher.size());
+  io::StringOutputStream output1(&plain);
+  EXPECT_FALSE(SslAESUtil::ParallelCBCDecrypt(&pool, kParallelism,
+                                              raw_key, iv,
+                                              &input1, &output1,
+                                              kSegmentSize));
+}
+
 } // namespace crypto
@@ -0,0 +1,129 @@
+#include "crypto/ssl_cbc_aes_encryptor.h"
+#include "crypto/ssl_aes_util.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+TEST(SslCbcAESEncryptor, ReuseMatchesUtil) {
+  std::unique_ptr<AESKey> key(AESKey::Create(128));
+  EXPECT_TRUE(key);
+  const std::string iv("16 bytes init iv");
+  SslCbcAESEncryptor cbc_encryptor(key->raw_key(), iv);
+
+  // Every call starts from a clean IV and cipher state, including after a
+  // failed decryption.
+  for (int size = 0; size < 100; size += 7) {
+    const std::string text = MakeText(size, size);
+    std::string expected;
+    io::StringInputStream input(text.data(), text.size());
+    io::StringOutputStream output(&expected);
+    EXPECT_TRUE(SslAESUtil::CBCEncrypt(key->raw_key(), iv, &input, &output));
+
+    std::string cipher;
+    io::StringInputStream input1(text.data(), text.size());
+    io::StringOutputStream output1(&cipher);
+    EXPECT_TRUE(cbc_encryptor.Encrypt(&input1, &output1).ok());
+    EXPECT_EQ(expected, cipher);
+
+    std::string truncated = cipher.substr(0, cipher.size() / 2);
+    std::string junk;
+    io::StringInputStream input2(truncated.data(), truncated.size());
+    io::StringOutputStream output2(&junk);
+    if (!truncated.empty()) {
+      EXPECT_FALSE(cbc_encryptor.Decrypt(&input2, &output2).ok());
+    }
+
+    std::string plain;
+    io::StringInputStream input3(cipher.data(), cipher.size());
+    io::StringOutputStream output3(&plain);
+    EXPECT_TRUE(cbc_encryptor.Decrypt(&input3, &output3).ok());
+    EXPECT_EQ(text, plain);
+  }
+}
+
+TEST(SslCbcAESEncryptor, SharedAcrossThreads) {
+  std::unique_ptr<AESKey> key(AESKey::Create(256));
+  EXPECT_TRUE(key);
+  const std::string iv("16 bytes init iv");
+  SslCbcAESEncryptor cbc_encryptor(key->raw_key(), iv);
+
+  const int kThreads = 8;
+  std::vector<int> failures(kThreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 200; ++i) {
+        const std::string text = MakeText(i + t, t);
+        std::string cipher;
+        io::StringInputStream input(text.data(), text.size());
+        io::StringOutputStream output(&cipher);
+        std::string plain;
+        if (!cbc_encryptor.Encrypt(&input, &output).ok()) {
+          failures[t]++;
+          continue;
+        }
+        io::StringInputStream input1(cipher.data(), cipher.size());
+        io::StringOutputStream output1(&plain);
+        if (!cbc_encryptor.Decrypt(&input1, &output1).ok() || plain != text) {
+          failures[t]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    EXPECT_EQ(0, failures[t]);
+  }
+}
+
+TEST(SslCbcAESEncryptor, EncryptBatch) {
+  std::unique_ptr<AESKey> key(AESKey::Create(128));
+  EXPECT_TRUE(key);
+  SslCbcAESEncryptor cbc_encryptor(key->raw_key(), "");
+
+  // The second record reuses a context the first one left with its own IV.
+  const std::string texts[] = {"first record", "second", "third record!"};
+  const std::string ivs[] = {"16 bytes init iv", "", "short iv"};
+  std::string ciphers[3];
+  std::vector<std::unique_ptr<io::StringInputStream>> inputs;
+  std::vector<std::unique_ptr<io::StringOutputStream>> outputs;
+  AESBatchRecord records[3];
+  for (int i = 0; i < 3; ++i) {
+    inputs.emplace_back(new io::StringInputStream(texts[i].data(),
+                                                  texts[i].size()));
+    outputs.emplace_back(new io::StringOutputStream(&ciphers[i]));
+    records[i].input = inputs[i].get();
+    records[i].output = outputs[i].get();
+    records[i].iv = ivs[i];
+  }
+  base::Status statuses[3];
+  cbc_encryptor.EncryptBatch(records, 3, statuses);
+
+  EXPECT_TRUE(statuses[0].ok());
+  EXPECT_TRUE(statuses[1].ok());
+  EXPECT_FALSE(statuses[2].ok());
+  for (int i = 0; i < 2; ++i) {
+    std::string expected;
+    io::StringInputStream input(texts[i].data(), texts[i].size());
+    io::StringOutputStream output(&expected);
+    EXPECT_TRUE(SslAESUtil::CBCEncrypt(key->raw_key(), ivs[i],
+                                       &input, &output));
+    EXPECT_EQ(expected, ciphers[i]);
+  }
+}
+
+} // namespace crypto
@@ -0,0 +1,91 @@
+#include "crypto/ssl_ctr_aes_encryptor.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/array_input_stream.h"
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include "strings/string_encode.h"
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+// NIST SP 800-38A, F.5.1 CTR-AES128.Encrypt
+TEST(SslCtrAESEncryptor, KnownAnswer) {
+  const std::string raw_key =
+      strings::HexDecode("2b7e151628aed2a6abf7158809cf4f3c");
+  const std::string iv =
+      strings::HexDecode("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+  const std::string text = strings::HexDecode(
+      "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51");
+
+  SslCtrAESEncryptor ctr_encryptor(raw_key, iv);
+  std::string cipher;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(ctr_encryptor.Encrypt(&input, &output).ok());
+  EXPECT_EQ("874D6191B620E3261BEF6864990DB6CE"
+            "9806F66B7970FDFF8617187BB9FFFDFF",
+            strings::HexEncode(cipher));
+}
+
+TEST(SslCtrAESEncryptor, DecryptRange) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  EXPECT_TRUE(key);
+  // The counter wraps inside the low 64 bits during the stream.
+  const std::string iv = strings::HexDecode("0000000000000000fffffffffffffffe");
+  const std::string text = MakeText(1000);
+
+  SslCtrAESEncryptor ctr_encryptor(key->raw_key(), iv);
+  std::string cipher;
+  io::ArrayInputStream input(text.data(), text.size(), 23);
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(ctr_encryptor.Encrypt(&input, &output).ok());
+  EXPECT_EQ(text.size(), cipher.size());
+
+  const int kOffsets[] = {0, 1, 15, 16, 17, 31, 32, 500, 999};
+  for (int offset : kOffsets) {
+    size_t length = std::min<size_t>(77, text.size() - offset);
+    std::string plain(length, '\0');
+    EXPECT_TRUE(ctr_encryptor.DecryptRange(offset, cipher.data() + offset,
+                                           length, &plain[0]).ok());
+    EXPECT_EQ(text.substr(offset, length), plain);
+  }
+}
+
+TEST(SslCtrAESEncryptor, ParallelCrypt) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  EXPECT_TRUE(key);
+  const std::string iv("16 bytes init iv");
+  const std::string text = MakeText(100003);
+
+  SslCtrAESEncryptor ctr_encryptor(key->raw_key(), iv);
+  std::string expected;
+  io::StringInputStream input(text.data(), text.size());
+  io::StringOutputStream output(&expected);
+  EXPECT_TRUE(ctr_encryptor.Encrypt(&input, &output).ok());
+
+  core::thread::ThreadPool pool(core::Env::Default(), "ctr", 4);
+  const int kRanges[] = {1, 2, 3, 8, 64};
+  for (int num_ranges : kRanges) {
+    std::string cipher(text.size(), '\0');
+    EXPECT_TRUE(ctr_encryptor.ParallelCrypt(&pool, num_ranges, text.data(),
+                                            text.size(), &cipher[0]).ok());
+    EXPECT_EQ(expected, cipher);
+
+    // In place.
+    EXPECT_TRUE(ctr_encryptor.ParallelCrypt(&pool, num_ranges, &cipher[0],
+                                            cipher.size(), &cipher[0]).ok());
+    EXPECT_EQ(text, cipher);
+  }
+}
+
+} // namespace crypto
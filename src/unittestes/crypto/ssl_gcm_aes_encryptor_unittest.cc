@@ -0,0 +1,161 @@
+#include "crypto/ssl_gcm_aes_encryptor.h"
+#include "crypto/aes_key.h"
+
+#include "io/array_input_stream.h"
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include "strings/string_encode.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+base::Status Encrypt(AESEncryptor* encryptor, const std::string& text,
+                     int block_size, std::string* cipher) {
+  io::ArrayInputStream input(text.data(), text.size(), block_size);
+  io::StringOutputStream output(cipher);
+  return encryptor->Encrypt(&input, &output);
+}
+
+base::Status Encrypt(SslGcmAESEncryptor* encryptor, const std::string& nonce,
+                     const std::string& text, int block_size,
+                     std::string* cipher) {
+  io::ArrayInputStream input(text.data(), text.size(), block_size);
+  io::StringOutputStream output(cipher);
+  return encryptor->Encrypt(nonce, &input, &output);
+}
+
+base::Status Decrypt(AESEncryptor* encryptor, const std::string& cipher,
+                     int block_size, std::string* plain) {
+  io::ArrayInputStream input(cipher.data(), cipher.size(), block_size);
+  io::StringOutputStream output(plain);
+  return encryptor->Decrypt(&input, &output);
+}
+
+} // namespace
+
+// Test cases 1 and 2 of the GCM specification.
+TEST(SslGcmAESEncryptor, KnownAnswer) {
+  const std::string raw_key(16, '\0');
+  const std::string iv(12, '\0');
+  SslGcmAESEncryptor gcm_encryptor(raw_key, iv);
+
+  std::string cipher;
+  io::StringInputStream empty(nullptr, 0);
+  io::StringOutputStream output(&cipher);
+  EXPECT_TRUE(gcm_encryptor.Encrypt(&empty, &output).ok());
+  EXPECT_EQ("58E2FCCEFA7E3061367F1D57A4E7455A", strings::HexEncode(cipher));
+
+  // The second case uses the same nonce, so it has to be passed in.
+  cipher.clear();
+  EXPECT_TRUE(Encrypt(&gcm_encryptor, iv, std::string(16, '\0'), -1,
+                      &cipher).ok());
+  EXPECT_EQ("0388DACE60B6A392F328C2B971B2FE78"
+            "AB6E47D42CEC13BDF53A67B21257BDDF",
+            strings::HexEncode(cipher));
+}
+
+TEST(SslGcmAESEncryptor, ChunkedRoundTrip) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  EXPECT_TRUE(key);
+  const std::string iv("12 bytes iv.");
+  SslGcmAESEncryptor gcm_encryptor(key->raw_key(), iv, "header");
+
+  std::string text;
+  for (int i = 0; i < 777; ++i) {
+    text.push_back(static_cast<char>(i * 13));
+  }
+
+  std::string expected;
+  EXPECT_TRUE(Encrypt(&gcm_encryptor, text, -1, &expected).ok());
+  EXPECT_EQ(text.size() + SslGcmAESEncryptor::kTagSize, expected.size());
+
+  // The same encryptor is reused for every call; this test seals the same
+  // text under the same nonce on purpose, to compare the chunkings.
+  const int kBlockSizes[] = {1, 7, 16, 17, 100};
+  for (int block_size : kBlockSizes) {
+    std::string cipher;
+    EXPECT_TRUE(Encrypt(&gcm_encryptor, iv, text, block_size, &cipher).ok());
+    EXPECT_EQ(expected, cipher);
+
+    std::string plain;
+    EXPECT_TRUE(Decrypt(&gcm_encryptor, cipher, block_size, &plain).ok());
+    EXPECT_EQ(text, plain);
+  }
+}
+
+TEST(SslGcmAESEncryptor, RejectsTampering) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  EXPECT_TRUE(key);
+  const std::string iv("12 bytes iv.");
+  SslGcmAESEncryptor gcm_encryptor(key->raw_key(), iv);
+
+  const std::string text("Hello, World");
+  std::string cipher;
+  EXPECT_TRUE(Encrypt(&gcm_encryptor, text, -1, &cipher).ok());
+
+  for (size_t i = 0; i < cipher.size(); ++i) {
+    std::string tampered = cipher;
+    tampered[i] ^= 0x01;
+    std::string plain;
+    base::Status s = Decrypt(&gcm_encryptor, tampered, 5, &plain);
+    EXPECT_EQ(base::error::DATA_LOSS, s.error_code());
+  }
+
+  // Different additional data.
+  SslGcmAESEncryptor other_aad(key->raw_key(), iv, "aad");
+  std::string plain;
+  EXPECT_FALSE(Decrypt(&other_aad, cipher, -1, &plain).ok());
+
+  // Shorter than a tag.
+  EXPECT_FALSE(Decrypt(&gcm_encryptor, cipher.substr(0, 15), -1, &plain).ok());
+}
+
+TEST(SslGcmAESEncryptor, NonceSealsOnce) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  EXPECT_TRUE(key);
+  SslGcmAESEncryptor gcm_encryptor(key->raw_key(), "12 bytes iv.");
+
+  std::string first, second;
+  EXPECT_TRUE(Encrypt(&gcm_encryptor, "message", -1, &first).ok());
+  EXPECT_EQ(base::error::FAILED_PRECONDITION,
+            Encrypt(&gcm_encryptor, "message", -1, &second).error_code());
+  // Decrypting under the same nonce is fine.
+  std::string plain;
+  EXPECT_TRUE(Decrypt(&gcm_encryptor, first, -1, &plain).ok());
+  EXPECT_EQ("message", plain);
+
+  // Fresh nonces per message, one by one or as a batch.
+  const std::string nonces[] = {"nonce 000001", "nonce 000002"};
+  std::string ciphers[2], batched[2];
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(Encrypt(&gcm_encryptor, nonces[i], "message", 3,
+                        &ciphers[i]).ok());
+  }
+  EXPECT_NE(ciphers[0], ciphers[1]);
+  io::ArrayInputStream input0("message", 7), input1("message", 7);
+  io::StringOutputStream output0(&batched[0]), output1(&batched[1]);
+  AESBatchRecord records[] = {{&input0, &output0, nonces[0]},
+                              {&input1, &output1, nonces[1]}};
+  base::Status statuses[2];
+  gcm_encryptor.EncryptBatch(records, 2, statuses);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(statuses[i].ok());
+    EXPECT_EQ(ciphers[i], batched[i]);
+
+    io::ArrayInputStream input(ciphers[i].data(), ciphers[i].size());
+    io::StringOutputStream output(&plain);
+    plain.clear();
+    EXPECT_TRUE(gcm_encryptor.Decrypt(nonces[i], &input, &output).ok());
+    EXPECT_EQ("message", plain);
+  }
+}
+
+} // namespace crypto
@@ -0,0 +1,148 @@
+#include "crypto/ssl_stream_aes_encryptor.h"
+#include "crypto/ssl_gcm_aes_encryptor.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "io/string_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include "third_party/boringssl/include/openssl/hmac.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+// HKDF-SHA256 of |key| under |salt|, with an empty info, worked out by hand.
+std::string Subkey(const std::string& key, const std::string& salt) {
+  uint8_t prk[32], okm[32];
+  unsigned int size = 0;
+  const uint8_t counter = 1;
+  HMAC(EVP_sha256(), salt.data(), salt.size(),
+       reinterpret_cast<const uint8_t*>(key.data()), key.size(), prk, &size);
+  HMAC(EVP_sha256(), prk, sizeof(prk), &counter, 1, okm, &size);
+  return std::string(reinterpret_cast<char*>(okm), key.size());
+}
+
+} // namespace
+
+TEST(SslStreamAESEncryptor, RoundTrip) {
+  std::unique_ptr<AESKey> key = AESKey::Create(256);
+  const size_t kSegmentSize = 1000;
+  core::thread::ThreadPool pool(core::Env::Default(), "stream", 4);
+
+  for (int size : {0, 1, 999, 1000, 1001, 2000, 37001}) {
+    const std::string text = MakeText(size);
+    // One segment per started kSegmentSize, and at least one.
+    const size_t segments = size == 0 ? 1 : (size + kSegmentSize - 1) /
+                                            kSegmentSize;
+    for (int window : {1, 3, 8}) {
+      for (core::thread::ThreadPool* p :
+           {&pool, static_cast<core::thread::ThreadPool*>(nullptr)}) {
+        SslStreamAESEncryptor stream(key->key(), p, window, kSegmentSize);
+        std::string cipher, plain;
+        EXPECT_TRUE(Crypt(&stream, true, text, &cipher, 333).ok());
+        EXPECT_EQ(SslStreamAESEncryptor::kHeaderSize + size +
+                      segments * SslStreamAESEncryptor::kTagSize,
+                  cipher.size());
+        EXPECT_TRUE(Crypt(&stream, false, cipher, &plain, 517).ok());
+        EXPECT_EQ(text, plain) << "size " << size << " window " << window;
+      }
+    }
+  }
+}
+
+TEST(SslStreamAESEncryptor, SegmentLayout) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  const std::string text = MakeText(1500);
+  SslStreamAESEncryptor stream(key->key(), nullptr, 4, 1000);
+  std::string cipher;
+  EXPECT_TRUE(Crypt(&stream, true, text, &cipher).ok());
+
+  // The salt and the stream nonce, then segment 0 as plain GCM under
+  // the salted subkey and nonce || 0 || not last, and segment 1 under
+  // nonce || 1 || last.
+  const std::string header =
+      cipher.substr(0, SslStreamAESEncryptor::kHeaderSize);
+  const std::string subkey = Subkey(
+      key->raw_key(), header.substr(0, SslStreamAESEncryptor::kSaltSize));
+  const std::string iv = header.substr(SslStreamAESEncryptor::kSaltSize);
+  const std::string nonces[] = {iv + std::string("\0\0\0\0\0", 5),
+                                iv + std::string("\0\0\0\1\1", 5)};
+  const std::string parts[] = {text.substr(0, 1000), text.substr(1000)};
+  std::string expected = header;
+  for (int i = 0; i < 2; ++i) {
+    SslGcmAESEncryptor gcm(subkey, nonces[i]);
+    std::string sealed;
+    io::StringInputStream input(parts[i].data(), parts[i].size());
+    io::StringOutputStream output(&sealed);
+    EXPECT_TRUE(gcm.Encrypt(&input, &output).ok());
+    expected += sealed;
+  }
+  EXPECT_EQ(expected, cipher);
+}
+
+TEST(SslStreamAESEncryptor, FreshNoncePerStream) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  SslStreamAESEncryptor stream(key->key(), nullptr, 2, 100);
+  const std::string text = MakeText(250);
+  std::string first, second, plain;
+  EXPECT_TRUE(Crypt(&stream, true, text, &first).ok());
+  EXPECT_TRUE(Crypt(&stream, true, text, &second).ok());
+  EXPECT_NE(first.substr(0, SslStreamAESEncryptor::kSaltSize),
+            second.substr(0, SslStreamAESEncryptor::kSaltSize));
+  EXPECT_NE(first, second);
+  EXPECT_TRUE(Crypt(&stream, false, second, &plain).ok());
+  EXPECT_EQ(text, plain);
+}
+
+TEST(SslStreamAESEncryptor, DetectsTampering) {
+  std::unique_ptr<AESKey> key = AESKey::Create(128);
+  core::thread::ThreadPool pool(core::Env::Default(), "stream", 2);
+  SslStreamAESEncryptor stream(key->key(), &pool, 2, 100);
+  const std::string text = MakeText(1000);
+  std::string cipher, plain;
+  EXPECT_TRUE(Crypt(&stream, true, text, &cipher).ok());
+  const size_t kHeader = SslStreamAESEncryptor::kHeaderSize;
+  const size_t kSealed = 100 + SslStreamAESEncryptor::kTagSize;
+
+  std::string flipped = cipher;
+  flipped[kHeader + 5 * kSealed + 3] ^= 1;
+  EXPECT_EQ(base::error::DATA_LOSS,
+            Crypt(&stream, false, flipped, &plain).error_code());
+  // Only the segments in front of the bad one were written.
+  EXPECT_EQ(text.substr(0, 500), plain);
+
+  // Cut at a segment boundary: the new last segment lacks the flag.
+  EXPECT_FALSE(Crypt(&stream, false, cipher.substr(0, kHeader + 4 * kSealed),
+                   &plain).ok());
+
+  std::string swapped = cipher;
+  swapped.replace(kHeader, kSealed, cipher, kHeader + kSealed, kSealed);
+  EXPECT_FALSE(Crypt(&stream, false, swapped, &plain).ok());
+
+  std::string resalted = cipher;
+  resalted[0] ^= 1;
+  EXPECT_FALSE(Crypt(&stream, false, resalted, &plain).ok());
+  std::string renonced = cipher;
+  renonced[SslStreamAESEncryptor::kSaltSize] ^= 1;
+  EXPECT_FALSE(Crypt(&stream, false, renonced, &plain).ok());
+
+  std::unique_ptr<AESKey> other_key = AESKey::Create(128);
+  SslStreamAESEncryptor other(other_key->key(), &pool, 2, 100);
+  EXPECT_FALSE(Crypt(&other, false, cipher, &plain).ok());
+  EXPECT_EQ(base::error::DATA_LOSS,
+            Crypt(&stream, false, "", &plain).error_code());
+  EXPECT_FALSE(Crypt(&stream, false, cipher.substr(0, kHeader),
+                     &plain).ok());
+}
+
+} // namespace crypto
@@ -0,0 +1,174 @@
+#include "crypto/ssl_xts_aes_encryptor.h"
+#include "crypto/aes_key.h"
+#include "unittestes/crypto/crypto_test.h"
+
+#include "files/file_system.h"
+#include "io/array_input_stream.h"
+#include "io/string_output_stream.h"
+#include "strings/string_encode.h"
+
+#include "system/env.h"
+#include "system/threadpool.h"
+
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace crypto {
+
+namespace {
+
+std::string SectorsCrypt(SslXtsAESEncryptor* xts, bool do_encrypt,
+                         uint64_t sector, const std::string& in) {
+  std::string out(in.size(), '\0');
+  base::Status status = do_encrypt ?
+      xts->EncryptSectors(sector, in.data(), in.size(), &out[0]) :
+      xts->DecryptSectors(sector, in.data(), in.size(), &out[0]);
+  EXPECT_TRUE(status.ok());
+  return out;
+}
+
+class StringRegion : public files::ReadOnlyMemoryRegion {
+ public:
+  explicit StringRegion(const std::string& data) : data_(data) {}
+  virtual const void* data() override { return data_.data(); }
+  virtual uint64_t length() override { return data_.size(); }
+
+ private:
+  const std::string& data_;
+};
+
+} // namespace
+
+// Vectors 2 and 10 of IEEE 1619-2007, annex B. Vector 1 uses the same
+// key twice, which the encryptor refuses.
+TEST(SslXtsAESEncryptor, IEEEVectors) {
+  {
+    SslXtsAESEncryptor xts(std::string(16, '\x11') + std::string(16, '\x22'),
+                           std::string(16, '\0'));
+    EXPECT_EQ(strings::HexDecode("c454185e6a16936e39334038acef838b"
+                                 "fb186fff7480adc4289382ecd6d394f0"),
+              SectorsCrypt(&xts, true, 0x3333333333ULL,
+                           std::string(32, '\x44')));
+  }
+  {
+    SslXtsAESEncryptor xts(strings::HexDecode(
+        "27182818284590452353602874713526"
+        "62497757247093699959574966967627"
+        "31415926535897932384626433832795"
+        "02884197169399375105820974944592"), std::string(16, '\0'), 512);
+    std::string text;
+    for (int i = 0; i < 512; ++i) {
+      text.push_back(static_cast<char>(i));
+    }
+    const std::string cipher = SectorsCrypt(&xts, true, 0xff, text);
+    EXPECT_EQ(strings::HexDecode("1c3b3a102f770386e4836c99e370cf9b"
+                                 "ea00803f5e482357a4ae12d414a3e63b"),
+              cipher.substr(0, 32));
+    EXPECT_EQ(strings::HexDecode("773dad38014bd2092fa755c824bb5e54"
+                                 "c4f36ffda9fcea70b9c6e693e148c151"),
+              cipher.substr(480));
+    EXPECT_EQ(text, SectorsCrypt(&xts, false, 0xff, cipher));
+  }
+}
+
+TEST(SslXtsAESEncryptor, StreamMatchesSectors) {
+  for (int bits : {256, 512}) {
+    std::unique_ptr<AESKey> key = AESKey::CreateXTS(bits);
+    ASSERT_TRUE(key);
+    // Sector 7 as a little-endian sector number.
+    std::string iv(16, '\0');
+    iv[0] = 7;
+    // The sizes with a tail exercise ciphertext stealing.
+    for (int size : {0, 16, 17, 512, 4096, 4096 * 20 + 100, 4096 * 33}) {
+      SslXtsAESEncryptor xts(key->key(), iv);
+      const std::string text = MakeText(size);
+      const std::string expected = SectorsCrypt(&xts, true, 7, text);
+
+      std::string cipher, plain;
+      io::ArrayInputStream input(text.data(), text.size(), 1000);
+      io::StringOutputStream output(&cipher);
+      EXPECT_TRUE(xts.Encrypt(&input, &output).ok());
+      EXPECT_EQ(expected, cipher) << "bits " << bits << " size " << size;
+
+      io::ArrayInputStream cipher_input(cipher.data(), cipher.size(), 777);
+      io::StringOutputStream plain_output(&plain);
+      EXPECT_TRUE(xts.Decrypt(&cipher_input, &plain_output).ok());
+      EXPECT_EQ(text, plain) << "bits " << bits << " size " << size;
+    }
+  }
+}
+
+TEST(SslXtsAESEncryptor, SectorsAreIndependent) {
+  std::unique_ptr<AESKey> key = AESKey::CreateXTS(256);
+  SslXtsAESEncryptor xts(key->key(), std::string(16, '\0'), 512);
+  const std::string text = MakeText(512 * 8);
+  const std::string cipher = SectorsCrypt(&xts, true, 100, text);
+
+  // Sector 103 alone, in place.
+  std::string sector = text.substr(3 * 512, 512);
+  EXPECT_TRUE(xts.EncryptSectors(103, &sector[0], 512, &sector[0]).ok());
+  EXPECT_EQ(cipher.substr(3 * 512, 512), sector);
+  EXPECT_NE(cipher.substr(0, 512), cipher.substr(512, 512));
+  EXPECT_NE(SectorsCrypt(&xts, true, 101, text.substr(0, 512)),
+            cipher.substr(0, 512));
+}
+
+TEST(SslXtsAESEncryptor, ParallelSectors) {
+  std::unique_ptr<AESKey> key = AESKey::CreateXTS(512);
+  SslXtsAESEncryptor xts(key->key(), std::string(16, '\0'));
+  core::thread::ThreadPool pool(core::Env::Default(), "xts", 4);
+
+  for (int size : {4096, 4096 * 10, 4096 * 37 + 1000}) {
+    const std::string text = MakeText(size);
+    const std::string expected = SectorsCrypt(&xts, true, 9, text);
+    for (int num_ranges : {1, 3, 8, 100}) {
+      StringRegion region(text);
+      std::string cipher(size, '\0');
+      EXPECT_TRUE(xts.ParallelCryptSectors(&pool, num_ranges, true, 9,
+                                           &region, &cipher[0]).ok());
+      EXPECT_EQ(expected, cipher) << "size " << size << " " << num_ranges;
+
+      EXPECT_TRUE(xts.ParallelCryptSectors(&pool, num_ranges, false, 9,
+                                           cipher.data(), cipher.size(),
+                                           &cipher[0]).ok());
+      EXPECT_EQ(text, cipher) << "size " << size << " " << num_ranges;
+    }
+  }
+}
+
+TEST(SslXtsAESEncryptor, Rejects) {
+  std::unique_ptr<AESKey> key = AESKey::CreateXTS(256);
+  SslXtsAESEncryptor xts(key->key(), "short iv", 512);
+  std::string text = MakeText(512 + 15);
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            xts.EncryptSectors(0, text.data(), text.size(),
+                               &text[0]).error_code());
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            xts.EncryptSectors(0, text.data(), 15, &text[0]).error_code());
+
+  std::string cipher;
+  io::ArrayInputStream input(text.data(), 512);
+  io::StringOutputStream output(&cipher);
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            xts.Encrypt(&input, &output).error_code());
+
+  // A single AES-128 key is not an XTS key pair.
+  std::unique_ptr<AESKey> single = AESKey::Create(128);
+  SslXtsAESEncryptor bad(single->key(), std::string(16, '\0'));
+  EXPECT_EQ(base::error::INVALID_ARGUMENT,
+            bad.EncryptSectors(0, text.data(), 512, &text[0]).error_code());
+
+  // Nor is one key used twice (vector 1 of IEEE 1619-2007).
+  for (int bytes : {16, 32}) {
+    SslXtsAESEncryptor same(std::string(2 * bytes, '\0'),
+                            std::string(16, '\0'));
+    EXPECT_EQ(base::error::INVALID_ARGUMENT,
+              same.EncryptSectors(0, text.data(), 512,
+                                  &text[0]).error_code());
+  }
+}
+
+} // namespace crypto
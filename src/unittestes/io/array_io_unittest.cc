@@ -1,6 +1,12 @@
 #include "unittestes/io/io_test.h"
 #include "io/array_input_stream.h"
 #include "io/array_output_stream.h"
+#include "io/io_util.h"
+#include "io/string_output_stream.h"
+
+#include <limits.h>
+#include <sys/mman.h>
+#include <string>
 
 namespace io {
 
@@ -23,5 +29,67 @@ TEST_F(IoTest, ArrayIo) {
   }
 }
 
+// Windows past kint32max over a 3 GiB mapping that is never touched.
+TEST_F(IoTest, ArrayIo64) {
+  const int64_t kSize = 3LL << 30;
+  void* region = mmap(nullptr, kSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  ASSERT_NE(MAP_FAILED, region);
+
+  {
+    ArrayInputStream input(region, kSize);
+    const void* data;
+    int size;
+    ASSERT_TRUE(input.Next(&data, &size));
+    EXPECT_EQ(INT_MAX, size);
+    input.BackUp(size);
+
+    int64_t size64;
+    ASSERT_TRUE(input.Next64(&data, &size64));
+    EXPECT_EQ(kSize, size64);
+    input.BackUp64(size64 - 1);
+    EXPECT_TRUE(input.Skip64(kSize - 2));
+    EXPECT_EQ(kSize - 1, input.ByteCount());
+    EXPECT_FALSE(input.Skip64(2));
+    EXPECT_EQ(kSize, input.ByteCount());
+  }
+  {
+    ArrayOutputStream output(region, kSize, 1LL << 31);
+    void* data;
+    int64_t size64;
+    ASSERT_TRUE(output.Next64(&data, &size64));
+    EXPECT_EQ(1LL << 31, size64);
+    output.BackUp64(1);
+    ASSERT_TRUE(output.Next64(&data, &size64));
+    EXPECT_EQ(kSize - (1LL << 31) + 1, size64);
+    EXPECT_EQ(kSize, output.ByteCount());
+  }
+  munmap(region, kSize);
+}
+
+TEST_F(IoTest, IoUtil64) {
+  const std::string text(100000, 'q');
+  std::string written;
+  {
+    StringOutputStream output(&written);
+    EXPECT_TRUE(IOUtil::WriteToOutput64(&output, text.data(), text.size()));
+    EXPECT_EQ(100000, output.ByteCount());
+  }
+  EXPECT_EQ(text, written);
+
+  // The default Next64() and Skip64() go through Next() and Skip().
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    ArrayInputStream array_input(written.data(), written.size(),
+                                 kBlockSizes[i]);
+    InputStream* input = &array_input;
+    std::string head(1000, '\0');
+    EXPECT_EQ(1000, IOUtil::ReadFromInput64(input, &head[0], head.size()));
+    EXPECT_EQ(text.substr(0, 1000), head);
+    EXPECT_TRUE(input->InputStream::Skip64(98000));
+    std::string rest(5000, '\0');
+    EXPECT_EQ(1000, IOUtil::ReadFromInput64(input, &rest[0], rest.size()));
+    EXPECT_EQ(100000, input->ByteCount());
+  }
+}
 
 } // namespace io
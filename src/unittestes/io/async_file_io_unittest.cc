@@ -0,0 +1,155 @@
+#include "unittestes/io/io_test.h"
+#include "io/async_file_input_stream.h"
+#include "io/async_file_output_stream.h"
+#include "io/io_uring.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+namespace io {
+
+namespace {
+
+std::string TestPath(const std::string& name) {
+  return testing::TempDir() + "async_file_io_" + std::to_string(getpid()) +
+         "_" + name;
+}
+
+int OpenTemp(const std::string& path) {
+  return open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+}
+
+// Whether this kernel lets the streams use io_uring; they fall back to
+// read() and write() otherwise.
+bool HaveIoUring() {
+  return IoUring::Create(4) != nullptr;
+}
+
+} // namespace
+
+TEST_F(IoTest, AsyncFileIo) {
+  const std::string path = TestPath("stuff");
+
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    for (int j = 0; j < kBlockSizeCount; j++) {
+      int file = OpenTemp(path);
+      ASSERT_GE(file, 0);
+
+      {
+        AsyncFileOutputStream output(file, kBlockSizes[i], 2);
+        WriteStuff(&output);
+        EXPECT_TRUE(output.Flush());
+        EXPECT_EQ(0, output.GetErrno());
+      }
+      // Flush() leaves the descriptor after the data.
+      EXPECT_EQ(68, lseek(file, 0, SEEK_CUR));
+      lseek(file, 0, SEEK_SET);
+
+      {
+        AsyncFileInputStream input(file, kBlockSizes[j], 3);
+        ReadStuff(&input);
+        EXPECT_EQ(0, input.GetErrno());
+      }
+      close(file);
+    }
+  }
+  unlink(path.c_str());
+}
+
+// Data much larger than the queue, read from an offset into the file,
+// with skips inside and past the read-ahead. Without io_uring the same
+// data goes through the fallback.
+TEST_F(IoTest, AsyncFileLarge) {
+  const std::string path = TestPath("large");
+  const bool have_ring = HaveIoUring();
+  const int kSize = 1 << 20;
+  std::string text(kSize, '\0');
+  for (int i = 0; i < kSize; ++i) {
+    text[i] = static_cast<char>(i * 7 + i / 4093);
+  }
+
+  int file = OpenTemp(path);
+  ASSERT_GE(file, 0);
+  {
+    AsyncFileOutputStream output(file, 4096, 4);
+    EXPECT_EQ(have_ring, output.async());
+    EXPECT_TRUE(WriteToOutput(&output, text.data(), 1000));
+    EXPECT_TRUE(WriteToOutput(&output, text.data() + 1000, kSize - 1000));
+    EXPECT_EQ(kSize, output.ByteCount());
+    output.SetCloseOnDelete(true);
+  }
+
+  file = open(path.c_str(), O_RDONLY);
+  ASSERT_GE(file, 0);
+  ASSERT_EQ(100, lseek(file, 100, SEEK_SET));
+  AsyncFileInputStream input(file, 4096, 4);
+  EXPECT_EQ(have_ring, input.async());
+  input.SetCloseOnDelete(true);
+
+  std::string head(5000, '\0');
+  EXPECT_EQ(5000, ReadFromInput(&input, &head[0], 5000));
+  EXPECT_EQ(text.substr(100, 5000), head);
+  EXPECT_TRUE(input.Skip(3000));
+  EXPECT_TRUE(input.Skip(500000));
+  EXPECT_EQ(508000, input.ByteCount());
+
+  std::string rest(kSize, '\0');
+  const int expected = kSize - 100 - 508000;
+  EXPECT_EQ(expected, ReadFromInput(&input, &rest[0], kSize));
+  EXPECT_EQ(text.substr(508100), rest.substr(0, expected));
+  EXPECT_EQ(kSize - 100, input.ByteCount());
+
+  EXPECT_TRUE(input.Skip(0));
+  EXPECT_FALSE(input.Skip(1));
+  unlink(path.c_str());
+}
+
+// Nothing touches the descriptor after an explicit Close(), even when its
+// number has been handed out again.
+TEST_F(IoTest, AsyncFileCloseThenDestroy) {
+  const std::string path = TestPath("closed");
+  const std::string other_path = TestPath("other");
+  int file = OpenTemp(path);
+  ASSERT_GE(file, 0);
+  int other = -1;
+  {
+    AsyncFileOutputStream output(file, 16, 2);
+    WriteStuff(&output);
+    EXPECT_TRUE(output.Close());
+    other = OpenTemp(other_path);
+    ASSERT_GE(other, 0);
+    ASSERT_EQ(3, write(other, "abc", 3));
+  }
+  EXPECT_EQ(3, lseek(other, 0, SEEK_CUR));
+  close(other);
+
+  file = open(path.c_str(), O_RDONLY);
+  ASSERT_GE(file, 0);
+  {
+    AsyncFileInputStream input(file, 16, 2);
+    input.SetCloseOnDelete(true);
+    ReadStuff(&input);
+  }
+  unlink(path.c_str());
+  unlink(other_path.c_str());
+}
+
+// Pipes cannot seek, so both streams fall back to read() and write().
+TEST_F(IoTest, AsyncFileFallback) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  {
+    AsyncFileOutputStream output(fds[1], 16);
+    EXPECT_FALSE(output.async());
+    WriteStuff(&output);
+    output.SetCloseOnDelete(true);
+  }
+  AsyncFileInputStream input(fds[0], 16);
+  EXPECT_FALSE(input.async());
+  input.SetCloseOnDelete(true);
+  ReadStuff(&input);
+}
+
+} // namespace io
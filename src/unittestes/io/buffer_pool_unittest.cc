@@ -0,0 +1,169 @@
+#include "io/buffer_pool.h"
+#include "io/copy_input_stream.h"
+#include "io/copy_output_stream.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+namespace io {
+
+namespace {
+
+class NullCopyOutputStream : public CopyOutputStream {
+ public:
+  virtual bool Write(const void* buffer, int size) override { return true; }
+};
+
+class ZeroCopyInputStream : public CopyInputStream {
+ public:
+  virtual int Read(void* buffer, int size) override {
+    memset(buffer, 0, size);
+    return size;
+  }
+};
+
+// Constructed before the thread cache, so destroyed after it.
+struct HeldAtExit {
+  BufferPool::Buffer buffer;
+};
+
+} // namespace
+
+TEST(BufferPool, SizeClasses) {
+  BufferPool pool;
+  uint8_t* small = pool.Allocate(1);
+  uint8_t* exact = pool.Allocate(8192);
+  uint8_t* odd = pool.Allocate(8193);
+  ASSERT_TRUE(small && exact && odd);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(odd) % 64);
+  memset(odd, 0xaa, 16384);
+
+  BufferPool::Stats stats = pool.GetStats();
+  ASSERT_EQ(BufferPool::kNumClasses, static_cast<int>(stats.classes.size()));
+  EXPECT_EQ(4096u, stats.classes[0].buffer_size);
+  EXPECT_EQ(BufferPool::kMaxClassSize, stats.classes.back().buffer_size);
+  EXPECT_EQ(1, stats.classes[0].in_use);
+  EXPECT_EQ(1, stats.classes[1].in_use);
+  EXPECT_EQ(1, stats.classes[2].in_use);
+  EXPECT_EQ(4096 + 8192 + 16384, stats.bytes_in_use);
+  EXPECT_EQ(3, stats.misses);
+
+  pool.Release(small, 1);
+  pool.Release(exact, 8192);
+  pool.Release(odd, 8193);
+  stats = pool.GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(4096 + 8192 + 16384, stats.bytes_cached);
+
+  // Same class, same buffer.
+  EXPECT_EQ(exact, pool.Allocate(5000));
+  EXPECT_EQ(1, pool.GetStats().hits);
+  pool.Release(exact, 5000);
+
+  pool.Trim();
+  stats = pool.GetStats();
+  EXPECT_EQ(0, stats.bytes_cached);
+  EXPECT_EQ(0, stats.classes[1].cached);
+}
+
+TEST(BufferPool, LimitsAndLargeBuffers) {
+  BufferPool::Options options;
+  options.max_free_per_class = 2;
+  options.alignment = 4096;
+  BufferPool pool(options);
+
+  std::vector<uint8_t*> buffers;
+  for (int i = 0; i < 5; ++i) {
+    buffers.push_back(pool.Allocate(4096));
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffers.back()) % 4096);
+  }
+  for (uint8_t* buffer : buffers) {
+    pool.Release(buffer, 4096);
+  }
+  EXPECT_EQ(2, pool.GetStats().classes[0].cached);
+
+  const size_t kLarge = BufferPool::kMaxClassSize + 1;
+  uint8_t* large = pool.Allocate(kLarge);
+  ASSERT_TRUE(large != nullptr);
+  EXPECT_EQ(static_cast<int64_t>(kLarge), pool.GetStats().bytes_in_use);
+  pool.Release(large, kLarge);
+  EXPECT_EQ(0, pool.GetStats().bytes_in_use);
+}
+
+TEST(BufferPool, HugePages) {
+  BufferPool::Options options;
+  options.huge_pages = true;
+  BufferPool pool(options);
+  BufferPool::Buffer buffer = pool.Get(3 << 20);
+  ASSERT_TRUE(buffer != nullptr);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer.get()) % (2 << 20));
+  memset(buffer.get(), 1, 4 << 20);
+}
+
+TEST(BufferPool, DefaultAcrossThreads) {
+  BufferPool* pool = BufferPool::Default();
+  const int64_t in_use = pool->GetStats().bytes_in_use;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([pool, t]() {
+      std::vector<BufferPool::Buffer> held;
+      for (int i = 0; i < 1000; ++i) {
+        held.push_back(pool->Get(4096 << (i % 3)));
+        memset(held.back().get(), t, 4096);
+        if (held.size() > 5) {
+          held.erase(held.begin());
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  BufferPool::Stats stats = pool->GetStats();
+  EXPECT_EQ(in_use, stats.bytes_in_use);
+  EXPECT_GT(stats.hits, stats.misses);
+}
+
+TEST(BufferPool, ReleaseAfterThreadCacheIsGone) {
+  BufferPool* pool = BufferPool::Default();
+  const int64_t in_use = pool->GetStats().bytes_in_use;
+  std::thread thread([pool]() {
+    static thread_local HeldAtExit held;
+    held.buffer = pool->Get(1 << 20);
+    pool->Get(1 << 20);
+  });
+  thread.join();
+  EXPECT_EQ(in_use, pool->GetStats().bytes_in_use);
+}
+
+TEST(BufferPool, Adaptors) {
+  BufferPool pool;
+  {
+    NullCopyOutputStream copy_output;
+    CopyOutputStreamAdaptor output(&copy_output, 10000);
+    output.SetBufferPool(&pool);
+    void* data;
+    int size;
+    ASSERT_TRUE(output.Next(&data, &size));
+    EXPECT_EQ(10000, size);
+    EXPECT_EQ(1, pool.GetStats().classes[2].in_use);
+
+    ZeroCopyInputStream copy_input;
+    CopyInputStreamAdaptor input(&copy_input, 10000);
+    input.SetBufferPool(&pool);
+    const void* in;
+    ASSERT_TRUE(input.Next(&in, &size));
+    EXPECT_EQ(2, pool.GetStats().classes[2].in_use);
+  }
+  BufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(2, stats.classes[2].cached);
+}
+
+} // namespace io
@@ -0,0 +1,188 @@
+#include "unittestes/io/io_test.h"
+#include "io/copy_input_stream.h"
+#include "io/copy_output_stream.h"
+#include "io/file_input_stream.h"
+#include "io/file_output_stream.h"
+
+#include "system/env.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+
+namespace io {
+
+namespace {
+
+// Reads a string at most |max_read| bytes at a time.
+class StringCopyInputStream : public CopyInputStream {
+ public:
+  StringCopyInputStream(const std::string& data, int max_read)
+      : data_(data), max_read_(max_read), position_(0) {}
+
+  virtual int Read(void* buffer, int size) override {
+    const int n = std::min<int>(std::min(size, max_read_),
+                                data_.size() - position_);
+    memcpy(buffer, data_.data() + position_, n);
+    position_ += n;
+    return n;
+  }
+
+ private:
+  const std::string data_;
+  const int max_read_;
+  int position_;
+};
+
+// Appends to a string, and fails once it would grow past |limit|.
+class StringCopyOutputStream : public CopyOutputStream {
+ public:
+  StringCopyOutputStream(std::string* target, size_t limit)
+      : target_(target), limit_(limit) {}
+
+  virtual bool Write(const void* buffer, int size) override {
+    if (target_->size() + size > limit_) {
+      return false;
+    }
+    target_->append(static_cast<const char*>(buffer), size);
+    return true;
+  }
+
+ private:
+  std::string* target_;
+  const size_t limit_;
+};
+
+} // namespace
+
+TEST_F(IoTest, CopyIoBackground) {
+  core::Env* env = core::Env::Default();
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    for (int j = 0; j < kBlockSizeCount; j++) {
+      std::string stuff;
+      {
+        StringCopyOutputStream copy_output(&stuff, 1 << 20);
+        CopyOutputStreamAdaptor output(&copy_output, kBlockSizes[i]);
+        output.SetWriteBehind(2, env);
+        WriteStuff(&output);
+        EXPECT_TRUE(output.Flush());
+      }
+      EXPECT_EQ(68u, stuff.size());
+
+      StringCopyInputStream copy_input(stuff, 5);
+      CopyInputStreamAdaptor input(&copy_input, kBlockSizes[j]);
+      input.SetReadAhead(3, env);
+      ReadStuff(&input);
+    }
+  }
+}
+
+TEST_F(IoTest, CopyIoBackgroundLarge) {
+  core::Env* env = core::Env::Default();
+  std::string text(300000, '\0');
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = static_cast<char>(i * 11 + i / 509);
+  }
+
+  std::string written;
+  {
+    StringCopyOutputStream copy_output(&written, text.size());
+    CopyOutputStreamAdaptor output(&copy_output, 1000);
+    output.SetWriteBehind(4, env);
+    EXPECT_TRUE(WriteToOutput(&output, text.data(), text.size()));
+    EXPECT_TRUE(output.Flush());
+    EXPECT_EQ(static_cast<int64_t>(text.size()), output.ByteCount());
+  }
+  EXPECT_EQ(text, written);
+
+  // Skips within the read-ahead and past it.
+  StringCopyInputStream copy_input(text, 777);
+  CopyInputStreamAdaptor input(&copy_input, 1000);
+  input.SetReadAhead(4, env);
+  std::string head(2500, '\0');
+  EXPECT_EQ(2500, ReadFromInput(&input, &head[0], head.size()));
+  EXPECT_EQ(text.substr(0, 2500), head);
+  EXPECT_TRUE(input.Skip(10));
+  EXPECT_TRUE(input.Skip(100000));
+  EXPECT_EQ(102510, input.ByteCount());
+  std::string rest(text.size(), '\0');
+  EXPECT_EQ(static_cast<int>(text.size()) - 102510,
+            ReadFromInput(&input, &rest[0], rest.size()));
+  EXPECT_EQ(text.substr(102510), rest.substr(0, text.size() - 102510));
+  EXPECT_FALSE(input.Skip(1));
+}
+
+// Close() while the thread is still reading ahead.
+TEST_F(IoTest, FileInputStreamCloseWithReadAhead) {
+  const std::string path = testing::TempDir() + "copy_io_" +
+                           std::to_string(getpid()) + "_read_ahead";
+  const std::string text(200000, 'r');
+  int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  ASSERT_GE(file, 0);
+  ASSERT_EQ(static_cast<ssize_t>(text.size()),
+            write(file, text.data(), text.size()));
+  ASSERT_EQ(0, lseek(file, 0, SEEK_SET));
+
+  for (int i = 0; i < 20; ++i) {
+    FileInputStream input(dup(file), 1000);
+    input.SetReadAhead(4, core::Env::Default());
+    std::string head(2500, '\0');
+    EXPECT_EQ(2500, ReadFromInput(&input, &head[0], head.size()));
+    EXPECT_EQ(text.substr(0, 2500), head);
+    EXPECT_TRUE(input.Close());
+    EXPECT_EQ(0, input.GetErrno());
+    const void* data;
+    int size;
+    EXPECT_FALSE(input.Next(&data, &size));
+    EXPECT_FALSE(input.Skip(1));
+    ASSERT_EQ(0, lseek(file, 0, SEEK_SET));
+  }
+  close(file);
+  unlink(path.c_str());
+}
+
+// Close() with write-behind: everything reaches the file, and nothing is
+// written after the descriptor is gone.
+TEST_F(IoTest, FileOutputStreamCloseWithWriteBehind) {
+  const std::string path = testing::TempDir() + "copy_io_" +
+                           std::to_string(getpid()) + "_write_behind";
+  const std::string text(200000, 'w');
+  for (int i = 0; i < 20; ++i) {
+    int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ASSERT_GE(file, 0);
+    {
+      FileOutputStream output(file, 1000);
+      output.SetWriteBehind(4, core::Env::Default());
+      EXPECT_TRUE(WriteToOutput(&output, text.data(), text.size()));
+      EXPECT_TRUE(output.Close());
+      EXPECT_EQ(0, output.GetErrno());
+      void* data;
+      int size;
+      EXPECT_FALSE(output.Next(&data, &size));
+      EXPECT_FALSE(output.Flush());
+    }
+    struct stat st;
+    ASSERT_EQ(0, stat(path.c_str(), &st));
+    EXPECT_EQ(static_cast<off_t>(text.size()), st.st_size);
+  }
+  unlink(path.c_str());
+}
+
+TEST_F(IoTest, CopyIoWriteBehindFailure) {
+  std::string written;
+  StringCopyOutputStream copy_output(&written, 2500);
+  CopyOutputStreamAdaptor output(&copy_output, 1000);
+  output.SetWriteBehind(2, core::Env::Default());
+  const std::string text(10000, 'x');
+  WriteToOutput(&output, text.data(), text.size());
+  EXPECT_FALSE(output.Flush());
+  EXPECT_EQ(2000u, written.size());
+  void* data;
+  int size;
+  EXPECT_FALSE(output.Next(&data, &size));
+}
+
+} // namespace io
@@ -0,0 +1,102 @@
+#include "unittestes/io/io_test.h"
+#include "io/mapped_file_input_stream.h"
+#include "io/string_output_stream.h"
+
+#include "files/file_system.h"
+#include "system/env.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+namespace io {
+
+namespace {
+
+std::string TestPath(const std::string& name) {
+  return "file://" + testing::TempDir() + "mapped_file_io_" +
+         std::to_string(getpid()) + "_" + name;
+}
+
+// A region over a string, to drive the stream without a file.
+class StringRegion : public files::ReadOnlyMemoryRegion {
+ public:
+  explicit StringRegion(const std::string& data) : data_(data) {}
+  virtual const void* data() override { return data_.data(); }
+  virtual uint64_t length() override { return data_.size(); }
+
+ private:
+  std::string data_;
+};
+
+} // namespace
+
+TEST_F(IoTest, MappedFileIo) {
+  core::Env* env = core::Env::Default();
+  const std::string path = TestPath("stuff");
+  std::string stuff;
+  {
+    StringOutputStream output(&stuff);
+    WriteStuff(&output);
+  }
+  ASSERT_TRUE(core::WriteStringToFile(env, path, stuff).ok());
+
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    std::unique_ptr<MappedFileInputStream> input;
+    ASSERT_TRUE(MappedFileInputStream::Open(env, path, &input,
+                                            kBlockSizes[i]).ok());
+    EXPECT_EQ(stuff.size(), input->size());
+    ReadStuff(input.get());
+  }
+  EXPECT_TRUE(env->DeleteFile(path).ok());
+}
+
+TEST_F(IoTest, MappedFileSlices) {
+  std::string text(10000, '\0');
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = static_cast<char>(i * 13);
+  }
+  StringRegion* region = new StringRegion(text);
+  const uint8_t* base = reinterpret_cast<const uint8_t*>(region->data());
+  MappedFileInputStream input(
+      std::unique_ptr<files::ReadOnlyMemoryRegion>(region), 4096, 1024);
+
+  // Slices point into the region, and Skip() and BackUp() move freely.
+  const void* data;
+  int size;
+  ASSERT_TRUE(input.Next(&data, &size));
+  EXPECT_EQ(base, data);
+  EXPECT_EQ(4096, size);
+  input.BackUp(96);
+  EXPECT_EQ(4000, input.ByteCount());
+  EXPECT_TRUE(input.Skip(5000));
+  ASSERT_TRUE(input.Next(&data, &size));
+  EXPECT_EQ(base + 9000, data);
+  EXPECT_EQ(1000, size);
+  EXPECT_EQ(0, memcmp(data, text.data() + 9000, size));
+  EXPECT_FALSE(input.Next(&data, &size));
+  EXPECT_EQ(10000, input.ByteCount());
+  EXPECT_FALSE(input.Skip(1));
+  EXPECT_EQ(10000, input.ByteCount());
+}
+
+TEST_F(IoTest, MappedFileEmpty) {
+  core::Env* env = core::Env::Default();
+  const std::string path = TestPath("empty");
+  ASSERT_TRUE(core::WriteStringToFile(env, path, "").ok());
+
+  std::unique_ptr<MappedFileInputStream> input;
+  ASSERT_TRUE(MappedFileInputStream::Open(env, path, &input).ok());
+  const void* data;
+  int size;
+  EXPECT_FALSE(input->Next(&data, &size));
+  EXPECT_TRUE(input->Skip(0));
+  EXPECT_FALSE(input->Skip(1));
+  EXPECT_EQ(0, input->ByteCount());
+  EXPECT_TRUE(env->DeleteFile(path).ok());
+
+  EXPECT_FALSE(MappedFileInputStream::Open(env, path, &input).ok());
+}
+
+} // namespace io